@@ -0,0 +1,1553 @@
+/*
+ *  Title: bench
+ *  Description: Host benchmarks for the sensor drivers. Bus timings are in
+ *               simulated time (SimI2CBus wire model at 400 kHz), so they are
+ *               exact and repeatable. CPU timings are wall-clock on the host.
+ *
+ *               Usage: bench [section ...]   (no arguments runs everything)
+ *               BENCH_TRACE=samples.csv adds a recorded trace (frame2csv
+ *               output) to the codec section.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <BME280.h>
+#include <BME280Fixed.h>
+#include <SCD30.h>
+#include <BusHealth.h>
+#include <SPIBus.h>
+#include <SensirionProtocol.h>
+#include <SampleRing.h>
+#include <WindowStats.h>
+#include <SampleRollup.h>
+#include <SampleFrame.h>
+#include <SampleCodec.h>
+#include <BusManager.h>
+#include <Trace.h>
+#include <DutyCycle.h>
+#include <EnergyMeter.h>
+#include <SampleLog.h>
+#include <DerivedMetrics.h>
+#include "SimClock.h"
+#include "SimI2CBus.h"
+#include "SimSPIBus.h"
+#include "BME280Sim.h"
+#include "SCD30Sim.h"
+#include "SimCalibrationStore.h"
+#include "SimFlash.h"
+
+/**
+ * Simulated BME280 on its own bus, brought up and ready to read.
+ */
+struct BME280Rig {
+    SimClock clock;
+    SimI2CBus bus{clock};
+    BME280Sim sim{clock};
+    BME280 bme{&bus, &clock, BME280_DEFAULT_I2CADDR};
+
+    BME280Rig() {
+        bus.attach(BME280_DEFAULT_I2CADDR, &sim);
+        bme.init();
+    }
+};
+
+/********** Timing helpers **********/
+
+#if defined(__x86_64__) || defined(__i386__)
+static const char *TICK_UNIT = "cycles";
+static uint64_t ticks(void) { return __rdtsc(); }
+#else
+static const char *TICK_UNIT = "ns";
+static uint64_t ticks(void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Distribution of the cost of one operation over many timed runs.
+ */
+struct Percentiles {
+    double min, p50, p90, p99, max;
+};
+
+/**
+ * Run body a few times untimed to warm caches and branch predictors, then
+ * time every further run on its own. A run does ops operations, so each
+ * result is per operation.
+ */
+template <typename Body>
+static Percentiles time_runs(int warmup, int runs, size_t ops, Body body) {
+    for (int i = 0; i < warmup; i++) body();
+
+    std::vector<double> per_op((size_t)runs);
+    for (int i = 0; i < runs; i++) {
+        uint64_t start = ticks();
+        body();
+        per_op[(size_t)i] = (double)(ticks() - start) / ops;
+    }
+    std::sort(per_op.begin(), per_op.end());
+
+    auto at = [&](double fraction) { return per_op[(size_t)(fraction * (runs - 1) + 0.5)]; };
+    return {per_op.front(), at(0.50), at(0.90), at(0.99), per_op.back()};
+}
+
+static void print_percentiles(const char *name, const Percentiles &p) {
+    printf("  %-28s %8.1f %8.1f %8.1f %8.1f %8.1f\n", name, p.min, p.p50, p.p90, p.p99, p.max);
+}
+
+/**
+ * Raw ADC triplets spread over the sensor's range, generated with a
+ * fixed-seed LCG so every run sees the same data.
+ */
+struct RawSamples {
+    std::vector<int32_t> temperature, pressure, humidity;
+
+    RawSamples(size_t n) : temperature(n), pressure(n), humidity(n) {
+        uint32_t state = 12345;
+        for (size_t i = 0; i < n; i++) {
+            state = state * 1664525u + 1013904223u;
+            temperature[i] = 400000 + (int32_t)((state >> 8) % 250000);
+            state = state * 1664525u + 1013904223u;
+            pressure[i] = 250000 + (int32_t)((state >> 8) % 300000);
+            state = state * 1664525u + 1013904223u;
+            humidity[i] = 15000 + (int32_t)((state >> 8) % 40000);
+        }
+    }
+};
+
+/********** BME280 read latency **********/
+
+///@brief The read path before repeated-start: address write with STOP, 10 ms, then read
+static bool legacy_read_registers(BME280Rig &rig, uint8_t reg, uint8_t count, uint8_t *data) {
+    if (rig.bus.write(BME280_DEFAULT_I2CADDR, &reg, 1, false, 100000) != 1) return false;
+    rig.clock.sleep_ms(10);
+    return rig.bus.read(BME280_DEFAULT_I2CADDR, data, count, false, 100000) == count;
+}
+
+static void bench_read_latency(void) {
+    const int N = 1000;
+    BME280Rig rig;
+    uint8_t data[8];
+
+    uint64_t start = rig.clock.time_us();
+    for (int i = 0; i < N; i++) legacy_read_registers(rig, BME280_PRESSURE_MSB, 8, data);
+    double legacy_read = (double)(rig.clock.time_us() - start) / N;
+
+    start = rig.clock.time_us();
+    for (int i = 0; i < N; i++) {
+        legacy_read_registers(rig, BME280_ID, 1, data);
+        legacy_read_registers(rig, BME280_PRESSURE_MSB, 8, data);
+    }
+    double legacy_loop = (double)(rig.clock.time_us() - start) / N;
+
+    start = rig.clock.time_us();
+    for (int i = 0; i < N; i++) rig.bme.read();
+    double read = (double)(rig.clock.time_us() - start) / N;
+
+    start = rig.clock.time_us();
+    for (int i = 0; i < N; i++) {
+        rig.bme.is_connected();
+        rig.bme.read();
+    }
+    double loop = (double)(rig.clock.time_us() - start) / N;
+
+    printf("                          STOP + 10 ms    repeated start\n");
+    printf("  read()                 %10.1f us     %10.1f us\n", legacy_read, read);
+    printf("  is_connected + read    %10.1f us     %10.1f us\n", legacy_loop, loop);
+}
+
+/********** BME280 forced mode **********/
+
+static void bench_forced(void) {
+    const int N = 100;
+    BME280Rig rig;
+    rig.bme.set_mode(BME280::SLEEP_MODE, BME280::OVERSAMPLING_RATE_16);
+
+    // Guessing with a sleep has to cover the worst case every time
+    uint64_t start = rig.clock.time_us();
+    for (int i = 0; i < N; i++) {
+        rig.bme.start_measurement();
+        rig.clock.sleep_us(rig.bme.max_measurement_time_us());
+        rig.bme.read();
+    }
+    double sleep_based = (double)(rig.clock.time_us() - start) / N;
+
+    rig.bus.reset_counters();
+    start = rig.clock.time_us();
+    for (int i = 0; i < N; i++) rig.bme.measure_once();
+    double polled = (double)(rig.clock.time_us() - start) / N;
+
+    printf("  conversion (typ)       %10u us\n", rig.sim.measurement_time_us());
+    printf("  conversion (max)       %10u us\n", rig.bme.max_measurement_time_us());
+    printf("  sleep max + read       %10.1f us\n", sleep_based);
+    printf("  measure_once           %10.1f us  (%.1f transfers)\n", polled,
+           (double)rig.bus.transfers() / N);
+}
+
+/********** BME280 configuration profiles **********/
+
+static void bench_profiles(void) {
+    struct {
+        const char *name;
+        BME280::Config config;
+    } profiles[] = {
+        {"weather monitoring", BME280::WEATHER_MONITORING},
+        {"humidity sensing", BME280::HUMIDITY_SENSING},
+        {"indoor navigation", BME280::INDOOR_NAVIGATION},
+        {"gaming", BME280::GAMING},
+        {"x16 everywhere", {BME280::NORMAL_MODE, BME280::OVERSAMPLING_RATE_16, BME280::OVERSAMPLING_RATE_16,
+                            BME280::OVERSAMPLING_RATE_16, BME280::FILTER_OFF, BME280::STANDBY_0_5_MS}},
+    };
+
+    printf("  %-20s %10s %10s %10s %12s %14s\n", "profile", "t_meas", "t_max", "period", "max rate", "configure");
+    for (auto &profile : profiles) {
+        BME280Rig rig;
+        rig.bus.reset_counters();
+        rig.bme.configure(profile.config);
+        uint32_t transfers = rig.bus.transfers();
+        uint32_t bytes = rig.bus.bytes();
+
+        // Normal mode: count the conversions the model completes in 10 s
+        double rate = 1e6 / BME280::sample_period_us(profile.config);
+        if (profile.config.mode == BME280::NORMAL_MODE) {
+            uint32_t before = rig.sim.conversions();
+            rig.clock.sleep_ms(10000);
+            rig.sim.reg(BME280_STATUS);
+            rate = (rig.sim.conversions() - before) / 10.0;
+        }
+
+        printf("  %-20s %7.2f ms %7.2f ms %7.2f ms %9.2f Hz %5u xfer %2u B\n", profile.name,
+               BME280::measurement_time_us(profile.config) / 1000.0,
+               BME280::max_measurement_time_us(profile.config) / 1000.0,
+               BME280::sample_period_us(profile.config) / 1000.0, rate, transfers, bytes);
+    }
+}
+
+/********** BME280 fixed-point output **********/
+
+static void bench_fixed(void) {
+    const size_t N = 1 << 20;
+    BME280Rig rig;
+    const BME280::BME_Comp_Coeff_t &coeffs = rig.bme.get_compensation_coefficients();
+    RawSamples raw(N);
+
+    // Best of a few rounds to keep scheduler noise out
+    uint64_t best_fixed = UINT64_MAX, best_float = UINT64_MAX;
+    int64_t fixed_sum = 0;
+    float float_sum = 0;
+    for (int round = 0; round < 5; round++) {
+        uint64_t start = ticks();
+        for (size_t i = 0; i < N; i++) {
+            int32_t t;
+            uint32_t p, h;
+            BME280::compensate_values(coeffs, &t, &p, &h, raw.temperature[i], raw.pressure[i], raw.humidity[i]);
+            fixed_sum += t + p + h;
+        }
+        uint64_t fixed = ticks() - start;
+
+        start = ticks();
+        for (size_t i = 0; i < N; i++) {
+            int32_t t;
+            uint32_t p, h;
+            BME280::compensate_values(coeffs, &t, &p, &h, raw.temperature[i], raw.pressure[i], raw.humidity[i]);
+            float_sum += (float)t / 100.0f + (float)p / 25600.0f + (float)h / 1024.0f;
+        }
+        uint64_t floating = ticks() - start;
+
+        if (fixed < best_fixed) best_fixed = fixed;
+        if (floating < best_float) best_float = floating;
+    }
+
+    printf("  fixed-point only       %8.1f %s/sample\n", (double)best_fixed / N, TICK_UNIT);
+    printf("  fixed-point + float    %8.1f %s/sample\n", (double)best_float / N, TICK_UNIT);
+    printf("  (checksums %lld %.1f)\n", (long long)fixed_sum, float_sum);
+}
+
+/********** BME280 batch compensation **********/
+
+static void bench_batch(void) {
+    const size_t N = 1 << 24;
+    BME280Rig rig;
+    const BME280::BME_Comp_Coeff_t &coeffs = rig.bme.get_compensation_coefficients();
+    RawSamples raw(N);
+    std::vector<int32_t> t_scalar(N), t_batch(N);
+    std::vector<uint32_t> p_scalar(N), p_batch(N), h_scalar(N), h_batch(N);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < N; i++) {
+        BME280::compensate_values(coeffs, &t_scalar[i], &p_scalar[i], &h_scalar[i],
+                                  raw.temperature[i], raw.pressure[i], raw.humidity[i]);
+    }
+    double scalar = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    BME280::compensate_batch(coeffs, raw.temperature.data(), raw.pressure.data(), raw.humidity.data(),
+                             t_batch.data(), p_batch.data(), h_batch.data(), N);
+    double batch = seconds_since(start);
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < N; i++) {
+        if (t_scalar[i] != t_batch[i] || p_scalar[i] != p_batch[i] || h_scalar[i] != h_batch[i]) mismatches++;
+    }
+
+    printf("  samples                %10zu\n", N);
+    printf("  compensate_values      %10.2f Msamples/s\n", N / scalar / 1e6);
+    printf("  compensate_batch       %10.2f Msamples/s\n", N / batch / 1e6);
+    printf("  one year at 1 Hz       %10.2f s (batch)\n", 365.0 * 86400.0 * batch / N);
+    printf("  mismatches             %10zu\n", mismatches);
+}
+
+/********** BME280 cold start **********/
+
+///@brief Power-on to the first valid sample, in simulated time
+static void cold_start(SimCalibrationStore *cache, uint64_t *init_us, uint64_t *first_sample_us, bool *cached) {
+    SimClock clock;
+    SimI2CBus bus(clock);
+    BME280Sim sim(clock);
+    bus.attach(BME280_DEFAULT_I2CADDR, &sim);
+    BME280 bme(&bus, &clock, BME280_DEFAULT_I2CADDR);
+
+    bme.init(cache);
+    *init_us = clock.time_us();
+    bme.configure(BME280::WEATHER_MONITORING);
+    bme.measure_once();
+    *first_sample_us = clock.time_us();
+    *cached = bme.used_cached_calibration();
+}
+
+static void bench_cold_start(void) {
+    SimCalibrationStore cache;
+    uint64_t init_us, first_us;
+    bool cached;
+
+    cold_start(nullptr, &init_us, &first_us, &cached);
+    printf("  no cache          init %6llu us   first sample %6llu us\n",
+           (unsigned long long)init_us, (unsigned long long)first_us);
+
+    cold_start(&cache, &init_us, &first_us, &cached);
+    printf("  first boot        init %6llu us   first sample %6llu us   (cached: %s)\n",
+           (unsigned long long)init_us, (unsigned long long)first_us, cached ? "yes" : "no");
+
+    cold_start(&cache, &init_us, &first_us, &cached);
+    printf("  warm boot         init %6llu us   first sample %6llu us   (cached: %s)\n",
+           (unsigned long long)init_us, (unsigned long long)first_us, cached ? "yes" : "no");
+
+    cache.corrupt(12);
+    cold_start(&cache, &init_us, &first_us, &cached);
+    printf("  corrupted cache   init %6llu us   first sample %6llu us   (cached: %s)\n",
+           (unsigned long long)init_us, (unsigned long long)first_us, cached ? "yes" : "no");
+}
+
+/********** Driver **********/
+
+static void bench_async(void) {
+    const int N = 100;
+    const uint64_t SLICE_US = 50;   // Other work done between two polls
+    BME280Rig rig;
+
+    uint64_t blocked = 0;
+    for (int i = 0; i < N; i++) {
+        uint64_t start = rig.clock.time_us();
+        rig.bme.read();
+        blocked += rig.clock.time_us() - start;
+    }
+    printf("  BME280 read()          %10.1f us blocked\n", (double)blocked / N);
+
+    uint64_t latency = 0;
+    for (int i = 0; i < N; i++) {
+        uint64_t start = rig.clock.time_us();
+        rig.bme.start_read();
+        while (rig.bme.poll_read() == BME280::MEASUREMENT_PENDING) rig.clock.advance_us(SLICE_US);
+        latency += rig.clock.time_us() - start;
+    }
+    printf("  BME280 start_read()    %10.1f us blocked, result after %.1f us (poll every %llu us)\n",
+           0.0, (double)latency / N, (unsigned long long)SLICE_US);
+
+    SimClock clock;
+    SimI2CBus bus(clock);
+    SCD30Sim sim(clock);
+    bus.attach(SCD30_DEFAULT_I2CADDR, &sim);
+    SCD30 scd(&bus, &clock);
+    scd.init();
+
+    blocked = 0;
+    for (int i = 0; i < N; i++) {
+        clock.sleep_ms(2000);
+        uint64_t start = clock.time_us();
+        scd.read();
+        blocked += clock.time_us() - start;
+    }
+    printf("  SCD30 read()           %10.1f us blocked\n", (double)blocked / N);
+
+    latency = 0;
+    for (int i = 0; i < N; i++) {
+        clock.sleep_ms(2000);
+        uint64_t start = clock.time_us();
+        scd.startRead();
+        while (scd.pollRead() == SCD30::READ_PENDING) clock.advance_us(SLICE_US);
+        latency += clock.time_us() - start;
+    }
+    printf("  SCD30 startRead()      %10.1f us blocked, result after %.1f us (poll every %llu us)\n",
+           0.0, (double)latency / N, (unsigned long long)SLICE_US);
+}
+
+static void bench_ring(void) {
+    const uint32_t N = 5000000;
+    SampleRing *ring = new SampleRing();
+    std::atomic<bool> done(false);
+
+    // Throughput with the consumer keeping up
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&]() {
+        Sample sample;
+        while (true) {
+            bool finished = done.load(std::memory_order_acquire);
+            if (!ring->pop(sample)) {
+                if (finished) break;
+                std::this_thread::yield();
+            }
+        }
+    });
+    Sample sample = {};
+    for (uint32_t i = 0; i < N; i++) {
+        sample.values[0] = (int32_t)i;
+        while (!ring->push(sample)) std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    double seconds = seconds_since(start);
+    printf("  two threads            %10.1f Msamples/s\n", N / seconds / 1e6);
+    delete ring;
+
+    // Cost of push() while the consumer is stuck (e.g. in a slow printf)
+    ring = new SampleRing();
+    const int PUSHES = 100000;
+    uint64_t worst = 0, total = 0;
+    for (int i = 0; i < PUSHES; i++) {
+        uint64_t t0 = ticks();
+        ring->push(sample);
+        uint64_t cost = ticks() - t0;
+        total += cost;
+        if (cost > worst) worst = cost;
+    }
+    printf("  push, consumer stalled %10.1f %s avg, %llu worst, %u dropped\n", (double)total / PUSHES, TICK_UNIT,
+           (unsigned long long)worst, ring->overflows());
+    delete ring;
+}
+
+static void bench_window(void) {
+    const int N = 1000000;
+    const size_t CAPACITY = 1024;
+    const uint64_t WINDOW_US = 600000000;    // 10 min at 1 Hz, 600 entries
+    RawSamples raw(N);
+    WindowStats<CAPACITY> *stats = new WindowStats<CAPACITY>(WINDOW_US);
+    volatile double sink = 0;
+
+    uint64_t start = ticks();
+    for (int i = 0; i < N; i++) {
+        stats->add((uint64_t)i * 1000000, raw.temperature[i]);
+        WindowSummary summary = stats->summary();
+        sink = summary.mean + summary.variance + summary.min + summary.max;
+    }
+    double incremental = (double)(ticks() - start) / N;
+
+    // The same query answered by scanning the 600 entries each time
+    const int M = 20000;
+    start = ticks();
+    for (int i = 600; i < 600 + M; i++) {
+        int32_t min = raw.temperature[i - 599], max = min;
+        double sum = 0, sum_sq = 0;
+        for (int j = i - 599; j <= i; j++) {
+            int32_t v = raw.temperature[j];
+            min = v < min ? v : min;
+            max = v > max ? v : max;
+            sum += v;
+        }
+        double mean = sum / 600;
+        for (int j = i - 599; j <= i; j++) sum_sq += (raw.temperature[j] - mean) * (raw.temperature[j] - mean);
+        sink = mean + sum_sq / 600 + min + max;
+    }
+    double rescan = (double)(ticks() - start) / M;
+    (void)sink;
+
+    printf("  add + summary          %10.1f %s\n", incremental, TICK_UNIT);
+    printf("  rescan of 600 entries  %10.1f %s\n", rescan, TICK_UNIT);
+    delete stats;
+}
+
+static void bench_frame(void) {
+    const int N = 1000000;
+    BME280Rig rig;
+    RawSamples raw(N);
+    const BME280::BME_Comp_Coeff_t &coeffs = rig.bme.get_compensation_coefficients();
+    std::vector<Sample> samples(N);
+    for (int i = 0; i < N; i++) {
+        int32_t t;
+        uint32_t p, h;
+        BME280::compensate_values(coeffs, &t, &p, &h, raw.temperature[i], raw.pressure[i], raw.humidity[i]);
+        samples[i] = {(uint64_t)i * 1000, SENSOR_BME280, 0, (uint16_t)i, {t, (int32_t)p, (int32_t)h}};
+    }
+
+    // The text main.cpp used to print for every sample
+    char text[256];
+    size_t text_bytes = 0;
+    uint64_t start = ticks();
+    for (int i = 0; i < N; i++) {
+        const Sample &s = samples[i];
+        text_bytes += snprintf(text, sizeof(text),
+                               "[AFLESTUR]\n       Hitastig :  %.2f °C            \n Loftþrýstingur :  %.2f hPa"
+                               "           \n       Rakastig :  %.2f%%             \n\033[F\033[F\033[F\033[F",
+                               s.values[0] / 100.0f, (uint32_t)s.values[1] / 25600.0f, (uint32_t)s.values[2] / 1024.0f);
+    }
+    double text_cost = (double)(ticks() - start) / N;
+
+    std::vector<uint8_t> stream((size_t)N * FRAME_LENGTH);
+    start = ticks();
+    for (int i = 0; i < N; i++) frame_encode(samples[i], &stream[(size_t)i * FRAME_LENGTH]);
+    double encode_cost = (double)(ticks() - start) / N;
+
+    FrameDecoder decoder;
+    Sample decoded[256];
+    size_t count, offset = 0;
+    start = ticks();
+    while (offset < stream.size()) offset += decoder.feed(&stream[offset], stream.size() - offset, decoded, 256, &count);
+    double decode_cost = (double)(ticks() - start) / N;
+
+    printf("  text (printf %%.2f)     %10.1f bytes  %10.1f %s/sample\n", (double)text_bytes / N, text_cost, TICK_UNIT);
+    printf("  binary frame           %10d bytes  %10.1f %s/sample\n", FRAME_LENGTH, encode_cost, TICK_UNIT);
+    printf("  frame decode           %10s        %10.1f %s/sample  (%u frames, %u errors)\n", "", decode_cost,
+           TICK_UNIT, decoder.frames(), decoder.crc_errors());
+}
+
+/**
+ * Synthetic trace: a slow drift plus sensor noise of the given size per
+ * value (in the fixed-point units of Sample.h), with a little timestamp
+ * jitter and an occasional lost sample.
+ */
+static std::vector<Sample> synthetic_trace(uint8_t sensor, int count, uint64_t period_us, const int32_t start[3],
+                                           const int32_t noise[3]) {
+    std::vector<Sample> trace(count);
+    uint32_t seed = 2024 + sensor;
+    uint64_t time = 0;
+    uint16_t sequence = 0;
+    int32_t drift[3] = {start[0], start[1], start[2]};
+    for (int i = 0; i < count; i++) {
+        seed = seed * 1664525 + 1013904223;
+        time += period_us + (seed >> 29);
+        sequence += (seed % 500 == 0) ? 2 : 1;
+        Sample &sample = trace[i];
+        sample = {time, sensor, 0, sequence, {0, 0, 0}};
+        for (int v = 0; v < 3; v++) {
+            seed = seed * 1664525 + 1013904223;
+            if ((seed >> 24) < 8) drift[v] += ((seed >> 20) & 1) ? 1 : -1;
+            sample.values[v] = drift[v] + (int32_t)((seed >> 8) % (2 * noise[v] + 1)) - noise[v];
+        }
+    }
+    return trace;
+}
+
+/**
+ * Recorded trace in the CSV format frame2csv writes, converted back to
+ * fixed point. Only samples of the first sensor and channel are kept.
+ */
+static std::vector<Sample> recorded_trace(const char *path) {
+    std::vector<Sample> trace;
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        perror(path);
+        return trace;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long long timestamp;
+        unsigned sensor, channel, sequence;
+        char name[16];
+        double t = 0, p = 0, h = 0, co2 = 0;
+        if (sscanf(line, "%llu,%u,%u,%u,%15[^,],%lf,%lf,%lf,%lf", &timestamp, &sensor, &channel, &sequence, name,
+                   &t, &p, &h, &co2) < 6) {
+            if (sscanf(line, "%llu,%u,%u,%u,%15[^,],%lf,,%lf,%lf", &timestamp, &sensor, &channel, &sequence, name,
+                       &t, &h, &co2) < 8) continue;
+        }
+        if (!trace.empty() && (trace[0].sensor != sensor || trace[0].channel != channel)) continue;
+        Sample sample = {timestamp, (uint8_t)sensor, (uint8_t)channel, (uint16_t)sequence, {0, 0, 0}};
+        if (sensor == SENSOR_BME280) {
+            sample.values[0] = (int32_t)lround(t * 100);
+            sample.values[1] = (int32_t)llround(p * 256);
+            sample.values[2] = (int32_t)lround(h * 1024);
+        } else {
+            sample.values[0] = (int32_t)lround(co2 * 100);
+            sample.values[1] = (int32_t)lround(t * 100);
+            sample.values[2] = (int32_t)lround(h * 100);
+        }
+        trace.push_back(sample);
+    }
+    fclose(file);
+    return trace;
+}
+
+static void codec_run(const char *name, const std::vector<Sample> &trace) {
+    if (trace.empty()) return;
+    const int REPEAT = 20;
+    std::vector<uint8_t> stream(trace.size() * CODEC_RECORD_MAX + CODEC_MAX_BLOCK_LENGTH * 2);
+    size_t length = 0;
+
+    uint64_t start = ticks();
+    for (int r = 0; r < REPEAT; r++) {
+        SampleEncoder encoder;
+        length = 0;
+        for (const Sample &sample : trace) length += encoder.add(sample, &stream[length]);
+        length += encoder.flush(&stream[length]);
+    }
+    double encode_cost = (double)(ticks() - start) / (REPEAT * trace.size());
+
+    std::vector<Sample> decoded(trace.size() + CODEC_BLOCK_SAMPLES);
+    size_t total = 0;
+    start = ticks();
+    for (int r = 0; r < REPEAT; r++) {
+        SampleDecoder decoder;
+        size_t offset = 0, count;
+        total = 0;
+        while (offset < length) {
+            offset += decoder.feed(&stream[offset], length - offset, &decoded[total], decoded.size() - total, &count);
+            total += count;
+        }
+    }
+    double decode_cost = (double)(ticks() - start) / (REPEAT * trace.size());
+    bool lossless = (total == trace.size()) && memcmp(decoded.data(), trace.data(), total * sizeof(Sample)) == 0;
+
+    double per_sample = (double)length / trace.size();
+    printf("  %-22s %7zu samples %6.2f B/sample  %5.1fx vs frame  %5.1fx vs float record"
+           "  enc %6.1f dec %6.1f %s/sample%s\n", name, trace.size(), per_sample, FRAME_LENGTH / per_sample,
+           20.0 / per_sample, encode_cost, decode_cost, TICK_UNIT, lossless ? "" : "  MISMATCH");
+}
+
+static void bench_codec(void) {
+    // BME280 at 1 Hz: 0.01 °C, Pa/256 and %RH/1024 noise as seen at x1 oversampling
+    const int32_t bme_start[3] = {2150, 101325 * 256, 45 * 1024};
+    const int32_t bme_noise[3] = {1, 400, 20};
+    codec_run("BME280 1 Hz", synthetic_trace(SENSOR_BME280, 100000, 1000000, bme_start, bme_noise));
+
+    // Same sensor with the IIR filter on, much less noise
+    const int32_t filtered_noise[3] = {0, 40, 4};
+    codec_run("BME280 1 Hz, filter 16", synthetic_trace(SENSOR_BME280, 100000, 1000000, bme_start, filtered_noise));
+
+    // SCD30 every 2 s: 0.01 ppm, 0.01 °C, 0.01 %RH from float conversions
+    const int32_t scd_start[3] = {65000, 2250, 4100};
+    const int32_t scd_noise[3] = {300, 3, 5};
+    codec_run("SCD30 0.5 Hz", synthetic_trace(SENSOR_SCD30, 50000, 2000000, scd_start, scd_noise));
+
+    const char *path = getenv("BENCH_TRACE");
+    if (path != nullptr) codec_run(path, recorded_trace(path));
+}
+
+/**
+ * Two BME280 read at 1 kHz each plus an SCD30, with everything on one
+ * controller or the second BME280 moved to the other controller.
+ */
+static void scheduler_run(const char *name, bool split) {
+    SimClock clock;
+    SimI2CBus bus0(clock), bus1(clock);
+    BME280Sim bme0_sim(clock), bme1_sim(clock);
+    SCD30Sim scd_sim(clock);
+    SimI2CBus &second = split ? bus1 : bus0;
+    bus0.attach(BME280_DEFAULT_I2CADDR, &bme0_sim);
+    second.attach(BME280_ALTERNATE_I2CADDR, &bme1_sim);
+    bus0.attach(SCD30_DEFAULT_I2CADDR, &scd_sim);
+
+    BME280 bme0(&bus0, &clock, BME280_DEFAULT_I2CADDR), bme1(&second, &clock, BME280_ALTERNATE_I2CADDR);
+    SCD30 scd(&bus0, &clock);
+    bme0.init();
+    bme1.init();
+    scd.init();
+    bme0.configure(BME280::GAMING);
+    bme1.configure(BME280::GAMING);
+
+    BME280Task bme0_task(&bme0, 0), bme1_task(&bme1, 1);
+    SCD30Task scd_task(&scd);
+    BusManager manager(&clock);
+    int b0 = manager.add_bus(&bus0), b1 = manager.add_bus(&bus1);
+    manager.add_sensor(&bme0_task, b0, 1000);
+    manager.add_sensor(&bme1_task, split ? b1 : b0, 1000);
+    manager.add_sensor(&scd_task, b0, 2000000);
+
+    manager.start();
+    uint64_t end = clock.time_us() + 10000000;
+    while (clock.time_us() < end) {
+        manager.poll();
+        clock.advance_us(10);
+    }
+
+    printf("  %s\n", name);
+    const char *names[3] = {"BME280 0x76 1 kHz", "BME280 0x77 1 kHz", "SCD30 0.5 Hz"};
+    for (int i = 0; i < 3; i++) {
+        SensorStats stats = manager.stats(i);
+        printf("    %-18s %9.3f Hz  jitter mean %6.1f us  sd %6.1f us  max %5u us  overruns %u\n", names[i],
+               stats.rate_hz, stats.jitter_mean_us, stats.jitter_stddev_us, stats.jitter_max_us, stats.overruns);
+    }
+}
+
+static void bench_scheduler(void) {
+    scheduler_run("one controller", false);
+    scheduler_run("two controllers", true);
+}
+
+/**
+ * CRC of one SCD30 measurement response (six words), the way SCD30.cpp
+ * did it before and with the table, plus the full checked decode.
+ */
+static void bench_sensirion(void) {
+    const int N = 1000000;
+    std::vector<uint8_t> responses((size_t)N * 18);
+    for (size_t i = 0; i < responses.size(); i++) responses[i] = (uint8_t)(i * 2654435761u >> 13);
+
+    volatile uint32_t sink = 0;
+    uint64_t start = ticks();
+    for (int i = 0; i < N; i++) {
+        const uint8_t *response = &responses[(size_t)i * 18];
+        uint32_t errors = 0;
+        for (int w = 0; w < 6; w++) {
+            if (sensirion_crc8_bitwise(response + 3 * w, 2) != response[3 * w + 2]) errors |= 1u << w;
+        }
+        sink = sink + errors;
+    }
+    double bitwise_cost = (double)(ticks() - start) / N;
+
+    start = ticks();
+    for (int i = 0; i < N; i++) {
+        const uint8_t *response = &responses[(size_t)i * 18];
+        uint32_t errors = 0;
+        for (int w = 0; w < 6; w++) {
+            if (sensirion_crc8(response + 3 * w, 2) != response[3 * w + 2]) errors |= 1u << w;
+        }
+        sink = sink + errors;
+    }
+    double table_cost = (double)(ticks() - start) / N;
+
+    uint16_t words[6];
+    start = ticks();
+    for (int i = 0; i < N; i++) sink = sink + sensirion_decode_words(&responses[(size_t)i * 18], 6, words);
+    double decode_cost = (double)(ticks() - start) / N;
+
+    printf("  CRC-8 bitwise, 6 words          %8.1f %s/response\n", bitwise_cost, TICK_UNIT);
+    printf("  CRC-8 table, 6 words            %8.1f %s/response\n", table_cost, TICK_UNIT);
+    printf("  sensirion_decode_words, 6 words %8.1f %s/response\n", decode_cost, TICK_UNIT);
+}
+
+/**
+ * One minute of SCD30 readings at its 2 s interval. The polling loop asks
+ * data ready every 100 ms and reads with the blocking calls, as main.cpp
+ * did; the event modes read without blocking.
+ */
+static void scd30_events_run(const char *name, int mode) {
+    const uint64_t RUN_US = 60000000;
+    SimClock clock;
+    SimI2CBus bus(clock);
+    SCD30Sim sim(clock);
+    bus.attach(SCD30_DEFAULT_I2CADDR, &sim);
+    SCD30 scd(&bus, &clock);
+    scd.init();
+    bus.reset_counters();
+
+    uint64_t blocked = 0;
+    uint32_t wakeups = 0;
+    uint64_t end = clock.time_us() + RUN_US;
+    if (mode == 0) {
+        while (clock.time_us() < end) {
+            uint64_t start = clock.time_us();
+            if (scd.dataReady()) scd.read();
+            blocked += clock.time_us() - start;
+            wakeups++;
+            clock.advance_us(100000);
+        }
+    } else {
+        SCD30::EventSource source = (mode == 1) ? SCD30::EVENTS_TIMED : SCD30::EVENTS_RDY_PIN;
+        scd.beginEvents(source, nullptr);
+        bool rdy = false;
+        while (clock.time_us() < end) {
+            if (source == SCD30::EVENTS_RDY_PIN) {
+                if (sim.rdy() && !rdy) scd.notifyDataReady();
+                rdy = sim.rdy();
+            }
+            uint64_t start = clock.time_us();
+            scd.service();
+            blocked += clock.time_us() - start;
+            wakeups++;
+
+            // Sleep until the next deadline, the end of a transfer or an edge on RDY (1 ms resolution)
+            uint64_t next = scd.nextServiceUs();
+            if (bus.busy() && bus.completes_at() < next) next = bus.completes_at();
+            while (clock.time_us() < next) {
+                if (source == SCD30::EVENTS_RDY_PIN) {
+                    if (sim.rdy() && !rdy) break;
+                    rdy = sim.rdy();
+                }
+                uint64_t step = next - clock.time_us();
+                if (source == SCD30::EVENTS_RDY_PIN && step > 1000) step = 1000;
+                clock.advance_us(step);
+            }
+        }
+    }
+
+    uint32_t reads = sim.measurements_read();
+    printf("  %-26s %3u reads  %8.1f us blocked/read  %5.1f transfers/read  %5.1f bytes/read  %5u wakeups\n",
+           name, reads, (double)blocked / reads, (double)bus.transfers() / reads, (double)bus.bytes() / reads,
+           wakeups);
+}
+
+static void bench_scd30_events(void) {
+    scd30_events_run("poll dataReady() 100 ms", 0);
+    scd30_events_run("event mode, timed", 1);
+    scd30_events_run("event mode, RDY pin", 2);
+}
+
+/**
+ * Cost of one BME280 read when the bus or the sensor misbehaves: the old
+ * fixed 100 ms timeouts, timeouts derived from the transfer length, and
+ * the same behind BusHealth (3 attempts, 200 us backoff, bus clear after
+ * two timeouts).
+ */
+static void bench_bus_health(void) {
+    uint8_t data[8];
+    uint8_t reg = BME280_PRESSURE_MSB;
+
+    printf("                            SDA held low            sensor NAKs\n");
+    {
+        BME280Rig rig;
+        rig.bus.hold_sda();
+        uint64_t start = rig.clock.time_us();
+        bool ok = rig.bus.write(BME280_DEFAULT_I2CADDR, &reg, 1, true, 100000) == 1 &&
+                  rig.bus.read(BME280_DEFAULT_I2CADDR, data, 8, false, 100000) == 8;
+        uint64_t held = rig.clock.time_us() - start;
+        rig.bus.recover();
+        rig.bus.inject_faults(BME280_DEFAULT_I2CADDR, 1, BUS_ERROR_GENERIC);
+        start = rig.clock.time_us();
+        bool nak_ok = rig.bus.write(BME280_DEFAULT_I2CADDR, &reg, 1, true, 100000) == 1 &&
+                      rig.bus.read(BME280_DEFAULT_I2CADDR, data, 8, false, 100000) == 8;
+        uint64_t nak = rig.clock.time_us() - start;
+        printf("  fixed 100 ms timeouts  %8llu us %-8s   %8llu us %s\n", (unsigned long long)held,
+               ok ? "ok" : "failed", (unsigned long long)nak, nak_ok ? "ok" : "failed");
+    }
+    {
+        BME280Rig rig;
+        rig.bus.hold_sda();
+        uint64_t start = rig.clock.time_us();
+        bool ok = rig.bme.read();
+        uint64_t held = rig.clock.time_us() - start;
+        rig.bus.recover();
+        rig.bus.inject_faults(BME280_DEFAULT_I2CADDR, 1, BUS_ERROR_GENERIC);
+        start = rig.clock.time_us();
+        bool nak_ok = rig.bme.read();
+        uint64_t nak = rig.clock.time_us() - start;
+        printf("  length-derived         %8llu us %-8s   %8llu us %s\n", (unsigned long long)held,
+               ok ? "ok" : "failed", (unsigned long long)nak, nak_ok ? "ok" : "failed");
+    }
+    {
+        BME280Rig rig;
+        BusHealth health(&rig.bus, &rig.clock);
+        BME280 bme(&health, &rig.clock, BME280_DEFAULT_I2CADDR);
+        bme.init();
+        rig.bus.hold_sda();
+        uint64_t start = rig.clock.time_us();
+        bool ok = bme.read();
+        uint64_t held = rig.clock.time_us() - start;
+        rig.bus.inject_faults(BME280_DEFAULT_I2CADDR, 1, BUS_ERROR_GENERIC);
+        start = rig.clock.time_us();
+        bool nak_ok = bme.read();
+        uint64_t nak = rig.clock.time_us() - start;
+        printf("  BusHealth              %8llu us %-8s   %8llu us %s\n", (unsigned long long)held,
+               ok ? "ok" : "failed", (unsigned long long)nak, nak_ok ? "ok" : "failed");
+    }
+}
+
+/// Clock that costs nothing, so only the bookkeeping of a span is measured
+class TickClock : public Clock {
+public:
+    uint64_t time_us(void) override { return _now++; }
+    void sleep_us(uint64_t us) override { _now += us; }
+private:
+    uint64_t _now = 0;
+};
+
+/**
+ * Cost of the instrumentation: one span with two transfers, as
+ * BME280::read() records it. Zero when built with TRACE_ENABLED=0.
+ */
+static void bench_trace(void) {
+    const int N = 1000000;
+    TickClock tick_clock;
+    trace_reset();
+
+    uint64_t start = ticks();
+    for (int i = 0; i < N; i++) {
+        TraceSpan span(TRACE_BME280_READ, BME280_DEFAULT_I2CADDR, &tick_clock);
+        span.transfer(1, 1);
+        span.transfer(8, 8);
+        span.finish(true);
+    }
+    double per_span = (double)(ticks() - start) / N;
+
+    printf("  TRACE_ENABLED=%d\n", TRACE_ENABLED);
+    printf("  span with two transfers   %8.1f %s\n", per_span, TICK_UNIT);
+}
+
+/**
+ * The per-sample math on the read path, timed per operation with warm-up
+ * and percentiles. sim_run checks the same functions against golden
+ * vectors, so a faster version can be shown to be bit-exact as well.
+ */
+static void bench_hot_math(void) {
+    const int WARMUP = 50, RUNS = 2000;
+    const size_t N = 1024;
+    BME280Rig rig;
+    const BME280::BME_Comp_Coeff_t &coeffs = rig.bme.get_compensation_coefficients();
+    RawSamples raw(N);
+    std::vector<int32_t> t(N);
+    std::vector<uint32_t> p(N), h(N);
+    volatile uint32_t sink = 0;
+
+    printf("  %s per operation              min      p50      p90      p99      max\n", TICK_UNIT);
+
+    print_percentiles("compensate_values", time_runs(WARMUP, RUNS, N, [&]() {
+        for (size_t i = 0; i < N; i++) {
+            BME280::compensate_values(coeffs, &t[i], &p[i], &h[i], raw.temperature[i], raw.pressure[i],
+                                      raw.humidity[i]);
+        }
+        sink = sink + p[N - 1];
+    }));
+
+    print_percentiles("compensate_batch, per sample", time_runs(WARMUP, RUNS, N, [&]() {
+        BME280::compensate_batch(coeffs, raw.temperature.data(), raw.pressure.data(), raw.humidity.data(),
+                                 t.data(), p.data(), h.data(), N);
+        sink = sink + p[N - 1];
+    }));
+
+    uint8_t registers[BME280_COMPENSATION_LENGTH];
+    for (size_t i = 0; i < sizeof(registers); i++) registers[i] = rig.sim.reg(i < 26 ? 0x88 + i : 0xE1 + i - 26);
+    BME280::BME_Comp_Coeff_t unpacked;
+    print_percentiles("unpack_compensation_data", time_runs(WARMUP, RUNS, 64, [&]() {
+        for (int i = 0; i < 64; i++) {
+            registers[0] = (uint8_t)i;
+            BME280::unpack_compensation_data(registers, unpacked);
+            sink = sink + unpacked.dig_T1;
+        }
+    }));
+
+    std::vector<uint8_t> responses(N * 18);
+    for (size_t i = 0; i < responses.size(); i++) responses[i] = (uint8_t)(i * 2654435761u >> 13);
+    print_percentiles("sensirion_crc8, per word", time_runs(WARMUP, RUNS, N * 6, [&]() {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < N * 6; i++) sum += sensirion_crc8(&responses[i * 3], 2);
+        sink = sink + sum;
+    }));
+
+    print_percentiles("SCD30 response to 3 floats", time_runs(WARMUP, RUNS, N, [&]() {
+        uint16_t words[6];
+        float sum = 0;
+        for (size_t i = 0; i < N; i++) {
+            sensirion_decode_words(&responses[i * 18], 6, words);
+            sum += sensirion_words_to_float(words) + sensirion_words_to_float(words + 2) +
+                   sensirion_words_to_float(words + 4);
+        }
+        sink = sink + (uint32_t)(sum != 0);
+    }));
+}
+
+
+/********** Low-power mode **********/
+
+/**
+ * BME280 and optionally an SCD30 on a simulated bus, with every sleep of the
+ * drivers counted by the meter.
+ */
+struct PowerRig {
+    SimClock clock;
+    SimI2CBus bus{clock};
+    BME280Sim bme_sim{clock};
+    SCD30Sim scd_sim{clock};
+    EnergyMeter meter;
+    BME280 bme{&bus, &meter, BME280_DEFAULT_I2CADDR};
+    SCD30 scd{&bus, &meter};
+
+    PowerRig(const PowerModel &model, bool with_scd30) : meter(&clock, model) {
+        bus.attach(BME280_DEFAULT_I2CADDR, &bme_sim);
+        if (with_scd30) bus.attach(SCD30_DEFAULT_I2CADDR, &scd_sim);
+        bme.init();
+        if (with_scd30) scd.init();
+    }
+};
+
+static void print_energy(const char *name, const EnergyReport &report) {
+    printf("  %-26s %9.0f %11.1f %10.0f %8.1f\n", name, report.active_us_per_sample(),
+           report.energy_uj_per_sample(), report.average_ua, report.battery_days(2000));
+}
+
+/// main.cpp loop(): x16 from init(), is_connected + measure_once, then sleep 1 s
+static EnergyReport run_legacy(const PowerModel &model, bool with_scd30, uint64_t duration_us) {
+    PowerRig rig(model, with_scd30);
+    if (with_scd30) rig.meter.set_scd30_interval(2);
+    rig.meter.reset();
+    uint64_t end = rig.clock.time_us() + duration_us;
+    while (rig.clock.time_us() < end) {
+        rig.bme.is_connected();
+        rig.bme.measure_once();
+        rig.meter.bme280_conversion(rig.bme.measurement_time_us());
+        rig.meter.sample();
+        if (with_scd30 && rig.scd.dataReady()) rig.scd.read();
+        rig.meter.sleep_us(1000000);
+    }
+    return rig.meter.report();
+}
+
+static EnergyReport run_duty_cycle(const PowerModel &model, bool with_scd30, uint32_t period_us,
+                                   uint64_t duration_us) {
+    PowerRig rig(model, with_scd30);
+    DutyCycle duty(&rig.meter, &rig.meter);
+    duty.begin(&rig.bme, period_us, with_scd30 ? &rig.scd : nullptr);
+    rig.meter.reset();
+    uint64_t end = rig.clock.time_us() + duration_us;
+    while (rig.clock.time_us() < end) duty.run_once();
+    return rig.meter.report();
+}
+
+static void bench_low_power(void) {
+    const uint64_t HOUR = 3600ull * 1000000;
+
+    // The legacy loop waits with the SDK sleep_us(), so it only ever gets WFE
+    const PowerModel *models[] = {&WFE_POWER_MODEL, &DEFAULT_POWER_MODEL};
+    const char *model_names[] = {"PicoClock, WFE between samples", "PicoSleepClock, sleep state between samples"};
+    for (int m = 0; m < 2; m++) {
+        const PowerModel &model = *models[m];
+        printf("  %s, MCU %.0f uA active / %.0f uA asleep, one simulated hour, 2000 mAh\n", model_names[m],
+               model.mcu_active_ua, model.mcu_sleep_ua);
+        printf("  %-26s %9s %11s %10s %8s\n", "", "active us", "uJ/sample", "avg uA", "days");
+        for (int with_scd30 = 0; with_scd30 < 2; with_scd30++) {
+            const char *suffix = with_scd30 ? " + SCD30" : "";
+            char name[48];
+            if (&model == &WFE_POWER_MODEL) {
+                snprintf(name, sizeof(name), "legacy x16 1 s%s", suffix);
+                print_energy(name, run_legacy(model, with_scd30, HOUR));
+            }
+            const uint32_t periods_s[] = {1, 10, 60};
+            for (uint32_t period : periods_s) {
+                snprintf(name, sizeof(name), "forced x1 %u s%s", period, suffix);
+                print_energy(name, run_duty_cycle(model, with_scd30, period * 1000000, HOUR));
+            }
+        }
+    }
+}
+
+
+/********** Flash sample log **********/
+
+static void count_drained(const Sample &, uint32_t, void *context) {
+    (*static_cast<uint32_t *>(context))++;
+}
+
+static void bench_flash_log(void) {
+    const uint32_t REGION = 512 * 1024;
+    const uint32_t N = 100000;
+    const char *image = "bench_flash.img";
+    RawSamples raw(N);
+
+    printf("  512 KB file-backed image, %u samples (about %u wraps)\n", N,
+           N / (REGION / LOG_FLASH_PAGE_SIZE * (uint32_t)LOG_RECORDS_PER_PAGE));
+    printf("  %-22s %10s %10s %12s %10s %14s\n", "", "pages", "erases", "flash us/smp", "wear", "host/sample");
+    for (int batched = 1; batched >= 0; batched--) {
+        remove(image);
+        SimFlash flash(REGION, image);
+        SampleLog log(&flash);
+        log.recover();
+        flash.reset_counters();
+
+        Sample sample = {};
+        sample.sensor = SENSOR_BME280;
+        uint64_t start = ticks();
+        for (uint32_t i = 0; i < N; i++) {
+            sample.timestamp_us = 1000000ull * i;
+            sample.sequence = (uint16_t)i;
+            sample.values[0] = raw.temperature[i];
+            sample.values[1] = raw.pressure[i];
+            sample.values[2] = raw.humidity[i];
+            log.append(sample);
+            if (!batched) log.flush();
+        }
+        double per_sample = (double)(ticks() - start) / N;
+
+        uint32_t least = UINT32_MAX, most = 0;
+        for (uint32_t sector = 0; sector < log.sectors(); sector++) {
+            least = std::min(least, flash.sector_erases(sector));
+            most = std::max(most, flash.sector_erases(sector));
+        }
+        char wear[24];
+        snprintf(wear, sizeof(wear), "%u..%u", least, most);
+        printf("  %-22s %10u %10u %12.1f %10s %9.0f %s\n", batched ? "page batching" : "page per sample",
+               flash.programs, flash.erases, (double)flash.busy_us / N, wear, per_sample, TICK_UNIT);
+
+        // 100k erase cycles per sector, one sample per second
+        double samples_per_sector = (double)N / flash.erases * log.sectors();
+        printf("  %-22s endurance at 1 sample/s: %.0f years\n", "",
+               100000.0 * samples_per_sector / (365.25 * 24 * 3600));
+
+        if (!batched) continue;
+
+        SimFlash reopened(REGION, image);
+        SampleLog rebooted(&reopened);
+        start = ticks();
+        rebooted.recover();
+        double recover_ticks = (double)(ticks() - start);
+        printf("  recovery: %llu bytes read of %u (%.1f %%), %.0f %s\n", (unsigned long long)reopened.read_bytes,
+               REGION, 100.0 * reopened.read_bytes / REGION, recover_ticks, TICK_UNIT);
+
+        uint32_t drained = 0;
+        reopened.reset_counters();
+        start = ticks();
+        rebooted.drain(0, count_drained, &drained);
+        printf("  drain of the whole log: %u samples, %.1f %s/sample, %llu bytes read\n", drained,
+               (double)(ticks() - start) / drained, TICK_UNIT, (unsigned long long)reopened.read_bytes);
+    }
+    remove(image);
+}
+
+
+/********** Rollups **********/
+
+/// Minute rollups of an hour of noisy BME280 temperature at 1 Hz, forced mode x1
+static void rollup_bme280(uint8_t filter, double *spread, double *mean_error) {
+    static SampleRollup<60, 60, 24> rollup;
+    rollup.clear();
+    BME280Rig rig;
+    BME280::Config config = BME280::WEATHER_MONITORING;
+    config.filter = filter;
+    rig.bme.configure(config);
+
+    uint32_t state = 7;
+    for (int i = 0; i < 3600; i++) {
+        // About +-0.5 C of white noise around the datasheet temperature
+        state = state * 1664525u + 1013904223u;
+        rig.sim.set_adc(519888 + (int32_t)((state >> 8) % 9000) - 4500, 415148, 30000);
+        rig.clock.sleep_us(1000000 - rig.clock.time_us() % 1000000);
+        rig.bme.measure_once();
+        Sample sample = {};
+        sample.timestamp_us = rig.clock.time_us();
+        sample.values[0] = rig.bme.get_temperature_centidegrees();
+        rollup.add(sample);
+    }
+    rollup.flush(rig.clock.time_us() + 3600000000ull);
+
+    double total = 0;
+    for (size_t i = 0; i < rollup.size(ROLLUP_MINUTES); i++) {
+        const RollupBucket &bucket = rollup.at(ROLLUP_MINUTES, i);
+        total += bucket.values[0].max - bucket.values[0].min;
+    }
+    *spread = total / rollup.size(ROLLUP_MINUTES);
+    // 25.08 C is what the noise-free ADC word gives (datasheet 8.2)
+    *mean_error = rollup.at(ROLLUP_HOURS, 0).mean(0) - 2508.0;
+}
+
+static void bench_rollup(void) {
+    const size_t N = 864000;        // One day at 10 Hz
+    RawSamples raw(N);
+    std::vector<Sample> samples(N);
+    for (size_t i = 0; i < N; i++) {
+        samples[i] = {};
+        samples[i].timestamp_us = 100000ull * i;
+        samples[i].values[0] = raw.temperature[i];
+        samples[i].values[1] = raw.pressure[i];
+        samples[i].values[2] = raw.humidity[i];
+    }
+
+    static SampleRollup<60, 60, 24> rollup;
+    static WindowStats<65536> hour_window(3600000000ull);
+    int64_t checksum = 0;
+    uint64_t best_rollup = UINT64_MAX, best_window = UINT64_MAX;
+    for (int round = 0; round < 3; round++) {
+        rollup.clear();
+        uint64_t start = ticks();
+        for (size_t i = 0; i < N; i++) rollup.add(samples[i]);
+        best_rollup = std::min(best_rollup, ticks() - start);
+        checksum += rollup.latest(ROLLUP_HOURS).values[0].sum;
+
+        // The existing sliding-window statistics, one value only, for an hour window
+        hour_window.clear();
+        start = ticks();
+        for (size_t i = 0; i < N; i++) hour_window.add(samples[i].timestamp_us, samples[i].values[0]);
+        best_window = std::min(best_window, ticks() - start);
+        checksum += hour_window.min();
+    }
+
+    printf("  one day at 10 Hz, %zu samples of three values\n", N);
+    printf("  SampleRollup<60,60,24>, 3 values   %8.1f %s/sample  %7zu bytes\n", (double)best_rollup / N, TICK_UNIT,
+           sizeof(rollup));
+    printf("  WindowStats<65536> 1 h, 1 value    %8.1f %s/sample  %7zu bytes\n", (double)best_window / N, TICK_UNIT,
+           sizeof(hour_window));
+    printf("  raw day in RAM                                       %9zu bytes\n", N * sizeof(Sample));
+    printf("  uplink per hour: one bucket %zu bytes vs. %u frames %u bytes\n", sizeof(RollupBucket), 36000u,
+           36000u * FRAME_LENGTH);
+    printf("  (checksum %lld)\n", (long long)checksum);
+
+    double raw_spread, raw_error, iir_spread, iir_error;
+    rollup_bme280(BME280::FILTER_OFF, &raw_spread, &raw_error);
+    rollup_bme280(BME280::FILTER_16, &iir_spread, &iir_error);
+    printf("  noisy BME280 at 1 Hz for 1 h     minute max-min   hour mean error  [0.01 C]\n");
+    printf("  raw conversions                  %14.1f %17.1f\n", raw_spread, raw_error);
+    printf("  IIR filter 16                    %14.1f %17.1f\n", iir_spread, iir_error);
+}
+
+/**
+ * DerivedMetrics against the same formulas through libm, per metric and
+ * for a full set on one sample. On the host the FPU makes libm cheap; on
+ * the M0+ every float operation is a soft-float call, so the host numbers
+ * show the integer cost and the float column is a lower bound there.
+ */
+struct MetricsInput {
+    int32_t temperature;    // 0.01 °C
+    uint32_t pressure;      // Pa, Q24.8
+    uint32_t humidity;      // %RH, Q22.10
+};
+
+static void bench_derived_metrics(void) {
+    const size_t N = 100000;
+    std::vector<MetricsInput> inputs(N);
+    std::vector<Sample> samples(N);
+    uint32_t state = 777;
+    for (size_t i = 0; i < N; i++) {
+        state = state * 1664525u + 1013904223u;
+        inputs[i].temperature = -4000 + (int32_t)((state >> 8) % 12500);
+        state = state * 1664525u + 1013904223u;
+        inputs[i].pressure = (30000u << 8) + (state >> 8) % (80000u << 8);
+        state = state * 1664525u + 1013904223u;
+        inputs[i].humidity = 1024 + (state >> 8) % (99u << 10);
+        samples[i] = {};
+        samples[i].sensor = SENSOR_BME280;
+        samples[i].values[0] = inputs[i].temperature;
+        samples[i].values[1] = (int32_t)inputs[i].pressure;
+        samples[i].values[2] = (int32_t)inputs[i].humidity;
+    }
+
+    DerivedMetrics metrics(50000);
+    const char *names[] = {"altitude", "sea-level pressure", "dew point", "absolute humidity", "all four"};
+    double fixed_cost[5], float_cost[5], double_cost[5];
+    int64_t checksum = 0;
+    double float_checksum = 0;
+
+    for (int metric = 0; metric < 5; metric++) {
+        uint64_t best_fixed = UINT64_MAX, best_float = UINT64_MAX, best_double = UINT64_MAX;
+        for (int round = 0; round < 3; round++) {
+            uint64_t start = ticks();
+            for (size_t i = 0; i < N; i++) {
+                metrics.set_sample(samples[i]);
+                if (metric == 0 || metric == 4) checksum += metrics.altitude_cm();
+                if (metric == 1 || metric == 4) checksum += metrics.sea_level_pressure_q24_8();
+                if (metric == 2 || metric == 4) checksum += metrics.dew_point_centidegrees();
+                if (metric == 3 || metric == 4) checksum += metrics.absolute_humidity_centigrams();
+            }
+            best_fixed = std::min(best_fixed, ticks() - start);
+
+            start = ticks();
+            for (size_t i = 0; i < N; i++) {
+                float t = inputs[i].temperature / 100.0f;
+                float p = inputs[i].pressure / 256.0f;
+                float rh = inputs[i].humidity / 1024.0f;
+                if (metric == 0 || metric == 4) float_checksum += 44330.77f * (1.0f - powf(p / 101325.0f, 0.1902632f));
+                if (metric == 1 || metric == 4) float_checksum += p * powf(1.0f - 500.0f / 44330.77f, -5.25588f);
+                float magnus = 17.62f * t / (243.12f + t);
+                if (metric == 2 || metric == 4) {
+                    float gamma = logf(rh / 100.0f) + magnus;
+                    float_checksum += 243.12f * gamma / (17.62f - gamma);
+                }
+                if (metric == 3 || metric == 4) float_checksum += 1324.715f * expf(magnus) * rh / 100.0f / (273.15f + t);
+            }
+            best_float = std::min(best_float, ticks() - start);
+
+            start = ticks();
+            for (size_t i = 0; i < N; i++) {
+                double t = inputs[i].temperature / 100.0;
+                double p = inputs[i].pressure / 256.0;
+                double rh = inputs[i].humidity / 1024.0;
+                if (metric == 0 || metric == 4) float_checksum += DerivedMetrics::reference_altitude_m(p, 101325.0);
+                if (metric == 1 || metric == 4) float_checksum += DerivedMetrics::reference_sea_level_pressure_pa(p, 500.0);
+                if (metric == 2 || metric == 4) float_checksum += DerivedMetrics::reference_dew_point_c(t, rh);
+                if (metric == 3 || metric == 4) float_checksum += DerivedMetrics::reference_absolute_humidity_g_m3(t, rh);
+            }
+            best_double = std::min(best_double, ticks() - start);
+        }
+        fixed_cost[metric] = (double)best_fixed / N;
+        float_cost[metric] = (double)best_float / N;
+        double_cost[metric] = (double)best_double / N;
+    }
+
+    // Lazy: a sample nobody asks about costs only set_sample()
+    uint64_t best_idle = UINT64_MAX;
+    for (int round = 0; round < 3; round++) {
+        uint64_t start = ticks();
+        for (size_t i = 0; i < N; i++) metrics.set_sample(samples[i]);
+        best_idle = std::min(best_idle, ticks() - start);
+    }
+
+    // Largest error over the same inputs, against double precision
+    double error[4] = {};
+    metrics.set_station_altitude_cm(50000);
+    for (size_t i = 0; i < N; i++) {
+        double t = inputs[i].temperature / 100.0;
+        double p = inputs[i].pressure / 256.0;
+        double rh = inputs[i].humidity / 1024.0;
+        metrics.set_sample(samples[i]);
+        error[0] = std::max(error[0], fabs(metrics.altitude_cm() / 100.0 - DerivedMetrics::reference_altitude_m(p, 101325.0)));
+        error[1] = std::max(error[1], fabs(metrics.sea_level_pressure_q24_8() / 256.0 -
+                                           DerivedMetrics::reference_sea_level_pressure_pa(p, 500.0)));
+        error[2] = std::max(error[2], fabs(metrics.dew_point_centidegrees() / 100.0 - DerivedMetrics::reference_dew_point_c(t, rh)));
+        error[3] = std::max(error[3], fabs(metrics.absolute_humidity_centigrams() / 100.0 -
+                                           DerivedMetrics::reference_absolute_humidity_g_m3(t, rh)));
+    }
+    const char *units[] = {"m", "Pa", "C", "g/m3"};
+
+    printf("  %zu samples, -40..85 C, 1..100 %%RH, 300..1100 hPa, station at 500 m\n", N);
+    printf("  %-20s %10s %10s %10s   largest error\n", "", "fixed", "float", "double");
+    for (int metric = 0; metric < 5; metric++) {
+        printf("  %-20s %10.1f %10.1f %10.1f", names[metric], fixed_cost[metric], float_cost[metric], double_cost[metric]);
+        if (metric < 4) printf("   %.4f %s", error[metric], units[metric]);
+        printf("\n");
+    }
+    printf("  set_sample() only   %10.1f  %s/sample\n", (double)best_idle / N, TICK_UNIT);
+    printf("  (checksum %lld %.0f)\n", (long long)checksum, float_checksum);
+}
+
+/**
+ * Runtime read() with channels skipped: bytes and simulated bus time per
+ * read, and host cost of a read with only the temperature asked for
+ * against one with all three getters.
+ */
+static void bench_read_window(void) {
+    const int WARMUP = 20, RUNS = 1000;
+    const size_t N = 100;
+    const BME280::Config thermometer = {BME280::FORCED_MODE, BME280::OVERSAMPLING_RATE_1,
+                                        BME280::OVERSAMPLING_RATE_SKIPPED, BME280::OVERSAMPLING_RATE_SKIPPED,
+                                        BME280::FILTER_OFF, BME280::STANDBY_0_5_MS};
+    const BME280::Config no_humidity = {BME280::FORCED_MODE, BME280::OVERSAMPLING_RATE_1, BME280::OVERSAMPLING_RATE_1,
+                                        BME280::OVERSAMPLING_RATE_SKIPPED, BME280::FILTER_OFF, BME280::STANDBY_0_5_MS};
+    struct Window {
+        const char *name;
+        BME280::Config config;
+    };
+    const Window windows[] = {
+        {"all channels", BME280::WEATHER_MONITORING},
+        {"no humidity", no_humidity},
+        {"no pressure", BME280::HUMIDITY_SENSING},
+        {"temperature only", thermometer},
+    };
+
+    printf("  %-18s bytes  bus [us]   read + temperature p50   read + all getters p50  [%s]\n", "", TICK_UNIT);
+    int64_t checksum = 0;
+    for (const Window &window : windows) {
+        BME280Rig rig;
+        rig.bme.configure(window.config);
+        rig.bme.measure_once();
+
+        rig.bus.reset_counters();
+        uint64_t start = rig.clock.time_us();
+        rig.bme.read();
+        uint64_t bus_us = rig.clock.time_us() - start;
+        uint32_t bytes = rig.bus.bytes();
+
+        Percentiles temperature_only = time_runs(WARMUP, RUNS, N, [&]() {
+            for (size_t i = 0; i < N; i++) {
+                rig.bme.read();
+                checksum += rig.bme.get_temperature_centidegrees();
+            }
+        });
+        Percentiles all = time_runs(WARMUP, RUNS, N, [&]() {
+            for (size_t i = 0; i < N; i++) {
+                rig.bme.read();
+                checksum += rig.bme.get_temperature_centidegrees() + rig.bme.get_pressure_q24_8() +
+                            rig.bme.get_humidity_q22_10();
+            }
+        });
+        printf("  %-18s %5u %9llu %24.1f %24.1f\n", window.name, bytes, (unsigned long long)bus_us,
+               temperature_only.p50, all.p50);
+    }
+    printf("  (checksum %lld)\n", (long long)checksum);
+}
+
+/**
+ * The same driver on I2C and on SPI through SPIRegisterBus: simulated bus
+ * time for a full data burst (read(), 8 bytes from 0xF7), for the
+ * calibration fetch (26 bytes from 0x88 and 7 from 0xE1, as init() reads
+ * them) and for init() as a whole, which includes the 2 ms reset wait.
+ */
+struct TransportTimes {
+    double burst_us, calibration_us, init_us;
+};
+
+static TransportTimes time_transport(SimClock &clock, I2CBus &bus, uint8_t address) {
+    const int N = 100;
+    TransportTimes times;
+    BME280 bme(&bus, &clock, address);
+
+    uint64_t start = clock.time_us();
+    for (int i = 0; i < N; i++) bme.init();
+    times.init_us = (double)(clock.time_us() - start) / N;
+
+    bme.configure(BME280::WEATHER_MONITORING);
+    bme.measure_once();
+    start = clock.time_us();
+    for (int i = 0; i < N; i++) bme.read();
+    times.burst_us = (double)(clock.time_us() - start) / N;
+
+    uint8_t calibration[BME280_COMPENSATION_LENGTH];
+    const uint8_t first = 0x88, second = 0xE1;
+    start = clock.time_us();
+    for (int i = 0; i < N; i++) {
+        bus.write(address, &first, 1, true, 100000);
+        bus.read(address, calibration, 26, false, 100000);
+        bus.write(address, &second, 1, true, 100000);
+        bus.read(address, calibration + 26, 7, false, 100000);
+    }
+    times.calibration_us = (double)(clock.time_us() - start) / N;
+    return times;
+}
+
+static void bench_transport(void) {
+    printf("  %-22s %12s %16s %10s\n", "", "burst [us]", "calibration [us]", "init [us]");
+    const uint32_t i2c_rates[] = {100000, 400000, 1000000};
+    for (uint32_t rate : i2c_rates) {
+        SimClock clock;
+        SimI2CBus bus(clock, rate);
+        BME280Sim sim(clock);
+        bus.attach(BME280_DEFAULT_I2CADDR, &sim);
+        TransportTimes times = time_transport(clock, bus, BME280_DEFAULT_I2CADDR);
+        printf("  I2C %4lu kHz           %12.1f %16.1f %10.1f\n", (unsigned long)(rate / 1000), times.burst_us,
+               times.calibration_us, times.init_us);
+    }
+    const uint32_t spi_rates[] = {1000000, 5000000, 10000000};
+    for (uint32_t rate : spi_rates) {
+        SimClock clock;
+        SimSPIBus spi(clock, rate);
+        BME280Sim sim(clock);
+        spi.attach(0, &sim);
+        SPIRegisterBus bus(&spi);
+        TransportTimes times = time_transport(clock, bus, 0);
+        printf("  SPI %4lu MHz           %12.1f %16.1f %10.1f\n", (unsigned long)(rate / 1000000), times.burst_us,
+               times.calibration_us, times.init_us);
+    }
+}
+
+/**
+ * Runtime driver against BME280Fixed in the gaming profile (humidity
+ * skipped): host cost of one read() and the bytes it moves on the bus.
+ * The runtime read() only stores the raw values and the getters
+ * compensate them, while BME280Fixed::read() compensates at once, so each
+ * side is timed as read() followed by the getters of the measured
+ * channels. Image sizes come from the size_compare target, not from here.
+ */
+static void bench_fixed_driver(void) {
+    typedef BME280Fixed<BME280_DEFAULT_I2CADDR, BME280::OVERSAMPLING_RATE_1, BME280::OVERSAMPLING_RATE_4,
+                        BME280::OVERSAMPLING_RATE_SKIPPED, BME280::FILTER_16, BME280::STANDBY_0_5_MS,
+                        BME280::NORMAL_MODE> GamingFixed;
+    const int WARMUP = 50, RUNS = 5000;
+    const size_t N = 100;
+    volatile int64_t sink = 0;
+
+    BME280Rig rig;
+    rig.bme.configure(BME280::GAMING);
+    rig.clock.sleep_us(BME280::sample_period_us(BME280::GAMING));
+    rig.bus.reset_counters();
+    rig.bme.read();
+    uint32_t runtime_bytes = rig.bus.bytes();
+    Percentiles runtime = time_runs(WARMUP, RUNS, N, [&]() {
+        for (size_t i = 0; i < N; i++) {
+            rig.bme.read();
+            sink = sink + rig.bme.get_temperature_centidegrees() + rig.bme.get_pressure_q24_8();
+        }
+    });
+
+    BME280Rig fixed_rig;
+    GamingFixed fixed(&fixed_rig.bus, &fixed_rig.clock);
+    fixed.init();
+    fixed_rig.clock.sleep_us(GamingFixed::SAMPLE_PERIOD_US);
+    fixed_rig.bus.reset_counters();
+    fixed.read();
+    uint32_t fixed_bytes = fixed_rig.bus.bytes();
+    Percentiles fixed_read = time_runs(WARMUP, RUNS, N, [&]() {
+        for (size_t i = 0; i < N; i++) {
+            fixed.read();
+            sink = sink + fixed.get_temperature_centidegrees() + fixed.get_pressure_q24_8();
+        }
+    });
+
+    printf("  %s per read() + getters (simulated bus included)   min      p50      p99   bytes on the bus\n",
+           TICK_UNIT);
+    printf("  BME280 + configure(GAMING)                    %8.1f %8.1f %8.1f   %u\n", runtime.min, runtime.p50,
+           runtime.p99, runtime_bytes);
+    printf("  BME280Fixed<..., GAMING>                      %8.1f %8.1f %8.1f   %u\n", fixed_read.min,
+           fixed_read.p50, fixed_read.p99, fixed_bytes);
+}
+
+struct Section {
+    const char *name;
+    const char *title;
+    void (*run)(void);
+};
+
+static const Section sections[] = {
+    {"read_latency", "BME280 read latency (simulated bus time per call)", bench_read_latency},
+    {"profiles", "BME280 configuration profiles (max rate measured on the model in normal mode)", bench_profiles},
+    {"hot_math", "Compensation, calibration unpacking and Sensirion decoding, percentiles over 2000 runs (host)",
+     bench_hot_math},
+    {"fixed_driver", "Runtime BME280 vs. BME280Fixed, gaming profile (host)", bench_fixed_driver},
+    {"transport", "BME280 over I2C vs. SPI, data burst and calibration fetch (simulated bus time)", bench_transport},
+    {"read_window", "Runtime BME280 read() by enabled channels, bus bytes and host cost (simulated bus)",
+     bench_read_window},
+    {"fixed", "BME280 compensation, integer results vs. integer + float conversion (host)", bench_fixed},
+    {"batch", "BME280 batch compensation throughput (host)", bench_batch},
+    {"cold_start", "BME280 time to first valid sample, weather profile (simulated time)", bench_cold_start},
+    {"forced", "BME280 forced-mode sample latency at x16 (simulated time per sample)", bench_forced},
+    {"async", "Blocking vs. asynchronous reads (simulated time per read)", bench_async},
+    {"ring", "SampleRing producer/consumer (host)", bench_ring},
+    {"window", "10 min window statistics, incremental vs. rescan per query (host)", bench_window},
+    {"rollup", "1 s / 1 min / 1 h rollups, cost per sample and raw vs. IIR input (host, simulated BME280)",
+     bench_rollup},
+    {"frame", "Sample output, text vs. binary frames (host)", bench_frame},
+    {"codec", "Delta/varint sample codec, size and speed (host)", bench_codec},
+    {"scheduler", "Bus manager, rate and start jitter per sensor (simulated time, 10 us poll step)", bench_scheduler},
+    {"bus_health", "BME280 read with a held bus or a NAK, fixed vs. derived timeouts vs. BusHealth (simulated time)",
+     bench_bus_health},
+    {"trace", "Cost of the latency histograms and counters per traced operation", bench_trace},
+    {"sensirion", "Sensirion word CRC, bitwise vs. table (host)", bench_sensirion},
+    {"scd30_events", "SCD30 polling vs. event mode, one minute at 2 s interval (simulated time)", bench_scd30_events},
+    {"low_power", "Legacy loop vs. duty-cycled forced mode, time and energy per sample (simulated time, power model)",
+     bench_low_power},
+    {"flash_log", "Flash sample log, page batching vs. a page per sample (file-backed image, W25Q16JV timings)",
+     bench_flash_log},
+    {"derived_metrics", "Altitude, sea-level pressure, dew point and absolute humidity, fixed point vs. libm (host)",
+     bench_derived_metrics},
+};
+
+int main(int argc, char **argv) {
+    for (const Section &section : sections) {
+        bool selected = (argc < 2);
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], section.name) == 0) selected = true;
+        }
+        if (!selected) continue;
+
+        printf("[%s] %s\n", section.name, section.title);
+        section.run();
+        printf("\n");
+    }
+    return 0;
+}
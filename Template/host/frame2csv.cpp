@@ -0,0 +1,60 @@
+/*
+ *  Title: frame2csv
+ *  Description: Converts the binary sample stream from the device (see
+ *               SampleFrame.h) to CSV, one row per sample. Values are
+ *               written in physical units, columns a sensor does not have
+ *               are left empty. Stream statistics go to stderr.
+ *
+ *               Usage: frame2csv [input [output]]   (default stdin/stdout)
+ *               e.g.   frame2csv /dev/ttyACM0 samples.csv
+ */
+
+#include <stdio.h>
+#include <SampleFrame.h>
+
+static void write_row(FILE *out, const Sample &sample) {
+    fprintf(out, "%llu,%u,%u,%u,", (unsigned long long)sample.timestamp_us, sample.sensor, sample.channel,
+            sample.sequence);
+    if (sample.sensor == SENSOR_BME280) {
+        fprintf(out, "bme280,%.2f,%.2f,%.3f,\n", sample.values[0] / 100.0, (uint32_t)sample.values[1] / 256.0,
+                (uint32_t)sample.values[2] / 1024.0);
+    } else if (sample.sensor == SENSOR_SCD30) {
+        fprintf(out, "scd30,%.2f,,%.2f,%.2f\n", sample.values[1] / 100.0, sample.values[2] / 100.0,
+                sample.values[0] / 100.0);
+    } else {
+        fprintf(out, "unknown,,,,\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    FILE *in = stdin, *out = stdout;
+    if (argc > 1 && (in = fopen(argv[1], "rb")) == nullptr) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (argc > 2 && (out = fopen(argv[2], "w")) == nullptr) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "timestamp_us,sensor_id,channel,sequence,sensor,temperature_c,pressure_pa,humidity_rh,co2_ppm\n");
+
+    FrameDecoder decoder;
+    uint8_t buffer[4096];
+    Sample samples[256];
+    size_t len;
+    while ((len = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        size_t offset = 0;
+        while (offset < len) {
+            size_t decoded;
+            offset += decoder.feed(buffer + offset, len - offset, samples, 256, &decoded);
+            for (size_t i = 0; i < decoded; i++) write_row(out, samples[i]);
+        }
+    }
+
+    fprintf(stderr, "%u frames, %u CRC errors, %u bytes skipped\n", decoder.frames(), decoder.crc_errors(),
+            decoder.skipped());
+    if (in != stdin) fclose(in);
+    if (out != stdout) fclose(out);
+    return 0;
+}
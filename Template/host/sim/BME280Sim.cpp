@@ -0,0 +1,234 @@
+/*
+ *  Title: BME280Sim
+ *  Description: Register-level model of a BME280 on the simulated I2C bus.
+ */
+
+#include <string.h>
+#include "BME280Sim.h"
+
+// Calibration from the worked example in the BME280 datasheet (section 8.2)
+// for temperature and pressure, humidity taken from a production part.
+static const uint16_t SIM_DIG_T1 = 27504;
+static const int16_t  SIM_DIG_T2 = 26435;
+static const int16_t  SIM_DIG_T3 = -1000;
+static const uint16_t SIM_DIG_P1 = 36477;
+static const int16_t  SIM_DIG_P2 = -10685;
+static const int16_t  SIM_DIG_P3 = 3024;
+static const int16_t  SIM_DIG_P4 = 2855;
+static const int16_t  SIM_DIG_P5 = 140;
+static const int16_t  SIM_DIG_P6 = -7;
+static const int16_t  SIM_DIG_P7 = 15500;
+static const int16_t  SIM_DIG_P8 = -14600;
+static const int16_t  SIM_DIG_P9 = 6000;
+static const uint8_t  SIM_DIG_H1 = 75;
+static const int16_t  SIM_DIG_H2 = 362;
+static const uint8_t  SIM_DIG_H3 = 0;
+static const int16_t  SIM_DIG_H4 = 313;
+static const int16_t  SIM_DIG_H5 = 50;
+static const int8_t   SIM_DIG_H6 = 30;
+
+static void put_le16(uint8_t *dst, uint16_t value) {
+    dst[0] = value & 0xFF;
+    dst[1] = value >> 8;
+}
+
+///@brief Oversampling factor for a 3-bit osrs field
+static uint32_t oversampling(uint8_t osrs) {
+    static const uint8_t factor[8] = {0, 1, 2, 4, 8, 16, 16, 16};
+    return factor[osrs & 0x07];
+}
+
+BME280Sim::BME280Sim(SimClock &clock) : _clock(clock) {
+    // Datasheet example: 25.08 °C and 100653 Pa
+    set_adc(519888, 415148, 30000);
+    power_on_reset();
+}
+
+void BME280Sim::power_on_reset(void) {
+    memset(_regs, 0, sizeof(_regs));
+    _iir_valid = false;
+
+    uint16_t words[12] = {SIM_DIG_T1, (uint16_t)SIM_DIG_T2, (uint16_t)SIM_DIG_T3,
+                          SIM_DIG_P1, (uint16_t)SIM_DIG_P2, (uint16_t)SIM_DIG_P3,
+                          (uint16_t)SIM_DIG_P4, (uint16_t)SIM_DIG_P5, (uint16_t)SIM_DIG_P6,
+                          (uint16_t)SIM_DIG_P7, (uint16_t)SIM_DIG_P8, (uint16_t)SIM_DIG_P9};
+    for (int i = 0; i < 12; i++) put_le16(&_regs[0x88 + 2 * i], words[i]);
+    _regs[0xA1] = SIM_DIG_H1;
+    put_le16(&_regs[0xE1], (uint16_t)SIM_DIG_H2);
+    _regs[0xE3] = SIM_DIG_H3;
+    _regs[0xE4] = (uint8_t)(SIM_DIG_H4 >> 4);
+    _regs[0xE5] = (uint8_t)((SIM_DIG_H4 & 0x0F) | ((SIM_DIG_H5 & 0x0F) << 4));
+    _regs[0xE6] = (uint8_t)(SIM_DIG_H5 >> 4);
+    _regs[0xE7] = (uint8_t)SIM_DIG_H6;
+
+    _regs[0xD0] = 0x60;
+
+    // Data registers read 0x80000 / 0x8000 until the first conversion
+    _regs[0xF7] = 0x80;
+    _regs[0xFA] = 0x80;
+    _regs[0xFD] = 0x80;
+
+    _pointer = 0;
+    _osrs_t = _osrs_p = _osrs_h = _mode = 0;
+    _converting = false;
+    _conversions = 0;
+    _nvm_copy_until = _clock.time_us() + NVM_COPY_US;
+    _regs[0xF3] = 0x01;
+}
+
+void BME280Sim::set_adc(int32_t raw_temperature, int32_t raw_pressure, int32_t raw_humidity) {
+    _adc_t = raw_temperature & 0xFFFFF;
+    _adc_p = raw_pressure & 0xFFFFF;
+    _adc_h = raw_humidity & 0xFFFF;
+}
+
+uint8_t BME280Sim::reg(uint8_t address) {
+    update();
+    return _regs[address];
+}
+
+bool BME280Sim::on_write(const uint8_t *src, size_t len) {
+    update();
+    if (len == 0) return true;
+
+    // First byte is the register pointer, after that (register, value) pairs
+    _pointer = src[0];
+    if (len >= 2) write_register(src[0], src[1]);
+    for (size_t i = 2; i + 1 < len; i += 2) {
+        write_register(src[i], src[i + 1]);
+    }
+    return true;
+}
+
+bool BME280Sim::on_read(uint8_t *dst, size_t len) {
+    update();
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = _regs[_pointer++];
+    }
+    return true;
+}
+
+uint32_t BME280Sim::measurement_time_us(void) const {
+    uint32_t t = 1000 + 2000 * oversampling(_osrs_t);
+    if (_osrs_p) t += 2000 * oversampling(_osrs_p) + 500;
+    if (_osrs_h) t += 2000 * oversampling(_osrs_h) + 500;
+    return t;
+}
+
+uint32_t BME280Sim::standby_us(void) const {
+    static const uint32_t t_sb[8] = {500, 62500, 125000, 250000, 500000, 1000000, 10000, 20000};
+    return t_sb[_regs[0xF5] >> 5];
+}
+
+void BME280Sim::write_register(uint8_t address, uint8_t value) {
+    switch (address) {
+        case 0xE0:
+            if (value == 0xB6) power_on_reset();
+            break;
+        case 0xF2:
+            // Only takes effect on the next write to ctrl_meas
+            _regs[0xF2] = value & 0x07;
+            break;
+        case 0xF4:
+            _regs[0xF4] = value;
+            _osrs_h = _regs[0xF2] & 0x07;
+            _osrs_t = (value >> 5) & 0x07;
+            _osrs_p = (value >> 2) & 0x07;
+            _mode = value & 0x03;
+            if (_mode == 0) {
+                _converting = false;
+            } else {
+                start_conversion(_clock.time_us());
+            }
+            break;
+        case 0xF5:
+            // Writes to config in normal mode may be ignored (datasheet 5.4.6)
+            if (_mode != 0x03) {
+                if (((value ^ _regs[0xF5]) >> 2) & 0x07) _iir_valid = false;
+                _regs[0xF5] = value & 0xFD;
+            }
+            break;
+        default:
+            // Everything else is read-only
+            break;
+    }
+}
+
+void BME280Sim::start_conversion(uint64_t at) {
+    _cycle_start = at;
+    _converting = true;
+    _regs[0xF3] |= 0x08;
+}
+
+///@brief Bring the model up to the current simulated time
+void BME280Sim::update(void) {
+    if (_regs[0xF3] & 0x01) {
+        if (_clock.time_us() >= _nvm_copy_until) _regs[0xF3] &= ~0x01;
+    }
+    if (!_converting) return;
+
+    uint64_t now = _clock.time_us();
+    uint32_t t_meas = measurement_time_us();
+    uint64_t done = _cycle_start + t_meas;
+
+    if (now < done) {
+        _regs[0xF3] |= 0x08;
+        return;
+    }
+
+    if (_mode == 0x03) {
+        // Normal mode: measurement and standby periods alternate
+        uint64_t cycle = t_meas + standby_us();
+        uint64_t finished = (now - done) / cycle + 1;
+        latch_results();
+        _conversions += (uint32_t)finished - 1;
+        _cycle_start += finished * cycle;
+        if (now >= _cycle_start) {
+            _regs[0xF3] |= 0x08;
+        } else {
+            _regs[0xF3] &= ~0x08;
+        }
+    } else {
+        // Forced mode: one conversion, then back to sleep
+        latch_results();
+        _converting = false;
+        _mode = 0;
+        _regs[0xF4] &= ~0x03;
+        _regs[0xF3] &= ~0x08;
+    }
+}
+
+/// data_filtered = (data_filtered_old * (c - 1) + data_ADC) / c, the first
+/// conversion after a reset or a filter change loads the state directly.
+int32_t BME280Sim::filter(int64_t &state, int32_t adc) {
+    uint8_t setting = (_regs[0xF5] >> 2) & 0x07;
+    if (setting == 0) return adc;
+
+    int64_t coefficient = (setting >= 4) ? 16 : (1 << setting);
+    if (!_iir_valid) {
+        state = (int64_t)adc * 16;
+    } else {
+        state = (state * (coefficient - 1) + (int64_t)adc * 16 + coefficient / 2) / coefficient;
+    }
+    return (int32_t)((state + 8) / 16);
+}
+
+void BME280Sim::latch_results(void) {
+    int32_t p = _osrs_p ? _adc_p : 0x80000;
+    int32_t t = _osrs_t ? _adc_t : 0x80000;
+    if (_osrs_t) t = filter(_iir_t, t);
+    if (_osrs_p) p = filter(_iir_p, p);
+    _iir_valid = ((_regs[0xF5] >> 2) & 0x07) != 0;
+    int32_t h = _osrs_h ? _adc_h : 0x8000;
+
+    _regs[0xF7] = (p >> 12) & 0xFF;
+    _regs[0xF8] = (p >> 4) & 0xFF;
+    _regs[0xF9] = (p << 4) & 0xF0;
+    _regs[0xFA] = (t >> 12) & 0xFF;
+    _regs[0xFB] = (t >> 4) & 0xFF;
+    _regs[0xFC] = (t << 4) & 0xF0;
+    _regs[0xFD] = (h >> 8) & 0xFF;
+    _regs[0xFE] = h & 0xFF;
+
+    _conversions++;
+}
@@ -0,0 +1,64 @@
+/*
+ *  Title: BME280Sim
+ *  Description: Register-level model of a BME280 on the simulated I2C bus.
+ *               Covers the calibration blocks (0x88..0xA1, 0xE1..0xE7), the
+ *               chip ID (0xD0), soft reset (0xE0) and the control, status and
+ *               data registers (0xF2..0xFE), including conversion timing in
+ *               forced and normal mode and the IIR filter on temperature and
+ *               pressure (datasheet 3.4.4).
+ */
+#pragma once
+#include "SimI2CBus.h"
+
+class BME280Sim : public SimDevice {
+public:
+    BME280Sim(SimClock &clock);
+
+    bool on_write(const uint8_t *src, size_t len) override;
+    bool on_read(uint8_t *dst, size_t len) override;
+
+    ///@brief Set the raw ADC words the next conversions produce
+    ///@param raw_temperature 20-bit temperature word
+    ///@param raw_pressure 20-bit pressure word
+    ///@param raw_humidity 16-bit humidity word
+    void set_adc(int32_t raw_temperature, int32_t raw_pressure, int32_t raw_humidity);
+
+    ///@brief Direct register access for inspecting the model
+    uint8_t reg(uint8_t address);
+
+    ///@brief Typical measurement time for the active settings (datasheet 9.1)
+    uint32_t measurement_time_us(void) const;
+
+    ///@brief Number of conversions completed since the last reset
+    uint32_t conversions(void) const { return _conversions; }
+
+    ///@brief Time the model takes to copy the NVM into the image registers after a reset
+    static const uint32_t NVM_COPY_US = 2000;
+
+    ///@brief Power-on reset: all registers back to their reset values
+    void power_on_reset(void);
+private:
+    SimClock &_clock;
+    uint8_t _regs[256];
+    uint8_t _pointer = 0;
+
+    int32_t _adc_t, _adc_p, _adc_h;
+
+    // IIR filter state in 1/16 LSB, valid after the first filtered conversion
+    int64_t _iir_t = 0, _iir_p = 0;
+    bool _iir_valid = false;
+
+    // Settings latched when ctrl_meas is written
+    uint8_t _osrs_t = 0, _osrs_p = 0, _osrs_h = 0, _mode = 0;
+    uint64_t _cycle_start = 0;      // Start of the current conversion
+    bool _converting = false;
+    uint32_t _conversions = 0;
+    uint64_t _nvm_copy_until = 0;   // im_update is set until then after a reset
+
+    void write_register(uint8_t address, uint8_t value);
+    void start_conversion(uint64_t at);
+    void update(void);
+    void latch_results(void);
+    int32_t filter(int64_t &state, int32_t adc);
+    uint32_t standby_us(void) const;
+};
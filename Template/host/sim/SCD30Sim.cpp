@@ -0,0 +1,147 @@
+/*
+ *  Title: SCD30Sim
+ *  Description: Command-level model of a Sensirion SCD30.
+ */
+
+#include <string.h>
+#include "SCD30Sim.h"
+
+///@brief Sensirion CRC-8 (polynomial 0x31, init 0xFF)
+static uint8_t sim_crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0xFF;
+    for (size_t j = 0; j < len; j++) {
+        crc ^= data[j];
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+SCD30Sim::SCD30Sim(SimClock &clock) : _clock(clock) {
+    set_measurement(650.0f, 22.5f, 41.0f);
+}
+
+void SCD30Sim::set_measurement(float co2, float temperature, float relative_humidity) {
+    _co2 = co2;
+    _temperature = temperature;
+    _humidity = relative_humidity;
+}
+
+bool SCD30Sim::data_ready(void) const {
+    return _measuring && _clock.time_us() >= _next_ready;
+}
+
+void SCD30Sim::respond_words(const uint16_t *words, size_t count) {
+    _response_len = 0;
+    for (size_t i = 0; i < count && _response_len + 3 <= sizeof(_response); i++) {
+        uint8_t *word = &_response[_response_len];
+        word[0] = words[i] >> 8;
+        word[1] = words[i] & 0xFF;
+        word[2] = sim_crc8(word, 2);
+        _response_len += 3;
+    }
+    if (_corrupt_responses > 0 && _response_len > 0) {
+        _response[2] ^= 0xFF;
+        _corrupt_responses--;
+    }
+}
+
+bool SCD30Sim::on_write(const uint8_t *src, size_t len) {
+    if (len == 0) return true;
+    if (len < 2) return false;
+
+    uint16_t command = (uint16_t)(src[0] << 8) | src[1];
+    bool has_argument = false;
+    uint16_t argument = 0;
+    if (len >= 5) {
+        if (sim_crc8(src + 2, 2) == src[4]) {
+            has_argument = true;
+            argument = (uint16_t)(src[2] << 8) | src[3];
+        }
+    }
+
+    _commands++;
+    _response_len = 0;
+    _response_time = _clock.time_us();
+
+    // Commands that take an argument are "get" commands when sent without one
+    uint16_t *setting = nullptr;
+    switch (command) {
+        case 0x0010:
+            if (len >= 5 && !has_argument) { _crc_errors++; return false; }
+            if (has_argument) {
+                _pressure = argument;
+                if (!_measuring) _next_ready = _clock.time_us() + (uint64_t)_interval * 1000000;
+                _measuring = true;
+            } else {
+                respond_word(_pressure);
+            }
+            return true;
+        case 0x0104:
+            _measuring = false;
+            return true;
+        case 0x4600:
+            if (len >= 5 && !has_argument) { _crc_errors++; return false; }
+            if (has_argument) {
+                if (argument < 2 || argument > 1800) return false;
+                _interval = argument;
+            } else {
+                respond_word(_interval);
+            }
+            return true;
+        case 0x0202:
+            respond_word(data_ready() ? 1 : 0);
+            return true;
+        case 0x0300: {
+            uint32_t co2 = float_bits(_co2);
+            uint32_t temperature = float_bits(_temperature);
+            uint32_t humidity = float_bits(_humidity);
+            uint16_t words[6] = {(uint16_t)(co2 >> 16), (uint16_t)co2,
+                                 (uint16_t)(temperature >> 16), (uint16_t)temperature,
+                                 (uint16_t)(humidity >> 16), (uint16_t)humidity};
+            respond_words(words, 6);
+            if (data_ready()) {
+                uint64_t now = _clock.time_us();
+                while (_next_ready <= now) _next_ready += (uint64_t)_interval * 1000000;
+                _measurements_read++;
+            }
+            return true;
+        }
+        case 0x5306: setting = &_asc; break;
+        case 0x5204: setting = &_frc_reference; break;
+        case 0x5403: setting = &_temperature_offset; break;
+        case 0x5102: setting = &_altitude; break;
+        case 0xD304:
+            _response_len = 0;
+            return true;
+        case 0xD100:
+            respond_word(0x0342);
+            return true;
+        default:
+            return false;
+    }
+
+    if (len >= 5 && !has_argument) { _crc_errors++; return false; }
+    if (has_argument) {
+        *setting = argument;
+    } else {
+        respond_word(*setting);
+    }
+    return true;
+}
+
+bool SCD30Sim::on_read(uint8_t *dst, size_t len) {
+    if (_clock.time_us() < _response_time + RESPONSE_DELAY_US) return false;
+
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = (i < _response_len) ? _response[i] : 0xFF;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+/*
+ *  Title: SCD30Sim
+ *  Description: Command-level model of a Sensirion SCD30 on the simulated
+ *               I2C bus. Commands are 16-bit words, arguments and responses
+ *               are 16-bit words each followed by a CRC-8 byte. A read has to
+ *               come at least 3 ms after the command that set it up, as the
+ *               interface description requires, otherwise it is NAKed.
+ */
+#pragma once
+#include "SimI2CBus.h"
+
+class SCD30Sim : public SimDevice {
+public:
+    SCD30Sim(SimClock &clock);
+
+    bool on_write(const uint8_t *src, size_t len) override;
+    bool on_read(uint8_t *dst, size_t len) override;
+
+    ///@brief Set the values reported by the next measurements
+    void set_measurement(float co2, float temperature, float relative_humidity);
+
+    ///@brief Minimum time between a command and the read of its response
+    static const uint32_t RESPONSE_DELAY_US = 3000;
+
+    ///@brief Level of the RDY pin, high while a new measurement is waiting to be read
+    bool rdy(void) const { return data_ready(); }
+
+    ///@brief Send the next responses with a wrong CRC on their first word
+    void corrupt_responses(uint32_t count) { _corrupt_responses = count; }
+
+    bool measuring(void) const { return _measuring; }
+    uint16_t interval(void) const { return _interval; }
+    uint32_t measurements_read(void) const { return _measurements_read; }
+    uint32_t commands(void) const { return _commands; }
+    uint32_t crc_errors(void) const { return _crc_errors; }
+private:
+    SimClock &_clock;
+
+    float _co2, _temperature, _humidity;
+
+    bool _measuring = false;
+    uint16_t _interval = 2;
+    uint16_t _pressure = 0;
+    uint16_t _altitude = 0;
+    uint16_t _temperature_offset = 0;
+    uint16_t _frc_reference = 400;
+    uint16_t _asc = 0;
+    uint64_t _next_ready = 0;
+
+    uint8_t _response[18];
+    size_t _response_len = 0;
+    uint64_t _response_time = 0;
+
+    uint32_t _measurements_read = 0;
+    uint32_t _commands = 0;
+    uint32_t _crc_errors = 0;
+    uint32_t _corrupt_responses = 0;
+
+    void respond_words(const uint16_t *words, size_t count);
+    void respond_word(uint16_t word) { respond_words(&word, 1); }
+    bool data_ready(void) const;
+};
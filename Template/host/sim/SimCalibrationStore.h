@@ -0,0 +1,37 @@
+/*
+ *  Title: SimCalibrationStore
+ *  Description: In-memory stand-in for the flash sector that keeps the
+ *               BME280 calibration between boots. Survives as long as the
+ *               object does, which is what a warm boot looks like on host.
+ */
+#pragma once
+#include <string.h>
+#include <BME280.h>
+
+class SimCalibrationStore : public BME280::CalibrationStore {
+public:
+    SimCalibrationStore() { erase(); }
+
+    bool load(BME280::CalibrationBlob &blob) override {
+        loads++;
+        memcpy(&blob, _image, sizeof(blob));
+        return true;
+    }
+
+    bool save(const BME280::CalibrationBlob &blob) override {
+        saves++;
+        memcpy(_image, &blob, sizeof(blob));
+        return true;
+    }
+
+    ///@brief Back to the erased flash state (all 0xFF)
+    void erase(void) { memset(_image, 0xFF, sizeof(_image)); }
+
+    ///@brief Flip one bit of the stored image
+    void corrupt(size_t byte) { _image[byte % sizeof(_image)] ^= 0x01; }
+
+    uint32_t loads = 0;
+    uint32_t saves = 0;
+private:
+    uint8_t _image[sizeof(BME280::CalibrationBlob)];
+};
@@ -0,0 +1,19 @@
+/*
+ *  Title: SimClock
+ *  Description: Virtual clock for host runs. Time only moves when a driver
+ *               sleeps or when the simulated bus spends time on a transfer,
+ *               so every measurement made against it is deterministic.
+ */
+#pragma once
+#include <I2CBus.h>
+
+class SimClock : public Clock {
+public:
+    uint64_t time_us(void) override { return _now; }
+    void sleep_us(uint64_t us) override { _now += us; }
+
+    ///@brief Move time forward without going through a driver
+    void advance_us(uint64_t us) { _now += us; }
+private:
+    uint64_t _now = 0;
+};
@@ -0,0 +1,73 @@
+/*
+ *  Title: SimFlash
+ *  Description: In-memory NOR flash with an optional image file.
+ */
+
+#include <string.h>
+#include "SimFlash.h"
+
+SimFlash::SimFlash(uint32_t size, const char *path) :
+    _image(size, 0xFF),
+    _erases(size / LOG_FLASH_SECTOR_SIZE, 0),
+    _file(nullptr),
+    _tear_bytes(-1) {
+    if (path == nullptr) return;
+
+    _file = fopen(path, "r+b");
+    if (_file != nullptr && fread(_image.data(), 1, size, _file) == size) return;
+
+    // Missing or the wrong size: start from an erased image
+    if (_file != nullptr) fclose(_file);
+    memset(_image.data(), 0xFF, size);
+    _file = fopen(path, "w+b");
+    if (_file != nullptr) write_through(0, size);
+}
+
+SimFlash::~SimFlash() {
+    if (_file != nullptr) fclose(_file);
+}
+
+void SimFlash::write_through(uint32_t offset, size_t len) {
+    if (_file == nullptr) return;
+    fseek(_file, offset, SEEK_SET);
+    fwrite(_image.data() + offset, 1, len, _file);
+    fflush(_file);
+}
+
+bool SimFlash::read(uint32_t offset, uint8_t *dst, size_t len) {
+    if (offset + len > _image.size()) return false;
+    memcpy(dst, _image.data() + offset, len);
+    read_bytes += len;
+    return true;
+}
+
+bool SimFlash::program(uint32_t offset, const uint8_t *src, size_t len) {
+    if (offset + len > _image.size() || offset % LOG_FLASH_PAGE_SIZE != 0 || len % LOG_FLASH_PAGE_SIZE != 0) {
+        return false;
+    }
+
+    size_t landed = len;
+    if (_tear_bytes >= 0) {
+        landed = ((size_t)_tear_bytes < len) ? (size_t)_tear_bytes : len;
+        _tear_bytes = -1;
+    }
+    for (size_t i = 0; i < landed; i++) {
+        _image[offset + i] &= src[i];
+    }
+    write_through(offset, len);
+    programs++;
+    busy_us += PAGE_PROGRAM_US * (len / LOG_FLASH_PAGE_SIZE);
+
+    // Read back like PicoFlash does
+    return memcmp(_image.data() + offset, src, len) == 0;
+}
+
+bool SimFlash::erase(uint32_t offset) {
+    if (offset + LOG_FLASH_SECTOR_SIZE > _image.size() || offset % LOG_FLASH_SECTOR_SIZE != 0) return false;
+    memset(_image.data() + offset, 0xFF, LOG_FLASH_SECTOR_SIZE);
+    write_through(offset, LOG_FLASH_SECTOR_SIZE);
+    _erases[offset / LOG_FLASH_SECTOR_SIZE]++;
+    erases++;
+    busy_us += SECTOR_ERASE_US;
+    return true;
+}
@@ -0,0 +1,50 @@
+/*
+ *  Title: SimFlash
+ *  Description: NOR flash region kept in memory and, if a path is given,
+ *               written through to an image file, so a log survives
+ *               between runs like it does across a reboot. Programming only
+ *               clears bits, as on the real part.
+ *
+ *               Busy time is modelled on the W25Q16JV on the Pico board:
+ *               0.4 ms per page program and 45 ms per sector erase (typical).
+ */
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <FlashDevice.h>
+
+class SimFlash : public FlashDevice {
+public:
+    static const uint32_t PAGE_PROGRAM_US = 400;
+    static const uint32_t SECTOR_ERASE_US = 45000;
+
+    ///@param size Size of the region, a multiple of LOG_FLASH_SECTOR_SIZE
+    ///@param path Image file, loaded if it exists and the right size, otherwise created erased
+    SimFlash(uint32_t size, const char *path = nullptr);
+    ~SimFlash();
+
+    uint32_t size(void) override { return (uint32_t)_image.size(); }
+    bool read(uint32_t offset, uint8_t *dst, size_t len) override;
+    bool program(uint32_t offset, const uint8_t *src, size_t len) override;
+    bool erase(uint32_t offset) override;
+
+    ///@brief Power loss during the next program: only its first bytes reach the flash
+    void tear_next_program(size_t bytes) { _tear_bytes = (long)bytes; }
+
+    ///@brief Erase cycles of one sector since the object was created
+    uint32_t sector_erases(uint32_t sector) const { return _erases[sector]; }
+
+    void reset_counters(void) { read_bytes = programs = erases = 0; busy_us = 0; }
+
+    uint64_t read_bytes = 0;
+    uint32_t programs = 0;
+    uint32_t erases = 0;
+    uint64_t busy_us = 0;
+private:
+    std::vector<uint8_t> _image;
+    std::vector<uint32_t> _erases;
+    FILE *_file;
+    long _tear_bytes;
+
+    void write_through(uint32_t offset, size_t len);
+};
@@ -0,0 +1,163 @@
+/*
+ *  Title: SimI2CBus
+ *  Description: Simulated I2C controller.
+ */
+
+#include "SimI2CBus.h"
+
+void SimI2CBus::attach(uint8_t addr, SimDevice *device) {
+    _devices[addr & 0x7F] = device;
+}
+
+void SimI2CBus::detach(uint8_t addr) {
+    _devices[addr & 0x7F] = nullptr;
+}
+
+int SimI2CBus::write(uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint32_t timeout_us) {
+    SimDevice *device = _devices[addr & 0x7F];
+    _transfers++;
+    int fault = take_fault(addr);
+    if (fault == BUS_ERROR_TIMEOUT) {
+        _clock.advance_us(timeout_us);
+        return BUS_ERROR_TIMEOUT;
+    }
+    if (device == nullptr || fault != 0) {
+        // Only the address byte goes out before the NAK
+        _clock.advance_us(wire_time_us(0, nostop));
+        return BUS_ERROR_GENERIC;
+    }
+    uint64_t cost = wire_time_us(len, nostop);
+    if (cost > timeout_us) {
+        _clock.advance_us(timeout_us);
+        return BUS_ERROR_TIMEOUT;
+    }
+    _clock.advance_us(cost);
+    if (!device->on_write(src, len)) return BUS_ERROR_GENERIC;
+    _bytes += len;
+    return (int)len;
+}
+
+int SimI2CBus::read(uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us) {
+    SimDevice *device = _devices[addr & 0x7F];
+    _transfers++;
+    int fault = take_fault(addr);
+    if (fault == BUS_ERROR_TIMEOUT) {
+        _clock.advance_us(timeout_us);
+        return BUS_ERROR_TIMEOUT;
+    }
+    if (device == nullptr || fault != 0) {
+        _clock.advance_us(wire_time_us(0, nostop));
+        return BUS_ERROR_GENERIC;
+    }
+    uint64_t cost = wire_time_us(len, nostop);
+    if (cost > timeout_us) {
+        _clock.advance_us(timeout_us);
+        return BUS_ERROR_TIMEOUT;
+    }
+    _clock.advance_us(cost);
+    if (!device->on_read(dst, len)) return BUS_ERROR_GENERIC;
+    _bytes += len;
+    return (int)len;
+}
+
+bool SimI2CBus::start_transfer(I2CTransfer *transfer) {
+    if (_active != nullptr || transfer->tx_len + transfer->rx_len == 0) return false;
+
+    uint64_t cost;
+    _active_fault = take_fault(transfer->address);
+    if (_active_fault == BUS_ERROR_TIMEOUT) {
+        cost = transfer->timeout_us;
+    } else if (_devices[transfer->address & 0x7F] == nullptr || _active_fault != 0) {
+        cost = wire_time_us(0, false);
+    } else {
+        cost = 0;
+        if (transfer->tx_len > 0) cost += wire_time_us(transfer->tx_len, transfer->rx_len > 0);
+        if (transfer->rx_len > 0) cost += wire_time_us(transfer->rx_len, false);
+    }
+    if (cost > transfer->timeout_us) cost = transfer->timeout_us;
+
+    transfer->done = false;
+    transfer->result = 0;
+    _active = transfer;
+    _complete_at = _clock.time_us() + cost;
+    return true;
+}
+
+void SimI2CBus::poll(void) {
+    if (_active == nullptr || _clock.time_us() < _complete_at) return;
+
+    I2CTransfer *transfer = _active;
+    SimDevice *device = _devices[transfer->address & 0x7F];
+    uint64_t cost = 0;
+    if (transfer->tx_len > 0) cost += wire_time_us(transfer->tx_len, transfer->rx_len > 0);
+    if (transfer->rx_len > 0) cost += wire_time_us(transfer->rx_len, false);
+
+    int result;
+    if (_active_fault != 0) {
+        _transfers++;
+        result = _active_fault;
+    } else if (device == nullptr) {
+        _transfers++;
+        result = BUS_ERROR_GENERIC;
+    } else if (cost > transfer->timeout_us) {
+        _transfers++;
+        result = BUS_ERROR_TIMEOUT;
+    } else {
+        result = 0;
+        if (transfer->tx_len > 0) {
+            _transfers++;
+            if (device->on_write(transfer->tx, transfer->tx_len)) {
+                _bytes += transfer->tx_len;
+                result += (int)transfer->tx_len;
+            } else {
+                result = BUS_ERROR_GENERIC;
+            }
+        }
+        if (result >= 0 && transfer->rx_len > 0) {
+            _transfers++;
+            if (device->on_read(transfer->rx, transfer->rx_len)) {
+                _bytes += transfer->rx_len;
+                result += (int)transfer->rx_len;
+            } else {
+                result = BUS_ERROR_GENERIC;
+            }
+        }
+    }
+
+    _active = nullptr;
+    transfer->result = result;
+    transfer->done = true;
+    if (transfer->callback != nullptr) transfer->callback(transfer);
+}
+
+bool SimI2CBus::recover(void) {
+    _recoveries++;
+    _sda_held = false;
+    // Nine clocks and a STOP
+    _clock.advance_us(wire_time_us(0, false));
+    return true;
+}
+
+void SimI2CBus::inject_faults(uint8_t addr, uint32_t count, int error) {
+    _fault_address = addr & 0x7F;
+    _fault_count = count;
+    _fault_error = error;
+}
+
+///@brief Fault for a transfer that is starting, 0 if it goes through
+int SimI2CBus::take_fault(uint8_t addr) {
+    if (_sda_held) return BUS_ERROR_TIMEOUT;
+    if (_fault_count == 0 || (addr & 0x7F) != _fault_address) return 0;
+    _fault_count--;
+    return _fault_error;
+}
+
+///@brief Time on the wire for one transfer
+///@param len Payload bytes
+///@param nostop True if the transfer ends without a STOP condition
+///@return Duration in microseconds, rounded up
+uint64_t SimI2CBus::wire_time_us(size_t len, bool nostop) const {
+    // START + address byte with ACK + payload bytes with ACK (+ STOP)
+    uint64_t clocks = 1 + 9 + 9 * (uint64_t)len + (nostop ? 0 : 1);
+    return (clocks * 1000000 + _baudrate - 1) / _baudrate;
+}
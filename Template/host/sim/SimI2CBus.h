@@ -0,0 +1,82 @@
+/*
+ *  Title: SimI2CBus
+ *  Description: Simulated I2C controller. Devices attach at an address and
+ *               receive the raw bytes of every transfer. Each transfer costs
+ *               the time it would take on the wire at the configured baud
+ *               rate (9 clocks per byte plus START/address/STOP).
+ *
+ *               Asynchronous transfers take the same wire time but leave the
+ *               clock alone: the devices see the bytes, and the callback
+ *               runs, from the first poll() at or after the completion time.
+ *
+ *               Faults can be injected per device (NAK or timeout), and SDA
+ *               can be held low so every transfer times out until recover().
+ */
+#pragma once
+#include <I2CBus.h>
+#include "SimClock.h"
+
+/**
+ * @class SimDevice
+ * @brief A device on the simulated bus. Returning false NAKs the transfer.
+ */
+class SimDevice {
+public:
+    virtual ~SimDevice() {}
+    virtual bool on_write(const uint8_t *src, size_t len) = 0;
+    virtual bool on_read(uint8_t *dst, size_t len) = 0;
+};
+
+class SimI2CBus : public I2CBus {
+public:
+    SimI2CBus(SimClock &clock, uint32_t baudrate = 400000) : _clock(clock), _baudrate(baudrate) {}
+
+    void attach(uint8_t addr, SimDevice *device);
+    void detach(uint8_t addr);
+
+    int write(uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint32_t timeout_us) override;
+    int read(uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us) override;
+
+    bool start_transfer(I2CTransfer *transfer) override;
+    void poll(void) override;
+    bool busy(void) override { return _active != nullptr; }
+
+    uint32_t baudrate(void) override { return _baudrate; }
+    bool recover(void) override;
+
+    ///@brief Make the next transfers to a device fail
+    ///@param addr Device address
+    ///@param count Number of transfers that fail
+    ///@param error BUS_ERROR_GENERIC (NAK) or BUS_ERROR_TIMEOUT
+    void inject_faults(uint8_t addr, uint32_t count, int error);
+    ///@brief A device holds SDA low, every transfer times out until recover()
+    void hold_sda(void) { _sda_held = true; }
+    uint32_t recoveries(void) const { return _recoveries; }
+
+    ///@brief Simulated time at which the transfer in flight completes
+    uint64_t completes_at(void) const { return _complete_at; }
+
+    ///@brief Number of transfers (START or repeated START) seen so far
+    uint32_t transfers(void) const { return _transfers; }
+    ///@brief Number of payload bytes moved so far, address bytes excluded
+    uint32_t bytes(void) const { return _bytes; }
+    void reset_counters(void) { _transfers = 0; _bytes = 0; }
+private:
+    SimClock &_clock;
+    uint32_t _baudrate;
+    SimDevice *_devices[128] = {};
+    uint32_t _transfers = 0;
+    uint32_t _bytes = 0;
+    I2CTransfer *_active = nullptr;
+    uint64_t _complete_at = 0;
+    int _active_fault = 0;
+
+    uint8_t _fault_address = 0;
+    uint32_t _fault_count = 0;
+    int _fault_error = 0;
+    bool _sda_held = false;
+    uint32_t _recoveries = 0;
+
+    uint64_t wire_time_us(size_t len, bool nostop) const;
+    int take_fault(uint8_t addr);
+};
@@ -0,0 +1,43 @@
+/*
+ *  Title: SimSPIBus
+ *  Description: Simulated SPI controller for register devices.
+ */
+
+#include "SimSPIBus.h"
+
+void SimSPIBus::attach(uint8_t cs, SimDevice *device) {
+    if (cs < SIM_SPI_DEVICES) _devices[cs] = device;
+}
+
+int SimSPIBus::transfer(uint8_t cs, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) {
+    if (cs >= SIM_SPI_DEVICES) return BUS_ERROR_GENERIC;
+
+    _frames++;
+    uint64_t clocks = 2 + 8 * (uint64_t)(tx_len + rx_len);
+    _carry_ns += (clocks * 1000000000ull + _baudrate - 1) / _baudrate;
+    _clock.advance_us(_carry_ns / 1000);
+    _carry_ns %= 1000;
+
+    SimDevice *device = _devices[cs];
+    if (tx_len > 0) _last_command = tx[0];
+    if (device == nullptr) {
+        // Nobody drives MISO, the pull-up reads as 0xFF
+        for (size_t i = 0; i < rx_len; i++) rx[i] = 0xFF;
+    } else if (tx_len > 0 && (tx[0] & 0x80)) {
+        uint8_t pointer = tx[0];
+        device->on_write(&pointer, 1);
+        device->on_read(rx, rx_len);
+    } else {
+        uint8_t pairs[256];
+        size_t n = tx_len & ~(size_t)1;
+        if (n > sizeof(pairs)) n = sizeof(pairs);
+        for (size_t i = 0; i < n; i += 2) {
+            pairs[i] = tx[i] | 0x80;
+            pairs[i + 1] = tx[i + 1];
+        }
+        device->on_write(pairs, n);
+        for (size_t i = 0; i < rx_len; i++) rx[i] = 0xFF;
+    }
+    _bytes += (uint32_t)(tx_len + rx_len);
+    return (int)(tx_len + rx_len);
+}
@@ -0,0 +1,45 @@
+/*
+ *  Title: SimSPIBus
+ *  Description: Simulated SPI controller for register devices. Devices
+ *               attach at a chip-select index and see the same byte
+ *               stream as on SimI2CBus: a frame with bit 7 set in its first
+ *               byte becomes a register-pointer write and a read, any other
+ *               frame a write of (register, value) pairs with bit 7 put back.
+ *
+ *               Each frame costs 8 clocks per byte plus one for chip-select
+ *               setup and one for hold at the configured baud rate. Time is
+ *               kept in nanoseconds so short frames at 10 MHz add up right.
+ */
+#pragma once
+#include <SPIBus.h>
+#include "SimClock.h"
+#include "SimI2CBus.h"
+
+#define SIM_SPI_DEVICES 8
+
+class SimSPIBus : public SPIBus {
+public:
+    SimSPIBus(SimClock &clock, uint32_t baudrate = 10000000) : _clock(clock), _baudrate(baudrate) {}
+
+    void attach(uint8_t cs, SimDevice *device);
+
+    int transfer(uint8_t cs, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) override;
+
+    uint32_t baudrate(void) override { return _baudrate; }
+
+    ///@brief Number of chip-select frames seen so far
+    uint32_t frames(void) const { return _frames; }
+    ///@brief Number of bytes moved so far, register bytes included
+    uint32_t bytes(void) const { return _bytes; }
+    ///@brief First byte of the last frame, the register with its read/write bit
+    uint8_t last_command(void) const { return _last_command; }
+    void reset_counters(void) { _frames = 0; _bytes = 0; }
+private:
+    SimClock &_clock;
+    uint32_t _baudrate;
+    SimDevice *_devices[SIM_SPI_DEVICES] = {};
+    uint32_t _frames = 0;
+    uint32_t _bytes = 0;
+    uint8_t _last_command = 0;
+    uint64_t _carry_ns = 0;         // Wire time not yet handed to the clock
+};
@@ -0,0 +1,1505 @@
+/*
+ *  Title: sim_run
+ *  Description: Host counterpart of main.cpp. Brings up the BME280 and SCD30
+ *               drivers on the simulated bus, takes a few samples and checks
+ *               them against the values the simulated calibration must give.
+ *               Exits non-zero if anything is off.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <BME280.h>
+#include <BME280Fixed.h>
+#include <SCD30.h>
+#include <BusHealth.h>
+#include <CompletionQueue.h>
+#include <SPIBus.h>
+#include <SensirionProtocol.h>
+#include <SampleRing.h>
+#include <SampleHistory.h>
+#include <SampleRollup.h>
+#include <SampleFrame.h>
+#include <SampleCodec.h>
+#include <BusManager.h>
+#include <Trace.h>
+#include <DutyCycle.h>
+#include <EnergyMeter.h>
+#include <SampleLog.h>
+#include <FixedMath.h>
+#include <DerivedMetrics.h>
+#include <vector>
+#include <algorithm>
+#include "SimClock.h"
+#include "SimI2CBus.h"
+#include "SimSPIBus.h"
+#include "BME280Sim.h"
+#include "SCD30Sim.h"
+#include "SimCalibrationStore.h"
+#include "SimFlash.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        printf("  FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void count_bme280_read(BME280 *, bool success, void *context) {
+    if (success) (*(int *)context)++;
+}
+
+static void count_scd30_read(SCD30 *, bool success, void *context) {
+    if (success) (*(int *)context)++;
+}
+
+/**
+ * Two threads on one ring. The producer numbers every sample it offers and
+ * the consumer checks that what arrives is in order and intact. If the
+ * producer waits when the ring is full nothing may be lost, otherwise the
+ * samples received plus the overflow count must add up to those offered.
+ */
+static void check_ring(uint32_t count, bool wait_when_full, uint32_t consumer_pause_every) {
+    SampleRing *ring = new SampleRing();
+    std::atomic<bool> done(false);
+    uint32_t received = 0, out_of_order = 0, corrupt = 0;
+
+    std::thread consumer([&]() {
+        Sample sample;
+        int64_t last = -1;
+        while (true) {
+            bool finished = done.load(std::memory_order_acquire);
+            if (!ring->pop(sample)) {
+                if (finished) break;
+                std::this_thread::yield();
+                continue;
+            }
+            if ((int64_t)sample.values[0] <= last) out_of_order++;
+            if (sample.values[1] != ~sample.values[0] || sample.timestamp_us != (uint64_t)sample.values[0] * 3 ||
+                sample.sequence != (uint16_t)sample.values[0]) {
+                corrupt++;
+            }
+            last = sample.values[0];
+            received++;
+            if (consumer_pause_every && received % consumer_pause_every == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    });
+
+    for (uint32_t i = 0; i < count; i++) {
+        Sample sample = {};
+        sample.timestamp_us = (uint64_t)i * 3;
+        sample.sensor = SENSOR_BME280;
+        sample.sequence = (uint16_t)i;
+        sample.values[0] = (int32_t)i;
+        sample.values[1] = ~(int32_t)i;
+        while (!ring->push(sample) && wait_when_full) std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    printf("  %u offered, %u received, high water %u/%u%s\n", count, received, ring->high_water(),
+           SampleRing::CAPACITY, wait_when_full ? "" : ", slow consumer");
+    check(out_of_order == 0, "ring keeps order");
+    check(corrupt == 0, "ring samples intact");
+    if (wait_when_full) {
+        check(received == count, "ring loses nothing when the producer waits");
+    } else {
+        check(received + ring->overflows() == count, "ring counts every dropped sample");
+        check(ring->overflows() > 0, "slow consumer overflows the ring");
+    }
+    delete ring;
+}
+
+/**
+ * Windowed statistics against a rescan of the same window, over random
+ * values with bursts that overrun the capacity and gaps that empty it.
+ */
+static void check_window_stats(void) {
+    const uint64_t WINDOW_US = 60000000;
+    const size_t CAPACITY = 64;
+    WindowStats<CAPACITY> stats(WINDOW_US);
+    std::vector<uint64_t> times;
+    std::vector<int32_t> values;
+    uint32_t seed = 12345;
+    uint64_t now = 0;
+    int mismatches = 0;
+
+    for (int i = 0; i < 20000; i++) {
+        seed = seed * 1664525 + 1013904223;
+        uint32_t step = (seed >> 8) % 100;
+        now += (step < 5) ? 100000 : (step == 99 ? 70000000 : 1000000);
+        seed = seed * 1664525 + 1013904223;
+        int32_t value = 2500 + (int32_t)((seed >> 12) % 2001) - 1000;
+        stats.add(now, value);
+        times.push_back(now);
+        values.push_back(value);
+
+        size_t first = times.size();
+        while (first > 0 && now - times[first - 1] <= WINDOW_US && times.size() - first < CAPACITY) first--;
+        uint32_t n = times.size() - first;
+        int32_t min = values[first], max = values[first];
+        double sum = 0, sum_sq = 0;
+        for (size_t j = first; j < times.size(); j++) {
+            if (values[j] < min) min = values[j];
+            if (values[j] > max) max = values[j];
+            sum += values[j];
+        }
+        double mean = sum / n;
+        for (size_t j = first; j < times.size(); j++) sum_sq += (values[j] - mean) * (values[j] - mean);
+        double variance = (n > 1) ? sum_sq / n : 0;
+
+        WindowSummary summary = stats.summary();
+        if (summary.count != n || summary.min != min || summary.max != max ||
+            fabs(summary.mean - mean) > 1e-6 || fabs(summary.variance - variance) > 1e-6 * (1 + variance)) {
+            mismatches++;
+        }
+    }
+    printf("  %zu samples, %d mismatches against rescan\n", values.size(), mismatches);
+    check(mismatches == 0, "window statistics match rescan");
+
+    stats.expire(now + WINDOW_US + 1);
+    check(stats.count() == 0 && stats.mean() == 0 && stats.variance() == 0, "window empties when samples stop");
+
+    SampleHistory<8, 16, 64> history(10000000, 60000000);
+    for (int i = 0; i < 20; i++) {
+        Sample sample = {};
+        sample.timestamp_us = (uint64_t)i * 1000000;
+        sample.sequence = (uint16_t)i;
+        sample.values[0] = i;
+        sample.values[1] = 100 - i;
+        sample.values[2] = 7;
+        history.add(sample);
+    }
+    check(history.size() == 8 && history.at(0).sequence == 12 && history.latest().sequence == 19,
+          "history keeps the newest samples");
+    WindowSummary recent = history.short_summary(0), all = history.long_summary(1);
+    check(recent.count == 11 && recent.min == 9 && recent.max == 19 && recent.mean == 14.0, "short window summary");
+    check(all.count == 20 && all.min == 81 && all.max == 100 && history.long_summary(2).variance == 0,
+          "long window summary");
+
+    // Values that share a window give the same statistics as a window each, with one timestamp ring
+    WindowStats<16, 3> shared(10000000);
+    WindowStats<16> single[3] = {WindowStats<16>(10000000), WindowStats<16>(10000000), WindowStats<16>(10000000)};
+    seed = 777;
+    int differences = 0;
+    for (int i = 0; i < 2000; i++) {
+        int32_t values[3];
+        for (int v = 0; v < 3; v++) {
+            seed = seed * 1664525 + 1013904223;
+            values[v] = (int32_t)(seed >> 16) - 32768;
+            single[v].add((uint64_t)i * 500000, values[v]);
+        }
+        shared.add((uint64_t)i * 500000, values);
+        for (int v = 0; v < 3; v++) {
+            WindowSummary a = shared.summary(v), b = single[v].summary();
+            if (a.count != b.count || a.min != b.min || a.max != b.max || a.mean != b.mean || a.variance != b.variance) {
+                differences++;
+            }
+        }
+    }
+    check(differences == 0, "shared window matches one window per value");
+    check(sizeof(shared) <= 3 * sizeof(single[0]) - 2 * 16 * sizeof(uint64_t), "timestamps stored once per window");
+}
+
+/**
+ * Frames survive the round trip, and the decoder finds its way back after
+ * text on the port, a corrupted byte and a frame cut short.
+ */
+static void check_frames(void) {
+    uint8_t check_input[] = "123456789";
+    check(crc16_ccitt(check_input, 9) == 0x29B1, "CRC-16/CCITT-FALSE check value");
+
+    Sample sent[4] = {};
+    for (int i = 0; i < 4; i++) {
+        sent[i].timestamp_us = 0x0123456789ULL + (uint64_t)i * 1000000;
+        sent[i].sensor = (i == 2) ? SENSOR_SCD30 : SENSOR_BME280;
+        sent[i].channel = (uint8_t)(i & 1);
+        sent[i].sequence = (uint16_t)(65534 + i);
+        sent[i].values[0] = -1234 + i;
+        sent[i].values[1] = (int32_t)(101325u * 256u) + i;
+        sent[i].values[2] = 0x0A0D0A0D;
+    }
+
+    uint8_t stream[256];
+    size_t len = 0;
+    const char banner[] = "[KEYRSLA]\n  Upphafsstilling tókst.\n";
+    memcpy(stream, banner, sizeof(banner) - 1);
+    len += sizeof(banner) - 1;
+    for (int i = 0; i < 4; i++) len += frame_encode(sent[i], stream + len);
+    check(len == sizeof(banner) - 1 + 4 * FRAME_LENGTH, "frame length");
+
+    size_t second = sizeof(banner) - 1 + FRAME_LENGTH;
+    stream[second + 20] ^= 0x40;                                    // Corrupt the second frame
+    memmove(stream + second + FRAME_LENGTH + 10, stream + second + FRAME_LENGTH, len - second - FRAME_LENGTH);
+    for (int i = 0; i < 10; i++) stream[second + FRAME_LENGTH + i] = (uint8_t)(i == 3 ? FRAME_SYNC_0 : 0x55);
+    len += 10;                                                      // Noise with a false sync byte
+
+    FrameDecoder decoder;
+    Sample received[8];
+    size_t total = 0;
+    for (size_t offset = 0; offset < len; offset += 7) {            // Fed in odd chunks
+        size_t decoded;
+        size_t chunk = (len - offset < 7) ? len - offset : 7;
+        decoder.feed(stream + offset, chunk, received + total, 8 - total, &decoded);
+        total += decoded;
+    }
+    check(total == 3 && decoder.crc_errors() >= 1, "decoder drops only the corrupted frame");
+    bool same = total == 3;
+    int expected[3] = {0, 2, 3};
+    for (size_t i = 0; same && i < total; i++) {
+        const Sample &a = received[i], &b = sent[expected[i]];
+        same = a.timestamp_us == b.timestamp_us && a.sensor == b.sensor && a.channel == b.channel &&
+               a.sequence == b.sequence && memcmp(a.values, b.values, sizeof(a.values)) == 0;
+    }
+    check(same, "decoded samples match");
+    printf("  %u frames, %u CRC errors, %u bytes skipped\n", decoder.frames(), decoder.crc_errors(),
+           decoder.skipped());
+}
+
+/**
+ * Codec round trip over a trace with timestamp jitter, sequence gaps, large
+ * jumps and a change of channel, then the same stream with one block
+ * damaged: only that block may be lost.
+ */
+static void check_codec(void) {
+    const int N = 1000;
+    std::vector<Sample> trace(N);
+    uint32_t seed = 777;
+    uint64_t time = 5000000;
+    uint16_t sequence = 0;
+    int32_t t = 2508, p = 100653 * 256, h = 55 * 1024;
+    for (int i = 0; i < N; i++) {
+        seed = seed * 1664525 + 1013904223;
+        time += 1000000 + (seed >> 28) - 8;
+        sequence += (i % 97 == 0) ? 3 : 1;
+        t += (int32_t)((seed >> 8) % 3) - 1;
+        p += (int32_t)((seed >> 12) % 601) - 300;
+        h += (int32_t)((seed >> 20) % 41) - 20;
+        if (i == 500) p = -5;                                       // Jump that needs a varint
+        trace[i] = {time, SENSOR_BME280, (uint8_t)(i < 700 ? 0 : 1), sequence, {t, p, h}};
+    }
+    trace[N - 1].values[0] = INT32_MIN;
+    trace[N - 2].values[0] = INT32_MAX;
+
+    std::vector<uint8_t> stream;
+    std::vector<size_t> block_starts;
+    SampleEncoder encoder;
+    uint8_t block[CODEC_MAX_BLOCK_LENGTH];
+    for (int i = 0; i <= N; i++) {
+        size_t length = (i < N) ? encoder.add(trace[i], block) : encoder.flush(block);
+        if (length == 0) continue;
+        block_starts.push_back(stream.size());
+        stream.insert(stream.end(), block, block + length);
+    }
+
+    std::vector<Sample> decoded(N + CODEC_BLOCK_SAMPLES);
+    SampleDecoder decoder;
+    size_t total = 0, offset = 0;
+    while (offset < stream.size()) {
+        size_t count, chunk = stream.size() - offset < 13 ? stream.size() - offset : 13;
+        offset += decoder.feed(&stream[offset], chunk, &decoded[total], CODEC_BLOCK_SAMPLES, &count);
+        total += count;
+    }
+    bool same = (total == (size_t)N);
+    for (int i = 0; same && i < N; i++) same = memcmp(&decoded[i], &trace[i], sizeof(Sample)) == 0;
+    printf("  %d samples in %zu blocks, %zu bytes (%.2f bytes/sample)\n", N, block_starts.size(), stream.size(),
+           (double)stream.size() / N);
+    check(same, "codec round trip is lossless");
+    check(block_starts.size() == 16, "block per 64 samples and at the channel change");
+
+    stream[block_starts[3] + 30] ^= 0x10;
+    SampleDecoder damaged;
+    total = 0;
+    offset = 0;
+    while (offset < stream.size()) {
+        size_t count;
+        offset += damaged.feed(&stream[offset], stream.size() - offset, &decoded[total], CODEC_BLOCK_SAMPLES, &count);
+        total += count;
+    }
+    printf("  damaged: %zu samples, %u blocks, %u errors\n", total, damaged.blocks(), damaged.errors());
+    check(total == (size_t)N - CODEC_BLOCK_SAMPLES && damaged.blocks() == 15 && damaged.errors() >= 1,
+          "damaged block is dropped, the rest decode");
+    check(memcmp(&decoded[3 * CODEC_BLOCK_SAMPLES], &trace[4 * CODEC_BLOCK_SAMPLES], sizeof(Sample)) == 0,
+          "decoder resyncs on the next block");
+}
+
+static void count_sample(const Sample &sample, void *context) {
+    int *counts = (int *)context;
+    counts[sample.sensor == SENSOR_SCD30 ? 2 : sample.channel]++;
+}
+
+/**
+ * Two BME280 on separate controllers and an SCD30 sharing the first one,
+ * run by the bus manager for 20 s of simulated time.
+ */
+static void check_bus_manager(void) {
+    SimClock clock;
+    SimI2CBus bus0(clock), bus1(clock);
+    BME280Sim bme0_sim(clock), bme1_sim(clock);
+    SCD30Sim scd_sim(clock);
+    bus0.attach(BME280_DEFAULT_I2CADDR, &bme0_sim);
+    bus1.attach(BME280_ALTERNATE_I2CADDR, &bme1_sim);
+    bus0.attach(SCD30_DEFAULT_I2CADDR, &scd_sim);
+
+    const BME280::Config normal = {BME280::NORMAL_MODE, BME280::OVERSAMPLING_RATE_1, BME280::OVERSAMPLING_RATE_1,
+                                   BME280::OVERSAMPLING_RATE_1, BME280::FILTER_OFF, BME280::STANDBY_62_5_MS};
+    BME280 bme0(&bus0, &clock, BME280_DEFAULT_I2CADDR), bme1(&bus1, &clock, BME280_ALTERNATE_I2CADDR);
+    SCD30 scd(&bus0, &clock);
+    check(bme0.init() && bme1.init() && scd.init(), "bus manager sensors init");
+    check(bme0.configure(normal) && bme1.configure(normal), "bus manager sensors in normal mode");
+
+    BME280Task bme0_task(&bme0, 0), bme1_task(&bme1, 1);
+    SCD30Task scd_task(&scd);
+    BusManager manager(&clock);
+    int b0 = manager.add_bus(&bus0), b1 = manager.add_bus(&bus1);
+    int s0 = manager.add_sensor(&bme0_task, b0, 100000);
+    int s1 = manager.add_sensor(&bme1_task, b1, 100000);
+    int s2 = manager.add_sensor(&scd_task, b0, 2000000, 50000);
+    check(s0 == 0 && s1 == 1 && s2 == 2, "bus manager registration");
+
+    int counts[3] = {};
+    manager.set_callback(count_sample, counts);
+    manager.start();
+    uint64_t end = clock.time_us() + 20000000;
+    while (clock.time_us() < end) {
+        manager.poll();
+        clock.advance_us(100);
+    }
+
+    const float expected[3] = {10.0f, 10.0f, 0.5f};
+    for (int i = 0; i < 3; i++) {
+        SensorStats stats = manager.stats(i);
+        printf("  sensor %d: %u samples, %.3f Hz, jitter mean %.0f us, sd %.0f us, max %u us\n", i, stats.samples,
+               stats.rate_hz, stats.jitter_mean_us, stats.jitter_stddev_us, stats.jitter_max_us);
+        check(fabsf(stats.rate_hz - expected[i]) < expected[i] * 0.01f, "achieved rate");
+        check(stats.failures == 0 && stats.overruns == 0, "no failures or overruns");
+        check(stats.jitter_max_us < 1000, "start jitter under 1 ms");
+        check(counts[i] == (int)stats.samples, "every sample delivered");
+    }
+    check(scd_sim.crc_errors() == 0, "SCD30 shares the bus cleanly");
+}
+
+/**
+ * Table CRC against the bitwise one for every possible word, the command
+ * encoder against the bytes in the SCD30 interface description, and the
+ * positions reported for corrupted response words.
+ */
+static void check_sensirion(void) {
+    int mismatches = 0;
+    for (uint32_t word = 0; word <= 0xFFFF; word++) {
+        uint8_t bytes[2] = {(uint8_t)(word >> 8), (uint8_t)word};
+        if (sensirion_crc8(bytes, 2) != sensirion_crc8_bitwise(bytes, 2)) mismatches++;
+    }
+    check(mismatches == 0, "table CRC matches bitwise CRC for all words");
+
+    // Set measurement interval to 2 s: 0x46 0x00 0x00 0x02 0xE3
+    const uint8_t expected[5] = {0x46, 0x00, 0x00, 0x02, 0xE3};
+    uint8_t command[5];
+    uint16_t interval = 2;
+    check(sensirion_encode_command(SCD30_CMD_SET_MEASUREMENT_INTERVAL, &interval, 1, command) == 5 &&
+              memcmp(command, expected, 5) == 0, "command encoding");
+    check(sensirion_encode_command(SCD30_CMD_SOFT_RESET, nullptr, 0, command) == 2, "command without arguments");
+
+    uint16_t in[6] = {0x43DB, 0x8C2E, 0x41D9, 0xE7FF, 0x4243, 0x3A1B}, out[6];
+    uint8_t response[18];
+    for (int i = 0; i < 6; i++) sensirion_encode_command(in[i], nullptr, 0, response + 3 * i);
+    for (int i = 0; i < 6; i++) response[3 * i + 2] = sensirion_crc8(response + 3 * i, 2);
+    check(sensirion_decode_words(response, 6, out) == 0 && memcmp(in, out, sizeof(in)) == 0, "decode valid words");
+    check(fabsf(sensirion_words_to_float(out) - 439.09f) < 0.01f, "float from two words");
+    response[4] ^= 0x01;
+    response[17] ^= 0x80;
+    check(sensirion_decode_words(response, 6, out) == 0b100010, "bad words reported by position");
+}
+
+/**
+ * SCD30 in event mode for 20 s of simulated time. The loop only wakes at
+ * nextServiceUs(), at the end of a bus transfer, or (RDY pin) on a rising
+ * edge of the pin, which is checked every millisecond like an interrupt.
+ */
+static void check_scd30_events(SCD30::EventSource source) {
+    SimClock clock;
+    SimI2CBus bus(clock);
+    SCD30Sim sim(clock);
+    bus.attach(SCD30_DEFAULT_I2CADDR, &sim);
+    SCD30 scd(&bus, &clock);
+    check(scd.init(), "SCD30 init for event mode");
+
+    int reads = 0;
+    check(scd.beginEvents(source, count_scd30_read, &reads), "beginEvents");
+    uint32_t commands = 0, first_read_commands = 0;
+    uint64_t blocked = 0;
+    bool rdy = false;
+    uint64_t end = clock.time_us() + 20000000;
+    while (clock.time_us() < end) {
+        if (source == SCD30::EVENTS_RDY_PIN) {
+            if (sim.rdy() && !rdy) scd.notifyDataReady();
+            rdy = sim.rdy();
+        }
+        uint64_t now = clock.time_us();
+        int before = reads;
+        scd.service();
+        blocked += clock.time_us() - now;
+        if (reads == 1 && before == 0) first_read_commands = sim.commands();
+
+        uint64_t next = scd.nextServiceUs();
+        if (bus.busy() && bus.completes_at() < next) next = bus.completes_at();
+        if (source == SCD30::EVENTS_RDY_PIN && next > now + 1000) next = now + 1000;
+        clock.advance_us(next > now ? next - now : 1);
+    }
+    commands = sim.commands() - first_read_commands;
+
+    printf("  %s: %d reads, %u commands after the first read, %llu us blocked\n",
+           source == SCD30::EVENTS_RDY_PIN ? "RDY pin" : "timed", reads, commands, (unsigned long long)blocked);
+    check(reads >= 9 && (uint32_t)reads == sim.measurements_read(), "one read per measurement");
+    check(blocked == 0, "event mode never blocks");
+    uint32_t per_read = (source == SCD30::EVENTS_RDY_PIN) ? 1 : 2;
+    check(commands == per_read * (uint32_t)(reads - 1), "no extra data ready polling");
+    check(sim.crc_errors() == 0, "event mode no CRC errors");
+}
+
+/**
+ * BusHealth in front of the simulated buses. A single NAK is retried, a
+ * held SDA line is cleared after two timeouts, and a BME280 that drops
+ * off its bus for 2 s is re-initialised by the bus manager while the
+ * sensor on the other controller keeps its rate.
+ */
+static void check_bus_health(void) {
+    SimClock clock;
+    SimI2CBus bus0(clock), bus1(clock);
+    BME280Sim bme0_sim(clock), bme1_sim(clock);
+    bus0.attach(BME280_DEFAULT_I2CADDR, &bme0_sim);
+    bus1.attach(BME280_ALTERNATE_I2CADDR, &bme1_sim);
+    BusHealth health0(&bus0, &clock), health1(&bus1, &clock);
+    BME280 bme0(&health0, &clock, BME280_DEFAULT_I2CADDR), bme1(&health1, &clock, BME280_ALTERNATE_I2CADDR);
+    check(bme0.init() && bme1.init(), "sensors init behind BusHealth");
+
+    bus0.inject_faults(BME280_DEFAULT_I2CADDR, 1, BUS_ERROR_GENERIC);
+    check(bme0.read(), "read retried after a NAK");
+    const DeviceHealth *device = health0.device(BME280_DEFAULT_I2CADDR);
+    check(device != nullptr && device->naks == 1 && device->retries == 1 && device->failures == 0,
+          "NAK counted without a failure");
+
+    bus0.hold_sda();
+    uint64_t start = clock.time_us();
+    check(bme0.read(), "read succeeds after a bus clear");
+    uint64_t stalled = clock.time_us() - start;
+    printf("  held SDA: cleared after %u timeouts, read took %llu us\n", device->timeouts,
+           (unsigned long long)stalled);
+    check(health0.recoveries() == 1 && bus0.recoveries() == 1, "bus cleared once");
+    check(stalled < 5000, "held SDA costs less than 5 ms");
+
+    bus0.inject_faults(BME280_DEFAULT_I2CADDR, 1, BUS_ERROR_TIMEOUT);
+    check(bme0.start_read(), "start_read behind BusHealth");
+    int polls = 0;
+    BME280::MeasurementState state;
+    while ((state = bme0.poll_read()) == BME280::MEASUREMENT_PENDING && polls++ < 1000) clock.advance_us(100);
+    check(state == BME280::MEASUREMENT_READY, "async read retried after a timeout");
+
+    const BME280::Config normal = {BME280::NORMAL_MODE, BME280::OVERSAMPLING_RATE_1, BME280::OVERSAMPLING_RATE_1,
+                                   BME280::OVERSAMPLING_RATE_1, BME280::FILTER_OFF, BME280::STANDBY_62_5_MS};
+    check(bme0.configure(normal) && bme1.configure(normal), "normal mode behind BusHealth");
+    BME280Task task0(&bme0, 0), task1(&bme1, 1);
+    BusManager manager(&clock);
+    int b0 = manager.add_bus(&health0), b1 = manager.add_bus(&health1);
+    manager.add_sensor(&task0, b0, 100000);
+    manager.add_sensor(&task1, b1, 100000);
+
+    int counts[3] = {};
+    manager.set_callback(count_sample, counts);
+    manager.start();
+    uint64_t longest_poll = 0;
+    int resumed_at = 0;
+    for (int step = 0; step < 60000; step++) {
+        if (step == 10000) bus0.detach(BME280_DEFAULT_I2CADDR);
+        if (step == 30000) {
+            // Back after a brown-out: in sleep mode with the data registers at their reset values
+            bme0_sim.power_on_reset();
+            bus0.attach(BME280_DEFAULT_I2CADDR, &bme0_sim);
+            resumed_at = counts[0];
+        }
+        uint64_t before = clock.time_us();
+        manager.poll();
+        if (clock.time_us() - before > longest_poll) longest_poll = clock.time_us() - before;
+        clock.advance_us(100);
+    }
+
+    SensorStats lost = manager.stats(0), other = manager.stats(1);
+    printf("  sensor off the bus for 2 s: %u failures, %u re-init, %d samples after, longest poll %llu us\n",
+           lost.failures, lost.reinits, counts[0] - resumed_at, (unsigned long long)longest_poll);
+    check(lost.reinits == 1 && (bme0_sim.reg(BME280_CTRL_MEASURE) & 0b11) == BME280::NORMAL_MODE,
+          "lost sensor re-initialised in normal mode");
+    check(counts[0] - resumed_at >= 25, "lost sensor delivers again");
+    printf("  other bus: %u samples, %u failures, jitter max %u us\n", other.samples, other.failures,
+           other.jitter_max_us);
+    // The re-init blocks the loop once, for a few milliseconds
+    check(other.failures == 0 && other.samples >= 59 && other.jitter_max_us <= longest_poll + 100,
+          "other bus only delayed by the re-init");
+    check(longest_poll < 5000, "no poll blocks for 5 ms");
+}
+
+typedef BME280Fixed<BME280_DEFAULT_I2CADDR, BME280::OVERSAMPLING_RATE_1, BME280::OVERSAMPLING_RATE_1,
+                    BME280::OVERSAMPLING_RATE_1> WeatherFixed;
+typedef BME280Fixed<BME280_DEFAULT_I2CADDR, BME280::OVERSAMPLING_RATE_1, BME280::OVERSAMPLING_RATE_4,
+                    BME280::OVERSAMPLING_RATE_SKIPPED, BME280::FILTER_16, BME280::STANDBY_0_5_MS,
+                    BME280::NORMAL_MODE> GamingFixed;
+typedef BME280Fixed<BME280_ALTERNATE_I2CADDR, BME280::OVERSAMPLING_RATE_2, BME280::OVERSAMPLING_RATE_SKIPPED,
+                    BME280::OVERSAMPLING_RATE_SKIPPED> ThermometerFixed;
+
+// Register values, burst and timing worked out by the compiler
+static_assert(WeatherFixed::CTRL_MEASURE_VALUE == 0b00100100 && WeatherFixed::CTRL_MEASURE_FORCED == 0b00100101 &&
+              WeatherFixed::CTRL_HUMIDITY_VALUE == 1 && WeatherFixed::CONFIG_VALUE == 0, "weather registers");
+static_assert(WeatherFixed::BURST_START == BME280_PRESSURE_MSB && WeatherFixed::BURST_LENGTH == 8, "weather burst");
+static_assert(WeatherFixed::MEASUREMENT_TIME_US == 8000 && WeatherFixed::MAX_MEASUREMENT_TIME_US == 9300,
+              "weather timing, datasheet section 9.1");
+static_assert(GamingFixed::CTRL_MEASURE_VALUE == 0b00101111 && GamingFixed::CONFIG_VALUE == 0b00010000,
+              "gaming registers");
+static_assert(GamingFixed::BURST_START == BME280_PRESSURE_MSB && GamingFixed::BURST_LENGTH == 6, "gaming burst");
+static_assert(GamingFixed::SAMPLE_PERIOD_US == 11500 + 500, "gaming period, about 83 Hz");
+static_assert(ThermometerFixed::BURST_START == BME280_TEMPERATURE_MSB && ThermometerFixed::BURST_LENGTH == 3,
+              "temperature only burst");
+
+/**
+ * The compile-time driver against the runtime one on the same model: same
+ * values, and only the bytes of the measured channels on the bus.
+ */
+static void check_fixed(void) {
+    SimClock clock;
+    SimI2CBus bus(clock);
+    BME280Sim sim(clock);
+    bus.attach(BME280_DEFAULT_I2CADDR, &sim);
+    bus.attach(BME280_ALTERNATE_I2CADDR, &sim);
+
+    BME280 runtime(&bus, &clock, BME280_DEFAULT_I2CADDR);
+    check(runtime.init() && runtime.configure(BME280::WEATHER_MONITORING) && runtime.measure_once(),
+          "runtime driver weather sample");
+
+    WeatherFixed weather(&bus, &clock);
+    check(weather.init(), "fixed driver init");
+    check(sim.reg(BME280_CTRL_MEASURE) == WeatherFixed::CTRL_MEASURE_VALUE &&
+          sim.reg(BME280_CTRL_HUMIDITY) == WeatherFixed::CTRL_HUMIDITY_VALUE, "fixed driver registers written");
+    check(memcmp(&weather.get_compensation_coefficients(), &runtime.get_compensation_coefficients(),
+                 sizeof(BME280::BME_Comp_Coeff_t)) == 0, "fixed driver calibration");
+    check(!weather.read(), "no values before the first measurement");
+    uint64_t start = clock.time_us();
+    check(weather.measure_once(), "fixed driver measure_once");
+    uint64_t elapsed = clock.time_us() - start;
+    check(elapsed >= sim.measurement_time_us() && elapsed <= WeatherFixed::MAX_MEASUREMENT_TIME_US,
+          "fixed driver waits for the conversion");
+    check(weather.get_temperature_centidegrees() == runtime.get_temperature_centidegrees() &&
+          weather.get_pressure_q24_8() == runtime.get_pressure_q24_8() &&
+          weather.get_humidity_q22_10() == runtime.get_humidity_q22_10(), "fixed driver matches runtime driver");
+
+    GamingFixed gaming(&bus, &clock);
+    check(gaming.init(), "gaming init");
+    check((sim.reg(BME280_CTRL_MEASURE) & 0b11) == BME280::NORMAL_MODE, "gaming in normal mode");
+    clock.sleep_us(GamingFixed::SAMPLE_PERIOD_US);
+    bus.reset_counters();
+    check(gaming.read(), "gaming read");
+    check(bus.bytes() == 1 + 6, "humidity not read when skipped");
+    check(gaming.get_temperature_centidegrees() == runtime.get_temperature_centidegrees(), "gaming temperature");
+
+    ThermometerFixed thermometer(&bus, &clock);
+    check(thermometer.init() && thermometer.measure_once(), "temperature only sample");
+    bus.reset_counters();
+    check(thermometer.read() && bus.bytes() == 1 + 3, "three bytes for temperature only");
+    check(thermometer.get_temperature_centidegrees() == runtime.get_temperature_centidegrees(),
+          "temperature only value");
+}
+
+/**
+ * Runtime read() with channels skipped: only the registers of the measured
+ * channels on the bus, values as with every channel on, skipped ones 0.
+ */
+static void check_read_window(void) {
+    SimClock clock;
+    SimI2CBus bus(clock);
+    BME280Sim sim(clock);
+    bus.attach(BME280_DEFAULT_I2CADDR, &sim);
+    BME280 bme(&bus, &clock, BME280_DEFAULT_I2CADDR);
+    check(bme.init() && bme.configure(BME280::WEATHER_MONITORING) && bme.measure_once(), "full sample");
+    int32_t temperature = bme.get_temperature_centidegrees();
+    uint32_t pressure = bme.get_pressure_q24_8();
+    uint32_t humidity = bme.get_humidity_q22_10();
+
+    struct Window {
+        const char *name;
+        BME280::Config config;
+        uint32_t bytes;
+    };
+    const BME280::Config thermometer = {BME280::FORCED_MODE, BME280::OVERSAMPLING_RATE_1,
+                                        BME280::OVERSAMPLING_RATE_SKIPPED, BME280::OVERSAMPLING_RATE_SKIPPED,
+                                        BME280::FILTER_OFF, BME280::STANDBY_0_5_MS};
+    const BME280::Config no_humidity = {BME280::FORCED_MODE, BME280::OVERSAMPLING_RATE_1, BME280::OVERSAMPLING_RATE_1,
+                                        BME280::OVERSAMPLING_RATE_SKIPPED, BME280::FILTER_OFF, BME280::STANDBY_0_5_MS};
+    const Window windows[] = {
+        {"all channels", BME280::WEATHER_MONITORING, 8},
+        {"no humidity", no_humidity, 6},
+        {"no pressure", BME280::HUMIDITY_SENSING, 5},
+        {"temperature only", thermometer, 3},
+    };
+
+    for (const Window &window : windows) {
+        char what[80];
+        BME280::Config config = window.config;
+        bool has_pressure = config.oversampling_pressure != BME280::OVERSAMPLING_RATE_SKIPPED;
+        bool has_humidity = config.oversampling_humidity != BME280::OVERSAMPLING_RATE_SKIPPED;
+        check(bme.configure(config) && bme.measure_once(), window.name);
+
+        bus.reset_counters();
+        snprintf(what, sizeof(what), "%s: read() moves %u bytes", window.name, 1 + window.bytes);
+        check(bme.read() && bus.bytes() == 1 + window.bytes, what);
+        // Humidity first: the lazy compensation must still work out t_fine
+        snprintf(what, sizeof(what), "%s: values", window.name);
+        check(bme.get_humidity_q22_10() == (has_humidity ? humidity : 0) &&
+              bme.get_pressure_q24_8() == (has_pressure ? pressure : 0) &&
+              bme.get_temperature_centidegrees() == temperature, what);
+
+        bus.reset_counters();
+        snprintf(what, sizeof(what), "%s: start_read() moves %u bytes", window.name, 1 + window.bytes);
+        bool started = bme.start_read();
+        while (bme.poll_read() == BME280::MEASUREMENT_PENDING) clock.sleep_us(10);
+        check(started && bme.poll_read() == BME280::MEASUREMENT_READY && bus.bytes() == 1 + window.bytes &&
+              bme.get_temperature_centidegrees() == temperature, what);
+    }
+
+    // Pressure and humidity need t_fine, so temperature is only skipped with them
+    BME280::Config no_temperature = BME280::WEATHER_MONITORING;
+    no_temperature.oversampling_temperature = BME280::OVERSAMPLING_RATE_SKIPPED;
+    check(!bme.configure(no_temperature) &&
+          bme.get_config().oversampling_temperature != BME280::OVERSAMPLING_RATE_SKIPPED,
+          "temperature not skipped while pressure or humidity is measured");
+    no_temperature.oversampling_pressure = BME280::OVERSAMPLING_RATE_SKIPPED;
+    no_temperature.oversampling_humidity = BME280::OVERSAMPLING_RATE_SKIPPED;
+    check(bme.configure(no_temperature) && bme.measure_once() && bme.get_temperature_centidegrees() == 0 &&
+          bme.get_pressure_q24_8() == 0 && bme.get_humidity_q22_10() == 0, "every channel skipped reads 0");
+}
+
+/**
+ * The runtime driver on SPI through SPIRegisterBus: same values as on I2C,
+ * bit 7 of the register byte set for reads and clear for writes, one frame
+ * per burst, and one sensor per chip select.
+ */
+static void check_spi(void) {
+    SimClock clock;
+    SimI2CBus i2c(clock);
+    BME280Sim i2c_sim(clock);
+    i2c.attach(BME280_DEFAULT_I2CADDR, &i2c_sim);
+    BME280 reference(&i2c, &clock, BME280_DEFAULT_I2CADDR);
+    check(reference.init() && reference.configure(BME280::WEATHER_MONITORING) && reference.measure_once(),
+          "I2C reference sample");
+
+    SimSPIBus spi(clock);
+    BME280Sim sim0(clock), sim1(clock);
+    spi.attach(0, &sim0);
+    spi.attach(1, &sim1);
+    SPIRegisterBus registers(&spi);
+    BME280 bme0(&registers, &clock, 0);
+    BME280 bme1(&registers, &clock, 1);
+
+    check(bme0.init() && bme1.init(), "init over SPI");
+    check(bme0.configure(BME280::WEATHER_MONITORING) && spi.last_command() == (BME280_CTRL_MEASURE & 0x7F) &&
+          sim0.reg(BME280_CTRL_MEASURE) == ((BME280::OVERSAMPLING_RATE_1 << 5) | (BME280::OVERSAMPLING_RATE_1 << 2)) &&
+          sim0.reg(BME280_CTRL_HUMIDITY) == BME280::OVERSAMPLING_RATE_1, "writes clear bit 7 and reach the register");
+    check(bme0.measure_once(), "forced sample over SPI");
+    check(bme0.get_temperature_centidegrees() == reference.get_temperature_centidegrees() &&
+          bme0.get_pressure_q24_8() == reference.get_pressure_q24_8() &&
+          bme0.get_humidity_q22_10() == reference.get_humidity_q22_10(), "SPI values match I2C");
+
+    spi.reset_counters();
+    check(bme0.read() && spi.frames() == 1 && spi.bytes() == 1 + 8 && spi.last_command() == BME280_PRESSURE_MSB,
+          "burst read is one frame with bit 7 set");
+
+    bool started = bme0.start_read();
+    check(started && bme0.poll_read() == BME280::MEASUREMENT_READY &&
+          bme0.get_temperature_centidegrees() == reference.get_temperature_centidegrees(), "start_read over SPI");
+
+    // The second chip select is a separate sensor
+    sim1.set_adc(519888 + 16000, 415148, 30000);
+    check(bme1.configure(BME280::WEATHER_MONITORING) && bme1.measure_once() &&
+          bme1.get_temperature_centidegrees() > bme0.get_temperature_centidegrees(), "second chip select");
+
+    BME280 missing(&registers, &clock, 2);
+    check(!missing.init(), "no device on the chip select fails init");
+}
+
+/**
+ * One raw sample and the results the Bosch integer reference gives for it.
+ */
+struct GoldenSample {
+    int32_t raw_temperature, raw_pressure, raw_humidity;
+    int32_t temperature;        // 0.01 C
+    uint32_t pressure;          // Pa, Q24.8
+    uint32_t humidity;          // %RH, Q22.10
+};
+
+/// @brief compensate_values and compensate_batch against a list of golden samples
+static int golden_mismatches(const BME280::BME_Comp_Coeff_t &coeffs, const GoldenSample *samples, size_t count) {
+    int mismatches = 0;
+    for (size_t i = 0; i < count; i++) {
+        const GoldenSample &g = samples[i];
+        int32_t t, bt;
+        uint32_t p, h, bp, bh;
+        BME280::compensate_values(coeffs, &t, &p, &h, g.raw_temperature, g.raw_pressure, g.raw_humidity);
+        BME280::compensate_batch(coeffs, &g.raw_temperature, &g.raw_pressure, &g.raw_humidity, &bt, &bp, &bh, 1);
+        if (t != g.temperature || p != g.pressure || h != g.humidity) {
+            printf("  sample %zu: got %d %u %u, expected %d %u %u\n", i, t, p, h, g.temperature, g.pressure,
+                   g.humidity);
+            mismatches++;
+        }
+        if (bt != t || bp != p || bh != h) mismatches++;
+    }
+    return mismatches;
+}
+
+/**
+ * Golden vectors for the hot math, so an optimisation can be shown to be
+ * bit-exact. The expected values come from an independent run of the
+ * Bosch integer formulas (datasheet section 4.2.3 and 8.1), not from this
+ * code.
+ */
+static void check_golden(void) {
+    // Datasheet example coefficients (BMP280 section 3.12) with typical humidity coefficients
+    BME280::BME_Comp_Coeff_t datasheet = {};
+    datasheet.dig_T1 = 27504; datasheet.dig_T2 = 26435; datasheet.dig_T3 = -1000;
+    datasheet.dig_P1 = 36477; datasheet.dig_P2 = -10685; datasheet.dig_P3 = 3024;
+    datasheet.dig_P4 = 2855; datasheet.dig_P5 = 140; datasheet.dig_P6 = -7;
+    datasheet.dig_P7 = 15500; datasheet.dig_P8 = -14600; datasheet.dig_P9 = 6000;
+    datasheet.dig_H1 = 75; datasheet.dig_H2 = 362; datasheet.dig_H3 = 0;
+    datasheet.dig_H4 = 321; datasheet.dig_H5 = 50; datasheet.dig_H6 = 30;
+    const GoldenSample datasheet_samples[] = {
+        {519888, 415148, 30000, 2508, 25767233, 53400},     // 25.08 C, 100653.25 Pa
+    };
+    check(golden_mismatches(datasheet, datasheet_samples, 1) == 0, "datasheet example");
+
+    // Register image of a production part, 0x88..0xA1 then 0xE1..0xE7
+    const uint8_t device_registers[BME280_COMPENSATION_LENGTH] = {
+        0x45, 0x6F, 0x6F, 0x68, 0x32, 0x00, 0x82, 0x8F, 0x75, 0xD6, 0xD0, 0x0B, 0x44, 0x1B, 0xFC, 0xFF, 0xF9,
+        0xFF, 0xAC, 0x26, 0x0A, 0xD8, 0xBD, 0x10, 0x00, 0x4B, 0x72, 0x01, 0x00, 0x13, 0x29, 0x03, 0x1E,
+    };
+    BME280::BME_Comp_Coeff_t device;
+    BME280::unpack_compensation_data(device_registers, device);
+    check(device.dig_T1 == 28485 && device.dig_T2 == 26735 && device.dig_T3 == 50 && device.dig_P1 == 36738 &&
+          device.dig_P2 == -10635 && device.dig_P4 == 6980 && device.dig_P5 == -4 && device.dig_P6 == -7 &&
+          device.dig_P9 == 4285 && device.dig_H1 == 75 && device.dig_H2 == 370 && device.dig_H3 == 0 &&
+          device.dig_H4 == 313 && device.dig_H5 == 50 && device.dig_H6 == 30,
+          "calibration registers unpacked");
+    const GoldenSample device_samples[] = {
+        {519888, 415148, 30000, 2044, 22524896, 57374},
+        {415000, 330000, 24000, -1299, 24833452, 23760},    // below 0 C
+        {600000, 500000, 40000, 4598, 19628226, 102400},    // humidity clamped at 100 %RH
+        {420000, 280000, 17000, -1140, 26963745, 0},        // humidity clamped at 0 %RH
+        {519888, 415148, 65535, 2044, 22524896, 102400},
+        {519888, 415148, 0, 2044, 22524896, 0},
+    };
+    check(golden_mismatches(device, device_samples, sizeof(device_samples) / sizeof(device_samples[0])) == 0,
+          "production part samples and humidity clamping");
+
+    // Every signed coefficient negative, dig_H4 and dig_H5 are 12-bit and sign extended
+    const uint8_t negative_registers[BME280_COMPENSATION_LENGTH] = {
+        0x45, 0x6F, 0x91, 0x97, 0xCE, 0xFF, 0x82, 0x8F, 0x75, 0xD6, 0xD0, 0x0B, 0xBC, 0xE4, 0xFC, 0xFF, 0xF9,
+        0xFF, 0xAC, 0x26, 0x0A, 0xD8, 0xBD, 0x10, 0x00, 0x4B, 0x8E, 0xFE, 0x00, 0xED, 0xE4, 0xFC, 0xE2,
+    };
+    BME280::BME_Comp_Coeff_t negative;
+    BME280::unpack_compensation_data(negative_registers, negative);
+    check(negative.dig_T2 == -26735 && negative.dig_T3 == -50 && negative.dig_P4 == -6980 &&
+          negative.dig_H2 == -370 && negative.dig_H4 == -300 && negative.dig_H5 == -50 && negative.dig_H6 == -30,
+          "negative coefficients sign extended");
+
+    // dig_P1 == 0 makes var1 == 0, the division is skipped and 0 Pa reported
+    BME280::BME_Comp_Coeff_t zero = datasheet;
+    zero.dig_P1 = 0;
+    const GoldenSample zero_samples[] = {
+        {519888, 415148, 30000, 2508, 0, 53400},
+    };
+    check(golden_mismatches(zero, zero_samples, 1) == 0, "var1 == 0 gives 0 Pa");
+
+    // The same over more than one batch block and the whole raw pressure range.
+    // Built with SENSORS_SANITIZE an overflow in the masked-out terms aborts here.
+    const size_t ZERO_BATCH = 600;
+    std::vector<int32_t> raw_t(ZERO_BATCH, 519888), raw_p(ZERO_BATCH), raw_h(ZERO_BATCH, 30000);
+    std::vector<int32_t> t(ZERO_BATCH);
+    std::vector<uint32_t> p(ZERO_BATCH, 1), h(ZERO_BATCH);
+    for (size_t i = 0; i < ZERO_BATCH; i++) raw_p[i] = (int32_t)(i * 1747u % 0x100000);
+    BME280::compensate_batch(zero, raw_t.data(), raw_p.data(), raw_h.data(), t.data(), p.data(), h.data(), ZERO_BATCH);
+    bool all_zero = true;
+    for (size_t i = 0; i < ZERO_BATCH; i++) all_zero &= (p[i] == 0 && t[i] == 2508 && h[i] == 53400);
+    check(all_zero, "batch with dig_P1 == 0 gives 0 Pa for every raw pressure");
+
+    // SCD30 interface description example: 439.09 ppm, 0x43DB 0x8C2E with CRCs 0xCB 0x8F
+    const uint8_t co2_response[6] = {0x43, 0xDB, 0xCB, 0x8C, 0x2E, 0x8F};
+    uint16_t words[2];
+    check(sensirion_crc8(co2_response, 2) == 0xCB && sensirion_crc8(co2_response + 3, 2) == 0x8F,
+          "SCD30 example CRCs");
+    float co2 = 0;
+    uint32_t bits = 0;
+    if (sensirion_decode_words(co2_response, 2, words) == 0) co2 = sensirion_words_to_float(words);
+    memcpy(&bits, &co2, sizeof(bits));
+    check(bits == 0x43DB8C2E, "SCD30 float reassembled bit for bit");
+}
+
+/**
+ * Instrumentation of the blocking and asynchronous reads: one series per
+ * operation and address, latencies that match the simulated bus time,
+ * and NAKs, timeouts and CRC failures counted where they happen.
+ */
+static void check_trace(void) {
+    if (!TRACE_ENABLED) {
+        printf("  built with TRACE_ENABLED=0\n");
+        return;
+    }
+    SimClock clock;
+    SimI2CBus bus(clock);
+    BME280Sim bme_sim(clock);
+    SCD30Sim scd_sim(clock);
+    bus.attach(BME280_DEFAULT_I2CADDR, &bme_sim);
+    bus.attach(SCD30_DEFAULT_I2CADDR, &scd_sim);
+    BME280 bme(&bus, &clock, BME280_DEFAULT_I2CADDR);
+    SCD30 scd(&bus, &clock);
+    check(bme.init() && scd.init(), "sensors init for tracing");
+    trace_reset();
+
+    for (int i = 0; i < 10; i++) {
+        uint64_t start = clock.time_us();
+        bme.read();
+        if (i == 0) printf("  BME280 read on the bus: %llu us\n", (unsigned long long)(clock.time_us() - start));
+    }
+    bus.inject_faults(BME280_DEFAULT_I2CADDR, 1, BUS_ERROR_GENERIC);
+    check(!bme.read(), "read fails on an injected NAK");
+    bus.inject_faults(BME280_DEFAULT_I2CADDR, 1, BUS_ERROR_TIMEOUT);
+    check(!bme.read(), "read fails on an injected timeout");
+    check(bme.start_read(), "traced start_read");
+    clock.advance_us(bus.completes_at() - clock.time_us());
+    check(bme.poll_read() == BME280::MEASUREMENT_READY, "traced async read completes");
+
+    clock.sleep_ms(2100);
+    check(scd.read(), "traced SCD30 read");
+    clock.sleep_ms(2000);
+    scd_sim.corrupt_responses(1);
+    check(!scd.read(), "SCD30 read fails on a bad CRC");
+    scd_sim.corrupt_responses(1);
+    check(scd.getMeasurementInterval() == 0, "register read fails on a bad CRC");
+
+    trace_dump();
+
+    const TraceSeries *read = trace_find(TRACE_BME280_READ, BME280_DEFAULT_I2CADDR);
+    check(read != nullptr && read->calls == 13 && read->failures == 2, "BME280 read calls and failures");
+    check(read != nullptr && read->naks == 1 && read->timeouts == 1 && read->crc_errors == 0,
+          "BME280 NAK and timeout counted");
+    check(read != nullptr && read->bytes == 11 * 9, "BME280 bytes of the good reads");
+    check(read != nullptr && read->histogram[9] == 11, "good reads land in the 256..511 us bucket");
+    check(read != nullptr && trace_percentile_us(*read, 50) == 512, "median bucket bound");
+    check(trace_find(TRACE_BME280_CALIBRATION, BME280_DEFAULT_I2CADDR) == nullptr, "no calibration after reset");
+
+    const TraceSeries *scd_read = trace_find(TRACE_SCD30_READ, SCD30_DEFAULT_I2CADDR);
+    check(scd_read != nullptr && scd_read->calls == 2 && scd_read->failures == 1 && scd_read->crc_errors == 1,
+          "SCD30 CRC failure counted");
+    check(scd_read != nullptr && scd_read->min_us >= SCD30_COMMAND_DELAY_US, "SCD30 latency includes the delay");
+    const TraceSeries *reg = trace_find(TRACE_SCD30_REGISTER, SCD30_DEFAULT_I2CADDR);
+    check(reg != nullptr && reg->calls == 1 && reg->crc_errors == 1, "SCD30 register CRC failure counted");
+}
+
+static void collect_sample(const Sample &sample, void *context) {
+    static_cast<std::vector<Sample> *>(context)->push_back(sample);
+}
+
+/// @brief Forced-mode sampling at 10 s with the SCD30 coordinated, energy from the default model
+static void check_duty_cycle(void) {
+    SimClock clock;
+    SimI2CBus bus(clock);
+    BME280Sim bme_sim(clock);
+    SCD30Sim scd_sim(clock);
+    bus.attach(BME280_DEFAULT_I2CADDR, &bme_sim);
+    bus.attach(SCD30_DEFAULT_I2CADDR, &scd_sim);
+
+    EnergyMeter meter(&clock);
+    BME280 bme(&bus, &meter, BME280_DEFAULT_I2CADDR);
+    SCD30 scd(&bus, &meter);
+    check(bme.init() && scd.init(), "duty cycle sensors init");
+
+    check(DutyCycle::scd30_interval_for(500000) == 2 && DutyCycle::scd30_interval_for(9600000) == 10 &&
+          DutyCycle::scd30_interval_for(4000000000u) == 1800, "SCD30 interval rounded and clamped");
+
+    DutyCycle duty(&meter, &meter);
+    check(!duty.begin(&bme, 1000), "period shorter than a conversion rejected");
+    check(duty.begin(&bme, 10000000, &scd), "duty cycle begin");
+    check((bme_sim.reg(BME280_CTRL_MEASURE) & 0b11) == BME280::SLEEP_MODE, "BME280 asleep after begin");
+    check(scd_sim.interval() == 10 && duty.scd30_interval_s() == 10, "SCD30 interval follows the period");
+
+    std::vector<Sample> samples;
+    duty.set_callback(collect_sample, &samples);
+    meter.reset();
+    const int cycles = 30;
+    bool all_ok = true;
+    bool asleep = true;
+    for (int i = 0; i < cycles; i++) {
+        all_ok &= duty.run_once();
+        asleep &= (bme_sim.reg(BME280_CTRL_MEASURE) & 0b11) == BME280::SLEEP_MODE;
+    }
+    check(all_ok && duty.samples() == cycles && duty.failures() == 0, "every wake-up gives a BME280 sample");
+    check(asleep, "BME280 back in sleep mode after each conversion");
+
+    uint64_t last = 0;
+    bool spaced = true;
+    uint32_t bme_samples = 0;
+    for (const Sample &sample : samples) {
+        if (sample.sensor != SENSOR_BME280) continue;
+        if (bme_samples > 0) {
+            uint64_t step = sample.timestamp_us - last;
+            spaced &= step > 10000000 - 1000 && step < 10000000 + 1000;
+        }
+        last = sample.timestamp_us;
+        bme_samples++;
+    }
+    check(spaced, "BME280 samples one period apart");
+    printf("  %u BME280 and %u SCD30 samples in %d wake-ups, %u SCD30 measurements read\n",
+           bme_samples, duty.scd30_samples(), cycles, scd_sim.measurements_read());
+    check(duty.scd30_samples() >= cycles - 2 && duty.scd30_samples() <= cycles, "one SCD30 sample per interval");
+
+    EnergyReport report = meter.report();
+    printf("  active %.0f us/sample, %.1f uJ/sample, average %.0f uA\n", report.active_us_per_sample(),
+           report.energy_uj_per_sample(), report.average_ua);
+    check(report.samples == (uint32_t)cycles, "meter counts the samples");
+    check(report.mcu_active_us * 100 < report.elapsed_us, "MCU active under 1 % of the time");
+    check(report.bme280_measuring_us == (uint64_t)cycles * bme.measurement_time_us(), "conversion time counted");
+    const PowerModel &model = meter.model();
+    double scd30_ua = model.scd30_base_ua + model.scd30_measurement_uc / 10;
+    check(report.average_ua > model.mcu_sleep_ua + scd30_ua && report.average_ua < model.mcu_active_ua + scd30_ua,
+          "average current between sleep and active");
+
+    // A caller that comes back late skips the missed slots instead of sampling in a burst
+    uint64_t next = duty.next_sample_us();
+    clock.advance_us(35000000);
+    check(duty.run_once() && duty.next_sample_us() == next + 30000000, "missed slots skipped");
+}
+
+/// Sample number i of the log checks, values follow from i so a drain can be verified
+static Sample log_sample(uint32_t i) {
+    Sample sample = {};
+    sample.timestamp_us = 1000000ull * i + 17;
+    sample.sensor = (i % 3 == 2) ? SENSOR_SCD30 : SENSOR_BME280;
+    sample.channel = (uint8_t)(i % 2);
+    sample.sequence = (uint16_t)i;
+    sample.values[0] = 2000 + (int32_t)i;
+    sample.values[1] = -(int32_t)i;
+    sample.values[2] = (int32_t)(i * 7919u);
+    return sample;
+}
+
+struct LogDrain {
+    uint32_t count = 0;
+    uint32_t first = 0;
+    uint32_t expected = 0;
+    bool in_order = true;
+    bool values_match = true;
+};
+
+static void check_drained(const Sample &sample, uint32_t sequence, void *context) {
+    LogDrain *drain = static_cast<LogDrain *>(context);
+    if (drain->count == 0) drain->first = sequence;
+    else drain->in_order &= (sequence == drain->expected);
+    drain->expected = sequence + 1;
+    drain->count++;
+
+    // The checks append log_sample(sequence), except after a power loss reuses sequences
+    Sample reference = log_sample(sample.sequence);
+    drain->values_match &= memcmp(sample.values, reference.values, sizeof(sample.values)) == 0 &&
+                           sample.timestamp_us == reference.timestamp_us && sample.sensor == reference.sensor;
+}
+
+static LogDrain drain_log(SampleLog &log, uint32_t since, uint32_t max_samples = UINT32_MAX) {
+    LogDrain drain;
+    log.drain(since, check_drained, &drain, max_samples);
+    return drain;
+}
+
+/// @brief Page batching, drain, reboot from the image file, torn pages and wrap-around
+static void check_sample_log(void) {
+    const char *image = "sim_run_flash.img";
+    remove(image);
+    {
+        SimFlash flash(16 * LOG_FLASH_SECTOR_SIZE, image);
+        SampleLog log(&flash);
+        check(log.recover() && log.next_sequence() == 0 && drain_log(log, 0).count == 0, "empty log");
+
+        for (uint32_t i = 0; i < 25; i++) log.append(log_sample(i));
+        check(flash.programs == 2 && log.pending() == 5, "two full pages programmed, five samples in RAM");
+        check(flash.erases == 1, "first sector erased before use");
+
+        LogDrain all = drain_log(log, 0);
+        check(all.count == 25 && all.first == 0 && all.in_order && all.values_match, "drain includes RAM samples");
+        LogDrain tail = drain_log(log, 12);
+        check(tail.count == 13 && tail.first == 12 && tail.values_match, "drain since sequence 12");
+        check(drain_log(log, 3, 4).count == 4, "drain stops at max_samples");
+        check(log.flush() && flash.programs == 3 && log.pending() == 0, "flush programs the partial page");
+    }
+    {
+        // Reboot: a new object on the same image file
+        SimFlash flash(16 * LOG_FLASH_SECTOR_SIZE, image);
+        SampleLog log(&flash);
+        check(log.recover() && log.next_sequence() == 25, "write position recovered from the image file");
+        LogDrain all = drain_log(log, 0);
+        check(all.count == 25 && all.in_order && all.values_match, "samples survive the reboot");
+
+        for (uint32_t i = 25; i < 35; i++) log.append(log_sample(i));
+        check(log.pending() == 0, "next page started right after the partial one");
+
+        // Power lost halfway through the next page
+        flash.tear_next_program(100);
+        for (uint32_t i = 35; i < 45; i++) log.append(log_sample(i));
+    }
+    {
+        SimFlash flash(16 * LOG_FLASH_SECTOR_SIZE, image);
+        SampleLog log(&flash);
+        flash.reset_counters();
+        check(log.recover() && log.next_sequence() == 35, "torn page not counted");
+        check(log.crc_errors() == 1, "torn page found by recovery");
+        printf("  recovery read %llu of %u bytes\n", (unsigned long long)flash.read_bytes, flash.size());
+        check(flash.read_bytes <= (16 + LOG_PAGES_PER_SECTOR) * LOG_FLASH_PAGE_SIZE, "recovery reads headers only");
+
+        for (uint32_t i = 35; i < 45; i++) log.append(log_sample(i));
+        LogDrain all = drain_log(log, 0);
+        check(all.count == 45 && all.in_order && all.values_match, "writing continues after the torn page");
+    }
+    remove(image);
+
+    // Four sectors wrap after 640 samples, the oldest sector goes first
+    SimFlash flash(4 * LOG_FLASH_SECTOR_SIZE);
+    SampleLog log(&flash);
+    log.recover();
+    const uint32_t total = 5000;
+    bool appended = true;
+    for (uint32_t i = 0; i < total; i++) appended &= log.append(log_sample(i));
+    check(appended, "append through wrap-around");
+
+    uint32_t least = UINT32_MAX, most = 0;
+    for (uint32_t sector = 0; sector < log.sectors(); sector++) {
+        least = std::min(least, flash.sector_erases(sector));
+        most = std::max(most, flash.sector_erases(sector));
+        check(log.erase_count(sector) == flash.sector_erases(sector), "erase count kept in the sector");
+    }
+    check(most - least <= 1, "erases spread evenly over the sectors");
+
+    uint32_t oldest = log.oldest_sequence();
+    LogDrain all = drain_log(log, 0);
+    check(oldest > 0 && all.first == oldest && all.count == total - oldest && all.in_order && all.values_match,
+          "drain after wrap-around starts at the oldest sample");
+    LogDrain recent = drain_log(log, total - 100);
+    check(recent.count == 100 && recent.first == total - 100, "drain of the newest samples");
+
+    SampleLog rebooted(&flash);
+    check(rebooted.recover() && rebooted.next_sequence() == total - total % LOG_RECORDS_PER_PAGE,
+          "wrapped log recovered");
+}
+
+/// Brute-force bucket over the raw values with start <= t < end
+static RollupBucket reference_bucket(const std::vector<Sample> &raw, uint64_t start, uint64_t end) {
+    RollupBucket bucket = {};
+    bucket.start_us = start;
+    for (const Sample &sample : raw) {
+        if (sample.timestamp_us < start || sample.timestamp_us >= end) continue;
+        for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+            RollupValue &value = bucket.values[i];
+            if (bucket.count == 0 || sample.values[i] < value.min) value.min = sample.values[i];
+            if (bucket.count == 0 || sample.values[i] > value.max) value.max = sample.values[i];
+            value.last = sample.values[i];
+            value.sum += sample.values[i];
+        }
+        bucket.count++;
+    }
+    return bucket;
+}
+
+static bool same_bucket(const RollupBucket &a, const RollupBucket &b) {
+    if (a.start_us != b.start_us || a.count != b.count) return false;
+    for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+        if (a.values[i].min != b.values[i].min || a.values[i].max != b.values[i].max ||
+            a.values[i].last != b.values[i].last || a.values[i].sum != b.values[i].sum) return false;
+    }
+    return true;
+}
+
+static void count_closed(int level, const RollupBucket &, void *context) {
+    static_cast<uint32_t *>(context)[level]++;
+}
+
+/// @brief Rollup buckets against brute force over the raw samples, and the IIR filter of the model
+static void check_rollup(void) {
+    static SampleRollup<120, 60, 24> rollup;
+    uint32_t closed[ROLLUP_LEVELS] = {};
+    rollup.set_callback(count_closed, closed);
+
+    // 10 Hz for 2.5 h with a 10 min gap after the first hour
+    std::vector<Sample> raw;
+    uint32_t state = 99;
+    for (uint64_t t = 0; t < 9000000000ull; t += 100000) {
+        if (t >= 3600000000ull && t < 4200000000ull) continue;
+        state = state * 1664525u + 1013904223u;
+        Sample sample = {};
+        sample.timestamp_us = t + 1234;
+        sample.values[0] = 2000 + (int32_t)(state >> 24) - 128;
+        sample.values[1] = (int32_t)(state >> 8);
+        sample.values[2] = -(int32_t)((state >> 16) & 0xFFF);
+        raw.push_back(sample);
+        rollup.add(sample);
+    }
+
+    check(rollup.size(ROLLUP_HOURS) == 2 && rollup.size(ROLLUP_MINUTES) == 60 && rollup.size(ROLLUP_SECONDS) == 120,
+          "closed buckets kept per level");
+    check(same_bucket(rollup.at(ROLLUP_HOURS, 0), reference_bucket(raw, 0, 3600000000ull)), "hour 0 matches raw");
+    check(closed[ROLLUP_HOURS] == 2 && closed[ROLLUP_MINUTES] == 139 && closed[ROLLUP_SECONDS] == 8399,
+          "one callback per closed bucket, none for the gap");
+
+    bool minutes_match = true;
+    for (size_t i = 0; i < rollup.size(ROLLUP_MINUTES); i++) {
+        const RollupBucket &bucket = rollup.at(ROLLUP_MINUTES, i);
+        minutes_match &= same_bucket(bucket, reference_bucket(raw, bucket.start_us, bucket.start_us + 60000000));
+    }
+    check(minutes_match, "minutes match raw");
+    const RollupBucket &second = rollup.latest(ROLLUP_SECONDS);
+    check(second.count == 10 && same_bucket(second, reference_bucket(raw, second.start_us, second.start_us + 1000000)),
+          "seconds match raw");
+
+    // current() folds in the samples not yet closed into the hour
+    RollupBucket hour = rollup.current(ROLLUP_HOURS);
+    check(same_bucket(hour, reference_bucket(raw, 7200000000ull, 10800000000ull)), "open hour includes open minute");
+    RollupBucket hour1 = reference_bucket(raw, 3600000000ull, 7200000000ull);
+    check(hour1.count == 50 * 600, "gap leaves 50 min in hour 1");
+
+    rollup.flush(10800000000ull);
+    check(rollup.size(ROLLUP_HOURS) == 3 && rollup.latest(ROLLUP_HOURS).count == 30 * 600 &&
+          same_bucket(rollup.at(ROLLUP_HOURS, 1), hour1), "flush closes the open buckets");
+
+    RollupBucket rounding = {};
+    rounding.count = 4;
+    rounding.values[0].sum = 10;
+    rounding.values[1].sum = -10;
+    check(rounding.mean(0) == 3 && rounding.mean(1) == -3, "mean rounds half away from zero");
+
+    // BME280 IIR filter: a step in the raw temperature moves the output by 1/16 per conversion
+    SimClock clock;
+    SimI2CBus bus(clock);
+    BME280Sim sim(clock);
+    bus.attach(BME280_DEFAULT_I2CADDR, &sim);
+    BME280 bme(&bus, &clock, BME280_DEFAULT_I2CADDR);
+    BME280::Config config = BME280::WEATHER_MONITORING;
+    config.filter = BME280::FILTER_16;
+    check(bme.init() && bme.configure(config) && bme.measure_once(), "filtered forced conversion");
+    int32_t before = bme.get_temperature_centidegrees();
+    sim.set_adc(519888 + 16000, 415148, 30000);
+    bme.measure_once();
+    int32_t after_one = bme.get_temperature_centidegrees();
+    for (int i = 0; i < 200; i++) bme.measure_once();
+    int32_t settled = bme.get_temperature_centidegrees();
+    printf("  IIR 16 step: %d -> %d after one conversion -> %d settled (0.01 C)\n", before, after_one, settled);
+    check(after_one - before > 0 && (after_one - before) * 12 < settled - before &&
+          (after_one - before) * 20 > settled - before, "IIR 16 moves a step by about 1/16");
+}
+
+static Sample metrics_sample(uint8_t sensor, int32_t temperature, uint32_t pressure_q24_8, uint32_t humidity_q22_10) {
+    Sample sample = {};
+    sample.sensor = sensor;
+    if (sensor == SENSOR_SCD30) {
+        sample.values[1] = temperature;
+        sample.values[2] = (int32_t)((humidity_q22_10 * 100 + 512) / 1024);
+    } else {
+        sample.values[0] = temperature;
+        sample.values[1] = (int32_t)pressure_q24_8;
+        sample.values[2] = (int32_t)humidity_q22_10;
+    }
+    return sample;
+}
+
+static void check_derived_metrics(void) {
+    check(fx_log2(1u << 8, 8) == 0 && fx_log2(12u << 8, 8) == fx_log2(3, 0) + 2 * FX_ONE, "fx_log2 of powers of two");
+    check(fx_exp2(0) == FX_ONE && fx_exp2(3 * FX_ONE) == 8 * FX_ONE && fx_exp2(-FX_ONE) == FX_ONE / 2, "fx_exp2 of integers");
+    check(fx_exp2(9 * FX_ONE) == UINT32_MAX && fx_exp2(-30 * FX_ONE) == 0, "fx_exp2 saturates");
+
+    DerivedMetrics metrics;
+
+    // Altitude over 300..1100 hPa
+    double altitude_error = 0;
+    for (uint32_t pa = 30000; pa <= 110000; pa += 7) {
+        metrics.set_sample(metrics_sample(SENSOR_BME280, 2000, (pa << 8) + 77, 50 << 10));
+        double reference = DerivedMetrics::reference_altitude_m((pa + 77 / 256.0), 101325.0);
+        altitude_error = std::max(altitude_error, fabs(metrics.altitude_cm() / 100.0 - reference));
+    }
+
+    // Sea-level pressure over -400..4000 m
+    double sea_level_error = 0;
+    for (int32_t altitude_cm = -40000; altitude_cm <= 400000; altitude_cm += 2317) {
+        metrics.set_station_altitude_cm(altitude_cm);
+        for (uint32_t pa = 30000; pa <= 110000; pa += 997) {
+            metrics.set_sample(metrics_sample(SENSOR_BME280, 2000, pa << 8, 50 << 10));
+            double reference = DerivedMetrics::reference_sea_level_pressure_pa(pa, altitude_cm / 100.0);
+            sea_level_error = std::max(sea_level_error, fabs(metrics.sea_level_pressure_q24_8() / 256.0 - reference));
+        }
+    }
+    metrics.set_station_altitude_cm(0);
+
+    // Dew point and absolute humidity over -40..85 C and 1..100 %RH
+    double dew_point_error = 0;
+    double absolute_humidity_error = 0;
+    for (int32_t temperature = -4000; temperature <= 8500; temperature += 13) {
+        for (uint32_t humidity = 1 << 10; humidity <= 100 << 10; humidity += 331) {
+            metrics.set_sample(metrics_sample(SENSOR_BME280, temperature, 101325 << 8, humidity));
+            double t = temperature / 100.0;
+            double rh = humidity / 1024.0;
+            dew_point_error = std::max(dew_point_error,
+                                       fabs(metrics.dew_point_centidegrees() / 100.0 - DerivedMetrics::reference_dew_point_c(t, rh)));
+            double reference = DerivedMetrics::reference_absolute_humidity_g_m3(t, rh);
+            // Relative error, but no finer than the 0.01 g/m³ resolution
+            double error = fabs(metrics.absolute_humidity_centigrams() / 100.0 - reference);
+            if (error > 0.005) absolute_humidity_error = std::max(absolute_humidity_error, (error - 0.005) / reference * 100.0);
+        }
+    }
+
+    printf("  largest error: altitude %.3f m, sea level %.3f Pa, dew point %.4f C, absolute humidity %.4f %%\n",
+           altitude_error, sea_level_error, dew_point_error, absolute_humidity_error);
+    check(altitude_error <= 0.10, "altitude within 0.10 m");
+    check(sea_level_error <= 1.5, "sea-level pressure within 1.5 Pa");
+    check(dew_point_error <= 0.01, "dew point within 0.01 C");
+    check(absolute_humidity_error <= 0.01, "absolute humidity within 0.01 %");
+
+    // Spot values: 25 C and 50 %RH give 13.86 C and 11.50 g/m³, 899.3 hPa is about 1000 m
+    metrics.set_sample(metrics_sample(SENSOR_BME280, 2500, 89875u << 8, 50 << 10));
+    check(abs(metrics.dew_point_centidegrees() - 1386) <= 1, "dew point at 25 C, 50 %RH");
+    check(abs(metrics.absolute_humidity_centigrams() - 1150) <= 1, "absolute humidity at 25 C, 50 %RH");
+    check(abs(metrics.altitude_cm() - 100000) <= 300, "altitude at 898.75 hPa");
+
+    // Results are cached until the next sample
+    metrics.set_reference_pressure_q24_8(100000u << 8);
+    int32_t moved = metrics.altitude_cm();
+    check(moved < 100000 - 10000, "new reference pressure recomputes the altitude");
+    metrics.set_sample(metrics_sample(SENSOR_BME280, 2500, 100000u << 8, 50 << 10));
+    check(metrics.altitude_cm() == 0 && metrics.altitude_cm() == 0, "altitude at the reference pressure");
+
+    Sample scd = metrics_sample(SENSOR_SCD30, 2500, 0, 50 << 10);
+    metrics.set_sample(scd);
+    check(!metrics.has_pressure() && metrics.altitude_cm() == 0 && metrics.sea_level_pressure_q24_8() == 0,
+          "SCD30 sample has no pressure");
+    check(abs(metrics.dew_point_centidegrees() - 1386) <= 1, "SCD30 dew point");
+}
+
+/**
+ * The completion ring of PicoI2CDmaBus: SIZE - 1 finished transfers fit,
+ * a further push is refused rather than overwriting one, and they come
+ * out oldest first. PicoI2CDmaBus::start_transfer() refuses to start while
+ * full(), so without poll() in between the fourth start fails.
+ */
+static void check_completion_queue(void) {
+    CompletionQueue<4> queue;
+    I2CTransfer transfers[5] = {};
+    int started = 0;
+    for (int i = 0; i < 5; i++) {
+        // What start_transfer() does, with the transfer finishing at once
+        if (queue.full()) break;
+        check(queue.push(&transfers[i]), "push while not full");
+        started++;
+    }
+    check(started == 3 && queue.full(), "three completions fill a queue of four");
+    check(!queue.push(&transfers[4]), "push to a full queue is refused");
+
+    check(queue.pop() == &transfers[0] && !queue.full(), "oldest first, room after a pop");
+    check(queue.push(&transfers[3]), "push after poll");
+    bool in_order = queue.pop() == &transfers[1] && queue.pop() == &transfers[2] && queue.pop() == &transfers[3];
+    check(in_order && queue.empty() && queue.pop() == nullptr, "every completion delivered once");
+}
+
+int main() {
+    SimClock clock;
+    SimI2CBus bus(clock);
+    BME280Sim bme_sim(clock);
+    SCD30Sim scd_sim(clock);
+    bus.attach(BME280_DEFAULT_I2CADDR, &bme_sim);
+    bus.attach(SCD30_DEFAULT_I2CADDR, &scd_sim);
+
+    BME280 bme(&bus, &clock, BME280_DEFAULT_I2CADDR);
+    SCD30 scd(&bus, &clock);
+
+    printf("[BME280]\n");
+    uint64_t start = clock.time_us();
+    check(bme.init(), "BME280 init");
+    printf("  init: %llu us\n", (unsigned long long)(clock.time_us() - start));
+
+    for (int i = 0; i < 3; i++) {
+        clock.sleep_ms(100);
+        start = clock.time_us();
+        check(bme.is_connected(), "BME280 is_connected");
+        check(bme.read(), "BME280 read");
+        printf("  %.2f C  %.2f hPa  %.2f %%RH  (%llu us)\n",
+               bme.get_temperature(), bme.get_pressure(), bme.get_humidity(),
+               (unsigned long long)(clock.time_us() - start));
+    }
+    // Datasheet section 8.2 example values
+    check(fabsf(bme.get_temperature() - 25.08f) < 0.005f, "temperature 25.08 C");
+    check(fabsf(bme.get_pressure() - 1006.53f) < 0.01f, "pressure 1006.53 hPa");
+    check(bme.get_humidity() > 0.0f && bme.get_humidity() < 100.0f, "humidity in range");
+
+    uint32_t conversions = bme_sim.conversions();
+    start = clock.time_us();
+    check(bme.measure_once(), "BME280 measure_once");
+    uint64_t elapsed = clock.time_us() - start;
+    printf("  measure_once: %llu us (conversion %u us, max %u us)\n", (unsigned long long)elapsed,
+           bme_sim.measurement_time_us(), bme.max_measurement_time_us());
+    check(bme_sim.conversions() == conversions + 1, "measure_once triggers one conversion");
+    check(elapsed >= bme_sim.measurement_time_us(), "measure_once waits for the conversion");
+    check(elapsed <= bme.max_measurement_time_us(), "measure_once within maximum time");
+    check((bme_sim.reg(BME280_CTRL_MEASURE) & 0b11) == BME280::SLEEP_MODE, "back in sleep mode");
+
+    check(bme.start_measurement(), "BME280 start_measurement");
+    check(bme.poll_measurement() == BME280::MEASUREMENT_PENDING, "poll while converting");
+    int polls = 0;
+    BME280::MeasurementState state;
+    while ((state = bme.poll_measurement()) == BME280::MEASUREMENT_PENDING && polls < 1000) {
+        clock.sleep_us(1000);
+        polls++;
+    }
+    check(state == BME280::MEASUREMENT_READY, "async measurement completes");
+    check(bme.poll_measurement() == BME280::MEASUREMENT_FAILED, "a finished measurement is reported once");
+    BME280 idle(&bus, &clock);
+    check(idle.poll_measurement() == BME280::MEASUREMENT_FAILED, "poll without a started measurement fails");
+
+    check(bme.configure(BME280::INDOOR_NAVIGATION), "BME280 configure");
+    check(bme_sim.reg(BME280_CONFIG) == ((BME280::STANDBY_0_5_MS << 5) | (BME280::FILTER_16 << 2)), "config register");
+    check(bme_sim.reg(BME280_CTRL_HUMIDITY) == BME280::OVERSAMPLING_RATE_1, "ctrl_hum register");
+    check(bme_sim.reg(BME280_CTRL_MEASURE) == ((BME280::OVERSAMPLING_RATE_2 << 5) |
+                                                (BME280::OVERSAMPLING_RATE_16 << 2) | BME280::NORMAL_MODE),
+          "ctrl_meas register");
+    check(bme_sim.measurement_time_us() == BME280::measurement_time_us(BME280::INDOOR_NAVIGATION),
+          "per-channel oversampling latched");
+
+    // Calibration cache: first boot fills it, second boot uses it, a bad checksum is rejected
+    SimCalibrationStore cache;
+    BME280::BME_Comp_Coeff_t fetched = bme.get_compensation_coefficients();
+    check(bme.init(&cache) && !bme.used_cached_calibration() && cache.saves == 1, "calibration cached on first boot");
+    check(bme.init(&cache) && bme.used_cached_calibration(), "calibration reused on warm boot");
+    check(memcmp(&fetched, &bme.get_compensation_coefficients(), sizeof(fetched)) == 0, "cached calibration matches");
+    cache.corrupt(20);
+    check(bme.init(&cache) && !bme.used_cached_calibration() && cache.saves == 2, "corrupt calibration re-read");
+    BME280 other(&bus, &clock, BME280_ALTERNATE_I2CADDR);
+    bus.attach(BME280_ALTERNATE_I2CADDR, &bme_sim);
+    check(other.init(&cache) && !other.used_cached_calibration(), "calibration of another address ignored");
+    bus.detach(BME280_ALTERNATE_I2CADDR);
+
+    // Asynchronous read: the bus does the work, the result shows up on poll
+    check(bme.read(), "BME280 read before async read");
+    int32_t sync_temperature = bme.get_temperature_centidegrees();
+    uint32_t sync_pressure = bme.get_pressure_q24_8();
+    int bme_callbacks = 0;
+    start = clock.time_us();
+    check(bme.start_read(count_bme280_read, &bme_callbacks), "BME280 start_read");
+    check(clock.time_us() == start && bus.busy(), "start_read does not block");
+    check(!bme.start_read(), "second start_read refused while busy");
+    check(bme.poll_read() == BME280::MEASUREMENT_PENDING, "poll_read before completion");
+    clock.advance_us(bus.completes_at() - clock.time_us());
+    check(bme.poll_read() == BME280::MEASUREMENT_READY && bme_callbacks == 1, "poll_read completes");
+    printf("  start_read: %llu us on the bus, 0 us blocked\n", (unsigned long long)(clock.time_us() - start));
+    check(bme.get_temperature_centidegrees() == sync_temperature && bme.get_pressure_q24_8() == sync_pressure,
+          "async read matches blocking read");
+    bus.detach(BME280_DEFAULT_I2CADDR);
+    check(bme.start_read(), "start_read with sensor gone");
+    clock.advance_us(1000);
+    check(bme.poll_read() == BME280::MEASUREMENT_FAILED, "async read reports NAK");
+    bus.attach(BME280_DEFAULT_I2CADDR, &bme_sim);
+
+    printf("[SCD30]\n");
+    start = clock.time_us();
+    check(scd.init(), "SCD30 init");
+    printf("  init: %llu us\n", (unsigned long long)(clock.time_us() - start));
+    check(scd_sim.measuring(), "SCD30 measuring");
+    check(scd.getMeasurementInterval() == 2, "SCD30 interval");
+
+    int samples = 0;
+    for (int i = 0; i < 100 && samples < 2; i++) {
+        clock.sleep_ms(100);
+        if (!scd.dataReady()) continue;
+        check(scd.read(), "SCD30 read");
+        printf("  %.1f ppm  %.2f C  %.2f %%RH\n", scd.CO2, scd.temperature, scd.relative_humidity);
+        samples++;
+    }
+    check(samples == 2, "SCD30 produced two samples");
+    check(scd.CO2 == 650.0f && scd.temperature == 22.5f && scd.relative_humidity == 41.0f,
+          "SCD30 values");
+
+    scd_sim.set_measurement(800.0f, 21.0f, 45.5f);
+    clock.sleep_ms(2000);
+    int scd_callbacks = 0;
+    start = clock.time_us();
+    check(scd.startRead(count_scd30_read, &scd_callbacks), "SCD30 startRead");
+    SCD30::ReadState scd_state;
+    polls = 0;
+    while ((scd_state = scd.pollRead()) == SCD30::READ_PENDING && polls < 100) {
+        clock.advance_us(250);
+        polls++;
+    }
+    check(scd_state == SCD30::READ_READY && scd_callbacks == 1, "SCD30 async read completes");
+    check(clock.time_us() - start >= SCD30_COMMAND_DELAY_US, "SCD30 command delay kept");
+    check(scd_sim.crc_errors() == 0, "SCD30 no CRC errors");
+    check(scd.CO2 == 800.0f && scd.temperature == 21.0f && scd.relative_humidity == 45.5f,
+          "SCD30 async values");
+    printf("  startRead: %llu us, %d polls\n", (unsigned long long)(clock.time_us() - start), polls);
+    check_scd30_events(SCD30::EVENTS_TIMED);
+    check_scd30_events(SCD30::EVENTS_RDY_PIN);
+
+    printf("[Sensirion]\n");
+    check_sensirion();
+
+    printf("[BME280Fixed]\n");
+    check_fixed();
+
+    printf("[ReadWindow]\n");
+    check_read_window();
+
+    printf("[SPI]\n");
+    check_spi();
+
+    printf("[Golden]\n");
+    check_golden();
+
+    printf("[WindowStats]\n");
+    check_window_stats();
+
+    printf("[SampleFrame]\n");
+    check_frames();
+
+    printf("[SampleCodec]\n");
+    check_codec();
+
+    printf("[BusManager]\n");
+    check_bus_manager();
+
+    printf("[CompletionQueue]\n");
+    check_completion_queue();
+
+    printf("[BusHealth]\n");
+    check_bus_health();
+
+    printf("[Trace]\n");
+    check_trace();
+
+    printf("[DutyCycle]\n");
+    check_duty_cycle();
+
+    printf("[SampleLog]\n");
+    check_sample_log();
+
+    printf("[SampleRollup]\n");
+    check_rollup();
+
+    printf("[DerivedMetrics]\n");
+    check_derived_metrics();
+
+    printf("[SampleRing]\n");
+    check_ring(1000000, true, 0);
+    check_ring(200000, false, 64);
+
+    printf(failures ? "%d check(s) failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+/*
+ *  Title: size_driver
+ *  Description: Smallest program that brings up a BME280 in the gaming
+ *               profile and reads it, for comparing image sizes. Built
+ *               twice by CMakeLists.txt, with the runtime driver and with
+ *               BME280Fixed (SIZE_FIXED=1), both -Os with section garbage
+ *               collection as the Pico SDK builds. The size_compare target
+ *               prints the two.
+ */
+
+#include <BME280.h>
+#include <BME280Fixed.h>
+
+#ifndef SIZE_FIXED
+#define SIZE_FIXED 0
+#endif
+
+/**
+ * Answers from a register image the compiler cannot see through, so
+ * nothing after init() is folded away.
+ */
+class ImageBus : public I2CBus {
+public:
+    volatile uint8_t image[256] = {};
+
+    int write(uint8_t, const uint8_t *src, size_t len, bool, uint32_t) override {
+        // Register and value pairs, a lone register byte only sets the pointer
+        _pointer = src[0];
+        for (size_t i = 0; i + 1 < len; i += 2) image[src[i]] = src[i + 1];
+        return (int)len;
+    }
+
+    int read(uint8_t, uint8_t *dst, size_t len, bool, uint32_t) override {
+        for (size_t i = 0; i < len; i++) dst[i] = image[(uint8_t)(_pointer + i)];
+        return (int)len;
+    }
+
+private:
+    uint8_t _pointer = 0;
+};
+
+class CountingClock : public Clock {
+public:
+    uint64_t time_us(void) override { return _now; }
+    void sleep_us(uint64_t us) override { _now += us; }
+
+private:
+    uint64_t _now = 0;
+};
+
+int main() {
+    ImageBus bus;
+    CountingClock clock;
+    bus.image[BME280_ID] = BME280_CHIP_ID;
+
+#if SIZE_FIXED
+    BME280Fixed<BME280_DEFAULT_I2CADDR, BME280::OVERSAMPLING_RATE_1, BME280::OVERSAMPLING_RATE_4,
+                BME280::OVERSAMPLING_RATE_SKIPPED, BME280::FILTER_16, BME280::STANDBY_0_5_MS,
+                BME280::NORMAL_MODE> bme(&bus, &clock);
+    if (!bme.init()) return 1;
+#else
+    BME280 bme(&bus, &clock, BME280_DEFAULT_I2CADDR);
+    if (!bme.init() || !bme.configure(BME280::GAMING)) return 1;
+#endif
+
+    if (!bme.read()) return 1;
+    return (int)((bme.get_temperature_centidegrees() + bme.get_pressure_q24_8()) & 0x7F);
+}
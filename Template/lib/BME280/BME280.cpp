@@ -16,53 +16,206 @@
 
 #include "BME280.h"
 #include <string.h>
+#include <stddef.h>
 #include <stdio.h>
 
 /**
  * @brief Upphafsstilla samskipti við skynjarann.
+ * 
+ *        Ef geymsla fyrir leiðréttingargögn er gefin og í henni eru gild gögn
+ *        fyrir þennan skynjara eru þau notuð í stað þess að lesa gistin aftur.
+ *        Annars eru gistin lesin og gögnin vistuð í geymslunni.
+ * @param cache Geymsla fyrir leiðréttingargögn milli ræsinga, má vera \c nullptr.
  * @return \c True ef upphafsstilling tekst, annars \c false.
  */
-bool BME280::init(void) {
+bool BME280::init(CalibrationStore* cache) {
     if (!reset() || !is_connected()) return false;
 
     temperature = pressure = humidity = 0; //kannski má sleppa þessu
+    _pending = 0;
 
     bool successful = true;
-    successful &= fetch_compensation_data();
-    sleep_us(500);
+    CalibrationBlob blob;
+    _cached_calibration = (cache != nullptr) && cache->load(blob) && is_valid_calibration(blob);
+    if (_cached_calibration) {
+        parse_compensation_data(blob.registers);
+    } else {
+        successful &= fetch_compensation_data(blob.registers);
+        if (successful && cache != nullptr) {
+            // Ef vistun mistekst eru gistin bara lesin aftur við næstu ræsingu.
+            seal_calibration(blob);
+            cache->save(blob);
+        }
+    }
 
     successful &= set_mode(NORMAL_MODE, OVERSAMPLING_RATE_16);
 
     return successful;
 }
 
+/**
+ * @brief Segir til um hvort leiðréttingargögnin í síðustu init() komu úr geymslu.
+ * @return \c True ef gögnin komu úr geymslu, \c false ef þau voru lesin úr skynjaranum.
+ */
+bool BME280::used_cached_calibration(void) {
+    return _cached_calibration;
+}
+
 /**
  * @brief Les hitastig, loftþrýsing og rakastig frá skynjaranum.
+ * 
+ *        Aðeins eru lesin gistin sem rásirnar í stillingunum þurfa (sjá
+ *        burst_start()) og hrágildin eru geymd. Leiðrétting hverrar rásar
+ *        bíður þar til beðið er um gildið.
  * @return \c True ef aflestur tekst, annars \c false.
  */
 bool BME280::read() {
-    uint8_t data[9];
+    uint8_t data[8];
+    uint8_t start = burst_start(_config);
+    TraceSpan span(TRACE_BME280_READ, _address, _clock);
+
+    if (!read_registers(start, burst_length(_config), data + (start - BME280_PRESSURE_MSB), &span)) {
+        return span.finish(false);
+    }
+
+    return span.finish(process_raw_data(data));
+}
 
-    if (!read_registers(BME280_PRESSURE_MSB, 8, data)) {
+/**
+ * @brief Ræsir aflestur á hitastigi, loftþrýstingi og rakastigi án þess að bíða.
+ * 
+ *        Gögnin eru flutt af I2CBus::start_transfer() (með DMA á Pico) á meðan
+ *        örgjörvinn sinnir öðru. Fylgst er með framgangi með poll_read() eða
+ *        kallað er á \c callback þegar aflestri lýkur.
+ * @param callback Fall sem er kallað á þegar aflestri lýkur, má vera \c nullptr.
+ * @param context Bendill sem er sendur óbreyttur til \c callback.
+ * @return \c True ef aflestur var ræstur, \c false ef annar aflestur er í gangi
+ *         eða tengingin er upptekin.
+ */
+bool BME280::start_read(ReadCallback callback, void* context) {
+    if (_read_state == MEASUREMENT_PENDING) return false;
+
+    _transfer_register = burst_start(_config);
+    _transfer.address = _address;
+    _transfer.tx = &_transfer_register;
+    _transfer.tx_len = 1;
+    _transfer.rx = _transfer_data + (_transfer_register - BME280_PRESSURE_MSB);
+    _transfer.rx_len = burst_length(_config);
+    _transfer.timeout_us = _bus->transfer_timeout_us(1 + _transfer.rx_len);
+    _transfer.callback = on_read_complete;
+    _transfer.context = this;
+
+    _read_callback = callback;
+    _read_context = context;
+    _read_state = MEASUREMENT_PENDING;
+    _read_span = TraceSpan(TRACE_BME280_READ, _address, _clock);
+
+    if (!_bus->start_transfer(&_transfer)) {
+        _read_state = MEASUREMENT_FAILED;
+        _read_span.finish(false);
         return false;
     }
-    
-    int32_t raw_temperature, raw_pressure, raw_humidity;
+    return true;
+}
+
+/**
+ * @brief Athugar stöðu aflesturs sem var ræstur með start_read().
+ * 
+ *        Lokar ekki. Kallar á I2CBus::poll() svo kláraðar færslur skili sér.
+ * @return \c MEASUREMENT_READY ef ný gildi hafa verið lesin, \c MEASUREMENT_PENDING
+ *         ef aflestur er enn í gangi, annars \c MEASUREMENT_FAILED.
+ */
+BME280::MeasurementState BME280::poll_read(void) {
+    if (_read_state == MEASUREMENT_PENDING) _bus->poll();
+    return _read_state;
+}
 
-    raw_pressure = ((data[0] << 12) | (data[1] << 4) | (data[2] >> 4));
-    raw_temperature = ((data[3] << 12) | (data[4] << 4) | (data[5] >> 4));
-    raw_humidity = ((data[6] << 8) | data[7]);
+/**
+ * @brief Kallað af tengingunni þegar færslu frá start_read() lýkur.
+ * @param transfer Færslan, \c context bendir á BME280 hlutinn.
+ */
+void BME280::on_read_complete(I2CTransfer* transfer) {
+    BME280* sensor = (BME280*)transfer->context;
+    bool success = (transfer->result == (int)(transfer->tx_len + transfer->rx_len));
 
-    compensate_values(  &temperature, 
-                        &pressure, 
-                        &humidity, 
-                        raw_temperature, 
-                        raw_pressure, 
-                        raw_humidity);
+    sensor->_read_span.transfer(transfer->result, transfer->tx_len + transfer->rx_len);
+    success = success && sensor->process_raw_data(sensor->_transfer_data);
+    sensor->_read_span.finish(success);
+    sensor->_read_state = success ? MEASUREMENT_READY : MEASUREMENT_FAILED;
 
+    if (sensor->_read_callback != nullptr) {
+        sensor->_read_callback(sensor, success, sensor->_read_context);
+    }
+}
+
+/**
+ * @brief Geymir hrágildi sem lesin voru frá gistunum 0xF7..0xFE.
+ * 
+ *        Hitastigsgistin sýna 0x80000 frá ræsingu skynjarans fram að fyrstu
+ *        mælingu. Ef það gildi kemur eftir að skynjarinn hefur skilað mælingu
+ *        hefur hann endurræst sig (t.d. við spennufall) og gildin eru ekki notuð.
+ * 
+ *        Rásir sem er sleppt í stillingunum eru ekki lesnar og gildi þeirra
+ *        verður 0. Hinar eru leiðréttar af compensate() þegar beðið er um þær.
+ *        Hitastiginu er aðeins sleppt þegar öllum rásum er sleppt, sjá configure().
+ * @param data Átta bæti, loftþrýstingur, hitastig og rakastig. Aðeins bætin sem
+ *        burst_start() og burst_length() ná yfir eru lesin.
+ * @return \c False ef skynjarinn hefur endurræst sig án reset(), annars \c true.
+ */
+bool BME280::process_raw_data(const uint8_t* data) {
+    int32_t raw_temperature = ((data[3] << 12) | (data[4] << 4) | (data[5] >> 4));
+
+    if (raw_temperature != 0x80000) {
+        _has_measured = true;
+    } else if (_has_measured && _config.oversampling_temperature != OVERSAMPLING_RATE_SKIPPED) {
+        return false;
+    }
+
+    if (_config.oversampling_temperature == OVERSAMPLING_RATE_SKIPPED) {
+        temperature = 0;
+        pressure = 0;
+        humidity = 0;
+        _pending = 0;
+        return true;
+    }
+
+    _raw_temperature = raw_temperature;
+    _pending = PENDING_TEMPERATURE;
+    if (_config.oversampling_pressure != OVERSAMPLING_RATE_SKIPPED) {
+        _raw_pressure = ((data[0] << 12) | (data[1] << 4) | (data[2] >> 4));
+        _pending |= PENDING_PRESSURE;
+    } else {
+        pressure = 0;
+    }
+    if (_config.oversampling_humidity != OVERSAMPLING_RATE_SKIPPED) {
+        _raw_humidity = ((data[6] << 8) | data[7]);
+        _pending |= PENDING_HUMIDITY;
+    } else {
+        humidity = 0;
+    }
     return true;
 }
 
+/**
+ * @brief Leiðréttir þær rásir síðasta aflesturs sem hafa ekki verið leiðréttar.
+ * 
+ *        Hitastigið er alltaf leiðrétt fyrst því loftþrýstingur og rakastig
+ *        þurfa t_fine úr því. t_fine er geymt svo það er aðeins reiknað einu
+ *        sinni fyrir hvern aflestur.
+ * @param channels PENDING_* bitar rásanna sem beðið er um.
+ */
+void BME280::compensate(uint8_t channels) {
+    channels &= _pending;
+    if (channels == 0) return;
+
+    if (_pending & PENDING_TEMPERATURE) {
+        temperature = compensate_temperature(comp_coeffs, _raw_temperature, &_t_fine);
+    }
+    if (channels & PENDING_PRESSURE) pressure = compensate_pressure(comp_coeffs, _t_fine, _raw_pressure);
+    if (channels & PENDING_HUMIDITY) humidity = compensate_humidity(comp_coeffs, _t_fine, _raw_humidity);
+    _pending &= ~(channels | PENDING_TEMPERATURE);
+}
+
 /**
  * @brief Athugar ef skynjarinn er tengdur.
  * @return \c True ef skynjarinn er tengdur, annars \c false.
@@ -89,12 +242,75 @@ bool BME280::set_mode(uint8_t mode, uint8_t oversampling_rate) {
     if (mode < 0b00 || mode > 0b11) return false;
     if (oversampling_rate < 0b000 || oversampling_rate > 0b101) return false;
 
-    bool success = true;
-    success &= send_command(BME280_CTRL_HUMIDITY, oversampling_rate);
-    success &= send_command(BME280_CTRL_MEASURE,
-                            (oversampling_rate << 5) | (oversampling_rate << 2) | mode);
+    Config config = _config;
+    config.mode = mode;
+    config.oversampling_temperature = oversampling_rate;
+    config.oversampling_pressure = oversampling_rate;
+    config.oversampling_humidity = oversampling_rate;
+
+    return configure(config);
+}
 
-    return success;
+/**
+ * @brief Setur saman ctrl_meas gildi úr stillingum.
+ * @param config Stillingarnar.
+ * @param mode Mode bitarnir sem eiga að fylgja.
+ * @return Gildið fyrir ctrl_meas gistið.
+ */
+static uint8_t ctrl_measure_value(const BME280::Config& config, uint8_t mode) {
+    return (config.oversampling_temperature << 5) | (config.oversampling_pressure << 2) | mode;
+}
+
+/**
+ * @brief Skrifar allar stillingar í skynjarann í einni I2C færslu.
+ * 
+ *        Skrifað er í röðinni ctrl_meas (Sleep Mode), ctrl_hum, config og
+ *        loks ctrl_meas með réttum mode. Breyting á ctrl_hum tekur ekki gildi
+ *        fyrr en skrifað er í ctrl_meas og skrif í config geta hunsast í
+ *        Normal Mode, svo skynjarinn er svæfður fyrst.
+ * 
+ *        Í Forced Mode er skynjarinn skilinn eftir í Sleep Mode, mælingar eru
+ *        ræstar með start_measurement() eða measure_once().
+ * 
+ *        Leiðrétting loftþrýstings og rakastigs þarf t_fine úr hitastiginu, svo
+ *        hitastiginu má aðeins sleppa ef hinum rásunum er líka sleppt.
+ * @param config Stillingarnar sem á að nota.
+ * @return \c True ef stilling tekst, annars \c false.
+ */
+bool BME280::configure(const Config& config) {
+    if (config.mode > NORMAL_MODE) return false;
+    if (config.oversampling_temperature > OVERSAMPLING_RATE_16 ||
+        config.oversampling_pressure > OVERSAMPLING_RATE_16 ||
+        config.oversampling_humidity > OVERSAMPLING_RATE_16) return false;
+    if (config.filter > FILTER_16 || config.standby > STANDBY_20_MS) return false;
+    if (config.oversampling_temperature == OVERSAMPLING_RATE_SKIPPED &&
+        (config.oversampling_pressure != OVERSAMPLING_RATE_SKIPPED ||
+         config.oversampling_humidity != OVERSAMPLING_RATE_SKIPPED)) return false;
+
+    uint8_t mode = (config.mode == NORMAL_MODE) ? NORMAL_MODE : SLEEP_MODE;
+
+    uint8_t buffer[8];
+    buffer[0] = BME280_CTRL_MEASURE;
+    buffer[1] = ctrl_measure_value(_config, SLEEP_MODE);
+    buffer[2] = BME280_CTRL_HUMIDITY;
+    buffer[3] = config.oversampling_humidity;
+    buffer[4] = BME280_CONFIG;
+    buffer[5] = (config.standby << 5) | (config.filter << 2);
+    buffer[6] = BME280_CTRL_MEASURE;
+    buffer[7] = ctrl_measure_value(config, mode);
+
+    if (_bus->write(_address, buffer, 8, false, _bus->transfer_timeout_us(8)) != 8) return false;
+
+    _config = config;
+    return true;
+}
+
+/**
+ * @brief Skilar stillingunum sem síðast voru skrifaðar í skynjarann.
+ * @return Stillingarnar.
+ */
+BME280::Config BME280::get_config(void) {
+    return _config;
 }
 
 /**
@@ -103,10 +319,181 @@ bool BME280::set_mode(uint8_t mode, uint8_t oversampling_rate) {
  */
 bool BME280::reset(void) {
     if (!send_command(BME280_CMD_RESET, 0xB6)) return false;
-    sleep_ms(10);
+    _config = Config();
+    _has_measured = false;
+    _measuring = false;
+
+    // Eftir 2 ms ræsitíma er im_update bitinn lesinn þar til skynjarinn hefur
+    // afritað leiðréttingargögnin úr NVM, þó aldrei lengur en 10 ms alls.
+    uint64_t deadline = _clock->time_us() + 10000;
+    _clock->sleep_us(2000);
+    while (_clock->time_us() < deadline) {
+        uint8_t status[1];
+        if (read_registers(BME280_STATUS, 1, status) && !(status[0] & 0b1)) break;
+        _clock->sleep_us(500);
+    }
+    return true;
+}
+
+
+/********** Forced Mode **********/
+
+/** @brief Biðtími milli þess sem stöðugistið er lesið á meðan mæling er í gangi. */
+static const uint32_t MEASUREMENT_POLL_INTERVAL_US = 250;
+
+/**
+ * @brief Framkvæmir eina mælingu í Forced Mode og les niðurstöðurnar.
+ * 
+ *        Bíður fyrst dæmigerðan mælitíma og les svo \c measuring bitann í
+ *        stöðugistinu þar til mælingu lýkur, svo skilað er um leið og gögnin
+ *        eru tilbúin í stað þess að giska á biðtíma.
+ * @return \c True ef mæling og aflestur tekst, annars \c false.
+ */
+bool BME280::measure_once(void) {
+    if (!start_measurement()) return false;
+
+    while (true) {
+        uint64_t now = _clock->time_us();
+        if (now < _measurement_ready_at) {
+            _clock->sleep_us(_measurement_ready_at - now);
+        }
+
+        MeasurementState state = poll_measurement();
+        if (state != MEASUREMENT_PENDING) return state == MEASUREMENT_READY;
+
+        _clock->sleep_us(MEASUREMENT_POLL_INTERVAL_US);
+    }
+}
+
+/**
+ * @brief Ræsir eina mælingu í Forced Mode án þess að bíða eftir henni.
+ * 
+ *        Notar þær stillingar á yfirsöfnun sem síðast voru settar. Fylgst er
+ *        með framgangi mælingarinnar með poll_measurement().
+ * @return \c True ef skipunin tókst, annars \c false.
+ */
+bool BME280::start_measurement(void) {
+    if (!send_command(BME280_CTRL_MEASURE, ctrl_measure_value(_config, FORCED_MODE))) return false;
+
+    uint64_t now = _clock->time_us();
+    _measurement_ready_at = now + measurement_time_us();
+    _measurement_deadline = now + max_measurement_time_us();
+    _measuring = true;
     return true;
 }
 
+/**
+ * @brief Athugar stöðu mælingar sem var ræst með start_measurement().
+ * 
+ *        Lokar ekki. Engin samskipti eiga sér stað fyrr en dæmigerður mælitími
+ *        er liðinn. Þegar mælingu er lokið eru gildin lesin með read().
+ * 
+ *        Hver mæling skilar \c MEASUREMENT_READY eða \c MEASUREMENT_FAILED
+ *        einu sinni. Eftir það, eða ef engin mæling var ræst, er skilað
+ *        \c MEASUREMENT_FAILED svo gömul gildi í gistunum séu ekki lesin sem ný.
+ * @return \c MEASUREMENT_READY ef ný gildi hafa verið lesin, \c MEASUREMENT_PENDING
+ *         ef mæling er enn í gangi, annars \c MEASUREMENT_FAILED.
+ */
+BME280::MeasurementState BME280::poll_measurement(void) {
+    if (!_measuring) return MEASUREMENT_FAILED;
+
+    uint64_t now = _clock->time_us();
+    if (now < _measurement_ready_at) return MEASUREMENT_PENDING;
+
+    MeasurementState state;
+    uint8_t status[1];
+    if (!read_registers(BME280_STATUS, 1, status)) {
+        state = MEASUREMENT_FAILED;
+    } else if (status[0] & 0b1000) {
+        state = (now > _measurement_deadline) ? MEASUREMENT_FAILED : MEASUREMENT_PENDING;
+    } else {
+        state = read() ? MEASUREMENT_READY : MEASUREMENT_FAILED;
+    }
+
+    if (state != MEASUREMENT_PENDING) _measuring = false;
+    return state;
+}
+
+/**
+ * @brief Athugar hvort skynjarinn sé að mæla.
+ * @return \c True ef \c measuring bitinn í stöðugistinu er settur, annars \c false.
+ */
+bool BME280::is_measuring(void) {
+    uint8_t status[1];
+    if (!read_registers(BME280_STATUS, 1, status)) return false;
+    return (status[0] & 0b1000) != 0;
+}
+
+/**
+ * @brief Dæmigerður mælitími fyrir núverandi stillingar.
+ * @return Mælitíminn í míkrósekúndum [µs].
+ */
+uint32_t BME280::measurement_time_us(void) {
+    return measurement_time_us(_config);
+}
+
+/**
+ * @brief Hámarks mælitími fyrir núverandi stillingar.
+ * @return Mælitíminn í míkrósekúndum [µs].
+ */
+uint32_t BME280::max_measurement_time_us(void) {
+    return max_measurement_time_us(_config);
+}
+
+/**
+ * @brief Tími milli nýrra gilda fyrir núverandi stillingar.
+ * @return Tíminn í míkrósekúndum [µs].
+ */
+uint32_t BME280::sample_period_us(void) {
+    return sample_period_us(_config);
+}
+
+
+
+/********** Leiðréttingargögn í geymslu **********/
+
+/**
+ * @brief CRC-32 (IEEE 802.3) yfir bætafylki.
+ * @param data Bendill á gögnin.
+ * @param length Lengd gagnanna í bætum.
+ * @return Gátsumman.
+ */
+static uint32_t crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Fyllir inn haus og gátsummu leiðréttingargagna svo vista megi þau.
+ * @param blob Gögnin, \c registers þarf að vera búið að fylla út.
+ */
+void BME280::seal_calibration(CalibrationBlob& blob) {
+    blob.magic = CALIBRATION_MAGIC;
+    blob.version = CALIBRATION_VERSION;
+    blob.chip_id = BME280_CHIP_ID;
+    blob.address = _address;
+    blob.reserved = 0;
+    memset(blob.padding, 0, sizeof(blob.padding));
+    blob.checksum = crc32((const uint8_t*)&blob, offsetof(CalibrationBlob, checksum));
+}
+
+/**
+ * @brief Athugar hvort leiðréttingargögn úr geymslu eigi við þennan skynjara.
+ * @param blob Gögnin.
+ * @return \c True ef haus, auðkenni, staðfang og gátsumma passa, annars \c false.
+ */
+bool BME280::is_valid_calibration(const CalibrationBlob& blob) {
+    if (blob.magic != CALIBRATION_MAGIC || blob.version != CALIBRATION_VERSION) return false;
+    if (blob.chip_id != BME280_CHIP_ID || blob.address != _address) return false;
+    return blob.checksum == crc32((const uint8_t*)&blob, offsetof(CalibrationBlob, checksum));
+}
+
 
 /********** Getters **********/
 
@@ -115,7 +502,8 @@ bool BME280::reset(void) {
  * @return Hitastigið í Celsíus [°C].
  */
 float BME280::get_temperature(void) {
-    return temperature;
+    compensate(PENDING_TEMPERATURE);
+    return (float)temperature / 100.0f;
 }
 
 /**
@@ -123,7 +511,8 @@ float BME280::get_temperature(void) {
  * @return Loftþrýstingur í hektópaskal [hPa].
  */
 float BME280::get_pressure(void) {
-    return pressure;
+    compensate(PENDING_PRESSURE);
+    return (float)pressure / 25600.0f;
 }
 
 /**
@@ -131,9 +520,44 @@ float BME280::get_pressure(void) {
  * @return Rakastigið sem hlutfallslegur raki [%].
  */
 float BME280::get_humidity(void) {
+    compensate(PENDING_HUMIDITY);
+    return (float)humidity / 1024.0f;
+}
+
+/**
+ * @brief Skilar hitastigi frá skynjara án fleytitalna.
+ * @return Hitastigið í hundraðshlutum úr gráðu [0,01 °C], t.d. 2508 fyrir 25,08 °C.
+ */
+int32_t BME280::get_temperature_centidegrees(void) {
+    compensate(PENDING_TEMPERATURE);
+    return temperature;
+}
+
+/**
+ * @brief Skilar loftþrýstingi frá skynjara án fleytitalna.
+ * @return Loftþrýstingur í paskölum á Q24.8 formi [Pa/256], t.d. 24674867 fyrir 96386,2 Pa.
+ */
+uint32_t BME280::get_pressure_q24_8(void) {
+    compensate(PENDING_PRESSURE);
+    return pressure;
+}
+
+/**
+ * @brief Skilar rakastigi frá skynjara án fleytitalna.
+ * @return Rakastigið á Q22.10 formi [%RH/1024], t.d. 47445 fyrir 46,333 %RH.
+ */
+uint32_t BME280::get_humidity_q22_10(void) {
+    compensate(PENDING_HUMIDITY);
     return humidity;
 }
 
+/**
+ * @brief Skilar leiðréttingarstuðlunum sem voru lesnir úr skynjaranum.
+ * @return Tilvísun í stuðlana.
+ */
+const BME280::BME_Comp_Coeff_t& BME280::get_compensation_coefficients(void) {
+    return comp_coeffs;
+}
 
 /********** Private methods **********/
 
@@ -148,34 +572,31 @@ bool BME280::send_command(uint8_t register_address, uint8_t argument) {
     buffer[0] = register_address & 0xFF;
     buffer[1] = argument & 0xFF;
 
-    return (i2c_write_timeout_us(_i2c, _address, buffer, 2, false, 100000) == 2);
-}
-
-/**
- * @brief Sendir skipun á skynjarann.
- * @param register_address Staðfang skipunargistis, 1 bæti að lengd.
- * @return \c True ef skipun tekst, annars \c false.
- */
-bool BME280::send_command(uint8_t register_address) {
-    uint8_t buffer[1];
-    buffer[0] = register_address & 0xFF;
-    
-    return (i2c_write_timeout_us(_i2c, _address, buffer, 1, false, 100000) == 1);
+    return (_bus->write(_address, buffer, 2, false, _bus->transfer_timeout_us(2)) == 2);
 }
 
 /**
  * @brief Les úr gistum skynjara.
+ * 
+ *        Staðfangið er skrifað án STOP og lesið strax á eftir með endurteknu
+ *        upphafi (e. repeated start), svo engin bið er milli skrifunar og lesturs.
  * @param register_address Staðfang fyrsta gistisins, 1 bæti að lengd.
  * @param register_count Fjöldi gista sem á að vista.
  * @param data Bendill á fylki sem tekur við gögnunum.
+ * @param span Tímamæling sem færslurnar eru skráðar í, má vera \c nullptr.
  * @return \c True ef aflestur tekst, annars \c false.
  */
-bool BME280::read_registers(uint8_t register_address, uint8_t register_count, uint8_t *data) {
-    send_command(register_address);
+bool BME280::read_registers(uint8_t register_address, uint8_t register_count, uint8_t *data, TraceSpan* span) {
+    uint8_t buffer[1];
+    buffer[0] = register_address & 0xFF;
 
-    sleep_ms(10);
+    int result = _bus->write(_address, buffer, 1, true, _bus->transfer_timeout_us(1));
+    if (span != nullptr) span->transfer(result, 1);
+    if (result != 1) return false;
 
-    return (i2c_read_timeout_us(_i2c, _address, data, register_count, false, 100000) == register_count);
+    result = _bus->read(_address, data, register_count, false, _bus->transfer_timeout_us(register_count));
+    if (span != nullptr) span->transfer(result, register_count);
+    return (result == register_count);
 }
 
 
@@ -203,20 +624,29 @@ bool BME280::read_registers(uint8_t register_address, uint8_t register_count, ui
 }
 
 /// @brief Fetch the compensation data from the BME280
+/// @param buffer Receives the raw compensation registers, BME280_COMPENSATION_LENGTH bytes
 /// @return \c True of fetching successful, \c false if not
-bool BME280::fetch_compensation_data(void) {
-    // We want to read the full compensation register data
-    uint8_t buffer[33]{0};
+bool BME280::fetch_compensation_data(uint8_t* buffer) {
+    TraceSpan span(TRACE_BME280_CALIBRATION, _address, _clock);
 
     // Two reads because the calibration/compensation registers are not aligned
-    uint8_t compensation_reg_first = 0x88;
-    uint8_t compensation_reg_second = 0xE1;
-    if (i2c_write_timeout_us(_i2c, _address, &compensation_reg_first, 1, false, 10000) != 1) return false;
-    if (i2c_read_timeout_us(_i2c, _address, buffer, 26, false, 10000) != 26) return false;
+    if (!read_registers(0x88, 26, buffer, &span)) return span.finish(false);
+    if (!read_registers(0xE1, 7, buffer + 26, &span)) return span.finish(false);
 
-    if (i2c_write_timeout_us(_i2c, _address, &compensation_reg_second, 1, false, 10000) != 1) return false;
-    if (i2c_read_timeout_us(_i2c, _address, buffer + 26, 7, false, 10000) != 7) return false;
+    parse_compensation_data(buffer);
+    return span.finish(true);
+}
 
+/// @brief Unpack raw compensation registers into the comp_coeffs struct
+/// @param buffer The registers 0x88..0xA1 followed by 0xE1..0xE7
+void BME280::parse_compensation_data(const uint8_t* buffer) {
+    unpack_compensation_data(buffer, comp_coeffs);
+}
+
+/// @brief Unpack raw compensation registers into a coefficient struct
+/// @param buffer The registers 0x88..0xA1 followed by 0xE1..0xE7, BME280_COMPENSATION_LENGTH bytes
+/// @param comp_coeffs Receives the coefficients
+void BME280::unpack_compensation_data(const uint8_t* buffer, BME_Comp_Coeff_t& comp_coeffs) {
     // Zero-initialize the comp_coeffs struct
     memset(&comp_coeffs, 0, sizeof(comp_coeffs));
 
@@ -236,62 +666,84 @@ bool BME280::fetch_compensation_data(void) {
     comp_coeffs.dig_H1 = buffer[25];
     comp_coeffs.dig_H2 = uint16_t_to_int16_t(((uint16_t)buffer[27] << 8) | (uint16_t)buffer[26]);
     comp_coeffs.dig_H3 = buffer[28];
-    comp_coeffs.dig_H4 = uint16_t_to_int16_t(((uint16_t)buffer[29] << 4) | (uint16_t)buffer[30] & 0x0F);
-    comp_coeffs.dig_H5 = uint16_t_to_int16_t((((uint16_t)buffer[30] & 0xF0 ) >> 4) | ((uint16_t)buffer[31] << 4));
+    // dig_H4 and dig_H5 are signed 12-bit values, the whole-byte halves (0xE4 and 0xE6) carry the sign
+    comp_coeffs.dig_H4 = (int16_t)(uint8_t_to_int8_t(buffer[29]) * 16) | (int16_t)(buffer[30] & 0x0F);
+    comp_coeffs.dig_H5 = (int16_t)(uint8_t_to_int8_t(buffer[31]) * 16) | (int16_t)(buffer[30] >> 4);
     comp_coeffs.dig_H6 = uint8_t_to_int8_t(buffer[32]);
-    return true;
 }
 
-/// @brief Do the compensation calculation for temperature, pressure and humidity.
-/// Note that pressure and humidity rely on temperature to stay accurate.
-/// @param temperature Pointer to a float where the temperature value will be inserted (in °C)
-/// @param pressure Pointer to a float where the pressure value will be inserted (in hPa)
-/// @param humidity Pointer to a float where the humidity value will be inserted (in %RH)
+/// @brief Temperature compensation, also gives t_fine for the other two channels
+/// @param comp_coeffs Compensation coefficients of the sensor the raw value came from
 /// @param raw_temperature Raw temperature reading from BME280 sensor
-/// @param raw_pressure Raw pressure reading from BME280 sensor
-/// @param raw_humidity Raw humidity reading from BME280 sensor
-void BME280::compensate_values(  float* temperature,
-                                float* pressure,
-                                float* humidity,
-                                int32_t raw_temperature,
-                                int32_t raw_pressure,
-                                int32_t raw_humidity) {
-    // Temperature compensation
-    int32_t t_fine;
-    int32_t var1, var2, T;
+/// @param t_fine Receives the fine temperature used by compensate_pressure and compensate_humidity
+/// @return Temperature in 0.01 °C
+int32_t BME280::compensate_temperature(const BME_Comp_Coeff_t& comp_coeffs, int32_t raw_temperature, int32_t* t_fine) {
+    int32_t var1, var2;
     var1 = ((((raw_temperature >> 3) - ((int32_t)comp_coeffs.dig_T1 << 1))) * ((int32_t)comp_coeffs.dig_T2)) >> 11;
     var2 = (((((raw_temperature >> 4) - ((int32_t)comp_coeffs.dig_T1)) * ((raw_temperature >> 4) - ((int32_t)comp_coeffs.dig_T1))) >> 12) * ((int32_t)comp_coeffs.dig_T3)) >> 14;
-    t_fine = var1 + var2;
-    T = (t_fine * 5 + 128) >> 8;
-    *temperature = (float)T / 100.0f;
-
-    // Pressure compensation
-    int64_t p;
-    var1 = 0;
-    var2 = 0;
-    var1 = ((int64_t)t_fine) - 128000;
-    var2 = var1 * var1 * (int64_t)comp_coeffs.dig_P6;
-    var2 = var2 + ((var1 * (int64_t)comp_coeffs.dig_P5) << 17);
-    var2 = var2 + (((int64_t)comp_coeffs.dig_P4) << 35);
-    var1 = ((var1 * var1 * (int64_t)comp_coeffs.dig_P3) >> 8) + ((var1 * (int64_t)comp_coeffs.dig_P2) << 12);
-    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)comp_coeffs.dig_P1) >> 33;
-    if (var1 == 0) {
-        *pressure = 0.0f;
-    } else {
-        p = 1048576 - raw_pressure;
-        p = (((p << 31) - var2) * 3125) / var1;
-        var1 = (((int64_t)comp_coeffs.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
-        var2 = (((int64_t)comp_coeffs.dig_P8) * p) >> 19;
-        p = ((p + var1 + var2) >> 8) + (((int64_t)comp_coeffs.dig_P7) << 4);
-        *pressure = (float)((uint32_t)p) / 25600.0f;
+    *t_fine = var1 + var2;
+    return (*t_fine * 5 + 128) >> 8;
+}
+
+/// @brief Pressure compensation
+/// @param comp_coeffs Compensation coefficients of the sensor the raw value came from
+/// @param t_fine Fine temperature from compensate_temperature
+/// @param raw_pressure Raw pressure reading from BME280 sensor
+/// @return Pressure in Pa, Q24.8
+uint32_t BME280::compensate_pressure(const BME_Comp_Coeff_t& comp_coeffs, int32_t t_fine, int32_t raw_pressure) {
+    // The pressure terms need 64 bits, the temperature temporaries are only 32
+    int64_t p, p_var1, p_var2;
+    p_var1 = ((int64_t)t_fine) - 128000;
+    p_var2 = p_var1 * p_var1 * (int64_t)comp_coeffs.dig_P6;
+    p_var2 = p_var2 + ((p_var1 * (int64_t)comp_coeffs.dig_P5) << 17);
+    p_var2 = p_var2 + (((int64_t)comp_coeffs.dig_P4) << 35);
+    p_var1 = ((p_var1 * p_var1 * (int64_t)comp_coeffs.dig_P3) >> 8) + ((p_var1 * (int64_t)comp_coeffs.dig_P2) << 12);
+    p_var1 = (((((int64_t)1) << 47) + p_var1)) * ((int64_t)comp_coeffs.dig_P1) >> 33;
+    if (p_var1 == 0) {
+        return 0;
     }
+    p = 1048576 - raw_pressure;
+    p = (((p << 31) - p_var2) * 3125) / p_var1;
+    p_var1 = (((int64_t)comp_coeffs.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+    p_var2 = (((int64_t)comp_coeffs.dig_P8) * p) >> 19;
+    p = ((p + p_var1 + p_var2) >> 8) + (((int64_t)comp_coeffs.dig_P7) << 4);
+    return (uint32_t)p;
+}
 
-    // Humidity compensation
+/// @brief Humidity compensation
+/// @param comp_coeffs Compensation coefficients of the sensor the raw value came from
+/// @param t_fine Fine temperature from compensate_temperature
+/// @param raw_humidity Raw humidity reading from BME280 sensor
+/// @return Humidity in %RH, Q22.10
+uint32_t BME280::compensate_humidity(const BME_Comp_Coeff_t& comp_coeffs, int32_t t_fine, int32_t raw_humidity) {
     int32_t h_temp;
     h_temp = (t_fine - ((int32_t)76800));
     h_temp = (((((raw_humidity << 14) - (((int32_t)comp_coeffs.dig_H4) << 20) - (((int32_t)comp_coeffs.dig_H5) * h_temp)) + ((int32_t)16384)) >> 15) * (((((((h_temp * ((int32_t)comp_coeffs.dig_H6)) >> 10) * (((h_temp * ((int32_t)comp_coeffs.dig_H3)) >> 11) + ((int32_t)32768))) >> 10) + ((int32_t)2097152)) * ((int32_t)comp_coeffs.dig_H2) + 8192) >> 14));
     h_temp = (h_temp - (((((h_temp >> 15) * (h_temp >> 15)) >> 7) * ((int32_t)comp_coeffs.dig_H1)) >> 4));
     h_temp = (h_temp < 0 ? 0 : h_temp);
     h_temp = (h_temp > 419430400 ? 419430400 : h_temp);
-    *humidity = (float)((uint32_t)(h_temp >> 12)) / 1024.0f;
+    return (uint32_t)(h_temp >> 12);
+}
+
+/// @brief Do the compensation calculation for temperature, pressure and humidity.
+/// Note that pressure and humidity rely on temperature to stay accurate.
+/// Integer only, the float getters convert the results when asked.
+/// @param comp_coeffs Compensation coefficients of the sensor the raw values came from
+/// @param temperature Pointer to where the temperature will be inserted (in 0.01 °C)
+/// @param pressure Pointer to where the pressure will be inserted (in Pa, Q24.8)
+/// @param humidity Pointer to where the humidity will be inserted (in %RH, Q22.10)
+/// @param raw_temperature Raw temperature reading from BME280 sensor
+/// @param raw_pressure Raw pressure reading from BME280 sensor
+/// @param raw_humidity Raw humidity reading from BME280 sensor
+void BME280::compensate_values(  const BME_Comp_Coeff_t& comp_coeffs,
+                                int32_t* temperature,
+                                uint32_t* pressure,
+                                uint32_t* humidity,
+                                int32_t raw_temperature,
+                                int32_t raw_pressure,
+                                int32_t raw_humidity) {
+    int32_t t_fine;
+    *temperature = compensate_temperature(comp_coeffs, raw_temperature, &t_fine);
+    *pressure = compensate_pressure(comp_coeffs, t_fine, raw_pressure);
+    *humidity = compensate_humidity(comp_coeffs, t_fine, raw_humidity);
 }
@@ -17,7 +17,8 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #pragma once
-#include <hardware/i2c.h>
+#include <I2CBus.h>
+#include <Trace.h>
 
 #define BME280_DEFAULT_I2CADDR      0x76    // SDO tengt við GND.
 #define BME280_ALTERNATE_I2CADDR    0x77    // SDO tengt við VDDIO.
@@ -30,6 +31,8 @@
 #define BME280_CTRL_MEASURE         0xF4    // Stýrir umframsýnatöku á hitastigi og loftþrýstingi.
 #define BME280_CONFIG               0xF5    // Gistið ákvarðar tíðni, síun and viðmót.
 
+#define BME280_COMPENSATION_LENGTH  33      // Fjöldi leiðréttingargista, 0x88..0xA1 og 0xE1..0xE7.
+
 // Hrátt loftþrýsingsmæligildi
 #define BME280_PRESSURE_MSB         0xF7    // Most Significant Byte
 #define BME280_PRESSURE_LSB         0xF8    // Least Significant Byte
@@ -70,61 +73,343 @@ public:
     /** @brief Yfirsafnar sinnum 16. */
     static const uint8_t OVERSAMPLING_RATE_16 = 0b101;
 
+    /** @brief IIR sía ekki notuð. */
+    static const uint8_t FILTER_OFF = 0b000;
+    /** @brief IIR sía með stuðul 2. */
+    static const uint8_t FILTER_2 = 0b001;
+    /** @brief IIR sía með stuðul 4. */
+    static const uint8_t FILTER_4 = 0b010;
+    /** @brief IIR sía með stuðul 8. */
+    static const uint8_t FILTER_8 = 0b011;
+    /** @brief IIR sía með stuðul 16. */
+    static const uint8_t FILTER_16 = 0b100;
+
+    /** @brief Biðtími 0,5 ms milli mælinga í Normal Mode. */
+    static const uint8_t STANDBY_0_5_MS = 0b000;
+    /** @brief Biðtími 62,5 ms milli mælinga í Normal Mode. */
+    static const uint8_t STANDBY_62_5_MS = 0b001;
+    /** @brief Biðtími 125 ms milli mælinga í Normal Mode. */
+    static const uint8_t STANDBY_125_MS = 0b010;
+    /** @brief Biðtími 250 ms milli mælinga í Normal Mode. */
+    static const uint8_t STANDBY_250_MS = 0b011;
+    /** @brief Biðtími 500 ms milli mælinga í Normal Mode. */
+    static const uint8_t STANDBY_500_MS = 0b100;
+    /** @brief Biðtími 1000 ms milli mælinga í Normal Mode. */
+    static const uint8_t STANDBY_1000_MS = 0b101;
+    /** @brief Biðtími 10 ms milli mælinga í Normal Mode. */
+    static const uint8_t STANDBY_10_MS = 0b110;
+    /** @brief Biðtími 20 ms milli mælinga í Normal Mode. */
+    static const uint8_t STANDBY_20_MS = 0b111;
+
+    /**
+     * @brief Allar stillingar skynjarans: mode, yfirsöfnun hverrar rásar fyrir sig,
+     *        IIR sía og biðtími milli mælinga.
+     */
+    struct Config {
+        uint8_t mode;                       ///< SLEEP_MODE, FORCED_MODE eða NORMAL_MODE.
+        uint8_t oversampling_temperature;   ///< osrs_t, eitt af OVERSAMPLING_RATE_*.
+        uint8_t oversampling_pressure;      ///< osrs_p, eitt af OVERSAMPLING_RATE_*.
+        uint8_t oversampling_humidity;      ///< osrs_h, eitt af OVERSAMPLING_RATE_*.
+        uint8_t filter;                     ///< IIR sía, eitt af FILTER_*.
+        uint8_t standby;                    ///< t_standby, eitt af STANDBY_*. Aðeins notað í Normal Mode.
+    };
+
+    /** @brief Veðurvöktun (kafli 3.5.1): Forced Mode, x1 á öllum rásum, engin sía. Ein mæling á mínútu. */
+    static constexpr Config WEATHER_MONITORING = {FORCED_MODE, OVERSAMPLING_RATE_1, OVERSAMPLING_RATE_1,
+                                                  OVERSAMPLING_RATE_1, FILTER_OFF, STANDBY_0_5_MS};
+    /** @brief Rakamæling (kafli 3.5.2): Forced Mode, loftþrýstingi sleppt, engin sía. Ein mæling á sekúndu. */
+    static constexpr Config HUMIDITY_SENSING = {FORCED_MODE, OVERSAMPLING_RATE_1, OVERSAMPLING_RATE_SKIPPED,
+                                                OVERSAMPLING_RATE_1, FILTER_OFF, STANDBY_0_5_MS};
+    /** @brief Innanhússstaðsetning (kafli 3.5.3): Normal Mode, loftþrýstingur x16, sía 16. Um 25 Hz. */
+    static constexpr Config INDOOR_NAVIGATION = {NORMAL_MODE, OVERSAMPLING_RATE_2, OVERSAMPLING_RATE_16,
+                                                 OVERSAMPLING_RATE_1, FILTER_16, STANDBY_0_5_MS};
+    /** @brief Leikir (kafli 3.5.4): Normal Mode, loftþrýstingur x4, raka sleppt, sía 16. Um 83 Hz. */
+    static constexpr Config GAMING = {NORMAL_MODE, OVERSAMPLING_RATE_1, OVERSAMPLING_RATE_4,
+                                      OVERSAMPLING_RATE_SKIPPED, FILTER_16, STANDBY_0_5_MS};
+
+    /** @brief Staða mælingar sem var ræst með start_measurement(). */
+    enum MeasurementState {
+        MEASUREMENT_PENDING,    ///< Mæling er enn í gangi.
+        MEASUREMENT_READY,      ///< Mæling er búin og gildin hafa verið lesin.
+        MEASUREMENT_FAILED      ///< Samskipti brugðust eða mæling kláraðist ekki í tíma.
+    };
+
+    /**
+     * @brief Fall sem er kallað á þegar aflestri sem var ræstur með start_read() lýkur.
+     *        Keyrir úr I2CBus::poll(), aldrei úr truflun.
+     */
+    typedef void (*ReadCallback)(BME280* sensor, bool success, void* context);
+
+    /** @brief Leiðréttingarstuðlar skynjarans (e. compensation coefficients). */
+    struct BME_Comp_Coeff_t {
+        uint16_t dig_T1, dig_P1;
+        int16_t dig_T2, dig_T3, dig_P2, dig_P3, dig_P4, 
+                dig_P5, dig_P6, dig_P7, dig_P8, dig_P9, 
+                dig_H2, dig_H4, dig_H5;
+        uint8_t dig_H1, dig_H3;
+        int8_t dig_H6;  
+    };
+
+    /**
+     * @brief Leiðréttingargögn skynjarans á formi sem geyma má milli ræsinga,
+     *        t.d. í flassminni, svo ekki þurfi að lesa gistin í hvert sinn.
+     */
+    struct CalibrationBlob {
+        uint32_t magic;                                 ///< CALIBRATION_MAGIC ef eitthvað hefur verið vistað.
+        uint8_t version;                                ///< CALIBRATION_VERSION.
+        uint8_t chip_id;                                ///< Auðkenni skynjarans sem gögnin komu frá.
+        uint8_t address;                                ///< I2C staðfang skynjarans sem gögnin komu frá.
+        uint8_t reserved;
+        uint8_t registers[BME280_COMPENSATION_LENGTH];  ///< Gistin 0x88..0xA1 og 0xE1..0xE7 óbreytt.
+        uint8_t padding[3];
+        uint32_t checksum;                              ///< CRC-32 yfir allt hér á undan.
+    };
+    /** @brief Auðkennir vistuð leiðréttingargögn, "BMEC". */
+    static const uint32_t CALIBRATION_MAGIC = 0x43454D42;
+    /** @brief Útgáfa CalibrationBlob sniðsins. */
+    static const uint8_t CALIBRATION_VERSION = 1;
+
+    /**
+     * @class CalibrationStore
+     * @brief Geymsla fyrir leiðréttingargögn milli ræsinga.
+     */
+    class CalibrationStore {
+    public:
+        virtual ~CalibrationStore() {}
+        /** @brief Sækir vistuð gögn. Gildi þeirra er athugað af BME280::init(). */
+        virtual bool load(CalibrationBlob& blob) = 0;
+        /** @brief Vistar gögn. */
+        virtual bool save(const CalibrationBlob& blob) = 0;
+    };
+
     /**
      * @brief Smiður fyrir BME280 hlut.
-     * @param i2c Bendill á I2C vélbúnaðartilvikið sem á að nota.
+     * @param bus Bendill á I2C tenginguna sem á að nota.
+     * @param clock Bendill á klukkuna sem er notuð fyrir biðtíma.
      * @param addr I2C staðfangið fyrir skynjarann, sjálfstillist á 0x76 sem er SDO tengt við GND.
      */
-    BME280(i2c_inst_t* i2c, uint8_t addr = BME280_DEFAULT_I2CADDR) :    _i2c(i2c), 
-                                                                        _address(addr),
-                                                                        temperature(0),
-                                                                        pressure(0),
-                                                                        humidity(0) {};
+    BME280(I2CBus* bus, Clock* clock, uint8_t addr = BME280_DEFAULT_I2CADDR) :  _bus(bus),
+                                                                                _clock(clock),
+                                                                                _address(addr),
+                                                                                _config(),
+                                                                                _cached_calibration(false),
+                                                                                _has_measured(false),
+                                                                                _measuring(false),
+                                                                                _measurement_ready_at(0),
+                                                                                _measurement_deadline(0),
+                                                                                _transfer(),
+                                                                                _read_state(MEASUREMENT_FAILED),
+                                                                                _read_callback(nullptr),
+                                                                                _read_context(nullptr),
+                                                                                temperature(0),
+                                                                                pressure(0),
+                                                                                humidity(0),
+                                                                                _raw_temperature(0),
+                                                                                _raw_pressure(0),
+                                                                                _raw_humidity(0),
+                                                                                _t_fine(0),
+                                                                                _pending(0) {};
 
     /**
      * @brief Sjálfgefni smiðurinn fyrir BME280 hlut.
      */
     BME280() {}
 
-    bool init(void);
+    bool init(CalibrationStore* cache = nullptr);
+    bool used_cached_calibration(void);
     bool read(void);
+    bool start_read(ReadCallback callback = nullptr, void* context = nullptr);
+    MeasurementState poll_read(void);
 
     bool is_connected(void);
     bool set_mode(uint8_t mode, uint8_t oversampling_rate);
+    bool configure(const Config& config);
+    Config get_config(void);
     bool reset(void);
 
+    bool measure_once(void);
+    bool start_measurement(void);
+    MeasurementState poll_measurement(void);
+    bool is_measuring(void);
+    uint32_t measurement_time_us(void);
+    uint32_t max_measurement_time_us(void);
+    uint32_t sample_period_us(void);
+
+    /**
+     * @brief Breytir þriggja bita oversampling gildi í fjölda sýna.
+     * @param oversampling_rate Eitt af OVERSAMPLING_RATE_* gildunum.
+     * @return 0 ef sleppt, annars 1, 2, 4, 8 eða 16.
+     */
+    static constexpr uint32_t oversampling_factor(uint8_t oversampling_rate) {
+        return ((oversampling_rate & 0b111) == 0) ? 0
+             : ((oversampling_rate & 0b111) > 0b101) ? 16
+             : 1u << ((oversampling_rate & 0b111) - 1);
+    }
+
+    /**
+     * @brief Dæmigerður mælitími (kafli 9.1 í gagnablaði).
+     *        Reiknast við þýðingu þegar stillingarnar eru fastar.
+     * @param config Stillingarnar sem mælitíminn er reiknaður fyrir.
+     * @return Mælitíminn í míkrósekúndum [µs].
+     */
+    static constexpr uint32_t measurement_time_us(const Config& config) {
+        uint32_t osrs_t = oversampling_factor(config.oversampling_temperature);
+        uint32_t osrs_p = oversampling_factor(config.oversampling_pressure);
+        uint32_t osrs_h = oversampling_factor(config.oversampling_humidity);
+
+        uint32_t time = 1000 + 2000 * osrs_t;
+        if (osrs_p) time += 2000 * osrs_p + 500;
+        if (osrs_h) time += 2000 * osrs_h + 500;
+        return time;
+    }
+
+    /**
+     * @brief Hámarks mælitími (kafli 9.1 í gagnablaði).
+     * @param config Stillingarnar sem mælitíminn er reiknaður fyrir.
+     * @return Mælitíminn í míkrósekúndum [µs].
+     */
+    static constexpr uint32_t max_measurement_time_us(const Config& config) {
+        uint32_t osrs_t = oversampling_factor(config.oversampling_temperature);
+        uint32_t osrs_p = oversampling_factor(config.oversampling_pressure);
+        uint32_t osrs_h = oversampling_factor(config.oversampling_humidity);
+
+        uint32_t time = 1250 + 2300 * osrs_t;
+        if (osrs_p) time += 2300 * osrs_p + 575;
+        if (osrs_h) time += 2300 * osrs_h + 575;
+        return time;
+    }
+
+    /** @brief Biðtímar STANDBY_* gildanna í míkrósekúndum (tafla 27 í gagnablaði). */
+    static constexpr uint32_t STANDBY_TIME_US[8] = {500, 62500, 125000, 250000, 500000, 1000000, 10000, 20000};
+
+    /**
+     * @brief Biðtími milli mælinga í Normal Mode.
+     * @param config Stillingarnar.
+     * @return Biðtíminn í míkrósekúndum [µs].
+     */
+    static constexpr uint32_t standby_time_us(const Config& config) {
+        return STANDBY_TIME_US[config.standby & 0b111];
+    }
+
+    /**
+     * @brief Tími milli nýrra gilda. Í Normal Mode er það mælitími að viðbættum
+     *        biðtíma, annars stysti mögulegi tími milli mælinga í Forced Mode.
+     * @param config Stillingarnar.
+     * @return Tíminn í míkrósekúndum [µs].
+     */
+    static constexpr uint32_t sample_period_us(const Config& config) {
+        return measurement_time_us(config) + ((config.mode == NORMAL_MODE) ? standby_time_us(config) : 0);
+    }
+
+    /**
+     * @brief Fyrsta gistið sem read() les. Hitastigið er alltaf lesið því hinar
+     *        rásirnar þurfa t_fine, loftþrýstingur er á undan því í 0xF7..0xF9.
+     * @param config Stillingarnar.
+     * @return BME280_PRESSURE_MSB ef loftþrýstingur er mældur, annars BME280_TEMPERATURE_MSB.
+     */
+    static constexpr uint8_t burst_start(const Config& config) {
+        return (config.oversampling_pressure != OVERSAMPLING_RATE_SKIPPED) ? BME280_PRESSURE_MSB
+                                                                           : BME280_TEMPERATURE_MSB;
+    }
+
+    /**
+     * @brief Fjöldi gista sem read() les frá burst_start(): 3 fyrir hitastig eingöngu,
+     *        5 fyrir hitastig og rakastig, 6 án rakastigs og 8 fyrir allar rásir.
+     * @param config Stillingarnar.
+     * @return Fjöldi bæta.
+     */
+    static constexpr uint8_t burst_length(const Config& config) {
+        return ((config.oversampling_humidity != OVERSAMPLING_RATE_SKIPPED) ? BME280_HUMIDITY_LSB
+                                                                            : BME280_TEMPERATURE_XLSB)
+               - burst_start(config) + 1;
+    }
+
     float get_temperature(void);
     float get_pressure(void);
     float get_humidity(void);
 
+    int32_t get_temperature_centidegrees(void);
+    uint32_t get_pressure_q24_8(void);
+    uint32_t get_humidity_q22_10(void);
+
+    const BME_Comp_Coeff_t& get_compensation_coefficients(void);
+    static void unpack_compensation_data(const uint8_t* buffer, BME_Comp_Coeff_t& comp_coeffs);
+    static int32_t compensate_temperature(const BME_Comp_Coeff_t& comp_coeffs, int32_t raw_temperature, int32_t* t_fine);
+    static uint32_t compensate_pressure(const BME_Comp_Coeff_t& comp_coeffs, int32_t t_fine, int32_t raw_pressure);
+    static uint32_t compensate_humidity(const BME_Comp_Coeff_t& comp_coeffs, int32_t t_fine, int32_t raw_humidity);
+    static void compensate_values(  const BME_Comp_Coeff_t& comp_coeffs,
+                                    int32_t* temperature,
+                                    uint32_t* pressure,
+                                    uint32_t* humidity,
+                                    int32_t raw_temperature,
+                                    int32_t raw_pressure,
+                                    int32_t raw_humidity);
+    static void compensate_batch(   const BME_Comp_Coeff_t& comp_coeffs,
+                                    const int32_t* raw_temperature,
+                                    const int32_t* raw_pressure,
+                                    const int32_t* raw_humidity,
+                                    int32_t* temperature,
+                                    uint32_t* pressure,
+                                    uint32_t* humidity,
+                                    size_t count);
+
 private:
-    /** @brief I2C vélbúnaðartilvikið sem er notað. */
-    i2c_inst_t* _i2c;
+    /** @brief I2C tengingin sem er notuð. */
+    I2CBus* _bus;
+    /** @brief Klukkan sem er notuð fyrir biðtíma. */
+    Clock* _clock;
     /** @brief I2C staðfangið fyrir skynjarann. */
     uint8_t _address;
 
-    /** @brief Gildin frá nemum skynjarans. */
-    float temperature, pressure, humidity;
+    /** @brief Stillingarnar sem síðast voru skrifaðar í skynjarann. */
+    Config _config;
 
-    struct BME_Comp_Coeff_t {
-        uint16_t dig_T1, dig_P1;
-        int16_t dig_T2, dig_T3, dig_P2, dig_P3, dig_P4, 
-                dig_P5, dig_P6, dig_P7, dig_P8, dig_P9, 
-                dig_H2, dig_H4, dig_H5;
-        uint8_t dig_H1, dig_H3;
-        int8_t dig_H6;  
-    } comp_coeffs;
-    bool fetch_compensation_data(void);
-    void compensate_values( float* temperature,
-                            float* pressure,
-                            float* humidity,
-                            int32_t raw_temperature,
-                            int32_t raw_pressure,
-                            int32_t raw_humidity);
+    /** @brief Hvort leiðréttingargögnin komu úr geymslu við síðustu init(). */
+    bool _cached_calibration;
+    bool _has_measured;         ///< Skynjarinn hefur skilað mælingu síðan reset().
+    bool _measuring;            ///< Mæling frá start_measurement() bíður eftir poll_measurement().
 
-    bool send_command(uint8_t register_address, uint8_t argument);
-    bool send_command(uint8_t register_address);
-    bool read_registers(uint8_t register_address, uint8_t register_count, uint8_t *data);
-};
+    /** @brief Tímar (í µs) fyrir mælingu sem er í gangi í Forced Mode. */
+    uint64_t _measurement_ready_at, _measurement_deadline;
+
+    /** @brief Ósamstilltur aflestur: færslan, gistið sem lesið er frá og gögnin. */
+    I2CTransfer _transfer;
+    uint8_t _transfer_register;
+    uint8_t _transfer_data[8];
+    /** @brief Staða síðasta aflesturs sem var ræstur með start_read(). */
+    MeasurementState _read_state;
+    ReadCallback _read_callback;
+    void* _read_context;
+    /** @brief Tímamæling aflesturs sem var ræstur með start_read(). */
+    TraceSpan _read_span;
+
+    /** @brief Hitastig í hundraðshlutum úr gráðu [0,01 °C]. */
+    int32_t temperature;
+    /** @brief Loftþrýstingur í paskölum á Q24.8 formi [Pa/256]. */
+    uint32_t pressure;
+    /** @brief Rakastig á Q22.10 formi [%RH/1024]. */
+    uint32_t humidity;
 
-static uint8_t crc8(const uint8_t *data, int len);
\ No newline at end of file
+    /** @brief Hrágildi síðasta aflesturs, leiðrétt af compensate() þegar beðið er um þau. */
+    int32_t _raw_temperature, _raw_pressure, _raw_humidity;
+    /** @brief Fínt hitastig úr leiðréttingu hitastigsins, notað af hinum rásunum. */
+    int32_t _t_fine;
+    /** @brief PENDING_* bitar rásanna sem hafa ekki verið leiðréttar síðan síðasti aflestur. */
+    uint8_t _pending;
+    static const uint8_t PENDING_TEMPERATURE = 1 << 0;
+    static const uint8_t PENDING_PRESSURE = 1 << 1;
+    static const uint8_t PENDING_HUMIDITY = 1 << 2;
+
+    BME_Comp_Coeff_t comp_coeffs;
+    bool process_raw_data(const uint8_t* data);
+    void compensate(uint8_t channels);
+    static void on_read_complete(I2CTransfer* transfer);
+    bool fetch_compensation_data(uint8_t* buffer);
+    void parse_compensation_data(const uint8_t* buffer);
+
+    void seal_calibration(CalibrationBlob& blob);
+    bool is_valid_calibration(const CalibrationBlob& blob);
+
+    bool send_command(uint8_t register_address, uint8_t argument);
+    bool read_registers(uint8_t register_address, uint8_t register_count, uint8_t *data, TraceSpan* span = nullptr);
+};
\ No newline at end of file
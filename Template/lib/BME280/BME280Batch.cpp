@@ -0,0 +1,138 @@
+/*
+ *  Title: BME280Batch
+ *  Description: Compensation of many raw samples at once, for replaying
+ *               archived ADC words against a set of calibration
+ *               coefficients. Gives the same results as
+ *               BME280::compensate_values, sample for sample.
+ *
+ *               The work is split into passes over a block of samples so
+ *               the 32-bit temperature and humidity passes have no branches
+ *               or cross-iteration dependencies and can be auto-vectorized.
+ *               Pressure needs a 64-bit division per sample, which no
+ *               common SIMD unit has, so that pass stays scalar but
+ *               branch-free.
+ */
+
+#include "BME280.h"
+
+#if defined(__GNUC__)
+#define BME280_RESTRICT __restrict__
+#else
+#define BME280_RESTRICT
+#endif
+
+// Samples per block, t_fine for one block lives on the stack
+static const size_t BATCH_BLOCK = 256;
+
+/// @brief Temperature pass, also produces t_fine for the other two passes
+static void compensate_temperature_block(const BME280::BME_Comp_Coeff_t& comp_coeffs,
+                                         const int32_t* BME280_RESTRICT raw_temperature,
+                                         int32_t* BME280_RESTRICT temperature,
+                                         int32_t* BME280_RESTRICT t_fine,
+                                         size_t count) {
+    const int32_t T1 = comp_coeffs.dig_T1;
+    const int32_t T2 = comp_coeffs.dig_T2;
+    const int32_t T3 = comp_coeffs.dig_T3;
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t raw = raw_temperature[i];
+        int32_t var1 = ((((raw >> 3) - (T1 << 1))) * T2) >> 11;
+        int32_t var2 = (((((raw >> 4) - T1) * ((raw >> 4) - T1)) >> 12) * T3) >> 14;
+        int32_t fine = var1 + var2;
+        t_fine[i] = fine;
+        temperature[i] = (fine * 5 + 128) >> 8;
+    }
+}
+
+/// @brief Humidity pass, 32-bit only
+static void compensate_humidity_block(const BME280::BME_Comp_Coeff_t& comp_coeffs,
+                                      const int32_t* BME280_RESTRICT raw_humidity,
+                                      const int32_t* BME280_RESTRICT t_fine,
+                                      uint32_t* BME280_RESTRICT humidity,
+                                      size_t count) {
+    const int32_t H1 = comp_coeffs.dig_H1;
+    const int32_t H2 = comp_coeffs.dig_H2;
+    const int32_t H3 = comp_coeffs.dig_H3;
+    const int32_t H4 = comp_coeffs.dig_H4;
+    const int32_t H5 = comp_coeffs.dig_H5;
+    const int32_t H6 = comp_coeffs.dig_H6;
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t h_temp = t_fine[i] - ((int32_t)76800);
+        h_temp = (((((raw_humidity[i] << 14) - (H4 << 20) - (H5 * h_temp)) + ((int32_t)16384)) >> 15) * (((((((h_temp * H6) >> 10) * (((h_temp * H3) >> 11) + ((int32_t)32768))) >> 10) + ((int32_t)2097152)) * H2 + 8192) >> 14));
+        h_temp = (h_temp - (((((h_temp >> 15) * (h_temp >> 15)) >> 7) * H1) >> 4));
+        h_temp = (h_temp < 0 ? 0 : h_temp);
+        h_temp = (h_temp > 419430400 ? 419430400 : h_temp);
+        humidity[i] = (uint32_t)(h_temp >> 12);
+    }
+}
+
+/// @brief Pressure pass, 64-bit with one division per sample
+static void compensate_pressure_block(const BME280::BME_Comp_Coeff_t& comp_coeffs,
+                                      const int32_t* BME280_RESTRICT raw_pressure,
+                                      const int32_t* BME280_RESTRICT t_fine,
+                                      uint32_t* BME280_RESTRICT pressure,
+                                      size_t count) {
+    const int64_t P1 = comp_coeffs.dig_P1;
+    const int64_t P2 = comp_coeffs.dig_P2;
+    const int64_t P3 = comp_coeffs.dig_P3;
+    const int64_t P4 = comp_coeffs.dig_P4;
+    const int64_t P5 = comp_coeffs.dig_P5;
+    const int64_t P6 = comp_coeffs.dig_P6;
+    const int64_t P7 = comp_coeffs.dig_P7;
+    const int64_t P8 = comp_coeffs.dig_P8;
+    const int64_t P9 = comp_coeffs.dig_P9;
+
+    for (size_t i = 0; i < count; i++) {
+        int64_t var1 = ((int64_t)t_fine[i]) - 128000;
+        int64_t var2 = var1 * var1 * P6;
+        var2 = var2 + ((var1 * P5) << 17);
+        var2 = var2 + (P4 << 35);
+        var1 = ((var1 * var1 * P3) >> 8) + ((var1 * P2) << 12);
+        var1 = (((((int64_t)1) << 47) + var1)) * P1 >> 33;
+
+        // var1 == 0 would divide by zero, the scalar path reports 0 Pa for it.
+        // The dividend is masked as well as the divisor, so p is 0 and the
+        // terms below cannot overflow.
+        int64_t divisor = (var1 == 0) ? 1 : var1;
+        int64_t p = 1048576 - raw_pressure[i];
+        int64_t dividend = (var1 == 0) ? 0 : (((p << 31) - var2) * 3125);
+        p = dividend / divisor;
+        int64_t var3 = (P9 * (p >> 13) * (p >> 13)) >> 25;
+        int64_t var4 = (P8 * p) >> 19;
+        p = ((p + var3 + var4) >> 8) + (P7 << 4);
+        pressure[i] = (var1 == 0) ? 0 : (uint32_t)p;
+    }
+}
+
+/// @brief Compensate a batch of raw samples, structure-of-arrays in and out.
+/// Output units are the same as BME280::compensate_values.
+/// The output arrays must not overlap each other or the input arrays, the
+/// passes are compiled on that assumption (restrict).
+/// @param comp_coeffs Compensation coefficients of the sensor the raw values came from
+/// @param raw_temperature Raw 20-bit temperature words
+/// @param raw_pressure Raw 20-bit pressure words
+/// @param raw_humidity Raw 16-bit humidity words
+/// @param temperature Output temperatures (in 0.01 °C)
+/// @param pressure Output pressures (in Pa, Q24.8)
+/// @param humidity Output humidities (in %RH, Q22.10)
+/// @param count Number of samples
+void BME280::compensate_batch(  const BME_Comp_Coeff_t& comp_coeffs,
+                                const int32_t* raw_temperature,
+                                const int32_t* raw_pressure,
+                                const int32_t* raw_humidity,
+                                int32_t* temperature,
+                                uint32_t* pressure,
+                                uint32_t* humidity,
+                                size_t count) {
+    int32_t t_fine[BATCH_BLOCK];
+
+    for (size_t start = 0; start < count; start += BATCH_BLOCK) {
+        size_t n = count - start;
+        if (n > BATCH_BLOCK) n = BATCH_BLOCK;
+
+        compensate_temperature_block(comp_coeffs, raw_temperature + start, temperature + start, t_fine, n);
+        compensate_humidity_block(comp_coeffs, raw_humidity + start, t_fine, humidity + start, n);
+        compensate_pressure_block(comp_coeffs, raw_pressure + start, t_fine, pressure + start, n);
+    }
+}
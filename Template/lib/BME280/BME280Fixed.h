@@ -0,0 +1,205 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *     Lýsing:  BME280 með stillingar sem eru fastar við þýðingu.
+ *
+ *              Staðfang, yfirsöfnun hverrar rásar, sía, biðtími og
+ *              mode eru sniðmátsbreytur (e. template parameters). Gildi
+ *              gistanna, lengd aflesturs og mælitímar eru reiknuð við
+ *              þýðingu og ógildar samsetningar stöðva þýðinguna með
+ *              static_assert.
+ *
+ *              Aðeins rásirnar sem eru mældar eru lesnar og leiðréttar,
+ *              svo leiðréttingarkóði fyrir rás sem er sleppt kemst ekki
+ *              í forritið (með -ffunction-sections og --gc-sections eins
+ *              og Pico SDK notar). Ekkert er athugað við keyrslu sem
+ *              þýðandinn getur athugað.
+ *
+ *              Dæmi, veðurvöktun á 0x76:
+ *                BME280Fixed<BME280_DEFAULT_I2CADDR, BME280::OVERSAMPLING_RATE_1,
+ *                            BME280::OVERSAMPLING_RATE_1, BME280::OVERSAMPLING_RATE_1> bme(&bus, &clock);
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+#include "BME280.h"
+
+/**
+ * @class BME280Fixed
+ * @brief BME280 með stillingum sem eru fastar við þýðingu.
+ * @tparam ADDRESS I2C staðfang, BME280_DEFAULT_I2CADDR eða BME280_ALTERNATE_I2CADDR.
+ * @tparam OSRS_T Yfirsöfnun hitastigs, má ekki vera sleppt.
+ * @tparam OSRS_P Yfirsöfnun loftþrýstings, OVERSAMPLING_RATE_SKIPPED sleppir rásinni.
+ * @tparam OSRS_H Yfirsöfnun rakastigs, OVERSAMPLING_RATE_SKIPPED sleppir rásinni.
+ * @tparam FILTER IIR sía, eitt af FILTER_*.
+ * @tparam STANDBY Biðtími í Normal Mode, eitt af STANDBY_*.
+ * @tparam MODE FORCED_MODE eða NORMAL_MODE.
+ */
+template <uint8_t ADDRESS, uint8_t OSRS_T, uint8_t OSRS_P, uint8_t OSRS_H,
+          uint8_t FILTER = BME280::FILTER_OFF, uint8_t STANDBY = BME280::STANDBY_0_5_MS,
+          uint8_t MODE = BME280::FORCED_MODE>
+class BME280Fixed {
+    static_assert(ADDRESS == BME280_DEFAULT_I2CADDR || ADDRESS == BME280_ALTERNATE_I2CADDR,
+                  "BME280 svarar aðeins á 0x76 eða 0x77");
+    static_assert(OSRS_T <= BME280::OVERSAMPLING_RATE_16 && OSRS_P <= BME280::OVERSAMPLING_RATE_16 &&
+                  OSRS_H <= BME280::OVERSAMPLING_RATE_16, "yfirsöfnun er OVERSAMPLING_RATE_SKIPPED..16");
+    static_assert(OSRS_T != BME280::OVERSAMPLING_RATE_SKIPPED,
+                  "leiðrétting loftþrýstings og rakastigs þarf t_fine úr hitastigsrásinni");
+    static_assert(FILTER <= BME280::FILTER_16, "sía er FILTER_OFF..FILTER_16");
+    static_assert(STANDBY <= BME280::STANDBY_20_MS, "biðtími er STANDBY_0_5_MS..STANDBY_20_MS");
+    static_assert(MODE == BME280::FORCED_MODE || MODE == BME280::NORMAL_MODE,
+                  "FORCED_MODE eða NORMAL_MODE, Sleep Mode mælir ekkert");
+
+public:
+    /** @brief Stillingarnar á sama formi og BME280::configure() tekur við. */
+    static constexpr BME280::Config CONFIG = {MODE, OSRS_T, OSRS_P, OSRS_H, FILTER, STANDBY};
+
+    /** @brief Gildi ctrl_hum gistisins. */
+    static constexpr uint8_t CTRL_HUMIDITY_VALUE = OSRS_H;
+    /** @brief Gildi config gistisins. */
+    static constexpr uint8_t CONFIG_VALUE = (STANDBY << 5) | (FILTER << 2);
+    /** @brief Gildi ctrl_meas eftir init(): Normal Mode, eða Sleep Mode þar til mæling er ræst. */
+    static constexpr uint8_t CTRL_MEASURE_VALUE = (OSRS_T << 5) | (OSRS_P << 2) |
+                                                  ((MODE == BME280::NORMAL_MODE) ? BME280::NORMAL_MODE
+                                                                                 : BME280::SLEEP_MODE);
+    /** @brief Gildi ctrl_meas sem ræsir eina mælingu í Forced Mode. */
+    static constexpr uint8_t CTRL_MEASURE_FORCED = (OSRS_T << 5) | (OSRS_P << 2) | BME280::FORCED_MODE;
+
+    /** @brief Fyrsta gistið sem er lesið, loftþrýstingur er á undan hitastigi. */
+    static constexpr uint8_t BURST_START = (OSRS_P != BME280::OVERSAMPLING_RATE_SKIPPED) ? BME280_PRESSURE_MSB
+                                                                                        : BME280_TEMPERATURE_MSB;
+    /** @brief Fjöldi bæta í aflestri, rakastig er aftast. */
+    static constexpr uint8_t BURST_LENGTH = ((OSRS_H != BME280::OVERSAMPLING_RATE_SKIPPED) ? BME280_HUMIDITY_LSB
+                                                                                           : BME280_TEMPERATURE_XLSB)
+                                            - BURST_START + 1;
+
+    /** @brief Dæmigerður mælitími [µs]. */
+    static constexpr uint32_t MEASUREMENT_TIME_US = BME280::measurement_time_us(CONFIG);
+    /** @brief Hámarks mælitími [µs]. */
+    static constexpr uint32_t MAX_MEASUREMENT_TIME_US = BME280::max_measurement_time_us(CONFIG);
+    /** @brief Tími milli nýrra gilda [µs]. */
+    static constexpr uint32_t SAMPLE_PERIOD_US = BME280::sample_period_us(CONFIG);
+
+    /**
+     * @brief Smiður.
+     * @param bus I2C tengingin sem skynjarinn er á.
+     * @param clock Klukkan sem er notuð fyrir biðtíma.
+     */
+    BME280Fixed(I2CBus* bus, Clock* clock) : _bus(bus), _clock(clock), _comp_coeffs(),
+                                             _temperature(0), _pressure(0), _humidity(0) {}
+
+    /**
+     * @brief Endurræsir skynjarann, les leiðréttingargögnin og skrifar stillingarnar.
+     * @return \c True ef upphafsstilling tekst, annars \c false.
+     */
+    bool init(void) {
+        uint8_t reset[2] = {BME280_CMD_RESET, 0xB6};
+        if (_bus->write(ADDRESS, reset, 2, false, _bus->transfer_timeout_us(2)) != 2) return false;
+
+        // Sama bið og BME280::reset(): im_update bitinn, þó aldrei lengur en 10 ms alls.
+        uint64_t deadline = _clock->time_us() + 10000;
+        _clock->sleep_us(2000);
+        uint8_t status[1];
+        while (_clock->time_us() < deadline) {
+            if (read_registers(BME280_STATUS, 1, status) && !(status[0] & 0b1)) break;
+            _clock->sleep_us(500);
+        }
+
+        uint8_t id[1];
+        if (!read_registers(BME280_ID, 1, id) || id[0] != BME280_CHIP_ID) return false;
+
+        uint8_t registers[BME280_COMPENSATION_LENGTH];
+        if (!read_registers(0x88, 26, registers) || !read_registers(0xE1, 7, registers + 26)) return false;
+        BME280::unpack_compensation_data(registers, _comp_coeffs);
+
+        // ctrl_hum tekur gildi við skrif í ctrl_meas, config er skrifað í Sleep Mode.
+        const uint8_t config[6] = {BME280_CTRL_HUMIDITY, CTRL_HUMIDITY_VALUE,
+                                   BME280_CONFIG, CONFIG_VALUE,
+                                   BME280_CTRL_MEASURE, CTRL_MEASURE_VALUE};
+        return _bus->write(ADDRESS, config, 6, false, _bus->transfer_timeout_us(6)) == 6;
+    }
+
+    /**
+     * @brief Les og leiðréttir þær rásir sem eru mældar, BURST_LENGTH bæti frá BURST_START.
+     * @return \c True ef aflestur tekst, \c false ef samskipti brugðust eða engin mæling
+     *         hefur verið gerð síðan skynjarinn ræsti sig (hitastig 0x80000).
+     */
+    bool read(void) {
+        uint8_t data[BURST_LENGTH];
+        TraceSpan span(TRACE_BME280_READ, ADDRESS, _clock);
+        if (!read_registers(BURST_START, BURST_LENGTH, data, &span)) return span.finish(false);
+
+        const uint8_t* t = data + ((OSRS_P != BME280::OVERSAMPLING_RATE_SKIPPED) ? 3 : 0);
+        int32_t raw_temperature = (t[0] << 12) | (t[1] << 4) | (t[2] >> 4);
+        if (raw_temperature == 0x80000) return span.finish(false);
+
+        int32_t t_fine;
+        _temperature = BME280::compensate_temperature(_comp_coeffs, raw_temperature, &t_fine);
+        if constexpr (OSRS_P != BME280::OVERSAMPLING_RATE_SKIPPED) {
+            int32_t raw_pressure = (data[0] << 12) | (data[1] << 4) | (data[2] >> 4);
+            _pressure = BME280::compensate_pressure(_comp_coeffs, t_fine, raw_pressure);
+        }
+        if constexpr (OSRS_H != BME280::OVERSAMPLING_RATE_SKIPPED) {
+            int32_t raw_humidity = (t[3] << 8) | t[4];
+            _humidity = BME280::compensate_humidity(_comp_coeffs, t_fine, raw_humidity);
+        }
+        return span.finish(true);
+    }
+
+    /**
+     * @brief Framkvæmir eina mælingu í Forced Mode og les niðurstöðurnar.
+     *        Bíður MEASUREMENT_TIME_US og les svo stöðugistið þar til mælingu lýkur.
+     * @return \c True ef mæling og aflestur tekst, annars \c false.
+     */
+    bool measure_once(void) {
+        static_assert(MODE == BME280::FORCED_MODE, "measure_once() er aðeins til í Forced Mode");
+
+        uint8_t command[2] = {BME280_CTRL_MEASURE, CTRL_MEASURE_FORCED};
+        if (_bus->write(ADDRESS, command, 2, false, _bus->transfer_timeout_us(2)) != 2) return false;
+
+        uint64_t deadline = _clock->time_us() + MAX_MEASUREMENT_TIME_US;
+        _clock->sleep_us(MEASUREMENT_TIME_US);
+        while (true) {
+            uint8_t status[1];
+            if (!read_registers(BME280_STATUS, 1, status)) return false;
+            if (!(status[0] & 0b1000)) return read();
+            if (_clock->time_us() > deadline) return false;
+            _clock->sleep_us(250);
+        }
+    }
+
+    /** @return Hitastig í hundraðshlutum úr gráðu [0,01 °C]. */
+    int32_t get_temperature_centidegrees(void) const { return _temperature; }
+
+    /** @return Loftþrýstingur á Q24.8 formi [Pa/256]. */
+    uint32_t get_pressure_q24_8(void) const {
+        static_assert(OSRS_P != BME280::OVERSAMPLING_RATE_SKIPPED, "loftþrýstingi er sleppt í þessum stillingum");
+        return _pressure;
+    }
+
+    /** @return Rakastig á Q22.10 formi [%RH/1024]. */
+    uint32_t get_humidity_q22_10(void) const {
+        static_assert(OSRS_H != BME280::OVERSAMPLING_RATE_SKIPPED, "rakastigi er sleppt í þessum stillingum");
+        return _humidity;
+    }
+
+    const BME280::BME_Comp_Coeff_t& get_compensation_coefficients(void) const { return _comp_coeffs; }
+
+private:
+    I2CBus* _bus;
+    Clock* _clock;
+    BME280::BME_Comp_Coeff_t _comp_coeffs;
+    int32_t _temperature;
+    uint32_t _pressure;
+    uint32_t _humidity;
+
+    /**
+     * @brief Les gisti með endurteknu upphafi, eins og BME280::read_registers().
+     */
+    bool read_registers(uint8_t register_address, uint8_t count, uint8_t* data, TraceSpan* span = nullptr) {
+        int result = _bus->write(ADDRESS, &register_address, 1, true, _bus->transfer_timeout_us(1));
+        if (span != nullptr) span->transfer(result, 1);
+        if (result != 1) return false;
+
+        result = _bus->read(ADDRESS, data, count, false, _bus->transfer_timeout_us(count));
+        if (span != nullptr) span->transfer(result, count);
+        return result == count;
+    }
+};
@@ -0,0 +1,42 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *     Lýsing:  Útfærsla á BME280FlashStore.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "BME280FlashStore.h"
+#include <string.h>
+#include <hardware/sync.h>
+#include <hardware/regs/addressmap.h>
+
+/**
+ * @brief Les gögnin beint úr flassminninu í gegnum XIP vistfangasviðið.
+ * @param blob Tekur við gögnunum.
+ * @return Alltaf \c true, BME280::init() athugar hvort gögnin séu gild.
+ */
+bool BME280FlashStore::load(BME280::CalibrationBlob& blob) {
+    memcpy(&blob, (const void*)(XIP_BASE + _offset), sizeof(blob));
+    return true;
+}
+
+/**
+ * @brief Eyðir geiranum og skrifar gögnin á fyrstu síðu hans.
+ * 
+ *        Rof eru óvirk á meðan, þar sem kóðinn er keyrður beint úr flassinu.
+ *        Ef hinn kjarninn er í gangi þarf hann að vera stöðvaður, t.d. með
+ *        multicore_lockout_start_blocking(), áður en þetta er kallað.
+ * @param blob Gögnin sem á að vista.
+ * @return \c True ef gögnin lesast rétt til baka, annars \c false.
+ */
+bool BME280FlashStore::save(const BME280::CalibrationBlob& blob) {
+    static_assert(sizeof(BME280::CalibrationBlob) <= FLASH_PAGE_SIZE, "Gögnin þurfa að komast fyrir á einni síðu");
+
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, &blob, sizeof(blob));
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(_offset, FLASH_SECTOR_SIZE);
+    flash_range_program(_offset, page, FLASH_PAGE_SIZE);
+    restore_interrupts(interrupts);
+
+    return memcmp((const void*)(XIP_BASE + _offset), &blob, sizeof(blob)) == 0;
+}
@@ -0,0 +1,34 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *     Lýsing:  Geymsla fyrir leiðréttingargögn BME280 í frátekna
+ *              geiranum aftast í QSPI flassminni RP2040.
+ *
+ *              Einn geiri (4 KB) geymir gögn eins skynjara. Ef fleiri
+ *              skynjarar eru notaðir fær hver sinn geira.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+#include <hardware/flash.h>
+#include "BME280.h"
+
+/** @brief Sjálfgefinn geiri: sá síðasti í flassminninu. */
+#define BME280_CALIBRATION_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
+/**
+ * @class BME280FlashStore
+ * @brief Vistar BME280::CalibrationBlob í flassminni.
+ */
+class BME280FlashStore : public BME280::CalibrationStore {
+public:
+    /**
+     * @brief Smiður fyrir geymsluna.
+     * @param flash_offset Hliðrun geirans frá upphafi flassminnis, þarf að vera margfeldi af FLASH_SECTOR_SIZE.
+     */
+    BME280FlashStore(uint32_t flash_offset = BME280_CALIBRATION_FLASH_OFFSET) : _offset(flash_offset) {}
+
+    bool load(BME280::CalibrationBlob& blob) override;
+    bool save(const BME280::CalibrationBlob& blob) override;
+
+private:
+    /** @brief Hliðrun geirans frá upphafi flassminnis. */
+    uint32_t _offset;
+};
@@ -0,0 +1,223 @@
+/*
+ *  Title: BusHealth
+ *  Description: Bounded retries, bus clear and per-device error counters
+ *               on top of any I2CBus.
+ */
+
+#include <string.h>
+#include "BusHealth.h"
+
+BusHealth::BusHealth(I2CBus *bus, Clock *clock, const RetryPolicy &policy) :
+    _bus(bus),
+    _clock(clock),
+    _policy(policy),
+    _devices(),
+    _overflow(),
+    _device_count(0),
+    _recoveries(0),
+    _consecutive_timeouts(0),
+    _recover_pending(false),
+    _prefix(),
+    _prefix_len(0),
+    _prefix_address(0),
+    _transfer(nullptr),
+    _callback(nullptr),
+    _context(nullptr),
+    _attempt(0),
+    _retry_pending(false),
+    _retry_at(0) {
+    if (_policy.attempts == 0) _policy.attempts = 1;
+}
+
+int BusHealth::write(uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint32_t timeout_us) {
+    DeviceHealth &device = entry(addr);
+    _prefix_len = 0;
+
+    int result;
+    for (uint8_t attempt = 0; ; attempt++) {
+        result = _bus->write(addr, src, len, nostop, timeout_us);
+        if (result == (int)len) break;
+        count_error(device, result);
+        run_recovery();
+        if (attempt + 1 >= _policy.attempts) break;
+        device.retries++;
+        backoff(attempt);
+    }
+
+    if (result == (int)len) {
+        count_success();
+        // The read that follows finishes this transfer
+        if (nostop && len <= BUS_HEALTH_MAX_PREFIX) {
+            memcpy(_prefix, src, len);
+            _prefix_len = len;
+            _prefix_address = addr;
+            return result;
+        }
+    }
+    finish(device, result == (int)len);
+    return result;
+}
+
+int BusHealth::read(uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us) {
+    DeviceHealth &device = entry(addr);
+    size_t prefix_len = (_prefix_address == addr) ? _prefix_len : 0;
+    _prefix_len = 0;
+
+    int result;
+    for (uint8_t attempt = 0; ; attempt++) {
+        result = 0;
+        // A retried read needs its register address again, the first try follows the caller's write
+        if (attempt > 0 && prefix_len > 0) {
+            int written = _bus->write(addr, _prefix, prefix_len, true, _bus->transfer_timeout_us(prefix_len));
+            if (written != (int)prefix_len) result = (written < 0) ? written : BUS_ERROR_GENERIC;
+        }
+        if (result == 0) result = _bus->read(addr, dst, len, nostop, timeout_us);
+        if (result == (int)len) break;
+        count_error(device, result);
+        run_recovery();
+        if (attempt + 1 >= _policy.attempts) break;
+        device.retries++;
+        backoff(attempt);
+    }
+
+    if (result == (int)len) count_success();
+    finish(device, result == (int)len);
+    return result;
+}
+
+bool BusHealth::start_transfer(I2CTransfer *transfer) {
+    if (busy()) return false;
+
+    _transfer = transfer;
+    _callback = transfer->callback;
+    _context = transfer->context;
+    _attempt = 0;
+    transfer->callback = on_transfer_complete;
+    transfer->context = this;
+
+    if (!_bus->start_transfer(transfer)) {
+        transfer->callback = _callback;
+        transfer->context = _context;
+        _transfer = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void BusHealth::poll(void) {
+    _bus->poll();
+    run_recovery();
+
+    if (_retry_pending && _clock->time_us() >= _retry_at && !_bus->busy()) {
+        _retry_pending = false;
+        if (!_bus->start_transfer(_transfer)) {
+            _transfer->result = BUS_ERROR_GENERIC;
+            _transfer->done = true;
+            _attempt = _policy.attempts;
+            complete();
+        }
+    }
+}
+
+bool BusHealth::busy(void) {
+    return _transfer != nullptr || _bus->busy();
+}
+
+bool BusHealth::recover(void) {
+    _recoveries++;
+    _consecutive_timeouts = 0;
+    _recover_pending = false;
+    return _bus->recover();
+}
+
+const DeviceHealth *BusHealth::device(uint8_t address) const {
+    for (int i = 0; i < _device_count; i++) {
+        if (_devices[i].address == address) return &_devices[i];
+    }
+    return nullptr;
+}
+
+void BusHealth::reset_counters(void) {
+    for (int i = 0; i < _device_count; i++) {
+        uint8_t address = _devices[i].address;
+        _devices[i] = DeviceHealth();
+        _devices[i].address = address;
+    }
+    _overflow = DeviceHealth();
+    _recoveries = 0;
+}
+
+DeviceHealth &BusHealth::entry(uint8_t address) {
+    for (int i = 0; i < _device_count; i++) {
+        if (_devices[i].address == address) return _devices[i];
+    }
+    if (_device_count == BUS_HEALTH_MAX_DEVICES) return _overflow;
+    DeviceHealth &device = _devices[_device_count++];
+    device.address = address;
+    return device;
+}
+
+void BusHealth::count_error(DeviceHealth &device, int result) {
+    if (result == BUS_ERROR_TIMEOUT) {
+        device.timeouts++;
+        if (++_consecutive_timeouts >= _policy.recover_after && _policy.recover_after > 0) _recover_pending = true;
+    } else {
+        // A NAK needs a working bus, only this device is in trouble
+        device.naks++;
+        _consecutive_timeouts = 0;
+    }
+}
+
+void BusHealth::count_success(void) {
+    _consecutive_timeouts = 0;
+}
+
+void BusHealth::finish(DeviceHealth &device, bool success) {
+    device.transfers++;
+    if (success) {
+        device.consecutive_failures = 0;
+    } else {
+        device.failures++;
+        device.consecutive_failures++;
+    }
+}
+
+/// @brief Clear the bus if enough timeouts were counted, never while a transfer is on it
+void BusHealth::run_recovery(void) {
+    if (_recover_pending && !_bus->busy()) recover();
+}
+
+void BusHealth::backoff(uint8_t attempt) {
+    _clock->sleep_us((uint64_t)_policy.backoff_us << attempt);
+}
+
+/// @brief An attempt of the asynchronous transfer ended, retry it or hand it back to its owner
+void BusHealth::complete(void) {
+    I2CTransfer *transfer = _transfer;
+    DeviceHealth &device = entry(transfer->address);
+    bool success = (transfer->result == (int)(transfer->tx_len + transfer->rx_len));
+
+    if (success) {
+        count_success();
+    } else if (_attempt < _policy.attempts) {
+        count_error(device, transfer->result);
+        if (++_attempt < _policy.attempts) {
+            // Started again from poll() once the backoff has passed
+            device.retries++;
+            transfer->done = false;
+            _retry_at = _clock->time_us() + ((uint64_t)_policy.backoff_us << (_attempt - 1));
+            _retry_pending = true;
+            return;
+        }
+    }
+
+    finish(device, success);
+    transfer->callback = _callback;
+    transfer->context = _context;
+    _transfer = nullptr;
+    if (transfer->callback != nullptr) transfer->callback(transfer);
+}
+
+void BusHealth::on_transfer_complete(I2CTransfer *transfer) {
+    ((BusHealth *)transfer->context)->complete();
+}
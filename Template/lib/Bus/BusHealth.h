@@ -0,0 +1,95 @@
+/*
+ *  Title: BusHealth
+ *  Description: I2CBus wrapper that keeps one flaky device from stalling
+ *               the bus. Failed transfers are retried a bounded number of
+ *               times with exponential backoff, consecutive timeouts (a
+ *               device holding SDA low) trigger the bus clear of the
+ *               wrapped controller, and every device address gets its own
+ *               error counters.
+ *
+ *               A register address written without STOP is remembered,
+ *               so a read that fails after the repeated start is retried
+ *               together with its address write.
+ */
+#pragma once
+#include "I2CBus.h"
+
+#define BUS_HEALTH_MAX_DEVICES 8
+#define BUS_HEALTH_MAX_PREFIX 4     // Longest nostop write replayed before a retried read
+
+struct RetryPolicy {
+    uint8_t attempts;           // Tries per transfer, the first one included
+    uint32_t backoff_us;        // Wait before the first retry, doubled for every further retry
+    uint8_t recover_after;      // Consecutive timeouts on the bus before recover() is called
+};
+
+static const RetryPolicy DEFAULT_RETRY_POLICY = {3, 200, 2};
+
+struct DeviceHealth {
+    uint8_t address;
+    uint32_t transfers;             // Transfers finished, retries not counted
+    uint32_t failures;              // Transfers that failed after all attempts
+    uint32_t retries;               // Attempts after the first one
+    uint32_t naks;                  // Attempts that ended in BUS_ERROR_GENERIC
+    uint32_t timeouts;              // Attempts that ended in BUS_ERROR_TIMEOUT
+    uint32_t consecutive_failures;  // Failed transfers since the last success
+};
+
+class BusHealth : public I2CBus {
+public:
+    BusHealth(I2CBus *bus, Clock *clock, const RetryPolicy &policy = DEFAULT_RETRY_POLICY);
+
+    int write(uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint32_t timeout_us) override;
+    int read(uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us) override;
+
+    bool start_transfer(I2CTransfer *transfer) override;
+    void poll(void) override;
+    bool busy(void) override;
+
+    uint32_t baudrate(void) override { return _bus->baudrate(); }
+    bool recover(void) override;
+
+    ///@brief Counters of one device
+    ///@return nullptr if nothing was sent to the address yet
+    const DeviceHealth *device(uint8_t address) const;
+    int device_count(void) const { return _device_count; }
+    const DeviceHealth &device_at(int index) const { return _devices[index]; }
+
+    ///@brief Number of times the bus was cleared
+    uint32_t recoveries(void) const { return _recoveries; }
+    void reset_counters(void);
+
+private:
+    I2CBus *_bus;
+    Clock *_clock;
+    RetryPolicy _policy;
+
+    DeviceHealth _devices[BUS_HEALTH_MAX_DEVICES];
+    DeviceHealth _overflow;     // Shared by addresses beyond BUS_HEALTH_MAX_DEVICES
+    int _device_count;
+    uint32_t _recoveries;
+    uint8_t _consecutive_timeouts;
+    bool _recover_pending;
+
+    // Register address written without STOP, replayed before a retried read
+    uint8_t _prefix[BUS_HEALTH_MAX_PREFIX];
+    size_t _prefix_len;
+    uint8_t _prefix_address;
+
+    // Asynchronous transfer in flight, with the owner's callback
+    I2CTransfer *_transfer;
+    I2CTransfer::Callback _callback;
+    void *_context;
+    uint8_t _attempt;
+    bool _retry_pending;
+    uint64_t _retry_at;
+
+    DeviceHealth &entry(uint8_t address);
+    void count_error(DeviceHealth &device, int result);
+    void count_success(void);
+    void finish(DeviceHealth &device, bool success);
+    void run_recovery(void);
+    void backoff(uint8_t attempt);
+    void complete(void);
+    static void on_transfer_complete(I2CTransfer *transfer);
+};
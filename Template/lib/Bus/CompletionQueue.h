@@ -0,0 +1,48 @@
+/*
+ *  Title: CompletionQueue
+ *  Description: Ring of finished asynchronous transfers, filled from an
+ *               interrupt handler and emptied by I2CBus::poll(). One
+ *               producer and one consumer, so the indices need no lock.
+ *
+ *               One slot is always left empty to tell a full ring from an
+ *               empty one, so it holds SIZE - 1 transfers. A bus must not
+ *               start a transfer while full() is true: its completion would
+ *               have nowhere to go and its callback would be lost.
+ */
+#pragma once
+#include <stdint.h>
+#include "I2CBus.h"
+
+template <uint8_t SIZE>
+class CompletionQueue {
+public:
+    static_assert(SIZE >= 2, "one slot is always kept empty");
+
+    CompletionQueue() : _head(0), _tail(0) {}
+
+    bool empty(void) const { return _head == _tail; }
+    bool full(void) const { return (uint8_t)((_head + 1) % SIZE) == _tail; }
+
+    ///@brief Queue a finished transfer, from the producer side only
+    ///@return False if the queue is full, the transfer is then not queued
+    bool push(I2CTransfer *transfer) {
+        if (full()) return false;
+        _entries[_head] = transfer;
+        _head = (_head + 1) % SIZE;
+        return true;
+    }
+
+    ///@brief Oldest finished transfer, from the consumer side only
+    ///@return The transfer, nullptr if the queue is empty
+    I2CTransfer *pop(void) {
+        if (empty()) return nullptr;
+        I2CTransfer *transfer = _entries[_tail];
+        _tail = (_tail + 1) % SIZE;
+        return transfer;
+    }
+
+private:
+    I2CTransfer *_entries[SIZE];
+    volatile uint8_t _head;
+    volatile uint8_t _tail;
+};
@@ -0,0 +1,37 @@
+/*
+ *  Title: I2CBus
+ *  Description: Blocking fallback for the asynchronous transfer interface
+ *               and the length-derived transfer timeout.
+ */
+
+#include "I2CBus.h"
+
+bool I2CBus::start_transfer(I2CTransfer *transfer) {
+    if (transfer->tx_len + transfer->rx_len == 0) return false;
+
+    transfer->done = false;
+    int result = 0;
+    if (transfer->tx_len > 0) {
+        int written = write(transfer->address, transfer->tx, transfer->tx_len,
+                            transfer->rx_len > 0, transfer->timeout_us);
+        result = (written == (int)transfer->tx_len) ? written : (written < 0 ? written : BUS_ERROR_GENERIC);
+    }
+    if (result >= 0 && transfer->rx_len > 0) {
+        int received = read(transfer->address, transfer->rx, transfer->rx_len, false, transfer->timeout_us);
+        result = (received == (int)transfer->rx_len) ? result + received : (received < 0 ? received : BUS_ERROR_GENERIC);
+    }
+
+    transfer->result = result;
+    transfer->done = true;
+    if (transfer->callback != nullptr) transfer->callback(transfer);
+    return true;
+}
+
+
+uint32_t I2CBus::transfer_timeout_us(size_t len, uint32_t stretch_us) {
+    // START, two address bytes (write then repeated start), payload, STOP
+    uint64_t clocks = 1 + 2 * 9 + 9 * (uint64_t)len + 1;
+    uint32_t rate = baudrate();
+    uint64_t wire_us = (clocks * 1000000 + rate - 1) / rate;
+    return (uint32_t)(2 * wire_us) + stretch_us + BUS_TIMEOUT_SLACK_US;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+/*
+ *  Title: I2CBus
+ *  Description: Transport and clock interfaces used by the sensor drivers.
+ *               The drivers never call the Pico SDK directly, so they can be
+ *               built against the hardware (PicoBus.h) or against a simulated
+ *               register model on a host machine (host/sim). Register
+ *               devices on SPI use the same interface through SPIRegisterBus
+ *               (SPIBus.h).
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Same values as PICO_ERROR_GENERIC and PICO_ERROR_TIMEOUT so a hardware
+// implementation can pass the SDK return codes straight through.
+#define BUS_ERROR_GENERIC -1    // Address NAK or other bus error
+#define BUS_ERROR_TIMEOUT -2    // Transfer did not finish in time
+
+#define BUS_TIMEOUT_SLACK_US 500        // Added to every length-derived timeout for interrupt and FIFO latency
+
+/**
+ * @class Clock
+ * @brief Monotonic time source and delay used by the drivers.
+ */
+class Clock {
+public:
+    virtual ~Clock() {}
+
+    ///@brief Microseconds since boot (or since the start of a simulation)
+    virtual uint64_t time_us(void) = 0;
+
+    ///@brief Block for the given number of microseconds
+    virtual void sleep_us(uint64_t us) = 0;
+
+    ///@brief Block for the given number of milliseconds
+    void sleep_ms(uint32_t ms) { sleep_us((uint64_t)ms * 1000); }
+};
+
+/**
+ * @brief One asynchronous combined transaction. The tx bytes are written
+ *        first, then, if rx_len is non-zero, rx_len bytes are read after a
+ *        repeated start. The transaction always ends with a STOP.
+ *
+ *        The transfer must stay alive until it completes. Completion is
+ *        reported through done/result and the callback, which runs from
+ *        I2CBus::poll() (never from an interrupt).
+ */
+struct I2CTransfer {
+    typedef void (*Callback)(I2CTransfer *transfer);
+
+    uint8_t address;        // 7-bit device address
+    const uint8_t *tx;      // Bytes to write, may be nullptr if tx_len is 0
+    size_t tx_len;
+    uint8_t *rx;            // Buffer for the bytes read, may be nullptr if rx_len is 0
+    size_t rx_len;
+    uint32_t timeout_us;    // Timeout for the whole transaction
+    Callback callback;      // Called on completion, may be nullptr
+    void *context;          // Free for the owner of the transfer
+
+    volatile bool done;     // Set when the transfer has completed or failed
+    int result;             // tx_len + rx_len on success, otherwise a BUS_ERROR_* code
+};
+
+/**
+ * @class I2CBus
+ * @brief One I2C controller. Semantics follow i2c_write_timeout_us and
+ *        i2c_read_timeout_us: the return value is the number of bytes
+ *        transferred, or BUS_ERROR_GENERIC / BUS_ERROR_TIMEOUT.
+ */
+class I2CBus {
+public:
+    virtual ~I2CBus() {}
+
+    ///@brief Write bytes to a device
+    ///@param addr 7-bit device address
+    ///@param src Data to write
+    ///@param len Number of bytes to write
+    ///@param nostop If true the bus is kept (no STOP), so the next transfer begins with a repeated start
+    ///@param timeout_us Timeout for the whole transfer
+    ///@return Number of bytes written, or a negative BUS_ERROR_* code
+    virtual int write(uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint32_t timeout_us) = 0;
+
+    ///@brief Read bytes from a device
+    ///@param addr 7-bit device address
+    ///@param dst Buffer that receives the data
+    ///@param len Number of bytes to read
+    ///@param nostop If true the bus is kept (no STOP), so the next transfer begins with a repeated start
+    ///@param timeout_us Timeout for the whole transfer
+    ///@return Number of bytes read, or a negative BUS_ERROR_* code
+    virtual int read(uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us) = 0;
+
+    ///@brief Start an asynchronous transfer
+    ///       The default implementation runs the transfer to completion with
+    ///       write() and read() and calls the callback before returning.
+    ///@param transfer The transfer, owned by the caller until it is done
+    ///@return True if the transfer was started, false if the bus is busy or the transfer is invalid
+    virtual bool start_transfer(I2CTransfer *transfer);
+
+    ///@brief Check for timeouts and run the callbacks of completed transfers
+    virtual void poll(void) {}
+
+    ///@brief True while an asynchronous transfer is in flight
+    virtual bool busy(void) { return false; }
+
+    ///@brief Nominal SCL frequency in Hz, the default is the slowest standard mode
+    virtual uint32_t baudrate(void) { return 100000; }
+
+    ///@brief Free a bus held low by a device (9 SCL pulses and a STOP) and re-initialise the controller
+    ///@return True if the bus is idle afterwards, false if it is still held or recovery is not supported
+    virtual bool recover(void) { return false; }
+
+    ///@brief Timeout for one transfer derived from its length instead of a fixed worst case
+    ///       Twice the time on the wire plus BUS_TIMEOUT_SLACK_US, so a device that
+    ///       does not answer fails the transfer in about a millisecond.
+    ///@param len Payload bytes, write and read part together
+    ///@param stretch_us Longest clock stretching the device is allowed
+    ///@return Timeout in microseconds
+    uint32_t transfer_timeout_us(size_t len, uint32_t stretch_us = 0);
+};
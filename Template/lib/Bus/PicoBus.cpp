@@ -0,0 +1,64 @@
+/*
+ *  Title: PicoBus
+ *  Description: I2CBus and Clock implemented on top of the Pico SDK.
+ */
+
+#include <pico/time.h>
+#include <hardware/gpio.h>
+#include "PicoBus.h"
+
+int PicoI2CBus::write(uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint32_t timeout_us) {
+    return i2c_write_timeout_us(_i2c, addr, src, len, nostop, timeout_us);
+}
+
+int PicoI2CBus::read(uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us) {
+    return i2c_read_timeout_us(_i2c, addr, dst, len, nostop, timeout_us);
+}
+
+/// @brief Bus clear as in the I2C specification, section 3.1.16.
+/// SDA and SCL are driven open drain by hand: low through the output,
+/// released by switching the pin to input and letting the pull-up take it.
+bool PicoI2CBus::recover(void) {
+    if (_sda < 0 || _scl < 0) return false;
+
+    uint32_t half_period_us = 500000 / _baudrate + 1;
+    i2c_deinit(_i2c);
+    gpio_set_function(_sda, GPIO_FUNC_SIO);
+    gpio_set_function(_scl, GPIO_FUNC_SIO);
+    gpio_put(_sda, 0);
+    gpio_put(_scl, 0);
+    gpio_set_dir(_sda, GPIO_IN);
+    gpio_set_dir(_scl, GPIO_IN);
+    busy_wait_us(half_period_us);
+
+    // Up to 9 clocks, until the device holding SDA has shifted out its byte
+    for (int i = 0; i < 9 && !gpio_get(_sda); i++) {
+        gpio_set_dir(_scl, GPIO_OUT);
+        busy_wait_us(half_period_us);
+        gpio_set_dir(_scl, GPIO_IN);
+        busy_wait_us(half_period_us);
+    }
+
+    // STOP: SDA rises while SCL is high
+    gpio_set_dir(_scl, GPIO_OUT);
+    gpio_set_dir(_sda, GPIO_OUT);
+    busy_wait_us(half_period_us);
+    gpio_set_dir(_scl, GPIO_IN);
+    busy_wait_us(half_period_us);
+    gpio_set_dir(_sda, GPIO_IN);
+    busy_wait_us(half_period_us);
+    bool idle = gpio_get(_sda) && gpio_get(_scl);
+
+    i2c_init(_i2c, _baudrate);
+    gpio_set_function(_sda, GPIO_FUNC_I2C);
+    gpio_set_function(_scl, GPIO_FUNC_I2C);
+    return idle;
+}
+
+uint64_t PicoClock::time_us(void) {
+    return time_us_64();
+}
+
+void PicoClock::sleep_us(uint64_t us) {
+    ::sleep_us(us);
+}
@@ -0,0 +1,36 @@
+/*
+ *  Title: PicoBus
+ *  Description: I2CBus and Clock implemented on top of the Pico SDK.
+ */
+#pragma once
+#include <hardware/i2c.h>
+#include "I2CBus.h"
+
+class PicoI2CBus : public I2CBus {
+public:
+    ///@param i2c The controller, set up by i2c_init() with the same baudrate
+    ///@param baudrate SCL frequency given to i2c_init()
+    PicoI2CBus(i2c_inst_t *i2c, uint32_t baudrate = 400000) : _i2c(i2c), _baudrate(baudrate), _sda(-1), _scl(-1) {}
+
+    int write(uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint32_t timeout_us) override;
+    int read(uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us) override;
+
+    uint32_t baudrate(void) override { return _baudrate; }
+
+    ///@brief Pins used by recover() to clock the bus by hand, without them recover() fails
+    void set_pins(int sda, int scl) { _sda = sda; _scl = scl; }
+    bool recover(void) override;
+
+    i2c_inst_t *instance(void) { return _i2c; }
+private:
+    i2c_inst_t *_i2c;
+    uint32_t _baudrate;
+    int _sda;
+    int _scl;
+};
+
+class PicoClock : public Clock {
+public:
+    uint64_t time_us(void) override;
+    void sleep_us(uint64_t us) override;
+};
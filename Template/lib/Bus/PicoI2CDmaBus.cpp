@@ -0,0 +1,180 @@
+/*
+ *  Title: PicoI2CDmaBus
+ *  Description: I2CBus with asynchronous transfers moved by DMA.
+ */
+
+#include <pico/time.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
+#include "PicoI2CDmaBus.h"
+
+PicoI2CDmaBus *PicoI2CDmaBus::_instances[2] = {nullptr, nullptr};
+
+PicoI2CDmaBus::PicoI2CDmaBus(i2c_inst_t *i2c, uint32_t baudrate) :
+    PicoI2CBus(i2c, baudrate),
+    _tx_channel(-1),
+    _rx_channel(-1),
+    _active(nullptr),
+    _started_at(0) {}
+
+void PicoI2CDmaBus::begin(void) {
+    unsigned index = i2c_hw_index(instance());
+
+    _tx_channel = dma_claim_unused_channel(true);
+    _rx_channel = dma_claim_unused_channel(true);
+    setup_controller();
+
+    _instances[index] = this;
+    unsigned irq = (index == 0) ? I2C0_IRQ : I2C1_IRQ;
+    irq_set_exclusive_handler(irq, (index == 0) ? i2c0_irq_handler : i2c1_irq_handler);
+    irq_set_enabled(irq, true);
+}
+
+/// @brief DMA handshake and interrupt mask, lost whenever i2c_init() resets the controller
+void PicoI2CDmaBus::setup_controller(void) {
+    i2c_hw_t *hw = i2c_get_hw(instance());
+
+    // DREQ as soon as there is room in the TX FIFO or one byte in the RX FIFO
+    hw->dma_tdlr = 0;
+    hw->dma_rdlr = 0;
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+
+    // The interrupts are only unmasked while an asynchronous transfer is in
+    // flight, the blocking SDK functions watch the same raw status bits
+    hw->intr_mask = 0;
+}
+
+bool PicoI2CDmaBus::recover(void) {
+    // A transfer still in flight fails, its callback runs from the next poll()
+    uint32_t interrupts = save_and_disable_interrupts();
+    if (_active != nullptr) finish(BUS_ERROR_TIMEOUT);
+    restore_interrupts(interrupts);
+
+    bool idle = PicoI2CBus::recover();
+    if (_tx_channel >= 0) setup_controller();
+    return idle;
+}
+
+bool PicoI2CDmaBus::start_transfer(I2CTransfer *transfer) {
+    if (_active != nullptr || _tx_channel < 0) return false;
+    // Completions not yet taken by poll() fill the queue, this one would be lost
+    if (_completed.full()) return false;
+    if (transfer->tx_len + transfer->rx_len == 0) return false;
+    if (transfer->tx_len > PICO_I2C_DMA_MAX_LENGTH || transfer->rx_len > PICO_I2C_DMA_MAX_LENGTH) return false;
+
+    i2c_hw_t *hw = i2c_get_hw(instance());
+
+    size_t count = 0;
+    for (size_t i = 0; i < transfer->tx_len; i++) {
+        _commands[count++] = transfer->tx[i];
+    }
+    for (size_t i = 0; i < transfer->rx_len; i++) {
+        uint32_t command = I2C_IC_DATA_CMD_CMD_BITS;
+        if (i == 0 && transfer->tx_len > 0) command |= I2C_IC_DATA_CMD_RESTART_BITS;
+        _commands[count++] = command;
+    }
+    _commands[count - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    transfer->done = false;
+    transfer->result = 0;
+
+    // The target address can only be changed while the controller is disabled
+    hw->enable = 0;
+    hw->tar = transfer->address;
+    hw->enable = 1;
+
+    (void)hw->clr_intr;
+    _active = transfer;
+    _started_at = time_us_64();
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    if (transfer->rx_len > 0) {
+        dma_channel_config rx_config = dma_channel_get_default_config(_rx_channel);
+        channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+        channel_config_set_read_increment(&rx_config, false);
+        channel_config_set_write_increment(&rx_config, true);
+        channel_config_set_dreq(&rx_config, i2c_get_dreq(instance(), false));
+        dma_channel_configure(_rx_channel, &rx_config, transfer->rx, &hw->data_cmd, transfer->rx_len, true);
+    }
+
+    dma_channel_config tx_config = dma_channel_get_default_config(_tx_channel);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&tx_config, true);
+    channel_config_set_write_increment(&tx_config, false);
+    channel_config_set_dreq(&tx_config, i2c_get_dreq(instance(), true));
+    dma_channel_configure(_tx_channel, &tx_config, &hw->data_cmd, _commands, count, true);
+
+    return true;
+}
+
+void PicoI2CDmaBus::poll(void) {
+    // Timeout, abort the controller. The TX_ABRT that follows finds no
+    // active transfer and is only cleared.
+    uint32_t interrupts = save_and_disable_interrupts();
+    I2CTransfer *active = _active;
+    if (active != nullptr && time_us_64() - _started_at > active->timeout_us) {
+        finish(BUS_ERROR_TIMEOUT);
+        i2c_get_hw(instance())->enable |= I2C_IC_ENABLE_ABORT_BITS;
+    }
+    restore_interrupts(interrupts);
+
+    I2CTransfer *transfer;
+    while ((transfer = _completed.pop()) != nullptr) {
+        if (transfer->callback != nullptr) transfer->callback(transfer);
+    }
+}
+
+/// @brief End the active transfer and queue it for poll(). Runs with the I2C interrupt masked or from it.
+void PicoI2CDmaBus::finish(int result) {
+    I2CTransfer *transfer = _active;
+    i2c_get_hw(instance())->intr_mask = 0;
+
+    if (dma_channel_is_busy(_tx_channel)) dma_channel_abort(_tx_channel);
+    if (dma_channel_is_busy(_rx_channel)) dma_channel_abort(_rx_channel);
+
+    transfer->result = result;
+    transfer->done = true;
+    _active = nullptr;
+
+    // Has room, start_transfer() does not start a transfer while the queue is full
+    _completed.push(transfer);
+}
+
+void PicoI2CDmaBus::irq_handler(void) {
+    i2c_hw_t *hw = i2c_get_hw(instance());
+    uint32_t status = hw->intr_stat;
+
+    if (status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // NAK or arbitration loss. The controller flushes the TX FIFO and
+        // holds it until the abort is cleared, so stop the DMA first.
+        if (_active != nullptr) finish(BUS_ERROR_GENERIC);
+        (void)hw->clr_tx_abrt;
+        (void)hw->clr_stop_det;
+        hw->intr_mask = 0;
+        return;
+    }
+
+    if (status & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        (void)hw->clr_stop_det;
+        I2CTransfer *transfer = _active;
+        if (transfer == nullptr) return;
+
+        // The last byte is in the RX FIFO at STOP, the DMA moves it within
+        // a few cycles
+        if (transfer->rx_len > 0) {
+            uint32_t spins = 0;
+            while (dma_channel_is_busy(_rx_channel) && spins++ < 1000) {}
+        }
+        bool complete = !dma_channel_is_busy(_tx_channel) && !dma_channel_is_busy(_rx_channel);
+        finish(complete ? (int)(transfer->tx_len + transfer->rx_len) : BUS_ERROR_GENERIC);
+    }
+}
+
+void PicoI2CDmaBus::i2c0_irq_handler(void) {
+    if (_instances[0] != nullptr) _instances[0]->irq_handler();
+}
+
+void PicoI2CDmaBus::i2c1_irq_handler(void) {
+    if (_instances[1] != nullptr) _instances[1]->irq_handler();
+}
@@ -0,0 +1,58 @@
+/*
+ *  Title: PicoI2CDmaBus
+ *  Description: I2CBus with asynchronous transfers moved by DMA. The TX
+ *               channel feeds IC_DATA_CMD with one command word per byte
+ *               (write data, read requests with RESTART/STOP flags), the RX
+ *               channel drains the receive FIFO into the caller's buffer.
+ *               STOP_DET and TX_ABRT interrupts mark the end of a transfer
+ *               and put it on a completion queue that poll() empties, so
+ *               the callbacks run in thread context.
+ *
+ *               poll() has to run between transfers. The queue holds
+ *               COMPLETION_QUEUE_SIZE - 1 finished transfers, and
+ *               start_transfer() returns false, like a busy bus, while it
+ *               is full, instead of losing a completion.
+ *
+ *               The blocking write()/read() of PicoI2CBus are still
+ *               available while no asynchronous transfer is in flight.
+ */
+#pragma once
+#include "PicoBus.h"
+#include "CompletionQueue.h"
+
+// Longest write or read part of one asynchronous transfer
+#define PICO_I2C_DMA_MAX_LENGTH 32
+
+class PicoI2CDmaBus : public PicoI2CBus {
+public:
+    PicoI2CDmaBus(i2c_inst_t *i2c, uint32_t baudrate = 400000);
+
+    ///@brief Claim the DMA channels and install the I2C interrupt handler
+    ///       Call once after i2c_init().
+    void begin(void);
+
+    bool start_transfer(I2CTransfer *transfer) override;
+    void poll(void) override;
+    bool busy(void) override { return _active != nullptr; }
+    bool recover(void) override;
+
+private:
+    static const uint8_t COMPLETION_QUEUE_SIZE = 4;
+
+    int _tx_channel;
+    int _rx_channel;
+    I2CTransfer *volatile _active;
+    uint64_t _started_at;
+    uint32_t _commands[2 * PICO_I2C_DMA_MAX_LENGTH];
+
+    // Written by the interrupt handler, read by poll()
+    CompletionQueue<COMPLETION_QUEUE_SIZE> _completed;
+
+    void setup_controller(void);
+    void irq_handler(void);
+    void finish(int result);
+
+    static PicoI2CDmaBus *_instances[2];
+    static void i2c0_irq_handler(void);
+    static void i2c1_irq_handler(void);
+};
@@ -0,0 +1,30 @@
+/*
+ *  Title: PicoSPIBus
+ *  Description: SPIBus implemented on top of the Pico SDK.
+ */
+
+#include <hardware/gpio.h>
+#include "PicoSPIBus.h"
+
+uint32_t PicoSPIBus::init(void) {
+    _baudrate = spi_init(_spi, _baudrate);
+    return _baudrate;
+}
+
+void PicoSPIBus::init_pins(void) {
+    for (size_t i = 0; i < _cs_count; i++) {
+        gpio_init(_cs_pins[i]);
+        gpio_put(_cs_pins[i], 1);
+        gpio_set_dir(_cs_pins[i], GPIO_OUT);
+    }
+}
+
+int PicoSPIBus::transfer(uint8_t cs, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) {
+    if (cs >= _cs_count) return BUS_ERROR_GENERIC;
+
+    gpio_put(_cs_pins[cs], 0);
+    if (tx_len > 0) spi_write_blocking(_spi, tx, tx_len);
+    if (rx_len > 0) spi_read_blocking(_spi, 0x00, rx, rx_len);
+    gpio_put(_cs_pins[cs], 1);
+    return (int)(tx_len + rx_len);
+}
@@ -0,0 +1,41 @@
+/*
+ *  Title: PicoSPIBus
+ *  Description: SPIBus implemented on top of the Pico SDK, with chip selects
+ *               driven from GPIO so any number of devices can share SCK,
+ *               MOSI and MISO.
+ */
+#pragma once
+#include <hardware/spi.h>
+#include "SPIBus.h"
+
+class PicoSPIBus : public SPIBus {
+public:
+    ///@param spi The controller, set up by init()
+    ///@param cs_pins Chip-select GPIO for each index, must outlive the bus
+    ///@param cs_count Number of chip selects
+    ///@param baudrate Requested SCK frequency, the BME280 takes up to 10 MHz
+    PicoSPIBus(spi_inst_t *spi, const uint8_t *cs_pins, size_t cs_count, uint32_t baudrate = 10000000) :
+        _spi(spi), _cs_pins(cs_pins), _cs_count(cs_count), _baudrate(baudrate) {}
+
+    ///@brief Start the controller with spi_init()
+    ///       spi_init() picks the nearest rate at or below the requested one.
+    ///       That rate is kept, so transfer timeouts follow the real SCK.
+    ///@return The SCK frequency actually set
+    uint32_t init(void);
+
+    ///@brief Set the chip-select pins up as outputs, all deselected (high)
+    ///       A BME280 switches to SPI for good at the first falling edge of
+    ///       CSB, so call this before the driver's init().
+    void init_pins(void);
+
+    int transfer(uint8_t cs, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) override;
+
+    uint32_t baudrate(void) override { return _baudrate; }
+
+    spi_inst_t *instance(void) { return _spi; }
+private:
+    spi_inst_t *_spi;
+    const uint8_t *_cs_pins;
+    size_t _cs_count;
+    uint32_t _baudrate;
+};
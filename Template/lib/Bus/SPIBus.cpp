@@ -0,0 +1,43 @@
+/*
+ *  Title: SPIBus
+ *  Description: I2CBus semantics for register devices on SPI.
+ */
+
+#include "SPIBus.h"
+
+#define SPI_READ 0x80                   // Bit 7 of the register byte: 1 read, 0 write
+
+/// Register writes go out as (register & 0x7F, value) pairs, up to
+/// SPI_REGISTER_BUS_PAIRS in one frame. A lone register byte only moves the
+/// pointer for the next read, no frame is sent for it.
+int SPIRegisterBus::write(uint8_t addr, const uint8_t *src, size_t len, bool, uint32_t) {
+    if (addr >= SPI_REGISTER_BUS_DEVICES) return BUS_ERROR_GENERIC;
+    if (len == 0) return 0;
+    if (len > 1 && (len & 1)) return BUS_ERROR_GENERIC;
+
+    _pointer[addr] = src[0];
+    uint8_t frame[2 * SPI_REGISTER_BUS_PAIRS];
+    for (size_t i = 0; i + 1 < len; ) {
+        size_t n = 0;
+        for (; n < sizeof(frame) && i + 1 < len; i += 2, n += 2) {
+            frame[n] = src[i] & ~SPI_READ;
+            frame[n + 1] = src[i + 1];
+        }
+        int result = _spi->transfer(addr, frame, n, nullptr, 0);
+        if (result < 0) return result;
+    }
+    return (int)len;
+}
+
+int SPIRegisterBus::read(uint8_t addr, uint8_t *dst, size_t len, bool, uint32_t) {
+    if (addr >= SPI_REGISTER_BUS_DEVICES) return BUS_ERROR_GENERIC;
+    if (len == 0) return 0;
+
+    uint8_t command = _pointer[addr] | SPI_READ;
+    int result = _spi->transfer(addr, &command, 1, dst, len);
+    if (result < 0) return result;
+
+    // The device auto-increments, as after an I2C burst
+    _pointer[addr] += (uint8_t)len;
+    return (int)len;
+}
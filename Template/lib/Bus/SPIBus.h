@@ -0,0 +1,62 @@
+/*
+ *  Title: SPIBus
+ *  Description: SPI controller interface, and SPIRegisterBus, which puts a
+ *               register device on SPI behind the I2CBus interface so the
+ *               same driver runs over either transport.
+ *
+ *               SPIRegisterBus follows the Bosch convention (BME280
+ *               datasheet, section 6.3): bit 7 of the register byte is 1 for
+ *               a read and 0 for a write. A read is the register byte
+ *               followed by a burst that auto-increments; a write is one or
+ *               more (register, value) pairs in one chip-select frame. The
+ *               I2C address given to the driver becomes the chip-select
+ *               index, so one controller carries as many sensors as there
+ *               are chip-select pins.
+ */
+#pragma once
+#include "I2CBus.h"
+
+#define SPI_REGISTER_BUS_DEVICES 8      // Chip selects an SPIRegisterBus keeps a register pointer for
+#define SPI_REGISTER_BUS_PAIRS 16       // (register, value) pairs sent per chip-select frame
+
+/**
+ * @class SPIBus
+ * @brief One SPI controller in mode 0 or 3, with chip selects by index.
+ */
+class SPIBus {
+public:
+    virtual ~SPIBus() {}
+
+    ///@brief One frame: chip select low, tx_len bytes out, then rx_len bytes in, chip select high
+    ///@param cs Chip-select index
+    ///@param tx Bytes to send, may be nullptr if tx_len is 0
+    ///@param tx_len Number of bytes to send
+    ///@param rx Buffer for the bytes received after tx, may be nullptr if rx_len is 0
+    ///@param rx_len Number of bytes to receive, 0x00 is clocked out meanwhile
+    ///@return tx_len + rx_len, or BUS_ERROR_GENERIC if there is no such chip select
+    virtual int transfer(uint8_t cs, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) = 0;
+
+    ///@brief SCK frequency in Hz
+    virtual uint32_t baudrate(void) { return 1000000; }
+};
+
+/**
+ * @class SPIRegisterBus
+ * @brief I2CBus semantics on an SPIBus, for the register drivers.
+ *        A one-byte write only sets the register pointer, as on I2C; the
+ *        read that follows sends it with bit 7 set. SPI has no
+ *        acknowledge, so a missing device shows up in the data (the
+ *        drivers check the chip ID) rather than as BUS_ERROR_GENERIC.
+ */
+class SPIRegisterBus : public I2CBus {
+public:
+    explicit SPIRegisterBus(SPIBus *spi) : _spi(spi), _pointer() {}
+
+    int write(uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint32_t timeout_us) override;
+    int read(uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us) override;
+
+    uint32_t baudrate(void) override { return _spi->baudrate(); }
+private:
+    SPIBus *_spi;
+    uint8_t _pointer[SPI_REGISTER_BUS_DEVICES];     // Next register to read, per chip select
+};
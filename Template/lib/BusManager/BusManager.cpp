@@ -0,0 +1,191 @@
+/*
+ *  Title: BusManager
+ *  Description: Earliest-deadline-first scheduling of sensor reads across
+ *               the I2C controllers.
+ */
+
+#include <math.h>
+#include "BusManager.h"
+
+BusManager::BusManager(Clock *clock) :
+    _clock(clock),
+    _buses(),
+    _bus_count(0),
+    _sensors(),
+    _sensor_count(0),
+    _callback(nullptr),
+    _context(nullptr) {}
+
+int BusManager::add_bus(I2CBus *bus) {
+    if (_bus_count == BUS_MANAGER_MAX_BUSES) return -1;
+    _buses[_bus_count] = bus;
+    return _bus_count++;
+}
+
+int BusManager::add_sensor(SensorTask *task, int bus, uint32_t period_us, uint32_t phase_us) {
+    if (_sensor_count == BUS_MANAGER_MAX_SENSORS || bus < 0 || bus >= _bus_count || period_us == 0) return -1;
+
+    Entry &entry = _sensors[_sensor_count];
+    entry.task = task;
+    entry.bus = (uint8_t)bus;
+    entry.active = false;
+    entry.period_us = period_us;
+    entry.phase_us = phase_us;
+    entry.release_us = _clock->time_us() + phase_us;
+    entry.consecutive_failures = 0;
+    entry.reinit_backoff_us = period_us;
+    entry.reinit_at = 0;
+    clear_stats(entry);
+    return _sensor_count++;
+}
+
+void BusManager::set_callback(SampleCallback callback, void *context) {
+    _callback = callback;
+    _context = context;
+}
+
+void BusManager::start(void) {
+    uint64_t now = _clock->time_us();
+    for (int i = 0; i < _sensor_count; i++) {
+        _sensors[i].release_us = now + _sensors[i].phase_us;
+    }
+    reset_stats();
+}
+
+void BusManager::poll(void) {
+    for (int b = 0; b < _bus_count; b++) _buses[b]->poll();
+
+    // Finish samples in progress
+    for (int i = 0; i < _sensor_count; i++) {
+        Entry &entry = _sensors[i];
+        if (!entry.active) continue;
+
+        Sample sample = {};
+        SensorTask::State state = entry.task->poll(sample);
+        if (state == SensorTask::TASK_PENDING) continue;
+
+        entry.active = false;
+        if (state == SensorTask::TASK_FAILED) {
+            entry.failures++;
+            entry.consecutive_failures++;
+            continue;
+        }
+        entry.consecutive_failures = 0;
+        sample.timestamp_us = _clock->time_us();
+        if (entry.samples == 0) entry.first_sample_us = sample.timestamp_us;
+        entry.last_sample_us = sample.timestamp_us;
+        entry.samples++;
+        if (_callback != nullptr) _callback(sample, _context);
+    }
+
+    uint64_t now = _clock->time_us();
+
+    // Releases that passed a whole period ago without a start are lost
+    for (int i = 0; i < _sensor_count; i++) {
+        Entry &entry = _sensors[i];
+        if (entry.active || now < entry.release_us + entry.period_us) continue;
+        uint64_t missed = (now - entry.release_us) / entry.period_us;
+        entry.overruns += (uint32_t)missed;
+        entry.release_us += missed * entry.period_us;
+    }
+
+    // On every idle controller start the released sensor with the earliest deadline
+    for (int b = 0; b < _bus_count; b++) {
+        if (_buses[b]->busy()) continue;
+
+        Entry *next = nullptr;
+        for (int i = 0; i < _sensor_count; i++) {
+            Entry &entry = _sensors[i];
+            if (entry.bus != b || entry.active || entry.release_us > now) continue;
+            if (next == nullptr || entry.release_us + entry.period_us < next->release_us + next->period_us) {
+                next = &entry;
+            }
+        }
+        if (next == nullptr) continue;
+
+        if (next->consecutive_failures >= BUS_MANAGER_REINIT_AFTER && now >= next->reinit_at) {
+            reinit(*next);
+            now = _clock->time_us();
+            continue;
+        }
+        if (!next->task->start()) continue;
+
+        uint32_t delay = (uint32_t)(now - next->release_us);
+        next->starts++;
+        next->jitter_sum += delay;
+        next->jitter_squares += (uint64_t)delay * delay;
+        if (delay > next->jitter_max) next->jitter_max = delay;
+
+        next->active = true;
+        next->release_us += next->period_us;
+    }
+}
+
+uint64_t BusManager::next_release_us(void) {
+    uint64_t next = UINT64_MAX;
+    for (int i = 0; i < _sensor_count; i++) {
+        if (!_sensors[i].active && _sensors[i].release_us < next) next = _sensors[i].release_us;
+    }
+    return next;
+}
+
+bool BusManager::busy(void) {
+    for (int i = 0; i < _sensor_count; i++) {
+        if (_sensors[i].active) return true;
+    }
+    return false;
+}
+
+/// @brief Set up a failing sensor again in place of its next sample. The bus is idle, so
+/// the blocking transfers of SensorTask::recover() do not collide with a DMA transfer.
+void BusManager::reinit(Entry &entry) {
+    entry.release_us += entry.period_us;
+    if (entry.task->recover()) {
+        entry.reinits++;
+        entry.consecutive_failures = 0;
+        entry.reinit_backoff_us = entry.period_us;
+        return;
+    }
+    entry.reinit_at = _clock->time_us() + entry.reinit_backoff_us;
+    entry.reinit_backoff_us = (entry.reinit_backoff_us > BUS_MANAGER_REINIT_MAX_BACKOFF_US / 2)
+                                  ? BUS_MANAGER_REINIT_MAX_BACKOFF_US : entry.reinit_backoff_us * 2;
+}
+
+SensorStats BusManager::stats(int sensor) {
+    SensorStats result = {};
+    if (sensor < 0 || sensor >= _sensor_count) return result;
+
+    const Entry &entry = _sensors[sensor];
+    result.samples = entry.samples;
+    result.failures = entry.failures;
+    result.overruns = entry.overruns;
+    result.reinits = entry.reinits;
+    if (entry.samples > 1 && entry.last_sample_us > entry.first_sample_us) {
+        result.rate_hz = (float)(entry.samples - 1) * 1e6f / (float)(entry.last_sample_us - entry.first_sample_us);
+    }
+    if (entry.starts > 0) {
+        double mean = (double)entry.jitter_sum / entry.starts;
+        double variance = (double)entry.jitter_squares / entry.starts - mean * mean;
+        result.jitter_mean_us = (float)mean;
+        result.jitter_stddev_us = (variance > 0) ? (float)sqrt(variance) : 0;
+        result.jitter_max_us = entry.jitter_max;
+    }
+    return result;
+}
+
+void BusManager::reset_stats(void) {
+    for (int i = 0; i < _sensor_count; i++) clear_stats(_sensors[i]);
+}
+
+void BusManager::clear_stats(Entry &entry) {
+    entry.samples = 0;
+    entry.failures = 0;
+    entry.overruns = 0;
+    entry.reinits = 0;
+    entry.first_sample_us = 0;
+    entry.last_sample_us = 0;
+    entry.starts = 0;
+    entry.jitter_sum = 0;
+    entry.jitter_squares = 0;
+    entry.jitter_max = 0;
+}
@@ -0,0 +1,114 @@
+/*
+ *  Title: BusManager
+ *  Description: Runs the sensors on one or more I2C controllers from one
+ *               non-blocking poll(). Each sensor is registered with its own
+ *               sample period and is released once per period. Whenever a
+ *               controller is idle the released sensor on it with the
+ *               earliest deadline (release + period) is started, so the
+ *               controllers work in parallel and the fastest sensors win
+ *               when a bus is contended.
+ *
+ *               Per sensor the manager measures the achieved sample rate
+ *               and the start jitter (start time minus release time).
+ *
+ *               A sensor that fails BUS_MANAGER_REINIT_AFTER samples in a
+ *               row is set up again with SensorTask::recover() in place of
+ *               its next sample. If that fails too the next attempt waits
+ *               twice as long, up to BUS_MANAGER_REINIT_MAX_BACKOFF_US, and
+ *               the sensor's regular samples keep failing fast meanwhile,
+ *               so the other sensors are not held up.
+ */
+#pragma once
+#include <I2CBus.h>
+#include <Sample.h>
+#include "SensorTask.h"
+
+#define BUS_MANAGER_MAX_BUSES 2
+#define BUS_MANAGER_MAX_SENSORS 8
+#define BUS_MANAGER_REINIT_AFTER 3                      // Failed samples in a row before a re-init
+#define BUS_MANAGER_REINIT_MAX_BACKOFF_US 60000000      // Longest wait between two failed re-inits
+
+struct SensorStats {
+    uint32_t samples;           // Samples delivered
+    uint32_t failures;          // Samples that failed on the bus
+    uint32_t overruns;          // Releases skipped because the sensor was still busy or the bus was taken
+    uint32_t reinits;           // Successful re-inits after repeated failures
+    float rate_hz;              // Achieved sample rate
+    float jitter_mean_us;       // Mean start delay after release
+    float jitter_stddev_us;     // Standard deviation of the start delay
+    uint32_t jitter_max_us;     // Largest start delay
+};
+
+class BusManager {
+public:
+    typedef void (*SampleCallback)(const Sample &sample, void *context);
+
+    BusManager(Clock *clock);
+
+    ///@brief Add a controller
+    ///@return Index for add_sensor(), or -1 if there is no room
+    int add_bus(I2CBus *bus);
+
+    ///@brief Add a sensor
+    ///@param task Adapter for the sensor driver
+    ///@param bus Index returned by add_bus() for the controller the sensor is on
+    ///@param period_us Sample period
+    ///@param phase_us Delay of the first release after start()
+    ///@return Sensor index for stats(), or -1 if there is no room
+    int add_sensor(SensorTask *task, int bus, uint32_t period_us, uint32_t phase_us = 0);
+
+    ///@brief Called from poll() for every sample, the timestamp is set by the manager
+    void set_callback(SampleCallback callback, void *context);
+
+    ///@brief Release every sensor, at now + its phase
+    void start(void);
+
+    ///@brief Advance all transfers and start the sensors that are due, never blocks
+    void poll(void);
+
+    ///@brief Earliest release time of an idle sensor, for sleeping between polls
+    uint64_t next_release_us(void);
+
+    ///@brief True while any sensor has a sample in progress
+    bool busy(void);
+
+    int sensor_count(void) const { return _sensor_count; }
+    SensorStats stats(int sensor);
+    void reset_stats(void);
+
+private:
+    struct Entry {
+        SensorTask *task;
+        uint8_t bus;
+        bool active;
+        uint32_t period_us;
+        uint32_t phase_us;
+        uint64_t release_us;
+
+        uint32_t consecutive_failures;
+        uint32_t reinit_backoff_us;
+        uint64_t reinit_at;
+
+        uint32_t samples;
+        uint32_t failures;
+        uint32_t overruns;
+        uint32_t reinits;
+        uint64_t first_sample_us;
+        uint64_t last_sample_us;
+        uint32_t starts;
+        uint64_t jitter_sum;
+        uint64_t jitter_squares;
+        uint32_t jitter_max;
+    };
+
+    Clock *_clock;
+    I2CBus *_buses[BUS_MANAGER_MAX_BUSES];
+    int _bus_count;
+    Entry _sensors[BUS_MANAGER_MAX_SENSORS];
+    int _sensor_count;
+    SampleCallback _callback;
+    void *_context;
+
+    void clear_stats(Entry &entry);
+    void reinit(Entry &entry);
+};
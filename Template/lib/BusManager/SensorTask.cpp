@@ -0,0 +1,69 @@
+/*
+ *  Title: SensorTask
+ *  Description: BusManager adapters for the BME280 and SCD30 drivers.
+ */
+
+#include "SensorTask.h"
+
+bool BME280Task::start(void) {
+    return _sensor->start_read();
+}
+
+SensorTask::State BME280Task::poll(Sample &sample) {
+    switch (_sensor->poll_read()) {
+        case BME280::MEASUREMENT_PENDING:
+            return TASK_PENDING;
+        case BME280::MEASUREMENT_FAILED:
+            return TASK_FAILED;
+        default:
+            break;
+    }
+    sample.sensor = SENSOR_BME280;
+    sample.channel = _channel;
+    sample.sequence = _sequence++;
+    fill_values(_sensor, sample);
+    return TASK_READY;
+}
+
+/// Calibration is read from the sensor again, the configuration in use is restored.
+bool BME280Task::recover(void) {
+    BME280::Config config = _sensor->get_config();
+    return _sensor->init() && _sensor->configure(config);
+}
+
+void BME280Task::fill_values(BME280 *sensor, Sample &sample) {
+    sample.values[0] = sensor->get_temperature_centidegrees();
+    sample.values[1] = (int32_t)sensor->get_pressure_q24_8();
+    sample.values[2] = (int32_t)sensor->get_humidity_q22_10();
+}
+
+bool SCD30Task::start(void) {
+    return _sensor->startRead();
+}
+
+SensorTask::State SCD30Task::poll(Sample &sample) {
+    switch (_sensor->pollRead()) {
+        case SCD30::READ_PENDING:
+            return TASK_PENDING;
+        case SCD30::READ_READY:
+            break;
+        default:
+            return TASK_FAILED;
+    }
+    sample.sensor = SENSOR_SCD30;
+    sample.channel = _channel;
+    sample.sequence = _sequence++;
+    fill_values(_sensor, sample);
+    return TASK_READY;
+}
+
+/// Soft reset and continuous measurement again, blocks for about 40 ms.
+bool SCD30Task::recover(void) {
+    return _sensor->init();
+}
+
+void SCD30Task::fill_values(const SCD30 *sensor, Sample &sample) {
+    sample.values[0] = (int32_t)(sensor->CO2 * 100.0f + 0.5f);
+    sample.values[1] = (int32_t)(sensor->temperature * 100.0f + (sensor->temperature < 0 ? -0.5f : 0.5f));
+    sample.values[2] = (int32_t)(sensor->relative_humidity * 100.0f + 0.5f);
+}
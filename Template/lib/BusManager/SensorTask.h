@@ -0,0 +1,77 @@
+/*
+ *  Title: SensorTask
+ *  Description: One sensor as seen by the BusManager: a job that takes one
+ *               sample with the asynchronous driver API and reports when it
+ *               is done. Adapters for the BME280 and SCD30 drivers.
+ */
+#pragma once
+#include <BME280.h>
+#include <SCD30.h>
+#include <Sample.h>
+
+class SensorTask {
+public:
+    enum State {
+        TASK_PENDING,   // Sample still in progress
+        TASK_READY,     // Sample filled in
+        TASK_FAILED     // Bus error, bad CRC or timeout
+    };
+
+    virtual ~SensorTask() {}
+
+    ///@brief Start taking one sample
+    ///@return False if it could not start now (bus busy), the manager tries again later
+    virtual bool start(void) = 0;
+
+    ///@brief Advance the sample started with start(), never blocks
+    ///@param sample Filled in when TASK_READY is returned
+    virtual State poll(Sample &sample) = 0;
+
+    ///@brief Bring the sensor back after repeated failures, with blocking transfers
+    ///@return True if the sensor answers and is set up again
+    virtual bool recover(void) { return false; }
+};
+
+/**
+ * @brief BME280 in Normal Mode, each sample is one asynchronous burst read
+ *        of the newest conversion. Configure the sensor so it converts at
+ *        least as often as the task is scheduled.
+ */
+class BME280Task : public SensorTask {
+public:
+    BME280Task(BME280 *sensor, uint8_t channel = 0) : _sensor(sensor), _channel(channel), _sequence(0) {}
+
+    bool start(void) override;
+    State poll(Sample &sample) override;
+    bool recover(void) override;
+
+    ///@brief Fixed-point sample values (0.01 °C, Pa Q24.8, %RH Q22.10) from the last read
+    static void fill_values(BME280 *sensor, Sample &sample);
+
+private:
+    BME280 *_sensor;
+    uint8_t _channel;
+    uint16_t _sequence;
+};
+
+/**
+ * @brief SCD30 in continuous measurement, each sample is an asynchronous
+ *        read (command, 4 ms delay, response). The bus is free during the
+ *        delay. Schedule it at the measurement interval set on the sensor.
+ */
+class SCD30Task : public SensorTask {
+public:
+    SCD30Task(SCD30 *sensor, uint8_t channel = 0) : _sensor(sensor), _channel(channel), _sequence(0) {}
+
+    bool start(void) override;
+    State poll(Sample &sample) override;
+    bool recover(void) override;
+
+    ///@brief Fixed-point sample values (0.01 ppm, 0.01 °C, 0.01 %RH) from the last read
+    static void fill_values(const SCD30 *sensor, Sample &sample);
+
+private:
+    SCD30 *_sensor;
+    uint8_t _channel;
+    uint16_t _sequence;
+};
@@ -0,0 +1,26 @@
+/*
+ *  Title: LittleEndian
+ *  Description: Byte order helpers shared by the USB frame format and the
+ *               flash sample log, both of which store fields little-endian.
+ */
+#pragma once
+#include <stdint.h>
+
+///@brief Write the low bytes of value, least significant first
+///@param out Buffer of at least bytes bytes
+///@param bytes Number of bytes to write, 1 to 8
+static inline void put_le(uint8_t *out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+///@brief Read a little-endian unsigned value
+///@param bytes Number of bytes to read, 1 to 8
+static inline uint64_t get_le(const uint8_t *in, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
@@ -0,0 +1,280 @@
+/*
+ *  Title: SampleCodec
+ *  Description: Compression of one series of samples for logging and uplink.
+ */
+
+#include <string.h>
+#include "SampleCodec.h"
+#include "SampleFrame.h"
+
+#define TAG_TIMESTAMP 0x01
+#define TAG_SEQUENCE 0x02
+#define VALUE_SAME 0
+#define VALUE_INT8 1
+#define VALUE_INT16 2
+#define VALUE_VARINT 3
+
+static size_t put_varint(uint8_t *out, uint64_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+static bool get_varint(const uint8_t *&in, const uint8_t *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+SampleEncoder::SampleEncoder(uint8_t block_samples) :
+    _block_samples(block_samples == 0 ? 1 : (block_samples > CODEC_BLOCK_SAMPLES ? CODEC_BLOCK_SAMPLES : block_samples)),
+    _length(0),
+    _count(0),
+    _previous(),
+    _previous_interval(0) {}
+
+size_t SampleEncoder::add(const Sample &sample, uint8_t *out) {
+    size_t written = 0;
+    if (_count > 0 && (sample.sensor != _previous.sensor || sample.channel != _previous.channel)) {
+        written = flush(out);
+    }
+
+    if (_count == 0) {
+        _block[0] = CODEC_MAGIC_0;
+        _block[1] = CODEC_MAGIC_1;
+        _block[2] = CODEC_VERSION;
+        _block[3] = sample.sensor;
+        _block[4] = sample.channel;
+        _length = CODEC_HEADER_LENGTH;
+
+        _length += put_varint(_block + _length, sample.timestamp_us);
+        _block[_length++] = (uint8_t)sample.sequence;
+        _block[_length++] = (uint8_t)(sample.sequence >> 8);
+        for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+            _length += put_varint(_block + _length, zigzag(sample.values[i]));
+        }
+        _previous_interval = 0;
+    } else {
+        size_t tag_at = _length++;
+        uint8_t tag = 0;
+
+        int64_t interval = (int64_t)(sample.timestamp_us - _previous.timestamp_us);
+        int64_t delta_of_delta = interval - _previous_interval;
+        if (delta_of_delta != 0) {
+            tag |= TAG_TIMESTAMP;
+            _length += put_varint(_block + _length, zigzag(delta_of_delta));
+        }
+        _previous_interval = interval;
+
+        uint16_t gap = (uint16_t)(sample.sequence - _previous.sequence - 1);
+        if (gap != 0) {
+            tag |= TAG_SEQUENCE;
+            _length += put_varint(_block + _length, gap);
+        }
+
+        for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+            int64_t delta = (int64_t)sample.values[i] - _previous.values[i];
+            uint8_t kind;
+            if (delta == 0) {
+                kind = VALUE_SAME;
+            } else if (delta >= INT8_MIN && delta <= INT8_MAX) {
+                kind = VALUE_INT8;
+                _block[_length++] = (uint8_t)(int8_t)delta;
+            } else if (delta >= INT16_MIN && delta <= INT16_MAX) {
+                kind = VALUE_INT16;
+                _block[_length++] = (uint8_t)delta;
+                _block[_length++] = (uint8_t)((uint16_t)delta >> 8);
+            } else {
+                kind = VALUE_VARINT;
+                _length += put_varint(_block + _length, zigzag(delta));
+            }
+            tag |= kind << (2 + 2 * i);
+        }
+        _block[tag_at] = tag;
+    }
+
+    _previous = sample;
+    _count++;
+    if (_count == _block_samples) written = flush(out);
+    return written;
+}
+
+size_t SampleEncoder::flush(uint8_t *out) {
+    if (_count == 0) return 0;
+
+    size_t payload = _length - CODEC_HEADER_LENGTH;
+    _block[5] = _count;
+    _block[6] = (uint8_t)payload;
+    _block[7] = (uint8_t)(payload >> 8);
+    uint16_t crc = crc16_ccitt(_block, _length);
+    _block[_length++] = (uint8_t)crc;
+    _block[_length++] = (uint8_t)(crc >> 8);
+
+    size_t length = _length;
+    memcpy(out, _block, length);
+    _length = 0;
+    _count = 0;
+    return length;
+}
+
+SampleDecoder::SampleDecoder() : _length(0), _blocks(0), _errors(0), _skipped(0) {}
+
+int SampleDecoder::decode_block(const uint8_t *block, size_t len, Sample *samples, size_t max_samples) {
+    if (len < CODEC_HEADER_LENGTH + 2) return -1;
+    if (block[0] != CODEC_MAGIC_0 || block[1] != CODEC_MAGIC_1 || block[2] != CODEC_VERSION) return -1;
+    size_t payload = block[6] | (block[7] << 8);
+    if (len != CODEC_HEADER_LENGTH + payload + 2) return -1;
+    if (crc16_ccitt(block, len - 2) != (block[len - 2] | (block[len - 1] << 8))) return -1;
+
+    uint8_t count = block[5];
+    if (count == 0 || count > max_samples) return -1;
+
+    const uint8_t *in = block + CODEC_HEADER_LENGTH;
+    const uint8_t *end = in + payload;
+    uint64_t value;
+
+    Sample sample = {};
+    sample.sensor = block[3];
+    sample.channel = block[4];
+    if (!get_varint(in, end, sample.timestamp_us)) return -1;
+    if (end - in < 2) return -1;
+    sample.sequence = (uint16_t)(in[0] | (in[1] << 8));
+    in += 2;
+    for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+        if (!get_varint(in, end, value)) return -1;
+        sample.values[i] = (int32_t)unzigzag(value);
+    }
+    samples[0] = sample;
+
+    int64_t interval = 0;
+    for (uint8_t n = 1; n < count; n++) {
+        if (in >= end) return -1;
+        uint8_t tag = *in++;
+
+        if (tag & TAG_TIMESTAMP) {
+            if (!get_varint(in, end, value)) return -1;
+            interval += unzigzag(value);
+        }
+        sample.timestamp_us += interval;
+
+        uint64_t gap = 0;
+        if ((tag & TAG_SEQUENCE) && !get_varint(in, end, gap)) return -1;
+        sample.sequence = (uint16_t)(sample.sequence + 1 + gap);
+
+        for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+            int64_t delta = 0;
+            switch ((tag >> (2 + 2 * i)) & 0b11) {
+                case VALUE_INT8:
+                    if (in >= end) return -1;
+                    delta = (int8_t)*in++;
+                    break;
+                case VALUE_INT16:
+                    if (end - in < 2) return -1;
+                    delta = (int16_t)(in[0] | (in[1] << 8));
+                    in += 2;
+                    break;
+                case VALUE_VARINT:
+                    if (!get_varint(in, end, value)) return -1;
+                    delta = unzigzag(value);
+                    break;
+            }
+            sample.values[i] = (int32_t)(sample.values[i] + delta);
+        }
+        samples[n] = sample;
+    }
+    return (in == end) ? count : -1;
+}
+
+size_t SampleDecoder::feed(const uint8_t *data, size_t len, Sample *samples, size_t max_samples, size_t *decoded) {
+    size_t used = 0;
+    *decoded = 0;
+
+    while (true) {
+        // Work through what is buffered, leftovers of a bad block may hold a good one
+        int state;
+        while ((state = step(samples, max_samples, decoded)) == STEP_AGAIN) {}
+        if (state == STEP_FULL || used == len) break;
+
+        // Leave the byte that would complete a block that does not fit for the next call.
+        // step() would keep such a block buffered too, but the caller could not tell a
+        // block left undecoded from data used up: all of data consumed means all decoded.
+        if (_length >= CODEC_HEADER_LENGTH && _length + 1 == block_length() && _buffer[5] > max_samples - *decoded) {
+            break;
+        }
+        _buffer[_length++] = data[used++];
+    }
+    return used;
+}
+
+///@brief Look at the buffered bytes once
+///@return STEP_AGAIN if something was discarded or decoded, STEP_MORE if more bytes are
+///        needed, STEP_FULL if a complete block does not fit in samples
+int SampleDecoder::step(Sample *samples, size_t max_samples, size_t *decoded) {
+    if (_length == 0) return STEP_MORE;
+    if (_buffer[0] != CODEC_MAGIC_0 || (_length > 1 && _buffer[1] != CODEC_MAGIC_1)) {
+        discard(1);
+        return STEP_AGAIN;
+    }
+    if (_length < CODEC_HEADER_LENGTH) return STEP_MORE;
+
+    size_t total = block_length();
+    if (_buffer[2] != CODEC_VERSION || _buffer[5] == 0 || _buffer[5] > CODEC_BLOCK_SAMPLES ||
+        total > CODEC_MAX_BLOCK_LENGTH) {
+        _errors++;
+        discard(1);
+        return STEP_AGAIN;
+    }
+    if (_length < total) return STEP_MORE;
+    if (_buffer[5] > max_samples - *decoded) return STEP_FULL;
+
+    int count = decode_block(_buffer, total, samples + *decoded, max_samples - *decoded);
+    if (count < 0) {
+        _errors++;
+        discard(1);
+        return STEP_AGAIN;
+    }
+    *decoded += count;
+    _blocks++;
+    memmove(_buffer, _buffer + total, _length - total);
+    _length -= total;
+    return STEP_AGAIN;
+}
+
+///@brief Length of the buffered block, header, payload and CRC, from its header
+size_t SampleDecoder::block_length(void) const {
+    return CODEC_HEADER_LENGTH + (size_t)(_buffer[6] | (_buffer[7] << 8)) + 2;
+}
+
+///@brief Drop bytes from the front of the buffer and rescan the rest for a block header
+void SampleDecoder::discard(size_t count) {
+    _skipped += count;
+    memmove(_buffer, _buffer + count, _length - count);
+    _length -= count;
+
+    size_t start = 0;
+    while (start < _length) {
+        if (_buffer[start] == CODEC_MAGIC_0 && (start + 1 == _length || _buffer[start + 1] == CODEC_MAGIC_1)) break;
+        start++;
+    }
+    if (start > 0) {
+        _skipped += start;
+        memmove(_buffer, _buffer + start, _length - start);
+        _length -= start;
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ *  Title: SampleCodec
+ *  Description: Compression of one series of samples (one sensor channel)
+ *               for flash logging and uplink. Samples are grouped in blocks
+ *               that can be decoded on their own:
+ *
+ *                 block header   magic C5 DE, version, sensor, channel,
+ *                                sample count, payload length (uint16 LE)
+ *                 keyframe       timestamp (varint), sequence (uint16 LE),
+ *                                values (zigzag varint)
+ *                 records        one per further sample, see below
+ *                 CRC-16         CRC-16/CCITT-FALSE over header and payload
+ *
+ *               A record starts with a tag byte:
+ *                 bit 0     timestamp delta-of-delta follows (zigzag varint),
+ *                           otherwise the sample interval is unchanged
+ *                 bit 1     sequence gap follows (varint), otherwise +1
+ *                 bits 2-7  two bits per value: 0 unchanged, 1 int8 delta,
+ *                           2 int16 delta, 3 zigzag varint delta
+ *
+ *               Slowly changing readings at a steady rate cost 2-5 bytes per
+ *               sample against 29 for a SampleFrame. A lost or corrupted block
+ *               only loses its own samples, the decoder resyncs on the next
+ *               block header.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <Sample.h>
+
+#define CODEC_MAGIC_0 0xC5
+#define CODEC_MAGIC_1 0xDE
+#define CODEC_VERSION 1
+
+// Samples per block, i.e. the keyframe interval
+#ifndef CODEC_BLOCK_SAMPLES
+#define CODEC_BLOCK_SAMPLES 64
+#endif
+
+#define CODEC_HEADER_LENGTH 8
+#define CODEC_KEYFRAME_MAX (10 + 2 + 5 * SAMPLE_VALUE_COUNT)
+#define CODEC_RECORD_MAX (1 + 10 + 5 + 5 * SAMPLE_VALUE_COUNT)
+// Worst-case size of one encoded block
+#define CODEC_MAX_BLOCK_LENGTH (CODEC_HEADER_LENGTH + CODEC_KEYFRAME_MAX + \
+                                (CODEC_BLOCK_SAMPLES - 1) * CODEC_RECORD_MAX + 2)
+
+class SampleEncoder {
+public:
+    ///@param block_samples Samples per block, 1..CODEC_BLOCK_SAMPLES
+    SampleEncoder(uint8_t block_samples = CODEC_BLOCK_SAMPLES);
+
+    ///@brief Add a sample to the open block
+    ///       A block is finished when it is full, or before a sample from
+    ///       another sensor or channel is added.
+    ///@param out Receives a finished block, at least CODEC_MAX_BLOCK_LENGTH bytes
+    ///@return Length of the block written to out, 0 if no block was finished
+    size_t add(const Sample &sample, uint8_t *out);
+
+    ///@brief Finish the open block, e.g. before going to sleep
+    ///@return Length of the block written to out, 0 if the block was empty
+    size_t flush(uint8_t *out);
+
+    ///@brief Samples in the open block
+    uint8_t pending(void) const { return _count; }
+
+private:
+    uint8_t _block_samples;
+    uint8_t _block[CODEC_MAX_BLOCK_LENGTH];
+    size_t _length;
+    uint8_t _count;
+
+    Sample _previous;
+    int64_t _previous_interval;
+};
+
+class SampleDecoder {
+public:
+    SampleDecoder();
+
+    ///@brief Feed bytes of an encoded stream
+    ///@param samples Receives decoded samples, room for CODEC_BLOCK_SAMPLES is always enough
+    ///@param max_samples Room in samples, feeding stops at a block that does not fit
+    ///       and the rest of data is left unconsumed
+    ///@param decoded Receives the number of samples decoded
+    ///@return Number of bytes consumed
+    size_t feed(const uint8_t *data, size_t len, Sample *samples, size_t max_samples, size_t *decoded);
+
+    uint32_t blocks(void) const { return _blocks; }
+    uint32_t errors(void) const { return _errors; }
+    uint32_t skipped(void) const { return _skipped; }
+
+    ///@brief Decode one complete block
+    ///@return Number of samples, or -1 if the block is damaged
+    static int decode_block(const uint8_t *block, size_t len, Sample *samples, size_t max_samples);
+
+private:
+    uint8_t _buffer[CODEC_MAX_BLOCK_LENGTH];
+    size_t _length;
+    uint32_t _blocks;
+    uint32_t _errors;
+    uint32_t _skipped;
+
+    enum { STEP_AGAIN, STEP_MORE, STEP_FULL };
+    int step(Sample *samples, size_t max_samples, size_t *decoded);
+    size_t block_length(void) const;
+    void discard(size_t count);
+};
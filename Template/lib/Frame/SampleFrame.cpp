@@ -0,0 +1,106 @@
+/*
+ *  Title: SampleFrame
+ *  Description: Binary framing of samples for streaming over USB CDC.
+ */
+
+#include <string.h>
+#include "LittleEndian.h"
+#include "SampleFrame.h"
+
+struct Crc16Table {
+    uint16_t entries[256];
+
+    constexpr Crc16Table() : entries() {
+        for (int i = 0; i < 256; i++) {
+            uint16_t crc = (uint16_t)(i << 8);
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+            }
+            entries[i] = crc;
+        }
+    }
+};
+
+// Built by the compiler, lives in flash on the Pico
+static constexpr Crc16Table CRC16_TABLE;
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)((crc << 8) ^ CRC16_TABLE.entries[((crc >> 8) ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+size_t frame_encode(const Sample &sample, uint8_t *out) {
+    out[0] = FRAME_SYNC_0;
+    out[1] = FRAME_SYNC_1;
+    out[2] = FRAME_VERSION;
+    out[3] = sample.sensor;
+    out[4] = sample.channel;
+    put_le(out + 5, sample.sequence, 2);
+    put_le(out + 7, sample.timestamp_us, 8);
+    for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+        put_le(out + 15 + 4 * i, (uint32_t)sample.values[i], 4);
+    }
+    put_le(out + 27, crc16_ccitt(out + 2, 25), 2);
+    return FRAME_LENGTH;
+}
+
+FrameDecoder::FrameDecoder() : _length(0), _frames(0), _crc_errors(0), _skipped(0) {}
+
+size_t FrameDecoder::feed(const uint8_t *data, size_t len, Sample *samples, size_t max_samples, size_t *decoded) {
+    size_t used = 0;
+    *decoded = 0;
+
+    while (used < len && *decoded < max_samples) {
+        _buffer[_length++] = data[used++];
+
+        // Keep only a prefix that can still become a frame
+        if (_length == 1 && _buffer[0] != FRAME_SYNC_0) {
+            discard(1);
+            continue;
+        }
+        if (_length == 2 && _buffer[1] != FRAME_SYNC_1) {
+            discard(1);
+            continue;
+        }
+        if (_length < FRAME_LENGTH) continue;
+
+        if (_buffer[2] != FRAME_VERSION || get_le(_buffer + 27, 2) != crc16_ccitt(_buffer + 2, 25)) {
+            _crc_errors++;
+            discard(1);
+            continue;
+        }
+
+        Sample &sample = samples[(*decoded)++];
+        sample.sensor = _buffer[3];
+        sample.channel = _buffer[4];
+        sample.sequence = (uint16_t)get_le(_buffer + 5, 2);
+        sample.timestamp_us = get_le(_buffer + 7, 8);
+        for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+            sample.values[i] = (int32_t)(uint32_t)get_le(_buffer + 15 + 4 * i, 4);
+        }
+        _frames++;
+        _length = 0;
+    }
+    return used;
+}
+
+///@brief Drop bytes from the front of the buffer and rescan the rest for a sync word
+void FrameDecoder::discard(size_t count) {
+    _skipped += count;
+    memmove(_buffer, _buffer + count, _length - count);
+    _length -= count;
+
+    size_t start = 0;
+    while (start < _length) {
+        if (_buffer[start] == FRAME_SYNC_0 && (start + 1 == _length || _buffer[start + 1] == FRAME_SYNC_1)) break;
+        start++;
+    }
+    if (start > 0) {
+        _skipped += start;
+        memmove(_buffer, _buffer + start, _length - start);
+        _length -= start;
+    }
+}
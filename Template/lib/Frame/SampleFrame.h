@@ -0,0 +1,64 @@
+/*
+ *  Title: SampleFrame
+ *  Description: Binary framing of samples for streaming over USB CDC.
+ *               One frame per sample, all fields little-endian:
+ *
+ *                 offset  size  field
+ *                      0     2  sync word A5 5A
+ *                      2     1  format version (FRAME_VERSION)
+ *                      3     1  sensor (SENSOR_*)
+ *                      4     1  channel
+ *                      5     2  sequence number
+ *                      7     8  timestamp [µs since boot]
+ *                     15    12  three int32 values, units as in Sample.h
+ *                     27     2  CRC-16/CCITT-FALSE over bytes 2..26
+ *
+ *               The decoder takes the stream a chunk at a time and finds
+ *               its way back to frame boundaries after lost or corrupted
+ *               bytes, or text written to the same port.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <Sample.h>
+
+#define FRAME_SYNC_0 0xA5
+#define FRAME_SYNC_1 0x5A
+#define FRAME_VERSION 1
+#define FRAME_LENGTH 29
+
+///@brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), table driven
+uint16_t crc16_ccitt(const uint8_t *data, size_t len);
+
+///@brief Encode one sample
+///@param out Buffer of at least FRAME_LENGTH bytes
+///@return Number of bytes written, always FRAME_LENGTH
+size_t frame_encode(const Sample &sample, uint8_t *out);
+
+class FrameDecoder {
+public:
+    FrameDecoder();
+
+    ///@brief Feed bytes from the stream
+    ///@param data Bytes received
+    ///@param len Number of bytes
+    ///@param samples Receives the decoded samples
+    ///@param max_samples Room in samples, decoding stops when it is full
+    ///@param decoded Receives the number of samples decoded
+    ///@return Number of bytes consumed, less than len only if samples filled up
+    size_t feed(const uint8_t *data, size_t len, Sample *samples, size_t max_samples, size_t *decoded);
+
+    uint32_t frames(void) const { return _frames; }
+    uint32_t crc_errors(void) const { return _crc_errors; }
+    ///@brief Bytes thrown away while looking for a sync word
+    uint32_t skipped(void) const { return _skipped; }
+
+private:
+    uint8_t _buffer[FRAME_LENGTH];
+    size_t _length;
+    uint32_t _frames;
+    uint32_t _crc_errors;
+    uint32_t _skipped;
+
+    void discard(size_t count);
+};
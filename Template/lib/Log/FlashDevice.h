@@ -0,0 +1,38 @@
+/*
+ *  Title: FlashDevice
+ *  Description: A region of NOR flash as seen by the sample log. The log
+ *               never touches the SDK directly, so it runs against the
+ *               QSPI flash of the RP2040 (PicoFlash.h) or against a
+ *               file-backed image on a host machine (host/sim).
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOG_FLASH_PAGE_SIZE 256         // Smallest unit that can be programmed
+#define LOG_FLASH_SECTOR_SIZE 4096      // Smallest unit that can be erased
+
+/**
+ * @class FlashDevice
+ * @brief Offsets are relative to the start of the region. Like real NOR
+ *        flash, programming can only clear bits; erase sets a whole sector
+ *        back to 0xFF.
+ */
+class FlashDevice {
+public:
+    virtual ~FlashDevice() {}
+
+    ///@brief Size of the region in bytes, a multiple of LOG_FLASH_SECTOR_SIZE
+    virtual uint32_t size(void) = 0;
+
+    ///@brief Read any number of bytes from any offset
+    virtual bool read(uint32_t offset, uint8_t *dst, size_t len) = 0;
+
+    ///@brief Program whole pages
+    ///@param offset Multiple of LOG_FLASH_PAGE_SIZE
+    ///@param len Multiple of LOG_FLASH_PAGE_SIZE
+    virtual bool program(uint32_t offset, const uint8_t *src, size_t len) = 0;
+
+    ///@brief Erase the sector that starts at offset
+    virtual bool erase(uint32_t offset) = 0;
+};
@@ -0,0 +1,57 @@
+/*
+ *  Title: PicoFlash
+ *  Description: FlashDevice on the QSPI flash of the RP2040.
+ */
+
+#include <string.h>
+#include <hardware/sync.h>
+#include <hardware/regs/addressmap.h>
+#include <pico/multicore.h>
+#include "PicoFlash.h"
+
+// End of the program image, from the linker script
+extern char __flash_binary_end;
+
+bool PicoFlash::valid(void) {
+    uint32_t binary_end = (uint32_t)(uintptr_t)&__flash_binary_end - XIP_BASE;
+    return _offset >= binary_end && _offset + _size <= PICO_FLASH_SIZE_BYTES &&
+           _offset % FLASH_SECTOR_SIZE == 0 && _size % FLASH_SECTOR_SIZE == 0;
+}
+
+/// Reads go through the XIP window like any other memory access.
+bool PicoFlash::read(uint32_t offset, uint8_t *dst, size_t len) {
+    if (offset + len > _size) return false;
+    memcpy(dst, (const void *)(XIP_BASE + _offset + offset), len);
+    return true;
+}
+
+/// While the flash is written nothing may run from it: interrupts are off
+/// and core 1, if it is running, is parked in RAM.
+uint32_t PicoFlash::begin_write(void) {
+    if (_lockout_core1) multicore_lockout_start_blocking();
+    return save_and_disable_interrupts();
+}
+
+void PicoFlash::end_write(uint32_t interrupts) {
+    restore_interrupts(interrupts);
+    if (_lockout_core1) multicore_lockout_end_blocking();
+}
+
+bool PicoFlash::program(uint32_t offset, const uint8_t *src, size_t len) {
+    if (offset + len > _size || offset % FLASH_PAGE_SIZE != 0 || len % FLASH_PAGE_SIZE != 0) return false;
+
+    uint32_t interrupts = begin_write();
+    flash_range_program(_offset + offset, src, len);
+    end_write(interrupts);
+
+    return memcmp((const void *)(XIP_BASE + _offset + offset), src, len) == 0;
+}
+
+bool PicoFlash::erase(uint32_t offset) {
+    if (offset + FLASH_SECTOR_SIZE > _size || offset % FLASH_SECTOR_SIZE != 0) return false;
+
+    uint32_t interrupts = begin_write();
+    flash_range_erase(_offset + offset, FLASH_SECTOR_SIZE);
+    end_write(interrupts);
+    return true;
+}
@@ -0,0 +1,40 @@
+/*
+ *  Title: PicoFlash
+ *  Description: FlashDevice on the QSPI flash of the RP2040, the same
+ *               flash the program runs from.
+ */
+#pragma once
+#include <hardware/flash.h>
+#include "FlashDevice.h"
+
+// Size of the sample log region, 128 sectors hold about 20000 samples
+#ifndef SAMPLE_LOG_FLASH_SIZE
+#define SAMPLE_LOG_FLASH_SIZE (512u * 1024)
+#endif
+
+// Directly below the last sector, which keeps the BME280 calibration (BME280FlashStore.h)
+#define SAMPLE_LOG_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE - SAMPLE_LOG_FLASH_SIZE)
+
+class PicoFlash : public FlashDevice {
+public:
+    ///@param offset Start of the region from the start of flash, a multiple of FLASH_SECTOR_SIZE
+    ///@param size Size of the region, a multiple of FLASH_SECTOR_SIZE
+    ///@param lockout_core1 Pause core 1 while programming, it must have called multicore_lockout_victim_init()
+    PicoFlash(uint32_t offset = SAMPLE_LOG_FLASH_OFFSET, uint32_t size = SAMPLE_LOG_FLASH_SIZE,
+              bool lockout_core1 = false) : _offset(offset), _size(size), _lockout_core1(lockout_core1) {}
+
+    uint32_t size(void) override { return _size; }
+    bool read(uint32_t offset, uint8_t *dst, size_t len) override;
+    bool program(uint32_t offset, const uint8_t *src, size_t len) override;
+    bool erase(uint32_t offset) override;
+
+    ///@brief False if the region overlaps the program image
+    bool valid(void);
+private:
+    uint32_t _offset;
+    uint32_t _size;
+    bool _lockout_core1;
+
+    uint32_t begin_write(void);
+    void end_write(uint32_t interrupts);
+};
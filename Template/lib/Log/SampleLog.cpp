@@ -0,0 +1,245 @@
+/*
+ *  Title: SampleLog
+ *  Description: Page batching, round-robin sectors and recovery of the
+ *               write position after a reset.
+ */
+
+#include <string.h>
+#include <LittleEndian.h>
+#include <SampleFrame.h>
+#include "SampleLog.h"
+
+static void encode_record(const Sample &sample, uint8_t *out) {
+    put_le(out, sample.timestamp_us, 8);
+    out[8] = sample.sensor;
+    out[9] = sample.channel;
+    put_le(out + 10, sample.sequence, 2);
+    for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+        put_le(out + 12 + 4 * i, (uint32_t)sample.values[i], 4);
+    }
+}
+
+static void decode_record(const uint8_t *in, Sample &sample) {
+    sample.timestamp_us = get_le(in, 8);
+    sample.sensor = in[8];
+    sample.channel = in[9];
+    sample.sequence = (uint16_t)get_le(in + 10, 2);
+    for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+        sample.values[i] = (int32_t)(uint32_t)get_le(in + 12 + 4 * i, 4);
+    }
+}
+
+SampleLog::SampleLog(FlashDevice *flash) :
+    _flash(flash),
+    _sectors(flash->size() / LOG_FLASH_SECTOR_SIZE),
+    _head_sector(0),
+    _head_page(0),
+    _head_erase_count(0),
+    _page_sequence(0),
+    _count(0),
+    _pages_written(0),
+    _sectors_erased(0),
+    _crc_errors(0) {
+    static_assert(LOG_HEADER_LENGTH + LOG_RECORDS_PER_PAGE * LOG_RECORD_LENGTH <= LOG_FLASH_PAGE_SIZE,
+                  "records must fit in a page");
+    memset(_page, 0xFF, sizeof(_page));
+}
+
+SampleLog::PageState SampleLog::read_page(uint32_t sector, uint32_t page, PageHeader &header, uint8_t *data) {
+    uint8_t buffer[LOG_FLASH_PAGE_SIZE];
+    if (data == nullptr) data = buffer;
+
+    uint32_t offset = sector * LOG_FLASH_SECTOR_SIZE + page * LOG_FLASH_PAGE_SIZE;
+    if (!_flash->read(offset, data, LOG_FLASH_PAGE_SIZE)) return PAGE_UNREADABLE;
+
+    if (data[0] == 0xFF && data[1] == 0xFF) {
+        // A page torn before the header landed can still have data bits cleared
+        for (size_t i = 2; i < LOG_FLASH_PAGE_SIZE; i++) {
+            if (data[i] != 0xFF) return PAGE_DAMAGED;
+        }
+        return PAGE_ERASED;
+    }
+
+    header.count = data[3];
+    header.first_sequence = (uint32_t)get_le(data + 4, 4);
+    header.erase_count = (uint32_t)get_le(data + 8, 4);
+    if (data[0] != LOG_MAGIC_0 || data[1] != LOG_MAGIC_1 || data[2] != LOG_VERSION ||
+        header.count == 0 || header.count > LOG_RECORDS_PER_PAGE) return PAGE_DAMAGED;
+
+    // CRC over the header fields and the records, computed as one run with the CRC field left out
+    uint8_t covered[LOG_FLASH_PAGE_SIZE];
+    memcpy(covered, data, 14);
+    memcpy(covered + 14, data + LOG_HEADER_LENGTH, header.count * LOG_RECORD_LENGTH);
+    uint16_t crc = crc16_ccitt(covered, 14 + header.count * LOG_RECORD_LENGTH);
+    return (crc == get_le(data + 14, 2)) ? PAGE_VALID : PAGE_DAMAGED;
+}
+
+/// Sectors are written in order, so the newest one is the sector whose first
+/// page has the highest sequence. Only that sector is walked page by page.
+bool SampleLog::recover(void) {
+    _head_sector = _sectors - 1;
+    _head_page = LOG_PAGES_PER_SECTOR;      // Nothing found: the first page goes to sector 0
+    _head_erase_count = 0;
+    _page_sequence = 0;
+    _count = 0;
+    memset(_page, 0xFF, sizeof(_page));
+
+    PageHeader header;
+    bool found = false;
+    uint32_t newest = 0;
+    for (uint32_t sector = 0; sector < _sectors; sector++) {
+        PageState state = read_page(sector, 0, header);
+        if (state == PAGE_UNREADABLE) return false;
+        if (state == PAGE_DAMAGED) _crc_errors++;
+        if (state == PAGE_VALID && (!found || header.first_sequence > newest)) {
+            found = true;
+            newest = header.first_sequence;
+            _head_sector = sector;
+            _head_erase_count = header.erase_count;
+        }
+    }
+    if (!found) return true;
+
+    _page_sequence = newest;
+    for (uint32_t page = 0; page < LOG_PAGES_PER_SECTOR; page++) {
+        PageState state = read_page(_head_sector, page, header);
+        if (state == PAGE_UNREADABLE) return false;
+        if (state == PAGE_ERASED) {
+            _head_page = page;
+            break;
+        }
+        if (state == PAGE_DAMAGED) {
+            _crc_errors++;
+        } else {
+            _page_sequence = header.first_sequence + header.count;
+        }
+    }
+    return true;
+}
+
+bool SampleLog::append(const Sample &sample) {
+    encode_record(sample, _page + LOG_HEADER_LENGTH + _count * LOG_RECORD_LENGTH);
+    _count++;
+    if (_count < LOG_RECORDS_PER_PAGE) return true;
+    return program_page();
+}
+
+bool SampleLog::flush(void) {
+    return program_page();
+}
+
+/// Erases the sector after the head, which holds the oldest samples once the log has wrapped.
+bool SampleLog::next_sector(void) {
+    uint32_t sector = (_head_sector + 1) % _sectors;
+
+    // A sector that lost its first page was erased about as often as its neighbour
+    PageHeader header;
+    uint32_t erase_count = (_head_erase_count > 0) ? _head_erase_count - 1 : 0;
+    if (read_page(sector, 0, header) == PAGE_VALID) erase_count = header.erase_count;
+
+    if (!_flash->erase(sector * LOG_FLASH_SECTOR_SIZE)) return false;
+    _sectors_erased++;
+    _head_sector = sector;
+    _head_page = 0;
+    _head_erase_count = erase_count + 1;
+    return true;
+}
+
+bool SampleLog::program_page(void) {
+    if (_count == 0) return true;
+
+    bool ok = (_head_page < LOG_PAGES_PER_SECTOR) || next_sector();
+    if (ok) {
+        _page[0] = LOG_MAGIC_0;
+        _page[1] = LOG_MAGIC_1;
+        _page[2] = LOG_VERSION;
+        _page[3] = (uint8_t)_count;
+        put_le(_page + 4, _page_sequence, 4);
+        put_le(_page + 8, _head_erase_count, 4);
+        _page[12] = 0xFF;
+        _page[13] = 0xFF;
+
+        uint8_t covered[LOG_FLASH_PAGE_SIZE];
+        memcpy(covered, _page, 14);
+        memcpy(covered + 14, _page + LOG_HEADER_LENGTH, _count * LOG_RECORD_LENGTH);
+        put_le(_page + 14, crc16_ccitt(covered, 14 + _count * LOG_RECORD_LENGTH), 2);
+
+        uint32_t offset = _head_sector * LOG_FLASH_SECTOR_SIZE + _head_page * LOG_FLASH_PAGE_SIZE;
+        ok = _flash->program(offset, _page, LOG_FLASH_PAGE_SIZE);
+        // A failed program may have cleared bits, the page is not used again
+        _head_page++;
+        if (ok) _pages_written++;
+    }
+
+    _page_sequence += _count;
+    _count = 0;
+    memset(_page, 0xFF, sizeof(_page));
+    return ok;
+}
+
+uint32_t SampleLog::drain(uint32_t since, DrainCallback callback, void *context, uint32_t max_samples) {
+    uint32_t delivered = 0;
+    uint32_t next = since;
+    uint8_t data[LOG_FLASH_PAGE_SIZE];
+    PageHeader header;
+    Sample sample;
+
+    // Oldest sector first, the head sector last
+    for (uint32_t i = 1; i <= _sectors && delivered < max_samples; i++) {
+        uint32_t sector = (_head_sector + i) % _sectors;
+        uint32_t pages = (sector == _head_sector) ? _head_page : LOG_PAGES_PER_SECTOR;
+        if (pages > LOG_PAGES_PER_SECTOR) pages = LOG_PAGES_PER_SECTOR;
+
+        // Skip the whole sector if the one after it already starts at or before since
+        if (sector != _head_sector &&
+            read_page((sector + 1) % _sectors, 0, header) == PAGE_VALID && header.first_sequence <= since) continue;
+
+        for (uint32_t page = 0; page < pages && delivered < max_samples; page++) {
+            PageState state = read_page(sector, page, header, data);
+            if (state == PAGE_ERASED || state == PAGE_UNREADABLE) break;
+            if (state == PAGE_DAMAGED) {
+                _crc_errors++;
+                continue;
+            }
+            if (header.first_sequence + header.count <= since) continue;
+
+            for (uint32_t record = 0; record < header.count && delivered < max_samples; record++) {
+                uint32_t sequence = header.first_sequence + record;
+                if (sequence < since) continue;
+                decode_record(data + LOG_HEADER_LENGTH + record * LOG_RECORD_LENGTH, sample);
+                callback(sample, sequence, context);
+                delivered++;
+                next = sequence + 1;
+            }
+        }
+    }
+
+    // Then whatever is still waiting in RAM
+    for (uint32_t record = 0; record < _count && delivered < max_samples; record++) {
+        uint32_t sequence = _page_sequence + record;
+        if (sequence < since) continue;
+        decode_record(_page + LOG_HEADER_LENGTH + record * LOG_RECORD_LENGTH, sample);
+        callback(sample, sequence, context);
+        delivered++;
+        next = sequence + 1;
+    }
+    return next;
+}
+
+uint32_t SampleLog::oldest_sequence(void) {
+    PageHeader header;
+    for (uint32_t i = 1; i <= _sectors; i++) {
+        uint32_t sector = (_head_sector + i) % _sectors;
+        for (uint32_t page = 0; page < LOG_PAGES_PER_SECTOR; page++) {
+            PageState state = read_page(sector, page, header);
+            if (state == PAGE_VALID) return header.first_sequence;
+            if (state != PAGE_DAMAGED) break;
+        }
+    }
+    return _page_sequence;
+}
+
+uint32_t SampleLog::erase_count(uint32_t sector) {
+    PageHeader header;
+    return (read_page(sector, 0, header) == PAGE_VALID) ? header.erase_count : 0;
+}
@@ -0,0 +1,112 @@
+/*
+ *  Title: SampleLog
+ *  Description: Append-only store-and-forward log of samples in flash.
+ *               Samples are collected in RAM until a page is full and the
+ *               page is programmed in one go. Sectors are used round-robin,
+ *               the oldest one is erased when the log wraps, so every sector
+ *               sees the same number of erase cycles.
+ *
+ *               Every sample gets a log sequence number, counting up from 0
+ *               over the life of the log. One page holds:
+ *
+ *                 offset  size  field
+ *                      0     2  magic 4C 47
+ *                      2     1  format version (LOG_VERSION)
+ *                      3     1  samples in the page, 1..LOG_RECORDS_PER_PAGE
+ *                      4     4  sequence of the first sample
+ *                      8     4  erase count of the sector
+ *                     12     2  reserved, FF FF
+ *                     14     2  CRC-16/CCITT-FALSE over bytes 0..13 and the records
+ *                     16    24  per sample: timestamp (8), sensor, channel,
+ *                               sequence (2), three int32 values
+ *
+ *               All fields are little-endian. A page torn by a power loss
+ *               fails its CRC and is skipped. After a reset recover() finds
+ *               the write position from the first page of every sector and
+ *               the headers of the newest sector, without reading the data.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <Sample.h>
+#include "FlashDevice.h"
+
+#define LOG_MAGIC_0 0x4C
+#define LOG_MAGIC_1 0x47
+#define LOG_VERSION 1
+
+#define LOG_HEADER_LENGTH 16
+#define LOG_RECORD_LENGTH 24
+#define LOG_RECORDS_PER_PAGE ((LOG_FLASH_PAGE_SIZE - LOG_HEADER_LENGTH) / LOG_RECORD_LENGTH)
+#define LOG_PAGES_PER_SECTOR (LOG_FLASH_SECTOR_SIZE / LOG_FLASH_PAGE_SIZE)
+
+class SampleLog {
+public:
+    typedef void (*DrainCallback)(const Sample &sample, uint32_t sequence, void *context);
+
+    ///@param flash Region of at least two sectors
+    SampleLog(FlashDevice *flash);
+
+    ///@brief Find the newest page and continue after it, call once before anything else
+    ///@return False if the flash could not be read
+    bool recover(void);
+
+    ///@brief Add a sample, a full page is programmed at once
+    ///@return False if programming the page failed, the samples in it are lost
+    bool append(const Sample &sample);
+
+    ///@brief Program the partly filled page, e.g. before going to sleep
+    ///       The rest of that page stays unused.
+    bool flush(void);
+
+    ///@brief Deliver the samples with a sequence of at least since, oldest first
+    ///       Samples still in RAM are included. If since is older than the
+    ///       oldest sample kept, the drain starts at the oldest one.
+    ///@param max_samples Stop after this many
+    ///@return Sequence after the last sample delivered, the since of the next drain
+    uint32_t drain(uint32_t since, DrainCallback callback, void *context, uint32_t max_samples = UINT32_MAX);
+
+    ///@brief Sequence the next appended sample gets
+    uint32_t next_sequence(void) const { return _page_sequence + _count; }
+
+    ///@brief Sequence of the oldest sample still in flash (or in RAM if flash is empty)
+    uint32_t oldest_sequence(void);
+
+    ///@brief Erase count stored in the first page of a sector, 0 if it has none
+    uint32_t erase_count(uint32_t sector);
+
+    uint32_t sectors(void) const { return _sectors; }
+    uint32_t pending(void) const { return _count; }
+    uint32_t pages_written(void) const { return _pages_written; }
+    uint32_t sectors_erased(void) const { return _sectors_erased; }
+    ///@brief Pages with a bad CRC seen by recover() and drain()
+    uint32_t crc_errors(void) const { return _crc_errors; }
+
+private:
+    struct PageHeader {
+        uint8_t count;
+        uint32_t first_sequence;
+        uint32_t erase_count;
+    };
+
+    enum PageState { PAGE_ERASED, PAGE_VALID, PAGE_DAMAGED, PAGE_UNREADABLE };
+
+    PageState read_page(uint32_t sector, uint32_t page, PageHeader &header, uint8_t *data = nullptr);
+    bool program_page(void);
+    bool next_sector(void);
+
+    FlashDevice *_flash;
+    uint32_t _sectors;
+
+    uint32_t _head_sector;          // Sector being written
+    uint32_t _head_page;            // Next page to program in it, LOG_PAGES_PER_SECTOR when full
+    uint32_t _head_erase_count;
+
+    uint8_t _page[LOG_FLASH_PAGE_SIZE];
+    uint32_t _page_sequence;        // Sequence of the first sample in _page
+    uint32_t _count;                // Samples in _page
+
+    uint32_t _pages_written;
+    uint32_t _sectors_erased;
+    uint32_t _crc_errors;
+};
@@ -0,0 +1,135 @@
+/*
+ *  Title: DerivedMetrics
+ *  Description: Altitude, sea-level pressure, dew point and absolute
+ *               humidity in fixed point.
+ */
+
+#include <math.h>
+#include "DerivedMetrics.h"
+#include "FixedMath.h"
+
+#define ALTITUDE_EXPONENT 3192087       // 1 / 5.25588 in Q8.24
+#define SEA_LEVEL_EXPONENT -88179034    // -5.25588 in Q8.24
+#define ALTITUDE_SCALE_CM 4433077       // 44330.77 m
+#define MAGNUS_B 295614546              // 17.62 in Q8.24
+#define MAGNUS_C_CENTI 24312            // 243.12 °C
+#define LOG2_100 111465410              // log2(100) in Q8.24
+#define ABSOLUTE_HUMIDITY_SCALE 132471  // 216.74 * 6.112 * 100, see absolute_humidity_centigrams()
+
+DerivedMetrics::DerivedMetrics(int32_t station_altitude_cm, uint32_t reference_pressure_q24_8) :
+    _reference_log2(0),
+    _sea_level_factor(FX_ONE),
+    _temperature(0),
+    _pressure(0),
+    _humidity(0),
+    _has_pressure(false),
+    _computed(0),
+    _altitude(0),
+    _sea_level(0),
+    _magnus(0),
+    _dew_point(0),
+    _absolute_humidity(0) {
+    set_station_altitude_cm(station_altitude_cm);
+    set_reference_pressure_q24_8(reference_pressure_q24_8);
+}
+
+/// The factor only depends on the altitude, so it is worked out here once.
+void DerivedMetrics::set_station_altitude_cm(int32_t altitude_cm) {
+    int32_t ratio = FX_ONE - (int32_t)(((int64_t)altitude_cm * FX_ONE) / ALTITUDE_SCALE_CM);
+    _sea_level_factor = fx_exp2(fx_mul(fx_log2((uint32_t)ratio, 24), SEA_LEVEL_EXPONENT));
+    _computed &= ~COMPUTED_SEA_LEVEL;
+}
+
+void DerivedMetrics::set_reference_pressure_q24_8(uint32_t pressure) {
+    _reference_log2 = fx_log2(pressure, 8);
+    _computed &= ~COMPUTED_ALTITUDE;
+}
+
+void DerivedMetrics::set_sample(const Sample &sample) {
+    if (sample.sensor == SENSOR_SCD30) {
+        _temperature = sample.values[1];
+        _humidity = (uint32_t)(((int64_t)sample.values[2] * 1024 + 50) / 100);
+        _pressure = 0;
+        _has_pressure = false;
+    } else {
+        _temperature = sample.values[0];
+        _pressure = (uint32_t)sample.values[1];
+        _humidity = (uint32_t)sample.values[2];
+        _has_pressure = true;
+    }
+    // Below 1/1024 %RH the logarithm runs away, the dew point is then far below anything measurable anyway
+    if (_humidity == 0) _humidity = 1;
+    _computed = 0;
+}
+
+int32_t DerivedMetrics::altitude_cm(void) {
+    if (!_has_pressure) return 0;
+    if (!(_computed & COMPUTED_ALTITUDE)) {
+        // (p / p0)^a = 2^(a (log2 p - log2 p0))
+        uint32_t power = fx_exp2(fx_mul(fx_log2(_pressure, 8) - _reference_log2, ALTITUDE_EXPONENT));
+        _altitude = (int32_t)(((int64_t)ALTITUDE_SCALE_CM * (FX_ONE - (int64_t)power) + (1 << 23)) >> 24);
+        _computed |= COMPUTED_ALTITUDE;
+    }
+    return _altitude;
+}
+
+uint32_t DerivedMetrics::sea_level_pressure_q24_8(void) {
+    if (!_has_pressure) return 0;
+    if (!(_computed & COMPUTED_SEA_LEVEL)) {
+        _sea_level = (uint32_t)(((uint64_t)_pressure * _sea_level_factor + (1 << 23)) >> 24);
+        _computed |= COMPUTED_SEA_LEVEL;
+    }
+    return _sea_level;
+}
+
+int32_t DerivedMetrics::magnus(void) {
+    if (!(_computed & COMPUTED_MAGNUS)) {
+        // b T / (c + T) with T in 0.01 °C
+        _magnus = (int32_t)(((int64_t)MAGNUS_B * _temperature) / (MAGNUS_C_CENTI + _temperature));
+        _computed |= COMPUTED_MAGNUS;
+    }
+    return _magnus;
+}
+
+int32_t DerivedMetrics::dew_point_centidegrees(void) {
+    if (!(_computed & COMPUTED_DEW_POINT)) {
+        // gamma = ln(RH / 100) + b T / (c + T), Td = c gamma / (b - gamma)
+        int32_t gamma = fx_mul(fx_log2(_humidity, 10) - LOG2_100, FX_LN2) + magnus();
+        int64_t numerator = (int64_t)MAGNUS_C_CENTI * gamma;
+        int64_t denominator = (int64_t)MAGNUS_B - gamma;
+        _dew_point = (int32_t)((numerator + (numerator >= 0 ? denominator / 2 : -denominator / 2)) / denominator);
+        _computed |= COMPUTED_DEW_POINT;
+    }
+    return _dew_point;
+}
+
+/// AH = 216.74 * 6.112 exp(b T / (c + T)) * RH / (273.15 + T) g/m³ with RH in %.
+/// In 0.01 g/m³ and with T in 0.01 K the factors of 100 cancel into the scale.
+int32_t DerivedMetrics::absolute_humidity_centigrams(void) {
+    if (!(_computed & COMPUTED_ABSOLUTE_HUMIDITY)) {
+        uint32_t saturation = fx_exp2(fx_mul(magnus(), FX_LOG2E));        // exp(b T / (c + T)), Q8.24
+        uint64_t product = ((uint64_t)saturation * _humidity) >> 10;         // %RH, Q8.24
+        uint64_t kelvin = (uint64_t)(_temperature + 27315);
+        _absolute_humidity = (int32_t)(((product * ABSOLUTE_HUMIDITY_SCALE / kelvin) + (1 << 23)) >> 24);
+        _computed |= COMPUTED_ABSOLUTE_HUMIDITY;
+    }
+    return _absolute_humidity;
+}
+
+double DerivedMetrics::reference_altitude_m(double pressure_pa, double reference_pa) {
+    return 44330.77 * (1.0 - pow(pressure_pa / reference_pa, 0.1902632));
+}
+
+double DerivedMetrics::reference_sea_level_pressure_pa(double pressure_pa, double altitude_m) {
+    return pressure_pa * pow(1.0 - altitude_m / 44330.77, -5.25588);
+}
+
+double DerivedMetrics::reference_dew_point_c(double temperature_c, double humidity_percent) {
+    double gamma = log(humidity_percent / 100.0) + 17.62 * temperature_c / (243.12 + temperature_c);
+    return 243.12 * gamma / (17.62 - gamma);
+}
+
+double DerivedMetrics::reference_absolute_humidity_g_m3(double temperature_c, double humidity_percent) {
+    double saturation_hpa = 6.112 * exp(17.62 * temperature_c / (243.12 + temperature_c));
+    return 216.74 * saturation_hpa * humidity_percent / 100.0 / (273.15 + temperature_c);
+}
@@ -0,0 +1,95 @@
+/*
+ *  Title: DerivedMetrics
+ *  Description: Quantities derived from one BME280 or SCD30 sample,
+ *               computed in fixed point with FixedMath instead of powf,
+ *               logf and expf, which cost thousands of cycles each in
+ *               soft float on the M0+.
+ *
+ *               Nothing is computed until it is asked for, and each result
+ *               is kept until the next set_sample(). The dew point and the
+ *               absolute humidity share their Magnus term.
+ *
+ *               Formulas and largest error against the same formula in
+ *               double precision (sim_run checks these bounds over
+ *               -40..85 C, 1..100 %RH, 300..1100 hPa, -400..4000 m):
+ *
+ *                 altitude            44330.77 (1 - (p / p0)^0.1902632)       0.10 m
+ *                 sea-level pressure  p (1 - h / 44330.77)^-5.25588          1.5 Pa
+ *                 dew point           Magnus, b = 17.62, c = 243.12 C        0.01 C
+ *                 absolute humidity   216.74 e_s(T) RH / (273.15 + T)        0.01 %
+ *
+ *               The sea-level bound is the largest because the exponent
+ *               multiplies the fx_log2 error by five; it is still a tenth of
+ *               the BME280's own relative accuracy of 12 Pa. The absolute
+ *               humidity is relative error on top of the 0.01 g/m³ step.
+ *
+ *               The formulas themselves are approximations: the ISA
+ *               barometric formula assumes a standard atmosphere and Magnus
+ *               is within 0.35 C of the exact dew point from -45 to 60 C.
+ */
+#pragma once
+#include <stdint.h>
+#include "Sample.h"
+
+#define METRICS_STANDARD_PRESSURE_Q24_8 (101325u << 8)
+
+class DerivedMetrics {
+public:
+    ///@param station_altitude_cm Height of the sensor above sea level, for sea_level_pressure()
+    ///@param reference_pressure_q24_8 Sea-level pressure altitude() is measured from [Pa, Q24.8]
+    DerivedMetrics(int32_t station_altitude_cm = 0,
+                   uint32_t reference_pressure_q24_8 = METRICS_STANDARD_PRESSURE_Q24_8);
+
+    void set_station_altitude_cm(int32_t altitude_cm);
+    void set_reference_pressure_q24_8(uint32_t pressure);
+
+    ///@brief New input, results for the previous sample are forgotten
+    ///       Values as in Sample.h, from a SENSOR_BME280 or SENSOR_SCD30 sample.
+    void set_sample(const Sample &sample);
+
+    ///@brief False for an SCD30 sample, pressure metrics are then 0
+    bool has_pressure(void) const { return _has_pressure; }
+
+    ///@brief Barometric altitude [0.01 m]
+    int32_t altitude_cm(void);
+    ///@brief Pressure reduced to sea level from the station altitude [Pa, Q24.8]
+    uint32_t sea_level_pressure_q24_8(void);
+    ///@brief Dew point [0.01 °C]
+    int32_t dew_point_centidegrees(void);
+    ///@brief Absolute humidity [0.01 g/m³]
+    int32_t absolute_humidity_centigrams(void);
+
+    ///@brief Same formulas in double precision with libm, for tests and benchmarks
+    static double reference_altitude_m(double pressure_pa, double reference_pa);
+    static double reference_sea_level_pressure_pa(double pressure_pa, double altitude_m);
+    static double reference_dew_point_c(double temperature_c, double humidity_percent);
+    static double reference_absolute_humidity_g_m3(double temperature_c, double humidity_percent);
+
+private:
+    enum {
+        COMPUTED_ALTITUDE = 1 << 0,
+        COMPUTED_SEA_LEVEL = 1 << 1,
+        COMPUTED_MAGNUS = 1 << 2,
+        COMPUTED_DEW_POINT = 1 << 3,
+        COMPUTED_ABSOLUTE_HUMIDITY = 1 << 4,
+    };
+
+    int32_t magnus(void);
+
+    // Per configuration
+    int32_t _reference_log2;        // log2 of the reference pressure in Pa, Q8.24
+    uint32_t _sea_level_factor;     // (1 - h / 44330.77)^-5.25588 in Q8.24
+
+    // Per sample
+    int32_t _temperature;           // 0.01 °C
+    uint32_t _pressure;             // Pa, Q24.8
+    uint32_t _humidity;             // %RH, Q22.10
+    bool _has_pressure;
+    uint8_t _computed;
+
+    int32_t _altitude;
+    uint32_t _sea_level;
+    int32_t _magnus;                // b T / (c + T) of the Magnus formula, Q8.24
+    int32_t _dew_point;
+    int32_t _absolute_humidity;
+};
@@ -0,0 +1,89 @@
+/*
+ *  Title: FixedMath
+ *  Description: Table-driven log2 and exp2 in Q8.24.
+ */
+
+#include "FixedMath.h"
+
+// Series good to double precision on the ranges the tables need, so the
+// tables can be computed at compile time without libm
+static constexpr double const_ln(double x) {
+    // ln(x) = 2 atanh((x - 1) / (x + 1)), |z| <= 1/3 for x in [1, 2]
+    double z = (x - 1) / (x + 1);
+    double z2 = z * z;
+    double term = z;
+    double sum = 0;
+    for (int k = 0; k < 40; k++) {
+        sum += term / (2 * k + 1);
+        term *= z2;
+    }
+    return 2 * sum;
+}
+
+static constexpr double const_exp(double x) {
+    double term = 1;
+    double sum = 1;
+    for (int k = 1; k < 30; k++) {
+        term *= x / k;
+        sum += term;
+    }
+    return sum;
+}
+
+struct Log2Table {
+    uint32_t entries[257];      // log2(1 + i/256) in Q8.24
+
+    constexpr Log2Table() : entries() {
+        for (int i = 0; i <= 256; i++) {
+            entries[i] = (uint32_t)(const_ln(1.0 + i / 256.0) / const_ln(2.0) * FX_ONE + 0.5);
+        }
+    }
+};
+
+struct Exp2Table {
+    uint32_t entries[257];      // 2^(i/256) in Q8.24
+
+    constexpr Exp2Table() : entries() {
+        for (int i = 0; i <= 256; i++) {
+            entries[i] = (uint32_t)(const_exp(i / 256.0 * const_ln(2.0)) * FX_ONE + 0.5);
+        }
+    }
+};
+
+// Built by the compiler, live in flash on the Pico
+static constexpr Log2Table LOG2_TABLE;
+static constexpr Exp2Table EXP2_TABLE;
+
+int32_t fx_log2(uint32_t x, int frac_bits) {
+    if (x == 0) return INT32_MIN;
+
+    // x = 2^msb * m with m in [1, 2), m as Q1.31
+    int msb = 31 - __builtin_clz(x);
+    uint32_t m = x << (31 - msb);
+    uint32_t index = (m >> 23) & 0xFF;
+    uint32_t fraction = m & 0x7FFFFF;
+
+    uint32_t low = LOG2_TABLE.entries[index];
+    uint32_t high = LOG2_TABLE.entries[index + 1];
+    int32_t mantissa = (int32_t)(low + (uint32_t)(((uint64_t)(high - low) * fraction + (1 << 22)) >> 23));
+    return (int32_t)((msb - frac_bits) * FX_ONE) + mantissa;
+}
+
+uint32_t fx_exp2(int32_t y) {
+    int32_t whole = y >> 24;                    // Floor, also for negative y
+    uint32_t fraction = (uint32_t)y & 0xFFFFFF;
+    if (whole >= 8) return UINT32_MAX;
+    if (whole < -24) return 0;
+
+    uint32_t index = fraction >> 16;
+    uint32_t rest = fraction & 0xFFFF;
+    uint32_t low = EXP2_TABLE.entries[index];
+    uint32_t high = EXP2_TABLE.entries[index + 1];
+    uint32_t mantissa = low + (uint32_t)(((uint64_t)(high - low) * rest + (1 << 15)) >> 16);
+
+    if (whole >= 0) {
+        uint64_t result = (uint64_t)mantissa << whole;
+        return (result > UINT32_MAX) ? UINT32_MAX : (uint32_t)result;
+    }
+    return (mantissa + (1u << (-whole - 1))) >> -whole;
+}
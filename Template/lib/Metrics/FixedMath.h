@@ -0,0 +1,34 @@
+/*
+ *  Title: FixedMath
+ *  Description: Base-2 logarithm and exponential in Q8.24 fixed point, for
+ *               the M0+ cores that have no floating point unit. Both are a
+ *               257-entry table over one octave with linear interpolation
+ *               between entries; the tables are built by the compiler.
+ *
+ *               Interpolation error, from f''h^2/8 with h = 1/256:
+ *                 fx_log2   below 2.8e-6 (absolute)
+ *                 fx_exp2   below 1.9e-6 (relative)
+ *               plus rounding of the last Q24 bit.
+ */
+#pragma once
+#include <stdint.h>
+
+#define FX_ONE (1 << 24)                // 1.0 in Q8.24
+#define FX_LOG2E 24204406               // log2(e) in Q8.24
+#define FX_LN2 11629080                 // ln(2) in Q8.24
+
+///@brief log2 of a positive fixed-point number
+///@param x The number, must be greater than zero
+///@param frac_bits Fraction bits of x, e.g. 8 for a Q24.8 pressure
+///@return log2(x / 2^frac_bits) in Q8.24, INT32_MIN for x == 0
+int32_t fx_log2(uint32_t x, int frac_bits);
+
+///@brief 2 to the power y
+///@param y Exponent in Q8.24
+///@return 2^y in Q8.24, saturated to UINT32_MAX above 2^8
+uint32_t fx_exp2(int32_t y);
+
+///@brief Product of two Q8.24 numbers, rounded
+static inline int32_t fx_mul(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b + (1 << 23)) >> 24);
+}
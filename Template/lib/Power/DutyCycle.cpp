@@ -0,0 +1,118 @@
+/*
+ *  Title: DutyCycle
+ *  Description: Forced-mode sampling at the output rate with the MCU
+ *               asleep in between.
+ */
+
+#include "DutyCycle.h"
+#include "SensorTask.h"
+
+DutyCycle::DutyCycle(Clock *clock, EnergyMeter *meter) :
+    _clock(clock),
+    _meter(meter),
+    _bme(nullptr),
+    _scd(nullptr),
+    _callback(nullptr),
+    _context(nullptr),
+    _period_us(0),
+    _scd30_interval_s(0),
+    _next_sample_us(0),
+    _scd30_due_us(0),
+    _bme_sequence(0),
+    _scd_sequence(0),
+    _samples(0),
+    _scd30_samples(0),
+    _failures(0) {}
+
+uint32_t DutyCycle::scd30_interval_for(uint32_t period_us) {
+    uint32_t seconds = (period_us + 500000) / 1000000;
+    if (seconds < DUTY_CYCLE_SCD30_MIN_INTERVAL_S) return DUTY_CYCLE_SCD30_MIN_INTERVAL_S;
+    if (seconds > DUTY_CYCLE_SCD30_MAX_INTERVAL_S) return DUTY_CYCLE_SCD30_MAX_INTERVAL_S;
+    return seconds;
+}
+
+bool DutyCycle::begin(BME280 *bme, uint32_t period_us, SCD30 *scd, const BME280::Config &config) {
+    BME280::Config forced = config;
+    forced.mode = BME280::FORCED_MODE;
+    if (period_us < BME280::max_measurement_time_us(forced)) return false;
+
+    // configure() leaves a forced-mode sensor in sleep mode until the first start_measurement()
+    if (!bme->configure(forced)) return false;
+
+    _scd30_interval_s = 0;
+    if (scd != nullptr) {
+        uint32_t interval = scd30_interval_for(period_us);
+        if (!scd->setMeasurementInterval(interval)) return false;
+        _scd30_interval_s = interval;
+    }
+
+    _bme = bme;
+    _scd = scd;
+    _period_us = period_us;
+    _next_sample_us = _clock->time_us();
+    _scd30_due_us = _next_sample_us + (uint64_t)_scd30_interval_s * 1000000;
+    if (_meter != nullptr) _meter->set_scd30_interval(_scd30_interval_s);
+    return true;
+}
+
+void DutyCycle::set_callback(SampleCallback callback, void *context) {
+    _callback = callback;
+    _context = context;
+}
+
+bool DutyCycle::run_once(void) {
+    uint64_t now = _clock->time_us();
+    if (now < _next_sample_us) {
+        _clock->sleep_us(_next_sample_us - now);
+        now = _clock->time_us();
+    }
+    _next_sample_us += ((now - _next_sample_us) / _period_us + 1) * _period_us;
+
+    // measure_once() waits for the conversion on the same clock, so that time is sleep too
+    bool ok = _bme->measure_once();
+    if (_meter != nullptr) {
+        _meter->bme280_conversion(_bme->measurement_time_us());
+        _meter->sample();
+    }
+
+    if (ok) {
+        Sample sample = {};
+        sample.timestamp_us = _clock->time_us();
+        sample.sensor = SENSOR_BME280;
+        sample.sequence = _bme_sequence++;
+        BME280Task::fill_values(_bme, sample);
+        _samples++;
+        deliver(sample);
+    } else {
+        _failures++;
+    }
+
+    if (_scd != nullptr && now >= _scd30_due_us) sample_scd30(now);
+    return ok;
+}
+
+/// The SCD30 runs on its own timer, so its measurements drift against the
+/// wake-ups. The data-ready flag is only asked for once a measurement is due
+/// and then in every wake-up until it is there.
+void DutyCycle::sample_scd30(uint64_t now) {
+    if (!_scd->dataReady()) return;
+    if (!_scd->read()) {
+        _failures++;
+        return;
+    }
+
+    Sample sample = {};
+    sample.timestamp_us = _clock->time_us();
+    sample.sensor = SENSOR_SCD30;
+    sample.sequence = _scd_sequence++;
+    SCD30Task::fill_values(_scd, sample);
+    _scd30_samples++;
+    deliver(sample);
+
+    // Half a period early so the next measurement is picked up in the first wake-up after it
+    _scd30_due_us = now + (uint64_t)_scd30_interval_s * 1000000 - _period_us / 2;
+}
+
+void DutyCycle::deliver(Sample &sample) {
+    if (_callback != nullptr) _callback(sample, _context);
+}
@@ -0,0 +1,84 @@
+/*
+ *  Title: DutyCycle
+ *  Description: Low-power acquisition. The BME280 stays in sleep mode and
+ *               makes one forced-mode conversion per output sample; between
+ *               samples the MCU sleeps on the Clock until a timer alarm wakes
+ *               it. The SCD30 keeps its own continuous measurement, with the
+ *               interval set to the output period, and is only asked for data
+ *               in the wake-up after a new measurement is due.
+ *
+ *               All waiting goes through the Clock, so the sleep the MCU gets
+ *               is whatever the Clock implementation gives: the RP2040 sleep
+ *               state for PicoSleepClock, WFE with every clock running for
+ *               PicoClock, instant time travel for SimClock.
+ */
+#pragma once
+#include <stdint.h>
+#include "I2CBus.h"
+#include "BME280.h"
+#include "SCD30.h"
+#include "Sample.h"
+#include "EnergyMeter.h"
+
+#define DUTY_CYCLE_SCD30_MIN_INTERVAL_S 2       // Limits of SCD30 set_measurement_interval
+#define DUTY_CYCLE_SCD30_MAX_INTERVAL_S 1800
+
+class DutyCycle {
+public:
+    typedef void (*SampleCallback)(const Sample &sample, void *context);
+
+    ///@param clock Used for all waiting, pass the EnergyMeter here (and to the drivers) to count the sleep
+    ///@param meter Told about conversions and samples, may be nullptr
+    DutyCycle(Clock *clock, EnergyMeter *meter = nullptr);
+
+    ///@brief Put the BME280 in forced mode with the given oversampling and set the SCD30 interval
+    ///@param bme Initialised BME280
+    ///@param period_us Time between output samples, at least the longest conversion
+    ///@param scd Initialised SCD30 in continuous measurement, or nullptr
+    ///@param config Oversampling and filter, the mode is always forced
+    ///@return False if the period is too short or the sensors could not be configured
+    bool begin(BME280 *bme, uint32_t period_us, SCD30 *scd = nullptr,
+               const BME280::Config &config = BME280::WEATHER_MONITORING);
+
+    ///@brief Called with every sample, from run_once()
+    void set_callback(SampleCallback callback, void *context);
+
+    ///@brief Sleep until the next sample is due, take it and deliver it
+    ///       Slots missed because the caller was late are skipped, not caught up.
+    ///@return False if the BME280 sample failed
+    bool run_once(void);
+
+    uint32_t period_us(void) const { return _period_us; }
+    ///@brief Measurement interval set on the SCD30, 0 without one
+    uint32_t scd30_interval_s(void) const { return _scd30_interval_s; }
+    uint64_t next_sample_us(void) const { return _next_sample_us; }
+
+    uint32_t samples(void) const { return _samples; }
+    uint32_t scd30_samples(void) const { return _scd30_samples; }
+    uint32_t failures(void) const { return _failures; }
+
+    ///@brief SCD30 interval for an output period: rounded to seconds and clamped to what the sensor accepts
+    static uint32_t scd30_interval_for(uint32_t period_us);
+
+private:
+    void deliver(Sample &sample);
+    void sample_scd30(uint64_t now);
+
+    Clock *_clock;
+    EnergyMeter *_meter;
+    BME280 *_bme;
+    SCD30 *_scd;
+    SampleCallback _callback;
+    void *_context;
+
+    uint32_t _period_us;
+    uint32_t _scd30_interval_s;
+    uint64_t _next_sample_us;
+    uint64_t _scd30_due_us;
+
+    uint16_t _bme_sequence;
+    uint16_t _scd_sequence;
+    uint32_t _samples;
+    uint32_t _scd30_samples;
+    uint32_t _failures;
+};
@@ -0,0 +1,55 @@
+/*
+ *  Title: EnergyMeter
+ *  Description: Time per state and the charge it adds up to.
+ */
+
+#include "EnergyMeter.h"
+
+EnergyMeter::EnergyMeter(Clock *clock, const PowerModel &model) :
+    _clock(clock),
+    _model(model),
+    _start_us(0),
+    _slept_us(0),
+    _bme280_measuring_us(0),
+    _scd30_interval_s(0),
+    _samples(0) {
+    reset();
+}
+
+void EnergyMeter::sleep_us(uint64_t us) {
+    uint64_t start = _clock->time_us();
+    _clock->sleep_us(us);
+    _slept_us += _clock->time_us() - start;
+}
+
+void EnergyMeter::reset(void) {
+    _start_us = _clock->time_us();
+    _slept_us = 0;
+    _bme280_measuring_us = 0;
+    _samples = 0;
+}
+
+EnergyReport EnergyMeter::report(void) {
+    EnergyReport report = {};
+    report.elapsed_us = _clock->time_us() - _start_us;
+    report.mcu_active_us = report.elapsed_us - _slept_us;
+    report.bme280_measuring_us = (_bme280_measuring_us < report.elapsed_us) ? _bme280_measuring_us : report.elapsed_us;
+    report.samples = _samples;
+
+    // µA times µs is pC, divided by 1e6 gives µC
+    double elapsed = (double)report.elapsed_us;
+    double charge = _model.mcu_active_ua * (double)report.mcu_active_us +
+                    _model.mcu_sleep_ua * (double)_slept_us +
+                    _model.bme280_measuring_ua * (double)report.bme280_measuring_us +
+                    _model.bme280_sleep_ua * (elapsed - (double)report.bme280_measuring_us);
+    report.charge_uc = charge / 1e6;
+
+    if (_scd30_interval_s > 0) {
+        report.scd30_measurements = elapsed / 1e6 / _scd30_interval_s;
+        report.charge_uc += _model.scd30_base_ua * elapsed / 1e6 + _model.scd30_measurement_uc * report.scd30_measurements;
+    }
+
+    report.energy_uj = report.charge_uc * _model.supply_v;
+    report.average_ua = (report.elapsed_us > 0) ? report.charge_uc * 1e6 / elapsed : 0;
+    return report;
+}
@@ -0,0 +1,77 @@
+/*
+ *  Title: EnergyMeter
+ *  Description: Estimate of the charge and energy a node uses, from a
+ *               current model and the time spent in each state. It wraps
+ *               the Clock given to the drivers: every sleep_us() through
+ *               it is counted as MCU sleep, everything else (bus transfers,
+ *               compensation, output) as MCU active. The same code runs on
+ *               the Pico and on the host with the simulated clock.
+ *
+ *               The default currents are datasheet figures and rough board
+ *               numbers. Replace them with measured values for a real node.
+ */
+#pragma once
+#include <stdint.h>
+#include "I2CBus.h"
+
+struct PowerModel {
+    float supply_v;
+    float mcu_active_ua;            // RP2040 running at 125 MHz
+    float mcu_sleep_ua;             // RP2040 between samples, depends on the Clock, see the models below
+    float bme280_measuring_ua;      // During a conversion, pressure is the worst channel (datasheet section 1)
+    float bme280_sleep_ua;          // Sleep mode
+    float scd30_base_ua;            // SCD30 between measurements
+    float scd30_measurement_uc;     // Charge of one SCD30 measurement, base + this at 2 s is the datasheet 19 mA
+};
+
+// PicoSleepClock (PicoSleep.h): sleep state, clk_sys from the crystal, PLLs off, only the timer clocked.
+// Pico board figure at 3.3 V, the regulator and the flash included.
+static const PowerModel DEFAULT_POWER_MODEL = {3.3f, 24000.0f, 1300.0f, 714.0f, 0.1f, 5000.0f, 28000.0f};
+// PicoClock: the SDK sleep_us(), WFE with every clock and both PLLs running
+static const PowerModel WFE_POWER_MODEL = {3.3f, 24000.0f, 10000.0f, 714.0f, 0.1f, 5000.0f, 28000.0f};
+
+struct EnergyReport {
+    uint64_t elapsed_us;
+    uint64_t mcu_active_us;
+    uint64_t bme280_measuring_us;
+    uint32_t samples;
+    double scd30_measurements;
+    double charge_uc;               // Total charge drawn [µC]
+    double energy_uj;               // charge_uc times the supply voltage [µJ]
+    double average_ua;
+
+    double active_us_per_sample(void) const { return samples ? (double)mcu_active_us / samples : 0; }
+    double energy_uj_per_sample(void) const { return samples ? energy_uj / samples : 0; }
+    ///@brief Days a battery of the given capacity lasts at the average current
+    double battery_days(double capacity_mah) const { return average_ua > 0 ? capacity_mah * 1000.0 / average_ua / 24 : 0; }
+};
+
+class EnergyMeter : public Clock {
+public:
+    EnergyMeter(Clock *clock, const PowerModel &model = DEFAULT_POWER_MODEL);
+
+    uint64_t time_us(void) override { return _clock->time_us(); }
+    ///@brief Counted as MCU sleep
+    void sleep_us(uint64_t us) override;
+
+    ///@brief Forget everything counted so far and start again from now
+    void reset(void);
+
+    ///@brief A BME280 conversion of the given length was started
+    void bme280_conversion(uint32_t us) { _bme280_measuring_us += us; }
+    ///@brief SCD30 measurement interval in seconds, 0 if there is no SCD30
+    void set_scd30_interval(uint32_t seconds) { _scd30_interval_s = seconds; }
+    ///@brief One sample delivered
+    void sample(void) { _samples++; }
+
+    EnergyReport report(void);
+    const PowerModel &model(void) const { return _model; }
+private:
+    Clock *_clock;
+    PowerModel _model;
+    uint64_t _start_us;
+    uint64_t _slept_us;
+    uint64_t _bme280_measuring_us;
+    uint32_t _scd30_interval_s;
+    uint32_t _samples;
+};
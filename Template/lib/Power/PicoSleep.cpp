@@ -0,0 +1,98 @@
+/*
+ *  Title: PicoSleep
+ *  Description: RP2040 sleep state between samples, woken by a timer alarm.
+ */
+
+#include <pico/time.h>
+#include <hardware/clocks.h>
+#include <hardware/pll.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include <hardware/structs/scb.h>
+#include "PicoSleep.h"
+
+/// @brief Divider settings of a PLL, read back so it can be started again as it was
+struct PllSettings {
+    uint32_t refdiv;
+    uint32_t vco_hz;
+    uint32_t postdiv1;
+    uint32_t postdiv2;
+};
+
+static PllSettings read_pll(PLL pll) {
+    PllSettings settings;
+    settings.refdiv = pll->cs & PLL_CS_REFDIV_BITS;
+    // The PLLs run from the crystal, which also drives clk_ref
+    settings.vco_hz = clock_get_hz(clk_ref) / settings.refdiv * pll->fbdiv_int;
+    settings.postdiv1 = (pll->prim & PLL_PRIM_POSTDIV1_BITS) >> PLL_PRIM_POSTDIV1_LSB;
+    settings.postdiv2 = (pll->prim & PLL_PRIM_POSTDIV2_BITS) >> PLL_PRIM_POSTDIV2_LSB;
+    return settings;
+}
+
+static void start_pll(PLL pll, const PllSettings &settings) {
+    pll_init(pll, settings.refdiv, settings.vco_hz, settings.postdiv1, settings.postdiv2);
+}
+
+/// The alarm only has to raise an interrupt, the wait loop checks the time itself
+static void on_alarm(uint) {}
+
+bool PicoSleepClock::begin(void) {
+    _alarm = hardware_alarm_claim_unused(false);
+    if (_alarm < 0) return false;
+    hardware_alarm_set_callback((uint)_alarm, on_alarm);
+    return true;
+}
+
+uint64_t PicoSleepClock::time_us(void) {
+    return time_us_64();
+}
+
+void PicoSleepClock::sleep_us(uint64_t us) {
+    if (_alarm < 0 || us < PICO_SLEEP_MIN_US || (_keep_awake != nullptr && _keep_awake())) {
+        ::sleep_us(us);
+        return;
+    }
+
+    absolute_time_t now = get_absolute_time();
+    absolute_time_t end = delayed_by_us(now, us);
+    absolute_time_t wake = delayed_by_us(now, us - PICO_SLEEP_WAKE_US);
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+    uint32_t ref_hz = clock_get_hz(clk_ref);
+    PllSettings sys_pll = read_pll(pll_sys);
+    PllSettings usb_pll = read_pll(pll_usb);
+
+    // clk_sys (and clk_peri behind it) to the crystal, then nothing needs the PLLs
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF, 0, ref_hz, ref_hz);
+    pll_deinit(pll_sys);
+    pll_deinit(pll_usb);
+
+    // In deep sleep only the timer, and the watchdog tick that counts for it, keep their clocks
+    uint32_t sleep_en0 = clocks_hw->sleep_en0;
+    uint32_t sleep_en1 = clocks_hw->sleep_en1;
+    clocks_hw->sleep_en0 = 0;
+    clocks_hw->sleep_en1 = CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS | CLOCKS_SLEEP_EN1_CLK_SYS_WATCHDOG_BITS;
+    uint32_t scr = scb_hw->scr;
+    scb_hw->scr = scr | M0PLUS_SCR_SLEEPDEEP_BITS;
+
+    // WFI returns on a pending interrupt even with interrupts masked, so the
+    // alarm cannot fire between the time check and the WFI and be missed.
+    uint32_t interrupts = save_and_disable_interrupts();
+    if (!hardware_alarm_set_target((uint)_alarm, wake)) {
+        while (absolute_time_diff_us(get_absolute_time(), wake) > 0) {
+            __wfi();
+            restore_interrupts(interrupts);
+            interrupts = save_and_disable_interrupts();
+        }
+    }
+    restore_interrupts(interrupts);
+
+    scb_hw->scr = scr;
+    clocks_hw->sleep_en0 = sleep_en0;
+    clocks_hw->sleep_en1 = sleep_en1;
+
+    start_pll(pll_usb, usb_pll);
+    start_pll(pll_sys, sys_pll);
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                    CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, sys_hz, sys_hz);
+    sleep_until(end);
+}
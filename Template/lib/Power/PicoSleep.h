@@ -0,0 +1,45 @@
+/*
+ *  Title: PicoSleep
+ *  Description: Clock that puts the RP2040 in its sleep state between
+ *               samples, with the base SDK only. For a wait of at least
+ *               PICO_SLEEP_MIN_US, clk_sys moves to the crystal and both PLLs
+ *               stop. The SLEEP_EN registers then gate every clock except
+ *               the timer's, and the core waits in deep sleep (WFI) for a
+ *               timer alarm. On wake-up the PLLs are brought back with the
+ *               settings they had, and the last PICO_SLEEP_WAKE_US are
+ *               waited out at full speed so the wait ends on time.
+ *
+ *               Other interrupts wake the core as well. It goes straight
+ *               back to sleep until the alarm, still running from the
+ *               crystal. Shorter waits, and every wait while keep_awake()
+ *               says so (e.g. a USB host is connected and needs the USB
+ *               clocks), fall back to the SDK sleep_us(), which is WFE with
+ *               every clock running.
+ *
+ *               Core 1 must not be running, its clocks would stop under it.
+ */
+#pragma once
+#include <stdint.h>
+#include "I2CBus.h"
+
+#define PICO_SLEEP_MIN_US 2000      // Shorter waits are not worth stopping the PLLs for
+#define PICO_SLEEP_WAKE_US 500      // Woken this early to relock the PLLs
+
+class PicoSleepClock : public Clock {
+public:
+    typedef bool (*KeepAwake)(void);
+
+    ///@param keep_awake Asked before each wait, true keeps every clock running, may be nullptr
+    PicoSleepClock(KeepAwake keep_awake = nullptr) : _keep_awake(keep_awake), _alarm(-1) {}
+
+    ///@brief Claim a timer alarm for the wake-up, call once after the SDK is up
+    ///@return False if no alarm is free, every wait then falls back to sleep_us()
+    bool begin(void);
+
+    uint64_t time_us(void) override;
+    void sleep_us(uint64_t us) override;
+
+private:
+    KeepAwake _keep_awake;
+    int _alarm;
+};
@@ -4,21 +4,36 @@
  *  Author: Mani Magnusson
  */
 
-#include <string.h>
 #include <stdio.h>
-#include <hardware/i2c.h>
+#include <SensirionProtocol.h>
 #include "SCD30.h"
 
-static uint8_t crc8(const uint8_t *data, int len);
-
 ///@brief Construct a new SCD30::SCD30 object
-///@param *i2c
-///       The I2C hardware instance to be used
+///@param *bus
+///       The I2C bus to be used
+///@param *clock
+///       Clock used for the delays required by the datasheet
 ///@param addr
 ///       The I2C address for the sensor, defaulted to 0x61 (optional)
-SCD30::SCD30(i2c_inst_t *i2c, uint8_t addr) {
-    _i2c = i2c;
+SCD30::SCD30(I2CBus *bus, Clock *clock, uint8_t addr) {
+    _bus = bus;
+    _clock = clock;
     SCD30_ADDRESS = addr;
+    _interval_us = 2000000;
+    _transfer = I2CTransfer();
+    _async_command = 0;
+    _response_len = 0;
+    _step = STEP_IDLE;
+    _response_at = 0;
+    _read_state = READ_IDLE;
+    _read_callback = nullptr;
+    _read_context = nullptr;
+    _events = false;
+    _event_source = EVENTS_TIMED;
+    _data_ready_event = false;
+    _next_check_at = 0;
+    _event_callback = nullptr;
+    _event_context = nullptr;
 }
 
 
@@ -42,7 +57,7 @@ bool SCD30::init(void) {
 ///@brief Soft reset the SCD30 sensor
 void SCD30::reset(void) {
     sendCommand(SCD30_CMD_SOFT_RESET);
-    sleep_ms(30);
+    _clock->sleep_ms(30);
 }
 
 ///@brief Ask the sensor if new data is ready to be read
@@ -55,53 +70,233 @@ bool SCD30::dataReady(void) {
 ///@return True if data read successful, false if otherwise
 bool SCD30::read(void) {
     uint8_t buffer[18];
+    TraceSpan span(TRACE_SCD30_READ, SCD30_ADDRESS, _clock);
 
     for(int i = 0; i < 18; i++) buffer[i] = 0x00;
     
-    buffer[0] = (SCD30_CMD_READ_MEASUREMENT >> 8) & 0xFF;
-    buffer[1] = SCD30_CMD_READ_MEASUREMENT & 0xFF;
+    size_t len = sensirion_encode_command(SCD30_CMD_READ_MEASUREMENT, nullptr, 0, buffer);
 
-    i2c_write_timeout_us(_i2c, SCD30_ADDRESS, buffer, 2, false, 10000);
-    
-    sleep_ms(4); // Delay between write and read specified by datasheet as 4 ms
+    int result = _bus->write(SCD30_ADDRESS, buffer, len, false, timeout(len));
+    span.transfer(result, len);
+    if (result != (int)len) {
+        return span.finish(false);
+    }
+
+    _clock->sleep_ms(4); // Delay between write and read specified by datasheet as 4 ms
+
+    result = _bus->read(SCD30_ADDRESS, buffer, 18, false, timeout(18));
+    span.transfer(result, 18);
+    if (result != 18) {
+        return span.finish(false);
+    }
+
+    if (!parseMeasurement(buffer)) {
+        span.crc_error();
+        return span.finish(false);
+    }
+    return span.finish(true);
+}
+
+///@brief Start reading data from the sensor without blocking
+///       The command is sent in the background, the 4 ms delay the datasheet
+///       asks for is timed by pollRead() and the response is then read in
+///       the background as well.
+///@param callback
+///       Called when the read finishes (optional)
+///@param context
+///       Passed unchanged to the callback (optional)
+///@return True if the read was started, false if one is already in progress or the bus is busy
+bool SCD30::startRead(ReadCallback callback, void* context) {
+    if (_step != STEP_IDLE) return false;
+
+    _read_callback = callback;
+    _read_context = context;
+    _read_state = READ_PENDING;
+
+    if (!startAsync(SCD30_CMD_READ_MEASUREMENT, 18)) {
+        _read_state = READ_FAILED;
+        return false;
+    }
+    return true;
+}
+
+///@brief Advance a read started with startRead(), never blocks
+///@return READ_READY when new values are available, READ_PENDING while in progress
+SCD30::ReadState SCD30::pollRead(void) {
+    advance();
+    return _read_state;
+}
+
+///@brief Start delivering measurements without blocking or polling the sensor
+///       With EVENTS_RDY_PIN a read is started after notifyDataReady(). If no
+///       edge arrives for two measurement intervals one data ready check is
+///       made, so a missed edge does not stop the measurements. With
+///       EVENTS_TIMED data ready is asked once per measurement interval, and
+///       again every SCD30_READY_RETRY_US until the new data is there.
+///       Nothing happens unless service() is called, at the latest at
+///       nextServiceUs().
+///@param source
+///       What tells the driver that new data is ready
+///@param callback
+///       Called from service() with each finished read
+///@param context
+///       Passed unchanged to the callback (optional)
+///@return True if event mode was started, false if a read is in progress
+bool SCD30::beginEvents(EventSource source, ReadCallback callback, void* context) {
+    if (_step != STEP_IDLE) return false;
+
+    _event_source = source;
+    _event_callback = callback;
+    _event_context = context;
+    _data_ready_event = false;
+    _next_check_at = _clock->time_us() + ((source == EVENTS_RDY_PIN) ? 2 * (uint64_t)_interval_us : 0);
+    _events = true;
+    return true;
+}
+
+///@brief Stop event mode, a read in progress still finishes
+void SCD30::endEvents(void) {
+    _events = false;
+}
+
+///@brief Run the event mode state machine, never blocks
+///       Call from the main loop whenever an interrupt has woken it (RDY pin
+///       or I2C completion) and at nextServiceUs().
+void SCD30::service(void) {
+    advance();
+    if (!_events || _step != STEP_IDLE) return;
+
+    if (_data_ready_event) {
+        if (startRead(_event_callback, _event_context)) {
+            _data_ready_event = false;
+        }
+    } else if (_clock->time_us() >= _next_check_at) {
+        // If the bus is taken this is tried again on the next service
+        startAsync(SCD30_CMD_GET_DATA_READY, 3);
+    }
+}
+
+///@brief Time at which service() has to run next
+///@return Time in microseconds on the driver clock, UINT64_MAX if only an interrupt can make progress
+uint64_t SCD30::nextServiceUs(void) {
+    if (_step == STEP_DELAY) return _response_at;
+    // The completion interrupt wakes the caller earlier, this is the timeout
+    if (_step != STEP_IDLE) return _clock->time_us() + _transfer.timeout_us;
+    if (!_events) return UINT64_MAX;
+    if (_data_ready_event) return _clock->time_us();
+    return _next_check_at;
+}
+
+///@brief Send a command and read its response in the background
+///@param command
+///       Command register, 2 bytes long
+///@param response_len
+///       Number of bytes in the response, at most 18
+///@return True if the command transfer was started, false if busy
+bool SCD30::startAsync(uint16_t command, size_t response_len) {
+    if (_step != STEP_IDLE) return false;
+
+    sensirion_encode_command(command, nullptr, 0, _transfer_buffer);
+
+    _transfer.address = SCD30_ADDRESS;
+    _transfer.tx = _transfer_buffer;
+    _transfer.tx_len = SENSIRION_COMMAND_LENGTH;
+    _transfer.rx = nullptr;
+    _transfer.rx_len = 0;
+    _transfer.timeout_us = timeout(response_len);
+    _transfer.callback = onTransferComplete;
+    _transfer.context = this;
+
+    _async_command = command;
+    _response_len = response_len;
+    _step = STEP_COMMAND;
+    if (command == SCD30_CMD_READ_MEASUREMENT) _read_span = TraceSpan(TRACE_SCD30_READ, SCD30_ADDRESS, _clock);
+
+    if (!_bus->start_transfer(&_transfer)) {
+        _step = STEP_IDLE;
+        _read_span.finish(false);
+        return false;
+    }
+    return true;
+}
 
-    i2c_read_timeout_us(_i2c, SCD30_ADDRESS, buffer, 18, false, 10000);
+///@brief Poll the bus and start the response transfer once the command delay has passed
+void SCD30::advance(void) {
+    _bus->poll();
+
+    if (_step == STEP_DELAY && _clock->time_us() >= _response_at) {
+        _transfer.tx = nullptr;
+        _transfer.tx_len = 0;
+        _transfer.rx = _transfer_buffer;
+        _transfer.rx_len = _response_len;
+        _step = STEP_RESPONSE;
+        if (!_bus->start_transfer(&_transfer)) {
+            // Bus taken by another transfer, try again on the next poll
+            _step = STEP_DELAY;
+        }
+    }
+}
 
-    for(uint8_t i = 0; i < 18; i += 3) {
-        if(crc8(buffer + i, 2) != buffer[i+2]) {
-            return false; // Aw shit we got a bad CRC
+///@brief Completion of the command and response transfers of startAsync()
+///@param *transfer
+///       The finished transfer, context points to the SCD30 object
+void SCD30::onTransferComplete(I2CTransfer *transfer) {
+    SCD30 *sensor = (SCD30 *)transfer->context;
+    bool success = (transfer->result == (int)(transfer->tx_len + transfer->rx_len));
+    if (sensor->_async_command == SCD30_CMD_READ_MEASUREMENT) {
+        sensor->_read_span.transfer(transfer->result, transfer->tx_len + transfer->rx_len);
+    }
+
+    if (success && sensor->_step == STEP_COMMAND) {
+        sensor->_response_at = sensor->_clock->time_us() + SCD30_COMMAND_DELAY_US;
+        sensor->_step = STEP_DELAY;
+    } else if (sensor->_async_command == SCD30_CMD_GET_DATA_READY) {
+        uint16_t word;
+        bool ready = success && sensirion_decode_words(sensor->_transfer_buffer, 1, &word) == 0 && word == 1;
+        sensor->_step = STEP_IDLE;
+        if (ready) {
+            sensor->_data_ready_event = true;
+        } else {
+            sensor->_next_check_at = sensor->_clock->time_us() + SCD30_READY_RETRY_US;
         }
+    } else {
+        bool parsed = success && sensor->parseMeasurement(sensor->_transfer_buffer);
+        if (success && !parsed) sensor->_read_span.crc_error();
+        sensor->finishRead(parsed);
+    }
+}
+
+///@brief End an asynchronous read and report the result
+///@param success
+///       True if new values were stored
+void SCD30::finishRead(bool success) {
+    _step = STEP_IDLE;
+    _read_span.finish(success);
+    _read_state = success ? READ_READY : READ_FAILED;
+    if (_events) {
+        // Next data is one interval away, the RDY pin only needs a fallback check
+        uint64_t wait = success ? _interval_us : SCD30_READY_RETRY_US;
+        if (success && _event_source == EVENTS_RDY_PIN) wait *= 2;
+        _next_check_at = _clock->time_us() + wait;
+    }
+    if (_read_callback != nullptr) {
+        _read_callback(this, success, _read_context);
+    }
+}
+
+///@brief Check the CRCs of a measurement response and store the values
+///@param *buffer
+///       The 18 bytes read after SCD30_CMD_READ_MEASUREMENT
+///@return True if all CRCs matched, false otherwise
+bool SCD30::parseMeasurement(const uint8_t *buffer) {
+    uint16_t words[6];
+    if (sensirion_decode_words(buffer, 6, words) != 0) {
+        return false; // Aw shit we got a bad CRC
     }
 
-    uint32_t co2 = 0, temp = 0, hum = 0;
-
-    co2 |= buffer[0];
-    co2 <<= 8;
-    co2 |= buffer[1];
-    co2 <<= 8;
-    co2 |= buffer[3];
-    co2 <<= 8;
-    co2 |= buffer[4];
-
-    temp |= buffer[6];
-    temp <<= 8;
-    temp |= buffer[7];
-    temp <<= 8;
-    temp |= buffer[9];
-    temp <<= 8;
-    temp |= buffer[10];
-
-    hum |= buffer[12];
-    hum <<= 8;
-    hum |= buffer[13];
-    hum <<= 8;
-    hum |= buffer[15];
-    hum <<= 8;
-    hum |= buffer[16];
-
-    memcpy(&CO2, &co2, sizeof(CO2));
-    memcpy(&temperature, &temp, sizeof(temperature));
-    memcpy(&relative_humidity, &hum, sizeof(relative_humidity));
+    CO2 = sensirion_words_to_float(words);
+    temperature = sensirion_words_to_float(words + 2);
+    relative_humidity = sensirion_words_to_float(words + 4);
 
     return true;
 }
@@ -114,7 +309,11 @@ bool SCD30::setMeasurementInterval(uint16_t interval) {
     if ((interval < 2) || (interval > 1800)) {
         return false;
     }
-    return sendCommand(SCD30_CMD_SET_MEASUREMENT_INTERVAL, interval);
+    if (!sendCommand(SCD30_CMD_SET_MEASUREMENT_INTERVAL, interval)) {
+        return false;
+    }
+    _interval_us = (uint32_t)interval * 1000000;
+    return true;
 }
 
 ///@brief Ask the sensor what the current measurement interval is
@@ -189,14 +388,10 @@ uint16_t SCD30::getForcedCalibrationWithReference(void) {
 ///       Argument for command, 2 bytes long
 ///@return True if command successful, false otherwise
 bool SCD30::sendCommand(uint16_t command, uint16_t argument) {
-    uint8_t buffer[5];
-    buffer[0] = (command >> 8) & 0xFF;
-    buffer[1] = command & 0xFF;
-    buffer[2] = argument >> 8;
-    buffer[3] = argument & 0xFF;
-    buffer[4] = crc8(buffer + 2, 2);
+    uint8_t buffer[SENSIRION_COMMAND_LENGTH + SENSIRION_WORD_LENGTH];
+    size_t len = sensirion_encode_command(command, &argument, 1, buffer);
 
-    return (i2c_write_timeout_us(_i2c, SCD30_ADDRESS, buffer, 5, false, 10000) == 5);
+    return (_bus->write(SCD30_ADDRESS, buffer, len, false, timeout(len)) == (int)len);
 }
 
 ///@brief Send I2C command to the sensor
@@ -204,47 +399,51 @@ bool SCD30::sendCommand(uint16_t command, uint16_t argument) {
 ///       Command register, 2 bytes long
 ///@return True if command successful, false otherwise
 bool SCD30::sendCommand(uint16_t command) {
-    uint8_t buffer[2];
-    buffer[0] = (command >> 8) & 0xFF;
-    buffer[1] = command & 0xFF;
-    
-    return (i2c_write_timeout_us(_i2c, SCD30_ADDRESS, buffer, 5, false, 10000) == 2); // FIX that 5, should be 2??? Check with logic analyzer
+    uint8_t buffer[SENSIRION_COMMAND_LENGTH];
+    size_t len = sensirion_encode_command(command, nullptr, 0, buffer);
+
+    return (_bus->write(SCD30_ADDRESS, buffer, len, false, timeout(len)) == (int)len);
 }
 
 ///@brief Read sensor register
 ///@param reg_address
 ///       Register address, 2 bytes long
-///@return Register contents, 2 bytes long
+///@return Register contents, 2 bytes long, 0 if the bus failed or the CRC did not match
 uint16_t SCD30::readRegister(uint16_t reg_address) {
-    uint8_t buffer[2];
-    buffer[0] = (reg_address >> 8) & 0xFF;
-    buffer[1] = reg_address & 0xFF;
-
-    i2c_write_timeout_us(_i2c, SCD30_ADDRESS, buffer, 2, false, 10000);
+    uint8_t buffer[SENSIRION_WORD_LENGTH];
+    TraceSpan span(TRACE_SCD30_REGISTER, SCD30_ADDRESS, _clock);
+    sensirion_encode_command(reg_address, nullptr, 0, buffer);
+
+    int result = _bus->write(SCD30_ADDRESS, buffer, SENSIRION_COMMAND_LENGTH, false, timeout(SENSIRION_COMMAND_LENGTH));
+    span.transfer(result, SENSIRION_COMMAND_LENGTH);
+    if (result != SENSIRION_COMMAND_LENGTH) {
+        span.finish(false);
+        return 0;
+    }
 
-    sleep_ms(4); // Good ol delay from the datasheet
+    _clock->sleep_ms(4); // Good ol delay from the datasheet
 
-    i2c_read_timeout_us(_i2c, SCD30_ADDRESS, buffer, 2, false, 10000);
+    result = _bus->read(SCD30_ADDRESS, buffer, SENSIRION_WORD_LENGTH, false, timeout(SENSIRION_WORD_LENGTH));
+    span.transfer(result, SENSIRION_WORD_LENGTH);
+    if (result != SENSIRION_WORD_LENGTH) {
+        span.finish(false);
+        return 0;
+    }
 
-    return (uint16_t)(buffer[0] << 8 | (buffer[1] & 0xFF));
+    uint16_t word;
+    if (sensirion_decode_words(buffer, 1, &word) != 0) {
+        span.crc_error();
+        span.finish(false);
+        return 0;
+    }
+    span.finish(true);
+    return word;
 }
 
-///@brief Calculate CRC8 checksum
-///@param *data
-///       Pointer to data to calculate checksum for
+///@brief Timeout for a transfer to the sensor, allowing for its clock stretching
 ///@param len
-///       Length of data in bytes
-///@return Checksum byte
-static uint8_t crc8(const uint8_t *data, int len) {
-    const uint8_t POLYNOMIAL(0x31);
-    uint8_t crc(0xFF);
-
-    for(int j = len; j; --j) {
-        crc ^= *data++;
-
-        for(int i = 8; i; --i) {
-            crc = (crc & 0x80) ? (crc << 1) ^ POLYNOMIAL : (crc << 1);
-        }
-    }
-    return crc;
+///       Number of bytes in the transfer
+///@return Timeout in microseconds
+uint32_t SCD30::timeout(size_t len) {
+    return _bus->transfer_timeout_us(len, SCD30_MAX_CLOCK_STRETCH_US);
 }
\ No newline at end of file
@@ -4,7 +4,8 @@
  *  Author: Mani Magnusson
  */
 #pragma once
-#include <hardware/i2c.h>
+#include <I2CBus.h>
+#include <Trace.h>
 
 #define SCD30_DEFAULT_I2CADDR 0x61
 #define SCD30_CHIP_ID 0x60
@@ -22,14 +23,43 @@
 #define SCD30_CMD_SOFT_RESET 0xD304                     // Soft reset
 #define SCD30_CMD_READ_REVISION 0xD100                  // Firmware revision number
 
+#define SCD30_COMMAND_DELAY_US 4000                     // Delay between a command and reading its response
+#define SCD30_MAX_CLOCK_STRETCH_US 30000                // Clock stretching allowed by the interface description
+#define SCD30_READY_RETRY_US 100000                     // Event mode: wait before asking again when data was not ready
+
 class SCD30 {
 public:
-    SCD30(i2c_inst_t* i2c, uint8_t addr = SCD30_DEFAULT_I2CADDR);
+    enum ReadState {
+        READ_IDLE,      // No asynchronous read has been started
+        READ_PENDING,   // Command, delay or response still in progress
+        READ_READY,     // New values are in CO2, temperature and relative_humidity
+        READ_FAILED     // Bus error or bad CRC
+    };
+
+    enum EventSource {
+        EVENTS_RDY_PIN, // notifyDataReady() is called from the RDY pin interrupt
+        EVENTS_TIMED    // No RDY pin, data ready is asked once per measurement interval
+    };
+
+    ///@brief Called from I2CBus::poll() when a read started with startRead() finishes
+    typedef void (*ReadCallback)(SCD30* sensor, bool success, void* context);
+
+    SCD30(I2CBus* bus, Clock* clock, uint8_t addr = SCD30_DEFAULT_I2CADDR);
     bool init(void);
 
     void reset(void);
     bool dataReady(void);
     bool read(void);
+    bool startRead(ReadCallback callback = nullptr, void* context = nullptr);
+    ReadState pollRead(void);
+
+    bool beginEvents(EventSource source, ReadCallback callback, void* context = nullptr);
+    void endEvents(void);
+    void service(void);
+    uint64_t nextServiceUs(void);
+
+    ///@brief Tell the driver new data is ready, safe to call from the RDY pin interrupt
+    void notifyDataReady(void) { _data_ready_event = true; }
 
     bool setMeasurementInterval(uint16_t interval);
     uint16_t getMeasurementInterval(void);
@@ -48,10 +78,41 @@ public:
 
     float CO2, temperature, relative_humidity;
 private:
-    i2c_inst_t* _i2c;
+    I2CBus* _bus;
+    Clock* _clock;
     uint8_t SCD30_ADDRESS;
 
+    uint32_t _interval_us;
+
+    // Asynchronous command: command transfer, delay, response transfer
+    enum AsyncStep { STEP_IDLE, STEP_COMMAND, STEP_DELAY, STEP_RESPONSE };
+    I2CTransfer _transfer;
+    uint8_t _transfer_buffer[18];
+    uint16_t _async_command;
+    size_t _response_len;
+    AsyncStep _step;
+    uint64_t _response_at;
+    ReadState _read_state;
+    ReadCallback _read_callback;
+    void* _read_context;
+    TraceSpan _read_span;
+
+    // Event mode: reads are started by the RDY pin or a timed data ready check
+    bool _events;
+    EventSource _event_source;
+    volatile bool _data_ready_event;
+    uint64_t _next_check_at;
+    ReadCallback _event_callback;
+    void* _event_context;
+
+    bool startAsync(uint16_t command, size_t response_len);
+    void advance(void);
+    bool parseMeasurement(const uint8_t *buffer);
+    void finishRead(bool success);
+    static void onTransferComplete(I2CTransfer *transfer);
+
     bool sendCommand(uint16_t command, uint16_t argument);
     bool sendCommand(uint16_t command);
     uint16_t readRegister(uint16_t reg_address);
+    uint32_t timeout(size_t len);
 };
\ No newline at end of file
@@ -0,0 +1,28 @@
+/*
+ *  Title: Sample
+ *  Description: One compensated, timestamped reading from any of the
+ *               sensors. Values are fixed point so a sample can be produced,
+ *               queued and stored without floating point on the M0+ cores.
+ *
+ *               SENSOR_BME280: values[0] temperature [0.01 °C]
+ *                              values[1] pressure [Pa, Q24.8]
+ *                              values[2] relative humidity [%RH, Q22.10]
+ *               SENSOR_SCD30:  values[0] CO2 [0.01 ppm]
+ *                              values[1] temperature [0.01 °C]
+ *                              values[2] relative humidity [0.01 %RH]
+ */
+#pragma once
+#include <stdint.h>
+
+#define SENSOR_BME280 1
+#define SENSOR_SCD30 2
+
+#define SAMPLE_VALUE_COUNT 3
+
+struct Sample {
+    uint64_t timestamp_us;              // Time the values were read, µs since boot
+    uint8_t sensor;                     // SENSOR_*
+    uint8_t channel;                    // Instance of the sensor, 0 if there is only one
+    uint16_t sequence;                  // Per-producer counter, gaps show lost samples
+    int32_t values[SAMPLE_VALUE_COUNT]; // Meaning depends on sensor, see above
+};
@@ -0,0 +1,58 @@
+/*
+ *  Title: SampleHistory
+ *  Description: Statically sized history of the samples of one sensor,
+ *               with windowed statistics kept up to date for every value of
+ *               the sample. Two windows per value, a short and a long one
+ *               (the dashboards ask for the last 60 s and the last 10 min).
+ *
+ *               HISTORY is the number of raw samples kept, SHORT and LONG
+ *               the capacities of the two windows. Each window keeps one
+ *               timestamp per entry for all the values of the sample.
+ */
+#pragma once
+#include "Sample.h"
+#include "WindowStats.h"
+
+template <size_t HISTORY, size_t SHORT, size_t LONG>
+class SampleHistory {
+public:
+    SampleHistory(uint64_t short_window_us, uint64_t long_window_us) :
+        _count(0),
+        _next(0),
+        _short(short_window_us),
+        _long(long_window_us) {}
+
+    ///@brief Store a sample, the oldest one is overwritten when the history is full
+    void add(const Sample &sample) {
+        _samples[_next] = sample;
+        _next = (_next + 1) % HISTORY;
+        if (_count < HISTORY) _count++;
+
+        _short.add(sample.timestamp_us, sample.values);
+        _long.add(sample.timestamp_us, sample.values);
+    }
+
+    ///@brief Drop entries that have left the windows, for when samples stop coming
+    void expire(uint64_t now_us) {
+        _short.expire(now_us);
+        _long.expire(now_us);
+    }
+
+    ///@brief Number of samples in the history
+    size_t size(void) const { return _count; }
+
+    ///@brief Sample by age, 0 is the oldest and size() - 1 the newest
+    const Sample &at(size_t i) const { return _samples[(_next + HISTORY - _count + i) % HISTORY]; }
+
+    const Sample &latest(void) const { return at(_count - 1); }
+
+    WindowSummary short_summary(int value) const { return _short.summary(value); }
+    WindowSummary long_summary(int value) const { return _long.summary(value); }
+
+private:
+    Sample _samples[HISTORY];
+    size_t _count;
+    size_t _next;
+    WindowStats<SHORT, SAMPLE_VALUE_COUNT> _short;
+    WindowStats<LONG, SAMPLE_VALUE_COUNT> _long;
+};
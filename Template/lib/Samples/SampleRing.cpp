@@ -0,0 +1,43 @@
+/*
+ *  Title: SampleRing
+ *  Description: Lock-free single-producer/single-consumer queue of samples.
+ */
+
+#include "SampleRing.h"
+
+SampleRing::SampleRing() : _head(0), _tail(0), _overflows(0), _high_water(0) {}
+
+bool SampleRing::push(const Sample &sample) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+    uint32_t used = head - tail;
+
+    if (used >= CAPACITY) {
+        // Only the producer writes the counter, so load + store is enough
+        _overflows.store(_overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    _slots[head % CAPACITY] = sample;
+    _head.store(head + 1, std::memory_order_release);
+
+    if (used + 1 > _high_water.load(std::memory_order_relaxed)) {
+        _high_water.store(used + 1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool SampleRing::pop(Sample &sample) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t head = _head.load(std::memory_order_acquire);
+
+    if (head == tail) return false;
+
+    sample = _slots[tail % CAPACITY];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+uint32_t SampleRing::size(void) const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+}
@@ -0,0 +1,58 @@
+/*
+ *  Title: SampleRing
+ *  Description: Lock-free single-producer/single-consumer queue of samples.
+ *               Meant for handing samples from the acquisition core to the
+ *               core that formats and sends them. push() never blocks: when
+ *               the queue is full the new sample is dropped and counted, so
+ *               a slow consumer can not stall sampling.
+ *
+ *               Only 32-bit atomic loads and stores are used. The Cortex-M0+
+ *               has no exclusive access instructions, so read-modify-write
+ *               atomics would not be lock-free there.
+ */
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include "Sample.h"
+
+// Number of slots, must be a power of two
+#ifndef SAMPLE_RING_CAPACITY
+#define SAMPLE_RING_CAPACITY 64
+#endif
+
+class SampleRing {
+public:
+    static const uint32_t CAPACITY = SAMPLE_RING_CAPACITY;
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SAMPLE_RING_CAPACITY must be a power of two");
+
+    SampleRing();
+
+    ///@brief Queue a sample, producer side only
+    ///@return False if the queue was full and the sample was dropped
+    bool push(const Sample &sample);
+
+    ///@brief Take the oldest sample, consumer side only
+    ///@return False if the queue was empty
+    bool pop(Sample &sample);
+
+    ///@brief Number of queued samples, exact only from the producer or consumer side
+    uint32_t size(void) const;
+
+    ///@brief Number of samples dropped because the queue was full
+    uint32_t overflows(void) const { return _overflows.load(std::memory_order_relaxed); }
+
+    ///@brief Largest number of samples that were queued at once
+    uint32_t high_water(void) const { return _high_water.load(std::memory_order_relaxed); }
+
+private:
+    Sample _slots[CAPACITY];
+
+    // Free-running indices, slot = index % CAPACITY. Head is only written by
+    // the producer, tail only by the consumer.
+    alignas(64) std::atomic<uint32_t> _head;
+    alignas(64) std::atomic<uint32_t> _tail;
+
+    // Producer-side statistics
+    std::atomic<uint32_t> _overflows;
+    std::atomic<uint32_t> _high_water;
+};
@@ -0,0 +1,180 @@
+/*
+ *  Title: SampleRollup
+ *  Description: Cascading downsampling of one sensor's samples into 1 s,
+ *               1 min and 1 h buckets, each with count, min, max, mean and
+ *               last for every value of the sample.
+ *
+ *               A sample is folded into the open second only. When time
+ *               moves on, the open bucket is stored in its level's ring and
+ *               folded into the open bucket one level up, so the cost per
+ *               sample is O(1) amortised however long the hours get. Sums are
+ *               kept exactly in 64 bits, so folding seconds into minutes into
+ *               hours gives the same mean as averaging the raw samples.
+ *
+ *               Buckets are aligned to their resolution in sample time.
+ *               Buckets without samples are not stored, a gap in the data
+ *               shows as a jump in start_us. SECONDS, MINUTES and HOURS are
+ *               the number of closed buckets kept per level.
+ *
+ *               The values are whatever the samples carry: raw conversions,
+ *               or the BME280 IIR filter output if the filter is enabled on
+ *               the sensor.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "Sample.h"
+
+#define ROLLUP_SECONDS 0
+#define ROLLUP_MINUTES 1
+#define ROLLUP_HOURS 2
+#define ROLLUP_LEVELS 3
+
+struct RollupValue {
+    int32_t min;
+    int32_t max;
+    int32_t last;
+    int64_t sum;
+};
+
+struct RollupBucket {
+    uint64_t start_us;      // Start of the bucket, a multiple of its resolution
+    uint32_t count;         // Raw samples folded into the bucket
+    RollupValue values[SAMPLE_VALUE_COUNT];
+
+    ///@brief Mean of one value, rounded to the nearest integer, 0 if the bucket is empty
+    int32_t mean(int value) const {
+        if (count == 0) return 0;
+        int64_t sum = values[value].sum;
+        int64_t half = count / 2;
+        return (int32_t)((sum >= 0) ? (sum + half) / count : (sum - half) / count);
+    }
+};
+
+template <size_t SECONDS, size_t MINUTES, size_t HOURS>
+class SampleRollup {
+public:
+    static_assert(SECONDS > 0 && MINUTES > 0 && HOURS > 0, "every level needs room for a bucket");
+
+    ///@brief Called for every bucket that is closed, from add() or flush()
+    typedef void (*BucketCallback)(int level, const RollupBucket &bucket, void *context);
+
+    SampleRollup() : _callback(nullptr), _context(nullptr) {
+        _rings[ROLLUP_SECONDS] = _seconds;
+        _rings[ROLLUP_MINUTES] = _minutes;
+        _rings[ROLLUP_HOURS] = _hours;
+        _capacity[ROLLUP_SECONDS] = SECONDS;
+        _capacity[ROLLUP_MINUTES] = MINUTES;
+        _capacity[ROLLUP_HOURS] = HOURS;
+        clear();
+    }
+
+    void clear(void) {
+        for (int level = 0; level < ROLLUP_LEVELS; level++) {
+            _open[level].count = 0;
+            _next[level] = 0;
+            _count[level] = 0;
+        }
+    }
+
+    void set_callback(BucketCallback callback, void *context) {
+        _callback = callback;
+        _context = context;
+    }
+
+    ///@brief Resolution of a level in microseconds
+    static uint64_t resolution_us(int level) {
+        return (level == ROLLUP_SECONDS) ? 1000000ull : (level == ROLLUP_MINUTES) ? 60000000ull : 3600000000ull;
+    }
+
+    ///@brief Add a sample, timestamps must not decrease
+    void add(const Sample &sample) { add(sample.timestamp_us, sample.values); }
+
+    void add(uint64_t timestamp_us, const int32_t *values) {
+        flush(timestamp_us);
+
+        RollupBucket &bucket = _open[ROLLUP_SECONDS];
+        if (bucket.count == 0) {
+            bucket.start_us = timestamp_us - timestamp_us % resolution_us(ROLLUP_SECONDS);
+            for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+                bucket.values[i].min = bucket.values[i].max = values[i];
+                bucket.values[i].sum = 0;
+            }
+        }
+        bucket.count++;
+        for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+            RollupValue &value = bucket.values[i];
+            if (values[i] < value.min) value.min = values[i];
+            if (values[i] > value.max) value.max = values[i];
+            value.last = values[i];
+            value.sum += values[i];
+        }
+    }
+
+    ///@brief Close every open bucket that ends at or before now, for when samples stop coming
+    void flush(uint64_t now_us) {
+        // Bottom up, so a closing second lands in its minute before that minute is checked
+        for (int level = 0; level < ROLLUP_LEVELS; level++) {
+            if (_open[level].count > 0 && now_us - _open[level].start_us >= resolution_us(level)) close(level);
+        }
+    }
+
+    ///@brief Closed buckets kept for a level
+    size_t size(int level) const { return _count[level]; }
+
+    ///@brief Closed bucket by age, 0 is the oldest and size(level) - 1 the newest
+    const RollupBucket &at(int level, size_t i) const {
+        return _rings[level][(_next[level] + _capacity[level] - _count[level] + i) % _capacity[level]];
+    }
+
+    const RollupBucket &latest(int level) const { return at(level, _count[level] - 1); }
+
+    ///@brief The bucket a level has open, with the newer samples still in the levels below folded in
+    RollupBucket current(int level) const {
+        RollupBucket result = _open[level];
+        for (int below = level - 1; below >= 0; below--) fold(result, _open[below], level);
+        return result;
+    }
+
+private:
+    RollupBucket _seconds[SECONDS];
+    RollupBucket _minutes[MINUTES];
+    RollupBucket _hours[HOURS];
+    RollupBucket *_rings[ROLLUP_LEVELS];
+    size_t _capacity[ROLLUP_LEVELS];
+    size_t _next[ROLLUP_LEVELS];
+    size_t _count[ROLLUP_LEVELS];
+
+    RollupBucket _open[ROLLUP_LEVELS];
+
+    BucketCallback _callback;
+    void *_context;
+
+    ///@brief Fold a newer bucket into one of the given level
+    static void fold(RollupBucket &into, const RollupBucket &from, int level) {
+        if (from.count == 0) return;
+        if (into.count == 0) {
+            into = from;
+            into.start_us = from.start_us - from.start_us % resolution_us(level);
+            return;
+        }
+        into.count += from.count;
+        for (int i = 0; i < SAMPLE_VALUE_COUNT; i++) {
+            if (from.values[i].min < into.values[i].min) into.values[i].min = from.values[i].min;
+            if (from.values[i].max > into.values[i].max) into.values[i].max = from.values[i].max;
+            into.values[i].last = from.values[i].last;
+            into.values[i].sum += from.values[i].sum;
+        }
+    }
+
+    void close(int level) {
+        RollupBucket &bucket = _open[level];
+        _rings[level][_next[level]] = bucket;
+        _next[level] = (_next[level] + 1) % _capacity[level];
+        if (_count[level] < _capacity[level]) _count[level]++;
+
+        if (level + 1 < ROLLUP_LEVELS) fold(_open[level + 1], bucket, level + 1);
+        if (_callback != nullptr) _callback(level, bucket, _context);
+        bucket.count = 0;
+    }
+};
@@ -0,0 +1,164 @@
+/*
+ *  Title: WindowStats
+ *  Description: Running min/max/mean/variance of one value over a sliding
+ *               time window, e.g. "the last 60 s". Every add() and expire()
+ *               is amortised O(1) and a summary is read without rescanning
+ *               the window:
+ *                 - min and max come from monotonic deques of entry indices,
+ *                 - mean and variance from Welford's update, run backwards
+ *                   when an entry leaves the window.
+ *
+ *               One window can follow VALUES values that arrive together,
+ *               e.g. the three values of a Sample. They share one ring of
+ *               timestamps and entry indices, only the values, deques and
+ *               Welford state are kept per value.
+ *
+ *               Storage is fixed by the CAPACITY template argument, nothing
+ *               is allocated. If more than CAPACITY entries fall inside the
+ *               window the oldest ones are dropped early, so size CAPACITY
+ *               for window length times the sample rate. CAPACITY must be a
+ *               power of two so the free-running indices wrap cleanly.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+struct WindowSummary {
+    uint32_t count;     // Entries in the window
+    int32_t min;        // Smallest value, 0 if count is 0
+    int32_t max;        // Largest value, 0 if count is 0
+    double mean;        // In the unit of the values
+    double variance;    // Population variance, in the unit of the values squared
+};
+
+template <size_t CAPACITY, size_t VALUES = 1>
+class WindowStats {
+public:
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "WindowStats capacity must be a power of two");
+    static_assert(VALUES > 0, "WindowStats needs at least one value");
+
+    ///@param window_us Length of the window, entries older than the newest minus this are removed
+    explicit WindowStats(uint64_t window_us) : _window_us(window_us) { clear(); }
+
+    void clear(void) {
+        _next = 0;
+        _count = 0;
+        for (size_t v = 0; v < VALUES; v++) {
+            Channel &channel = _channels[v];
+            channel.min_head = channel.min_tail = 0;
+            channel.max_head = channel.max_tail = 0;
+            channel.mean = 0;
+            channel.m2 = 0;
+        }
+    }
+
+    ///@brief Add one entry, timestamps must not decrease
+    ///@param values VALUES values, one for each statistic
+    void add(uint64_t timestamp_us, const int32_t *values) {
+        expire(timestamp_us);
+        if (_count == CAPACITY) remove_oldest();
+
+        uint32_t index = _next++;
+        _timestamps[index % CAPACITY] = timestamp_us;
+        _count++;
+
+        for (size_t v = 0; v < VALUES; v++) {
+            Channel &channel = _channels[v];
+            int32_t value = values[v];
+            channel.values[index % CAPACITY] = value;
+
+            // Welford
+            double delta = value - channel.mean;
+            channel.mean += delta / _count;
+            channel.m2 += delta * (value - channel.mean);
+
+            // Entries that can never be the minimum (maximum) again leave the back
+            while (channel.min_tail != channel.min_head &&
+                   channel.values[channel.min_queue[(channel.min_tail - 1) % CAPACITY] % CAPACITY] >= value) {
+                channel.min_tail--;
+            }
+            channel.min_queue[channel.min_tail++ % CAPACITY] = index;
+            while (channel.max_tail != channel.max_head &&
+                   channel.values[channel.max_queue[(channel.max_tail - 1) % CAPACITY] % CAPACITY] <= value) {
+                channel.max_tail--;
+            }
+            channel.max_queue[channel.max_tail++ % CAPACITY] = index;
+        }
+    }
+
+    ///@brief Add a value to a window of one value, timestamps must not decrease
+    void add(uint64_t timestamp_us, int32_t value) {
+        static_assert(VALUES == 1, "pass one value per statistic");
+        add(timestamp_us, &value);
+    }
+
+    ///@brief Remove entries that are older than the window at the given time
+    void expire(uint64_t now_us) {
+        while (_count > 0 && now_us - _timestamps[(_next - _count) % CAPACITY] > _window_us) remove_oldest();
+    }
+
+    uint32_t count(void) const { return _count; }
+    int32_t min(size_t v = 0) const {
+        return _count ? _channels[v].values[_channels[v].min_queue[_channels[v].min_head % CAPACITY] % CAPACITY] : 0;
+    }
+    int32_t max(size_t v = 0) const {
+        return _count ? _channels[v].values[_channels[v].max_queue[_channels[v].max_head % CAPACITY] % CAPACITY] : 0;
+    }
+    double mean(size_t v = 0) const { return _count ? _channels[v].mean : 0; }
+    double variance(size_t v = 0) const {
+        return (_count > 1 && _channels[v].m2 > 0) ? _channels[v].m2 / _count : 0;
+    }
+    uint64_t window_us(void) const { return _window_us; }
+
+    WindowSummary summary(size_t v = 0) const {
+        WindowSummary result = {_count, min(v), max(v), mean(v), variance(v)};
+        return result;
+    }
+
+private:
+    uint64_t _window_us;
+    uint64_t _timestamps[CAPACITY];
+    uint32_t _next;         // Index the next entry gets, the oldest is _next - _count
+    uint32_t _count;
+
+    struct Channel {
+        int32_t values[CAPACITY];
+
+        // Deques of entry indices, values increasing (min) or decreasing (max) from head to tail
+        uint32_t min_queue[CAPACITY];
+        uint32_t min_head, min_tail;
+        uint32_t max_queue[CAPACITY];
+        uint32_t max_head, max_tail;
+
+        double mean;
+        double m2;
+    };
+    Channel _channels[VALUES];
+
+    void remove_oldest(void) {
+        uint32_t index = _next - _count;
+        _count--;
+
+        for (size_t v = 0; v < VALUES; v++) {
+            Channel &channel = _channels[v];
+            int32_t value = channel.values[index % CAPACITY];
+
+            if (channel.min_head != channel.min_tail && channel.min_queue[channel.min_head % CAPACITY] == index) {
+                channel.min_head++;
+            }
+            if (channel.max_head != channel.max_tail && channel.max_queue[channel.max_head % CAPACITY] == index) {
+                channel.max_head++;
+            }
+
+            if (_count == 0) {
+                // Start over exactly instead of carrying rounding errors forward
+                channel.mean = 0;
+                channel.m2 = 0;
+                continue;
+            }
+            double delta = value - channel.mean;
+            channel.mean -= delta / _count;
+            channel.m2 -= delta * (value - channel.mean);
+        }
+    }
+};
\ No newline at end of file
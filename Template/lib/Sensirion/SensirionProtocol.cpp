@@ -0,0 +1,79 @@
+/*
+ *  Title: SensirionProtocol
+ *  Description: Word protocol shared by the Sensirion I2C sensors.
+ */
+
+#include <string.h>
+#include "SensirionProtocol.h"
+
+struct Crc8Table {
+    uint8_t entries[256];
+
+    constexpr Crc8Table() : entries() {
+        for (int i = 0; i < 256; i++) {
+            uint8_t crc = (uint8_t)i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+            }
+            entries[i] = crc;
+        }
+    }
+
+    constexpr uint8_t word_crc(uint8_t msb, uint8_t lsb) const {
+        return entries[entries[0xFF ^ msb] ^ lsb];
+    }
+};
+
+// Built by the compiler, lives in flash on the Pico
+static constexpr Crc8Table CRC8_TABLE;
+
+// Example from the Sensirion interface descriptions: CRC(0xBEEF) = 0x92
+static_assert(CRC8_TABLE.word_crc(0xBE, 0xEF) == 0x92, "Sensirion CRC-8 table");
+
+uint8_t sensirion_crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < len; i++) {
+        crc = CRC8_TABLE.entries[crc ^ data[i]];
+    }
+    return crc;
+}
+
+uint8_t sensirion_crc8_bitwise(const uint8_t *data, size_t len) {
+    uint8_t crc = 0xFF;
+    for (size_t j = 0; j < len; j++) {
+        crc ^= data[j];
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+size_t sensirion_encode_command(uint16_t command, const uint16_t *arguments, size_t count, uint8_t *out) {
+    out[0] = (uint8_t)(command >> 8);
+    out[1] = (uint8_t)command;
+    uint8_t *word = out + SENSIRION_COMMAND_LENGTH;
+    for (size_t i = 0; i < count; i++, word += SENSIRION_WORD_LENGTH) {
+        word[0] = (uint8_t)(arguments[i] >> 8);
+        word[1] = (uint8_t)arguments[i];
+        word[2] = CRC8_TABLE.word_crc(word[0], word[1]);
+    }
+    return SENSIRION_COMMAND_LENGTH + count * SENSIRION_WORD_LENGTH;
+}
+
+uint32_t sensirion_decode_words(const uint8_t *data, size_t count, uint16_t *words) {
+    uint32_t errors = 0;
+    if (count > SENSIRION_MAX_WORDS) count = SENSIRION_MAX_WORDS;
+    for (size_t i = 0; i < count; i++, data += SENSIRION_WORD_LENGTH) {
+        words[i] = (uint16_t)((data[0] << 8) | data[1]);
+        if (CRC8_TABLE.word_crc(data[0], data[1]) != data[2]) errors |= (uint32_t)1 << i;
+    }
+    return errors;
+}
+
+float sensirion_words_to_float(const uint16_t *words) {
+    uint32_t bits = ((uint32_t)words[0] << 16) | words[1];
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
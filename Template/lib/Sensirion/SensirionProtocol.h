@@ -0,0 +1,39 @@
+/*
+ *  Title: SensirionProtocol
+ *  Description: Word protocol shared by the Sensirion I2C sensors (SCD30,
+ *               SHT4x, SGP4x). A command is a 16-bit word sent big-endian,
+ *               optionally followed by argument words. Every argument and
+ *               response word is two bytes big-endian followed by a CRC-8
+ *               (polynomial 0x31, init 0xFF) of those two bytes.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define SENSIRION_WORD_LENGTH 3         // Two data bytes and a CRC byte
+#define SENSIRION_COMMAND_LENGTH 2
+#define SENSIRION_MAX_WORDS 32          // Words checked by one sensirion_decode_words() call
+
+///@brief Sensirion CRC-8 (poly 0x31, init 0xFF), table driven
+uint8_t sensirion_crc8(const uint8_t *data, size_t len);
+
+///@brief Same CRC computed bit by bit, the reference for the table
+uint8_t sensirion_crc8_bitwise(const uint8_t *data, size_t len);
+
+///@brief Encode a command and its arguments
+///@param command Command word
+///@param arguments Argument words, may be nullptr if count is 0
+///@param count Number of argument words
+///@param out Buffer of at least SENSIRION_COMMAND_LENGTH + count * SENSIRION_WORD_LENGTH bytes
+///@return Number of bytes to send
+size_t sensirion_encode_command(uint16_t command, const uint16_t *arguments, size_t count, uint8_t *out);
+
+///@brief Check and unpack response words
+///@param data Response, count * SENSIRION_WORD_LENGTH bytes
+///@param count Number of words, at most SENSIRION_MAX_WORDS
+///@param words Receives the words, including those with a bad CRC
+///@return Bit i set if word i failed its CRC, 0 if all words are valid
+uint32_t sensirion_decode_words(const uint8_t *data, size_t count, uint16_t *words);
+
+///@brief IEEE 754 float sent as two words, most significant word first
+float sensirion_words_to_float(const uint16_t *words);
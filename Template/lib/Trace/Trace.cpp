@@ -0,0 +1,191 @@
+/*
+ *  Title: Trace
+ *  Description: Series table, histogram buckets and the printed dump.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "Trace.h"
+
+static const char *const OP_NAMES[TRACE_OP_COUNT] = {
+    "BME280 read",
+    "BME280 calibration",
+    "SCD30 read",
+    "SCD30 register",
+};
+
+const char *trace_op_name(TraceOp op) {
+    return (op < TRACE_OP_COUNT) ? OP_NAMES[op] : "?";
+}
+
+/// @brief Upper bound of a bucket, the first latency that no longer fits in it
+static uint32_t bucket_limit_us(int bucket) {
+    return (uint32_t)1 << bucket;
+}
+
+#if TRACE_ENABLED
+
+static TraceSeries series_table[TRACE_MAX_SERIES];
+static TraceSeries overflow_series;     // Shared by everything beyond TRACE_MAX_SERIES
+static volatile int series_count = 0;
+
+/// @brief Bucket of a latency: the number of significant bits, capped at the last bucket
+static int bucket_of(uint32_t us) {
+#if defined(__GNUC__)
+    int bucket = (us == 0) ? 0 : 32 - __builtin_clz(us);
+#else
+    int bucket = 0;
+    while (us != 0) {
+        us >>= 1;
+        bucket++;
+    }
+#endif
+    return (bucket < TRACE_BUCKETS) ? bucket : TRACE_BUCKETS - 1;
+}
+
+/// @brief Find the series of an operation and address, create it on first use
+static TraceSeries *series_for(TraceOp op, uint8_t address) {
+    int count = series_count;
+    for (int i = 0; i < count; i++) {
+        if (series_table[i].op == op && series_table[i].address == address) return &series_table[i];
+    }
+    if (count == TRACE_MAX_SERIES) return &overflow_series;
+
+    TraceSeries *series = &series_table[count];
+    memset(series, 0, sizeof(*series));
+    series->op = op;
+    series->address = address;
+    series->min_us = UINT32_MAX;
+    // Published last, a reader on the other core never sees a half-made series
+    series_count = count + 1;
+    return series;
+}
+
+TraceSpan::TraceSpan(TraceOp op, uint8_t address, Clock *clock) :
+    _series(series_for(op, address)),
+    _clock(clock),
+    _start_us(clock->time_us()) {}
+
+void TraceSpan::transfer(int result, size_t len) {
+    if (_series == nullptr) return;
+    if (result == (int)len) {
+        _series->bytes += len;
+    } else if (result == BUS_ERROR_TIMEOUT) {
+        _series->timeouts++;
+    } else if (result == BUS_ERROR_GENERIC) {
+        _series->naks++;
+    }
+}
+
+bool TraceSpan::finish(bool success) {
+    if (_series == nullptr) return success;
+
+    uint64_t elapsed = _clock->time_us() - _start_us;
+    uint32_t us = (elapsed > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed;
+
+    _series->calls++;
+    if (!success) _series->failures++;
+    if (us < _series->min_us) _series->min_us = us;
+    if (us > _series->max_us) _series->max_us = us;
+    _series->total_us += us;
+    _series->histogram[bucket_of(us)]++;
+
+    // A span is counted once, a second finish() does nothing
+    _series = nullptr;
+    return success;
+}
+
+int trace_series_count(void) {
+    return series_count;
+}
+
+const TraceSeries &trace_series_at(int index) {
+    return series_table[index];
+}
+
+const TraceSeries *trace_find(TraceOp op, uint8_t address) {
+    int count = series_count;
+    for (int i = 0; i < count; i++) {
+        if (series_table[i].op == op && series_table[i].address == address) return &series_table[i];
+    }
+    return nullptr;
+}
+
+void trace_reset(void) {
+    series_count = 0;
+    memset(&overflow_series, 0, sizeof(overflow_series));
+}
+
+#else
+
+int trace_series_count(void) {
+    return 0;
+}
+
+const TraceSeries &trace_series_at(int index) {
+    static const TraceSeries empty = {};
+    (void)index;
+    return empty;
+}
+
+const TraceSeries *trace_find(TraceOp op, uint8_t address) {
+    (void)op;
+    (void)address;
+    return nullptr;
+}
+
+void trace_reset(void) {}
+
+#endif
+
+uint32_t trace_percentile_us(const TraceSeries &series, uint32_t percent) {
+    if (series.calls == 0) return 0;
+
+    // Rank of the sample at the percentile, 1-based and rounded up
+    uint64_t rank = ((uint64_t)series.calls * percent + 99) / 100;
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < TRACE_BUCKETS - 1; bucket++) {
+        seen += series.histogram[bucket];
+        if (seen >= rank) {
+            uint32_t limit = bucket_limit_us(bucket);
+            return (limit < series.max_us) ? limit : series.max_us;
+        }
+    }
+    return series.max_us;
+}
+
+void trace_dump(void) {
+    int count = trace_series_count();
+    if (!TRACE_ENABLED) {
+        printf("[TRACE] disabled (TRACE_ENABLED=0)\n");
+        return;
+    }
+    printf("[TRACE] %d series\n", count);
+
+    for (int i = 0; i < count; i++) {
+        const TraceSeries &series = trace_series_at(i);
+        uint32_t mean = series.calls ? (uint32_t)(series.total_us / series.calls) : 0;
+
+        printf("  %-18s 0x%02x : %lu calls, %lu failed, %lu bytes, %lu NAK, %lu timeout, %lu CRC\n",
+               trace_op_name(series.op), series.address, (unsigned long)series.calls,
+               (unsigned long)series.failures, (unsigned long)series.bytes, (unsigned long)series.naks,
+               (unsigned long)series.timeouts, (unsigned long)series.crc_errors);
+        if (series.calls == 0) continue;
+        printf("      us min/mean/max %lu/%lu/%lu, p50 <= %lu, p99 <= %lu\n", (unsigned long)series.min_us,
+               (unsigned long)mean, (unsigned long)series.max_us,
+               (unsigned long)trace_percentile_us(series, 50), (unsigned long)trace_percentile_us(series, 99));
+
+        printf("      ");
+        for (int bucket = 0; bucket < TRACE_BUCKETS; bucket++) {
+            if (series.histogram[bucket] == 0) continue;
+            if (bucket == TRACE_BUCKETS - 1) {
+                printf(" >=%lu:%lu", (unsigned long)bucket_limit_us(bucket - 1), (unsigned long)series.histogram[bucket]);
+            } else {
+                printf(" <%lu:%lu", (unsigned long)bucket_limit_us(bucket), (unsigned long)series.histogram[bucket]);
+            }
+        }
+        printf("\n");
+    }
+}
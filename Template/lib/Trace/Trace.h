@@ -0,0 +1,108 @@
+/*
+ *  Title: Trace
+ *  Description: Latency histograms and error counters for the driver
+ *               operations that touch the bus. Every operation and device
+ *               address gets its own series: calls, failures, bytes moved,
+ *               NAKs, timeouts, CRC failures and a histogram of latencies
+ *               in power-of-two buckets, timed with the driver's Clock
+ *               (time_us_64() on the Pico).
+ *
+ *               Build with TRACE_ENABLED set to 0 and TraceSpan becomes an
+ *               empty class, so the drivers compile to the same code as
+ *               without instrumentation.
+ *
+ *               The counters are written by the core that runs the driver
+ *               and may be read from the other one, a dump can be one
+ *               operation behind.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "I2CBus.h"
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+#define TRACE_BUCKETS 20        // Bucket 0 is 0 us, bucket n holds [2^(n-1), 2^n) us, the last one everything above
+#define TRACE_MAX_SERIES 12
+
+enum TraceOp : uint8_t {
+    TRACE_BME280_READ,          // BME280::read() and start_read()
+    TRACE_BME280_CALIBRATION,   // BME280::fetch_compensation_data()
+    TRACE_SCD30_READ,           // SCD30::read() and startRead()
+    TRACE_SCD30_REGISTER,       // SCD30::readRegister()
+    TRACE_OP_COUNT
+};
+
+struct TraceSeries {
+    TraceOp op;
+    uint8_t address;
+    uint32_t calls;
+    uint32_t failures;
+    uint32_t bytes;             // Bytes written and read by successful transfers
+    uint32_t naks;              // Transfers that ended in BUS_ERROR_GENERIC
+    uint32_t timeouts;          // Transfers that ended in BUS_ERROR_TIMEOUT
+    uint32_t crc_errors;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t histogram[TRACE_BUCKETS];
+};
+
+/**
+ * @class TraceSpan
+ * @brief One timed operation. Started by the constructor, fed the result of
+ *        every bus transfer and closed by finish(), which adds it to the
+ *        series of its operation and address.
+ */
+class TraceSpan {
+public:
+#if TRACE_ENABLED
+    TraceSpan(void) : _series(nullptr), _clock(nullptr), _start_us(0) {}
+    TraceSpan(TraceOp op, uint8_t address, Clock *clock);
+
+    ///@brief Count one transfer
+    ///@param result Return value of I2CBus::write/read or I2CTransfer::result
+    ///@param len Bytes the transfer should have moved
+    void transfer(int result, size_t len);
+
+    void crc_error(void) { if (_series != nullptr) _series->crc_errors++; }
+
+    ///@brief Record the latency since the constructor
+    ///@return success, so a driver can end with return span.finish(...)
+    bool finish(bool success);
+private:
+    TraceSeries *_series;
+    Clock *_clock;
+    uint64_t _start_us;
+#else
+    TraceSpan(void) {}
+    TraceSpan(TraceOp, uint8_t, Clock *) {}
+    void transfer(int, size_t) {}
+    void crc_error(void) {}
+    bool finish(bool success) { return success; }
+#endif
+};
+
+///@brief Name of an operation, for printing
+const char *trace_op_name(TraceOp op);
+
+///@return Number of series recorded so far
+int trace_series_count(void);
+const TraceSeries &trace_series_at(int index);
+
+///@brief Series of one operation and address
+///@return nullptr if the operation never ran on that address
+const TraceSeries *trace_find(TraceOp op, uint8_t address);
+
+///@brief Upper bound of the bucket that holds the given percentile
+///@param percent 0 to 100
+///@return Latency in microseconds, 0 if the series is empty
+uint32_t trace_percentile_us(const TraceSeries &series, uint32_t percent);
+
+///@brief Forget all series
+void trace_reset(void);
+
+///@brief Print every series with printf
+void trace_dump(void);
@@ -9,13 +9,675 @@
 
 #include <stdio.h>
 #include <pico/stdlib.h>
+#include <pico/multicore.h>
+#include <pico/stdio_usb.h>
 #include <hardware/i2c.h>
+#include <hardware/structs/systick.h>
+#include <PicoBus.h>
+#include <PicoI2CDmaBus.h>
+#include <PicoSPIBus.h>
+#include <BusHealth.h>
 #include <BME280.h>
+#include <BME280FlashStore.h>
+#include <SCD30.h>
+#include <SensirionProtocol.h>
+#include <SampleRing.h>
+#include <SampleHistory.h>
+#include <SampleRollup.h>
+#include <SampleFrame.h>
+#include <BusManager.h>
+#include <Trace.h>
+#include <EnergyMeter.h>
+#include <DutyCycle.h>
+#include <PicoSleep.h>
+#include <SampleLog.h>
+#include <PicoFlash.h>
+#include <DerivedMetrics.h>
 
 const uint8_t PIN_BME_SDA = 4;
 const uint8_t PIN_BME_SCL = 5;
+const uint8_t PIN_I2C1_SDA = 6;
+const uint8_t PIN_I2C1_SCL = 7;
+const uint8_t PIN_SPI0_MISO = 16;
+const uint8_t PIN_SPI0_SCK = 18;
+const uint8_t PIN_SPI0_MOSI = 19;
+// Eitt flísaval á hvern BME280 á SPI, fleiri skynjarar bætast við hér.
+const uint8_t PIN_BME_CS[] = {17};
 
+// Settu á 1 til að mæla klukkupúlsa í leiðréttingu BME280 gilda við ræsingu.
+#ifndef BENCHMARK_COMPENSATION
+#define BENCHMARK_COMPENSATION 0
+#endif
+
+// Settu á 1 til að mæla klukkupúlsa í CRC-8 útreikningi SCD30 svara við ræsingu.
+#ifndef BENCHMARK_CRC
+#define BENCHMARK_CRC 0
+#endif
+
+// Settu á 1 til að kjarni 1 sjái um aflestur og kjarni 0 um útskrift.
+#ifndef PIPELINE_MODE
+#define PIPELINE_MODE 0
+#endif
+
+// Settu á 1 til að senda sýnin sem tvíundarramma (SampleFrame.h) í stað texta.
+// Á tölvunni breytir host/frame2csv straumnum í CSV.
+#ifndef OUTPUT_BINARY
+#define OUTPUT_BINARY 0
+#endif
+
+// Tímamælingar á aflestrum (Trace.h) eru á sjálfgefið. Þýddu með -DTRACE_ENABLED=0
+// til að taka þær út. Skipunin 't' á raðtenginu prentar þær, 'r' núllstillir.
+#define TRACE_DUMP_KEY 't'
+#define TRACE_RESET_KEY 'r'
+
+// Tími milli BME280 mælinga í pípulagningarham [µs].
+#ifndef PIPELINE_PERIOD_US
+#define PIPELINE_PERIOD_US 1000000
+#endif
+
+// Settu á 1 til að SCD30 sé lesinn í atburðaham (SCD30::beginEvents) í stað þess
+// að BusManager lesi hann á föstu millibili.
+#ifndef SCD30_EVENT_MODE
+#define SCD30_EVENT_MODE 1
+#endif
+
+// GPIO pinni sem RDY úttak SCD30 er tengt við, -1 ef það er ekki tengt. Þá er
+// spurt einu sinni á mælibili hvort ný gögn séu tilbúin.
+#ifndef PIN_SCD30_RDY
+#define PIN_SCD30_RDY -1
+#endif
+
+// Settu á 1 fyrir lágaflsham (DutyCycle.h): BME280 gerir eina mælingu í Forced Mode
+// á LOW_POWER_PERIOD_US fresti og örgjörvinn sefur á milli. Mælibil SCD30 fylgir.
+#ifndef LOW_POWER_MODE
+#define LOW_POWER_MODE 0
+#endif
+
+// Tími milli sýna í lágaflsham [µs].
+#ifndef LOW_POWER_PERIOD_US
+#define LOW_POWER_PERIOD_US 60000000
+#endif
+
+// Settu á 1 til að geyma sýnin í flassminni (SampleLog.h) á meðan engin tölva er
+// tengd við USB. Þau eru send þegar hún tengist aftur, skipunin 'd' sendir allan logginn.
+#ifndef SAMPLE_LOG
+#define SAMPLE_LOG 0
+#endif
+#define LOG_DRAIN_KEY 'd'
+
+// IIR sía BME280 (BME280::FILTER_*) í pípulagningar- og lágaflsham. Samantektirnar fá
+// þá síuð gildi í stað hrárra mælinga. Með löngu bili í lágaflsham bregst sían hægt við.
+#ifndef BME280_FILTER
+#define BME280_FILTER BME280::FILTER_OFF
+#endif
+
+// Settu á 1 ef BME280 er tengdur með SPI (4 víra) í stað I2C. Skynjarinn er þá á
+// flísavali 0 (PIN_BME_CS) á spi0 og SDO hans á PIN_SPI0_MISO.
+#ifndef BME280_SPI
+#define BME280_SPI 0
+#endif
+#define BME280_SPI_BAUDRATE 10000000
+
+// Hæð skynjarans yfir sjávarmáli [cm], fyrir loftþrýsting við sjávarmál í aflestrinum.
+#ifndef STATION_ALTITUDE_CM
+#define STATION_ALTITUDE_CM 0
+#endif
+
+// Hvaða I2C tengingu (0 eða 1) seinni BME280 skynjarinn (0x77) og SCD30 eru á í pípulagningarham.
+const int BME280_ALTERNATE_BUS = 1;
+const int SCD30_BUS = 0;
+const uint32_t SCD30_PERIOD_US = 2000000;
+
+PicoI2CDmaBus bus0(i2c0);
+PicoI2CDmaBus bus1(i2c1);
+PicoClock pico_clock;
+PicoSPIBus spi_bus(spi0, PIN_BME_CS, sizeof(PIN_BME_CS), BME280_SPI_BAUDRATE);
+// BME280 rekillinn talar við SPI í gegnum sama viðmót og við I2C, staðfangið er flísavalið.
+SPIRegisterBus spi_registers(&spi_bus);
+// Í lágaflsham sefur örgjörvinn með klukkurnar stöðvaðar á milli sýna, nema tölva sé tengd við USB.
+PicoSleepClock sleep_clock(stdio_usb_connected);
+// Í lágaflsham fá reklarnir klukkuna í gegnum mælinn svo allur svefn þeirra sé talinn.
+EnergyMeter energy_meter(LOW_POWER_MODE ? (Clock*)&sleep_clock : &pico_clock,
+                         LOW_POWER_MODE ? DEFAULT_POWER_MODEL : WFE_POWER_MODEL);
+DutyCycle duty_cycle(&energy_meter, &energy_meter);
+const uint32_t ENERGY_REPORT_SAMPLES = 60;
+
+// Í pípulagningarham er kjarni 1 stöðvaður á meðan skrifað er í flassið.
+PicoFlash log_flash(SAMPLE_LOG_FLASH_OFFSET, SAMPLE_LOG_FLASH_SIZE, PIPELINE_MODE);
+SampleLog sample_log(&log_flash);
+bool sample_log_ready = false;
+// Raðnúmer fyrsta sýnis í logginum sem hefur ekki verið sent.
+uint32_t log_forwarded = 0;
+// Skynjararnir tala í gegnum BusHealth: endurtekningar, losun á föstum línum og villuteljarar.
+BusHealth bus0_health(&bus0, &pico_clock);
+BusHealth bus1_health(&bus1, &pico_clock);
+BusHealth* const buses[2] = {&bus0_health, &bus1_health};
 BME280 bme;
+BME280 bme_alternate;
+BME280FlashStore calibration_store;
+SCD30 scd(&bus0_health, &pico_clock);
+bool scd_connected = false;
+
+// Pípulagningarhamur: tengingarnar og skynjararnir sem kjarni 1 sér um.
+BusManager manager(&pico_clock);
+BME280Task bme_task(&bme, 0);
+BME280Task bme_alternate_task(&bme_alternate, 1);
+SCD30Task scd_task(&scd);
+
+// Sýni frá kjarna 1 til kjarna 0.
+SampleRing samples;
+
+#if PIPELINE_MODE
+// Saga og tölfræði síðustu 60 s og 10 mín, BME280 á 1 s fresti og SCD30 á 2 s fresti.
+// Um 75 KB af vinnsluminni, svo aðeins í pípulagningarham sem notar þær.
+SampleHistory<64, 64, 1024> bme_history(60000000, 600000000);
+SampleHistory<32, 32, 512> scd_history(60000000, 600000000);
+#endif
+const uint64_t SUMMARY_PERIOD_US = 60000000;
+
+// Samantektir á sekúndu, mínútu og klukkustund. Síðustu 60, 60 og 24 eru geymdar.
+SampleRollup<60, 60, 24> bme_rollup;
+SampleRollup<60, 60, 24> scd_rollup;
+
+// Daggarmark, hæð og loftþrýstingur við sjávarmál, reiknuð með heiltölum (DerivedMetrics.h).
+DerivedMetrics metrics(STATION_ALTITUDE_CM);
+
+/**
+ * @brief Prentar tugabrot sem geymt er sem heiltala, án fleytitalnareiknings.
+ * @param value Gildið margfaldað með 10^decimals.
+ * @param decimals Fjöldi aukastafa, 1 eða 2.
+ */
+void print_fixed(int32_t value, int decimals) {
+    uint32_t scale = (decimals == 1) ? 10 : 100;
+    uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+    printf("%s%lu.%0*lu", (value < 0) ? "-" : "",
+           (unsigned long)(magnitude / scale), decimals, (unsigned long)(magnitude % scale));
+}
+
+/**
+ * @brief Mælir fjölda klukkupúlsa sem leiðrétting á einu sýni tekur, annars vegar
+ *        eingöngu með heiltölum og hins vegar með umbreytingu í fleytitölur.
+ *        Notar SysTick teljarann þar sem M0+ kjarninn hefur engan púlsateljara.
+ */
+void benchmark_compensation() {
+    const int N = 100;
+    const BME280::BME_Comp_Coeff_t& coeffs = bme.get_compensation_coefficients();
+    volatile int32_t fixed_sink = 0;
+    volatile float float_sink = 0;
+    int32_t t;
+    uint32_t p, h;
+
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0b101;    // Klukka örgjörvans, teljari virkur.
+
+    uint32_t start = systick_hw->cvr;
+    for (int i = 0; i < N; i++) {
+        BME280::compensate_values(coeffs, &t, &p, &h, 519888 + i, 415148 + i, 30000 + i);
+        fixed_sink = t + p + h;
+    }
+    uint32_t fixed_cycles = (start - systick_hw->cvr) & 0x00FFFFFF;
+
+    start = systick_hw->cvr;
+    for (int i = 0; i < N; i++) {
+        BME280::compensate_values(coeffs, &t, &p, &h, 519888 + i, 415148 + i, 30000 + i);
+        float_sink = (float)t / 100.0f + (float)p / 25600.0f + (float)h / 1024.0f;
+    }
+    uint32_t float_cycles = (start - systick_hw->cvr) & 0x00FFFFFF;
+
+    (void)fixed_sink;
+    (void)float_sink;
+    printf("[MÆLING]\n");
+    printf("  Leiðrétting, heiltölur       :  %lu púlsar/sýni\n", (unsigned long)(fixed_cycles / N));
+    printf("  Leiðrétting, með fleytitölum :  %lu púlsar/sýni\n\n", (unsigned long)(float_cycles / N));
+}
+
+/**
+ * @brief Mælir fjölda klukkupúlsa sem CRC-8 athugun á einu 18 bæta SCD30 svari
+ *        tekur, reiknuð bita fyrir bita og með töflu.
+ */
+void benchmark_crc() {
+    const int N = 100;
+    uint8_t response[18];
+    volatile uint32_t sink = 0;
+    for (int i = 0; i < 18; i++) response[i] = (uint8_t)(i * 37 + 11);
+
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0b101;    // Klukka örgjörvans, teljari virkur.
+
+    uint32_t start = systick_hw->cvr;
+    for (int i = 0; i < N; i++) {
+        for (int w = 0; w < 18; w += 3) sink = sink + (sensirion_crc8_bitwise(response + w, 2) != response[w + 2]);
+    }
+    uint32_t bitwise_cycles = (start - systick_hw->cvr) & 0x00FFFFFF;
+
+    uint16_t words[6];
+    start = systick_hw->cvr;
+    for (int i = 0; i < N; i++) {
+        sink = sink + sensirion_decode_words(response, 6, words);
+    }
+    uint32_t table_cycles = (start - systick_hw->cvr) & 0x00FFFFFF;
+
+    (void)sink;
+    printf("[MÆLING]\n");
+    printf("  CRC-8 SCD30 svars, biti fyrir bita :  %lu púlsar\n", (unsigned long)(bitwise_cycles / N));
+    printf("  CRC-8 SCD30 svars, með töflu       :  %lu púlsar\n\n", (unsigned long)(table_cycles / N));
+}
+
+/**
+ * @brief Býr til sýni úr síðustu gildum BME280.
+ * @param sequence Raðnúmer sýnisins.
+ */
+Sample bme_sample(uint16_t sequence) {
+    Sample sample = {};
+    sample.timestamp_us = time_us_64();
+    sample.sensor = SENSOR_BME280;
+    sample.sequence = sequence;
+    sample.values[0] = bme.get_temperature_centidegrees();
+    sample.values[1] = (int32_t)bme.get_pressure_q24_8();
+    sample.values[2] = (int32_t)bme.get_humidity_q22_10();
+    return sample;
+}
+
+/**
+ * @brief Prentar eitt sýni sem eina textalínu.
+ */
+void print_sample(const Sample& sample) {
+    printf("[%10llu] ", (unsigned long long)sample.timestamp_us);
+    if (sample.sensor == SENSOR_BME280) {
+        printf("BME280/%u #%u  ", sample.channel, sample.sequence);
+        print_fixed(sample.values[0], 2);
+        printf(" °C  ");
+        print_fixed((sample.values[1] + 128) >> 8, 2);
+        printf(" hPa  ");
+        print_fixed((sample.values[2] * 10 + 512) >> 10, 1);
+        printf(" %%\n");
+    } else {
+        printf("SCD30    #%u  ", sample.sequence);
+        print_fixed(sample.values[0], 2);
+        printf(" ppm  ");
+        print_fixed(sample.values[1], 2);
+        printf(" °C  ");
+        print_fixed(sample.values[2], 2);
+        printf(" %%\n");
+    }
+}
+
+/**
+ * @brief Sendir eitt sýni sem 29 bæta ramma, án sniðmótunar eða fleytitalna.
+ */
+void write_frame(const Sample& sample) {
+    uint8_t frame[FRAME_LENGTH];
+    fwrite(frame, 1, frame_encode(sample, frame), stdout);
+    fflush(stdout);
+}
+
+/**
+ * @brief Skrifar sýni á því sniði sem OUTPUT_BINARY segir til um.
+ */
+void output_sample(const Sample& sample) {
+    if (OUTPUT_BINARY) {
+        write_frame(sample);
+    } else {
+        print_sample(sample);
+    }
+}
+
+/**
+ * @brief Kallað af SampleLog::drain() fyrir hvert sýni úr logginum.
+ */
+void output_logged_sample(const Sample& sample, uint32_t, void*) {
+    output_sample(sample);
+}
+
+/**
+ * @brief Sendir sýnin sem söfnuðust í logginn á meðan tölvan var ekki tengd.
+ * @return \c True ef eitthvað var sent.
+ */
+bool forward_log() {
+    if (!SAMPLE_LOG || !sample_log_ready || log_forwarded == sample_log.next_sequence()) return false;
+    sample_log.drain(log_forwarded, output_logged_sample, nullptr);
+    log_forwarded = sample_log.next_sequence();
+    return true;
+}
+
+/**
+ * @brief Sendir sýni, eða geymir það í flassloggnum ef engin tölva er tengd.
+ */
+void emit_sample(const Sample& sample) {
+    if (SAMPLE_LOG && sample_log_ready) {
+        if (!stdio_usb_connected()) {
+            sample_log.append(sample);
+            return;
+        }
+        forward_log();
+    }
+    output_sample(sample);
+}
+
+/**
+ * @brief Kallað af BusManager fyrir hvert sýni, á kjarna 1.
+ */
+void push_sample(const Sample& sample, void*) {
+    samples.push(sample);
+}
+
+/**
+ * @brief Kallað af SCD30 í atburðaham þegar aflestri lýkur, á kjarna 1.
+ */
+void push_scd30_sample(SCD30* sensor, bool success, void*) {
+    static uint16_t sequence = 0;
+    if (!success) return;
+
+    Sample sample = {};
+    sample.timestamp_us = time_us_64();
+    sample.sensor = SENSOR_SCD30;
+    sample.sequence = sequence++;
+    SCD30Task::fill_values(sensor, sample);
+    samples.push(sample);
+}
+
+/**
+ * @brief Truflun á RDY pinna SCD30, ný mæling er tilbúin.
+ */
+void scd30_rdy_irq(uint gpio, uint32_t events) {
+    scd.notifyDataReady();
+}
+
+/**
+ * @brief Aflestrarlykkja kjarna 1 í pípulagningarham.
+ * 
+ *        BusManager les alla skráða skynjara, hvern með sínu millibili, á
+ *        báðum I2C tengingunum samtímis og stimplar sýnin með tíma. Hér er
+ *        hvorki prentað né beðið eftir kjarna 0, svo hægur USB útgangur hefur
+ *        engin áhrif á tímasetningu mælinga. Ef biðröðin fyllist er sýnum
+ *        hent og þau talin í SampleRing::overflows().
+ */
+void acquisition_core() {
+    // SampleLog stöðvar kjarnann á meðan skrifað er í flassið sem hann keyrir úr.
+    if (SAMPLE_LOG) multicore_lockout_victim_init();
+
+    // Truflanir DMA tenginganna eiga að keyra á þessum kjarna.
+    bus0.begin();
+    bus1.begin();
+
+    manager.set_callback(push_sample, nullptr);
+    manager.start();
+
+    bool scd_events = scd_connected && SCD30_EVENT_MODE;
+    if (scd_events) {
+        if (PIN_SCD30_RDY >= 0) {
+            gpio_init(PIN_SCD30_RDY);
+            gpio_set_dir(PIN_SCD30_RDY, GPIO_IN);
+            gpio_set_irq_enabled_with_callback(PIN_SCD30_RDY, GPIO_IRQ_EDGE_RISE, true, scd30_rdy_irq);
+            scd.beginEvents(SCD30::EVENTS_RDY_PIN, push_scd30_sample);
+            // Engin brún kemur ef mæling bíður nú þegar.
+            if (gpio_get(PIN_SCD30_RDY)) scd.notifyDataReady();
+        } else {
+            scd.beginEvents(SCD30::EVENTS_TIMED, push_scd30_sample);
+        }
+    }
+
+    while (true) {
+        manager.poll();
+        if (scd_events) scd.service();
+
+        // Beðið með WFE fram að næsta verki. Vekjari (e. hardware alarm) sér um
+        // tímann, en truflanir frá DMA og RDY pinna vekja kjarnann fyrr.
+        uint64_t next = manager.next_release_us();
+        if (scd_events && scd.nextServiceUs() < next) next = scd.nextServiceUs();
+        if (!manager.busy() && next > time_us_64() + 100) {
+            best_effort_wfe_or_timeout(from_us_since_boot(next));
+        }
+    }
+}
+
+/**
+ * @brief Velur lengsta biðtíma í Normal Mode sem skilar nýju gildi fyrir hverja mælingu.
+ * @param config Stillingar skynjarans, biðtíminn er settur í þær.
+ * @param period_us Tími milli mælinga [µs].
+ */
+void set_standby_for_period(BME280::Config& config, uint32_t period_us) {
+    const uint8_t codes[] = {BME280::STANDBY_1000_MS, BME280::STANDBY_500_MS, BME280::STANDBY_250_MS,
+                             BME280::STANDBY_125_MS, BME280::STANDBY_62_5_MS, BME280::STANDBY_20_MS,
+                             BME280::STANDBY_10_MS, BME280::STANDBY_0_5_MS};
+    for (uint8_t code : codes) {
+        config.standby = code;
+        if (BME280::sample_period_us(config) <= period_us / 2) return;
+    }
+}
+
+/**
+ * @brief Ræsir seinni BME280, SCD30 og seinni I2C tenginguna og skráir skynjarana í BusManager.
+ */
+void init_pipeline() {
+    i2c_init(i2c1, 400000);
+    gpio_set_function(PIN_I2C1_SDA, GPIO_FUNC_I2C);
+    gpio_set_function(PIN_I2C1_SCL, GPIO_FUNC_I2C);
+    bus1.set_pins(PIN_I2C1_SDA, PIN_I2C1_SCL);
+
+    int bus_index[2];
+    bus_index[0] = manager.add_bus(&bus0_health);
+    bus_index[1] = manager.add_bus(&bus1_health);
+
+    BME280::Config config = {BME280::NORMAL_MODE, BME280::OVERSAMPLING_RATE_1, BME280::OVERSAMPLING_RATE_1,
+                             BME280::OVERSAMPLING_RATE_1, BME280_FILTER, BME280::STANDBY_0_5_MS};
+    set_standby_for_period(config, PIPELINE_PERIOD_US);
+
+    if (bme.configure(config)) {
+        manager.add_sensor(&bme_task, bus_index[0], PIPELINE_PERIOD_US);
+    }
+
+    // Kvörðunargeymslan hefur aðeins pláss fyrir einn skynjara, þann á 0x76.
+    bme_alternate = BME280(buses[BME280_ALTERNATE_BUS], &pico_clock, BME280_ALTERNATE_I2CADDR);
+    bool alternate_connected = bme_alternate.init() && bme_alternate.configure(config);
+    if (alternate_connected) {
+        manager.add_sensor(&bme_alternate_task, bus_index[BME280_ALTERNATE_BUS], PIPELINE_PERIOD_US);
+    }
+
+    scd = SCD30(buses[SCD30_BUS], &pico_clock);
+    scd_connected = scd.init();
+    if (scd_connected && !SCD30_EVENT_MODE) {
+        manager.add_sensor(&scd_task, bus_index[SCD30_BUS], SCD30_PERIOD_US, PIPELINE_PERIOD_US / 2);
+    }
+
+    printf("  BME280 0x%02x (i2c%d)     :  %s\n", BME280_ALTERNATE_I2CADDR, BME280_ALTERNATE_BUS,
+           alternate_connected ? "tengdur" : "ekki tengdur");
+    printf("  SCD30 (i2c%d)            :  %s\n\n", SCD30_BUS, scd_connected ? "tengdur" : "ekki tengdur");
+}
+
+/**
+ * @brief Prentar lokaða mínútu- eða klukkustundarsamantekt, kallað af SampleRollup.
+ * @param context Heiti gildisins.
+ */
+void print_rollup(int level, const RollupBucket& bucket, void* context) {
+    if (OUTPUT_BINARY || level == ROLLUP_SECONDS) return;
+    printf("[%s] %s :  ", (level == ROLLUP_MINUTES) ? "MÍNÚTA" : "KLUKKUSTUND", (const char*)context);
+    print_fixed(bucket.mean(0), 2);
+    printf("  (");
+    print_fixed(bucket.values[0].min, 2);
+    printf(" / ");
+    print_fixed(bucket.values[0].max, 2);
+    printf(", %lu sýni)\n", (unsigned long)bucket.count);
+}
+
+/**
+ * @brief Bætir sýni í samantekt síns skynjara.
+ */
+void rollup_sample(const Sample& sample) {
+    if (sample.sensor == SENSOR_BME280 && sample.channel == 0) {
+        bme_rollup.add(sample);
+    } else if (sample.sensor == SENSOR_SCD30) {
+        scd_rollup.add(sample);
+    }
+}
+
+/**
+ * @brief Kallað af DutyCycle fyrir hvert sýni í lágaflsham.
+ */
+void emit_duty_cycle_sample(const Sample& sample, void*) {
+    rollup_sample(sample);
+    emit_sample(sample);
+}
+
+/**
+ * @brief Ræsir SCD30 og setur BME280 í Forced Mode fyrir lágaflsham.
+ */
+void init_low_power() {
+    scd = SCD30(&bus0_health, &energy_meter);
+    scd_connected = scd.init();
+
+    duty_cycle.set_callback(emit_duty_cycle_sample, nullptr);
+    BME280::Config config = BME280::WEATHER_MONITORING;
+    config.filter = BME280_FILTER;
+    bool started = duty_cycle.begin(&bme, LOW_POWER_PERIOD_US, scd_connected ? &scd : nullptr, config);
+    bool deep_sleep = sleep_clock.begin();
+    energy_meter.reset();
+
+    if (OUTPUT_BINARY) return;
+    printf("[LÁGAFLSHAMUR]\n");
+    printf("  Tími milli sýna        :  %lu ms\n", (unsigned long)(LOW_POWER_PERIOD_US / 1000));
+    printf("  SCD30                  :  %s", scd_connected ? "tengdur" : "ekki tengdur\n");
+    if (scd_connected) printf(", mælibil %lu s\n", (unsigned long)duty_cycle.scd30_interval_s());
+    printf("  Svefn milli sýna       :  %s\n", deep_sleep ? "klukkur stöðvaðar (WFE á meðan tölva er tengd)"
+                                                         : "WFE, enginn teljari laus");
+    if (!started) printf("  [VILLA] Stilling lágaflshams misstókst.\n");
+    printf("\n");
+}
+
+/**
+ * @brief Prentar tíma í virkni og áætlaða orku á sýni samkvæmt straumlíkaninu í EnergyMeter.h.
+ */
+void print_energy_report() {
+    EnergyReport report = energy_meter.report();
+    printf("[ORKA] %lu sýni á %lu s\n", (unsigned long)report.samples, (unsigned long)(report.elapsed_us / 1000000));
+    printf("  Virkni á sýni          :  %lu µs\n", (unsigned long)report.active_us_per_sample());
+    printf("  Orka á sýni            :  %lu µJ\n", (unsigned long)report.energy_uj_per_sample());
+    printf("  Meðalstraumur          :  %lu µA\n", (unsigned long)report.average_ua);
+    printf("  Ending 2000 mAh        :  %lu dagar\n\n", (unsigned long)report.battery_days(2000));
+}
+
+/**
+ * @brief Eitt sýni í lágaflsham. Sefur þar til næsta sýni á að taka.
+ */
+void low_power_loop() {
+    bool ok = duty_cycle.run_once();
+    if (OUTPUT_BINARY) return;
+
+    if (!ok) {
+        printf("[VILLA] Mæling í lágaflsham misstókst.\n");
+    } else if (duty_cycle.samples() % ENERGY_REPORT_SAMPLES == 0) {
+        print_energy_report();
+    }
+}
+
+/**
+ * @brief Prentar lágmark, meðaltal og hámark eins gildis yfir glugga.
+ * @param name Heiti gildisins.
+ * @param summary Tölfræði gluggans, gildin í hundraðshlutum.
+ */
+void print_summary(const char* name, const WindowSummary& summary) {
+    printf("  %s :  ", name);
+    print_fixed(summary.min, 2);
+    printf(" / ");
+    print_fixed((int32_t)(summary.mean + (summary.mean < 0 ? -0.5 : 0.5)), 2);
+    printf(" / ");
+    print_fixed(summary.max, 2);
+    printf("  (%lu sýni)\n", (unsigned long)summary.count);
+}
+
+/**
+ * @brief Prentar tíðni og flökt (e. jitter) hvers skynjara. Talningin er uppfærð
+ *        á kjarna 1 svo gildin geta verið einu sýni á eftir.
+ */
+void print_manager_stats() {
+    for (int i = 0; i < manager.sensor_count(); i++) {
+        SensorStats stats = manager.stats(i);
+        printf("  Skynjari %d : %lu sýni, %lu villur, %lu sleppt, %lu mHz, flökt %lu/%lu µs (meðal/hámark)\n", i,
+               (unsigned long)stats.samples, (unsigned long)stats.failures, (unsigned long)stats.overruns,
+               (unsigned long)(stats.rate_hz * 1000.0f), (unsigned long)stats.jitter_mean_us,
+               (unsigned long)stats.jitter_max_us);
+    }
+    for (int b = 0; b < 2; b++) {
+        for (int d = 0; d < buses[b]->device_count(); d++) {
+            const DeviceHealth &health = buses[b]->device_at(d);
+            printf("  i2c%d 0x%02x : %lu færslur, %lu villur, %lu endurtekningar\n", b, health.address,
+                   (unsigned long)health.transfers, (unsigned long)health.failures, (unsigned long)health.retries);
+        }
+        printf("  i2c%d losanir á línu : %lu\n", b, (unsigned long)buses[b]->recoveries());
+    }
+}
+
+/**
+ * @brief Les skipun af raðtenginu án þess að bíða og framkvæmir hana.
+ * @return \c True ef eitthvað var prentað.
+ */
+bool poll_commands() {
+    int key = getchar_timeout_us(0);
+    if (key == TRACE_DUMP_KEY) {
+        trace_dump();
+        return true;
+    } else if (key == TRACE_RESET_KEY) {
+        trace_reset();
+        printf("[TRACE] núllstillt\n");
+        return true;
+    } else if (key == LOG_DRAIN_KEY && SAMPLE_LOG && sample_log_ready) {
+        uint32_t oldest = sample_log.oldest_sequence();
+        printf("[LOGGUR] sýni %lu til %lu\n", (unsigned long)oldest, (unsigned long)sample_log.next_sequence());
+        sample_log.drain(oldest, output_logged_sample, nullptr);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Útskriftarlykkja kjarna 0 í pípulagningarham. Tæmir biðröðina og prentar sýnin.
+ */
+void output_loop() {
+    Sample sample;
+    uint32_t reported_overflows = 0;
+    uint64_t next_summary = time_us_64() + SUMMARY_PERIOD_US;
+
+    while (true) {
+        while (samples.pop(sample)) {
+#if PIPELINE_MODE
+            if (sample.sensor == SENSOR_BME280 && sample.channel == 0) {
+                bme_history.add(sample);
+            } else if (sample.sensor == SENSOR_SCD30) {
+                scd_history.add(sample);
+            }
+#endif
+
+            rollup_sample(sample);
+            emit_sample(sample);
+        }
+
+        uint64_t now = time_us_64();
+        if (!OUTPUT_BINARY && now >= next_summary) {
+            next_summary += SUMMARY_PERIOD_US;
+#if PIPELINE_MODE
+            bme_history.expire(now);
+            scd_history.expire(now);
+            printf("[SAMANTEKT] lágmark / meðaltal / hámark\n");
+            print_summary("Hitastig 60 s   [°C] ", bme_history.short_summary(0));
+            print_summary("Hitastig 10 mín [°C] ", bme_history.long_summary(0));
+            if (scd_connected) {
+                print_summary("CO2 60 s       [ppm] ", scd_history.short_summary(0));
+                print_summary("CO2 10 mín     [ppm] ", scd_history.long_summary(0));
+            }
+#endif
+            print_manager_stats();
+        }
+
+        if (!OUTPUT_BINARY && samples.overflows() != reported_overflows) {
+            reported_overflows = samples.overflows();
+            printf("[VILLA] Biðröð full, %lu sýnum hent.\n", (unsigned long)reported_overflows);
+        }
+        if (!OUTPUT_BINARY) poll_commands();
+        sleep_ms(10);
+    }
+}
 
 void init() {
 
@@ -27,8 +689,6 @@ void init() {
     printf("  S. Maggi Snorrason\n");
     printf("  sms70@hi.is\n\n");
 
-    sleep_ms(1000);
-
     printf("[UPPLÝSINGAR]\n");
     printf("  Skynjari: BME280 - Combined humidity and pressure sensor\n");
     printf("  I2C ræsing með Actual set baudrate %d Hz \n", i2c_init(i2c0, 400000));
@@ -39,45 +699,165 @@ void init() {
     
     gpio_set_function(PIN_BME_SDA, GPIO_FUNC_I2C);
     gpio_set_function(PIN_BME_SCL, GPIO_FUNC_I2C);
+    bus0.set_pins(PIN_BME_SDA, PIN_BME_SCL);
+    // Í pípulagningarham ræsir kjarni 1 tenginguna.
+    if (!PIPELINE_MODE) bus0.begin();
     
-    bme = BME280(i2c0, BME280_DEFAULT_I2CADDR);
-
-    sleep_ms(1000);
+    Clock* driver_clock = LOW_POWER_MODE ? (Clock*)&energy_meter : &pico_clock;
+    if (BME280_SPI) {
+        printf("  SPI ræsing með Actual set baudrate %lu Hz \n\n", (unsigned long)spi_bus.init());
+        gpio_set_function(PIN_SPI0_MISO, GPIO_FUNC_SPI);
+        gpio_set_function(PIN_SPI0_SCK, GPIO_FUNC_SPI);
+        gpio_set_function(PIN_SPI0_MOSI, GPIO_FUNC_SPI);
+        spi_bus.init_pins();
+        bme = BME280(&spi_registers, driver_clock, 0);
+    } else {
+        bme = BME280(&bus0_health, driver_clock, BME280_DEFAULT_I2CADDR);
+    }
     
-    if(!bme.init()) {
-        printf("[VILLA] Upphafsstilling misstókst!\n");
-        while(true);
+    uint64_t init_start = time_us_64();
+    // Án skynjara heldur keyrslan áfram.
+    bool init_ok = bme.init(&calibration_store);
+    uint64_t init_done = time_us_64();
+
+    if (init_ok) {
+        // Fyrsta gilda sýnið markar lok ræsingar.
+        bool first_sample = bme.measure_once();
+        uint64_t first_sample_done = time_us_64();
+
+        printf("[KEYRSLA]\n  Upphafsstilling tókst.\n");
+        printf("  Leiðréttingargögn      :  %s\n", bme.used_cached_calibration() ? "úr flassminni" : "lesin úr skynjara");
+        printf("  Upphafsstilling BME280 :  %lu µs\n", (unsigned long)(init_done - init_start));
+        if (first_sample) {
+            printf("  Fyrsta gilda sýni      :  %lu µs eftir ræsingu\n\n", (unsigned long)first_sample_done);
+        } else {
+            printf("  [VILLA] Fyrsta mæling misstókst.\n\n");
+        }
     } else {
-        printf("[KEYRSLA]\n  Upphafsstilling tókst.\n\n");
+        printf("[VILLA] Upphafsstilling misstókst!\n");
+        // Aðeins textalykkjan í loop() reynir aftur, hinir hamirnir keyra án skynjarans.
+        if (!PIPELINE_MODE && !LOW_POWER_MODE && !OUTPUT_BINARY) {
+            printf("  Reynt verður aftur úr loop() á sekúndu fresti.\n");
+        }
+        printf("\n");
     }
 
-    sleep_ms(1000);
+    if (BENCHMARK_COMPENSATION) benchmark_compensation();
+    if (BENCHMARK_CRC) benchmark_crc();
+
+    // Tvíundarrammar mega ekki fá \r skotið inn á undan 0x0A bætum.
+    if (OUTPUT_BINARY) stdio_set_translate_crlf(&stdio_usb, false);
+
+    bme_rollup.set_callback(print_rollup, (void*)"Hitastig [°C]");
+    scd_rollup.set_callback(print_rollup, (void*)"CO2     [ppm]");
+
+    if (SAMPLE_LOG) {
+        uint64_t log_start = time_us_64();
+        sample_log_ready = log_flash.valid() && sample_log.recover();
+        log_forwarded = sample_log.next_sequence();
+        uint64_t log_done = time_us_64();
+        if (!OUTPUT_BINARY && sample_log_ready) {
+            printf("[FLASSLOGGUR]\n");
+            printf("  Sýni í logginum        :  %lu til %lu\n", (unsigned long)sample_log.oldest_sequence(),
+                   (unsigned long)sample_log.next_sequence());
+            printf("  Endurheimt             :  %lu µs, %lu skemmdar síður\n\n", (unsigned long)(log_done - log_start),
+                   (unsigned long)sample_log.crc_errors());
+        } else if (!OUTPUT_BINARY) {
+            printf("[VILLA] Flasslogginn skarast á við forritið eða er ólæsilegur.\n\n");
+        }
+    }
+
+    if (PIPELINE_MODE) init_pipeline();
+    if (LOW_POWER_MODE) init_low_power();
+}
+
+/**
+ * @brief Prentar aflestur án gilda þegar engin ný mæling er til.
+ */
+void print_missing_reading() {
+    printf("[AFLESTUR]\n");
+    printf("       Hitastig :  - °C               \n");
+    printf(" Loftþrýstingur :  - hPa              \n");
+    printf("       Rakastig :  -%%                \n\n");
 }
 
 void loop() {
+    if (OUTPUT_BINARY) {
+        static uint16_t sequence = 0;
+        static absolute_time_t next = get_absolute_time();
+        if (bme.measure_once()) emit_sample(bme_sample(sequence++));
+        next = delayed_by_us(next, PIPELINE_PERIOD_US);
+        sleep_until(next);
+        return;
+    }
+
+    // Án tölvu fara mælingarnar í flassloggið í stað skjásins.
+    if (SAMPLE_LOG && sample_log_ready && !stdio_usb_connected()) {
+        static uint16_t log_sequence = 0;
+        if (bme.measure_once()) sample_log.append(bme_sample(log_sequence++));
+        sleep_ms(1000);
+        return;
+    }
+    bool forwarded = forward_log();
+
     if (bme.is_connected()) {
-        bme.read();
+        // Eftir misheppnaða mælingu eru gildin í hlutnum gömul, þau eru hvorki prentuð né notuð.
+        if (!bme.measure_once()) {
+            print_missing_reading();
+            printf("[VILLA] Mæling misstókst, reyni aftur eftir 1 s.\n");
+            sleep_ms(1000);
+            return;
+        }
+
+        // Heiltölur alla leið, engar fleytitölur á M0+ kjarnanum.
+        int32_t pressure_pa = (bme.get_pressure_q24_8() + 128) >> 8;
+        int32_t humidity_tenths = (bme.get_humidity_q22_10() * 10 + 512) >> 10;
 
         printf("[AFLESTUR]\n");
-        printf("       Hitastig :  %.2f °C            \n", bme.get_temperature());
-        printf(" Loftþrýstingur :  %.2f hPa           \n", bme.get_pressure());
-        printf("       Rakastig :  %.1f%%             \n", bme.get_humidity());
+        printf("       Hitastig :  ");
+        print_fixed(bme.get_temperature_centidegrees(), 2);
+        printf(" °C            \n");
+        printf(" Loftþrýstingur :  ");
+        print_fixed(pressure_pa, 2);
+        printf(" hPa           \n");
+        printf("       Rakastig :  ");
+        print_fixed(humidity_tenths, 1);
+        printf("%%             \n");
+
+        metrics.set_sample(bme_sample(0));
+        printf("     Daggarmark :  ");
+        print_fixed(metrics.dew_point_centidegrees(), 2);
+        printf(" °C            \n");
+        printf("  Við sjávarmál :  ");
+        print_fixed((metrics.sea_level_pressure_q24_8() + 128) >> 8, 2);
+        printf(" hPa           \n");
     } else {
-        printf("[AFLESTUR]\n");
-        printf("       Hitastig :  - °C               \n");
-        printf(" Loftþrýstingur :  - hPa              \n");
-        printf("       Rakastig :  -%%                \n\n");
-        printf("[VILLA] Skynjari aftengdur.\n");
-        while(true);
+        print_missing_reading();
+        printf("[VILLA] Skynjari aftengdur, reyni aftur eftir 1 s.\n");
+        sleep_ms(1000);
+        // Nýræsing eftir spennufall eða endurtengingu, kvörðunin kemur úr flassminni.
+        if (bme.init(&calibration_store)) printf("[KEYRSLA] Skynjari tengdur aftur.\n\n");
+        return;
     }
     
     sleep_ms(1000);
 
-    printf("\033[F\033[F\033[F\033[F");
+    // Eftir útprentun skipunar er ekki skrifað yfir síðasta aflestur.
+    if (!poll_commands() && !forwarded) printf("\033[F\033[F\033[F\033[F\033[F\033[F");
 }
 
 int main() {
     init();
+    if (PIPELINE_MODE) {
+        // Eftir þetta skrifar aðeins SampleLog í flassminnið, og stöðvar kjarna 1 á meðan.
+        multicore_launch_core1(acquisition_core);
+        output_loop();
+    }
+    if (LOW_POWER_MODE) {
+        while (1) {
+            low_power_loop();
+        }
+    }
     while(1) {
         loop();
     }